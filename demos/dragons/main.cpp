@@ -1,5 +1,6 @@
 #include "core/assert.h"
 #include "core/clock.h"
+#include "core/job_system.h"
 #include "core/log.h"
 #include "core/memory.h"
 #include "core/platform.h"
@@ -1161,7 +1162,7 @@ static void RecordPrepass(RHI::CommandBuffer& cmd,
     RHI::Buffer& meshInstanceBuffer = *(bufferInput[1].pBuffer);
     RHI::Buffer& remapBuffer = *(bufferInput[2].pBuffer);
 
-    RHI::BindIndexBuffer(cmd, sScene.indexBuffer, VK_INDEX_TYPE_UINT32);
+    BindMeshIndexBuffer(cmd, sScene, sScene.meshes[0]);
 
     u32 pushConstants[] = {
         cameraBuffer.bindlessHandle, sScene.vertexBuffer.bindlessHandle,
@@ -1220,7 +1221,7 @@ static void RecordDrawMesh(RHI::CommandBuffer& cmd,
     RHI::Texture& brdfIntegrationLUT = *(textureInput[0].pTexture);
     RHI::Texture& prefilteredMap = *(textureInput[1].pTexture);
 
-    RHI::BindIndexBuffer(cmd, sScene.indexBuffer, VK_INDEX_TYPE_UINT32);
+    BindMeshIndexBuffer(cmd, sScene, sScene.meshes[0]);
 
     u32 pushConstants[] = {cameraBuffer.bindlessHandle,
                            sScene.vertexBuffer.bindlessHandle,
@@ -1305,6 +1306,7 @@ static void DrawGUI(RHI::Device& device)
 int main(int argc, char* argv[])
 {
     InitThreadContext();
+    InitJobSystem();
     if (!InitLogger())
     {
         return -1;
@@ -1505,6 +1507,7 @@ int main(int argc, char* argv[])
     glfwTerminate();
     FLY_LOG("Shutdown successful");
     ShutdownLogger();
+    ShutdownJobSystem();
     ReleaseThreadContext();
     return 0;
 }
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "core/clock.h"
+#include "core/job_system.h"
 #include "core/log.h"
 #include "core/thread_context.h"
 
@@ -185,7 +186,6 @@ static void RecordDrawScene(RHI::CommandBuffer& cmd,
     // const RHI::Buffer& materialBuffer = scene->materialBuffer;
 
     RHI::BindGraphicsPipeline(cmd, sGraphicsPipeline);
-    RHI::BindIndexBuffer(cmd, sScene.indexBuffer, VK_INDEX_TYPE_UINT32);
 
     u32 pushConstants[] = {cameraBuffer.bindlessHandle,
                            sScene.vertexBuffer.bindlessHandle,
@@ -200,6 +200,7 @@ static void RecordDrawScene(RHI::CommandBuffer& cmd,
         {
             const Math::Mat4& model = node.transform.GetWorldMatrix();
             RHI::PushConstants(cmd, &model, sizeof(Math::Mat4));
+            BindMeshIndexBuffer(cmd, sScene, *node.mesh);
             for (u32 j = 0; j < node.mesh->submeshCount; j++)
             {
                 i32 materialIndex = node.mesh->submeshes[j].materialIndex;
@@ -236,6 +237,7 @@ static void DrawScene(RHI::Device& device)
 int main(int argc, char* argv[])
 {
     InitThreadContext();
+    InitJobSystem();
     Arena& arena = GetScratchArena();
     if (!InitLogger())
     {
@@ -348,6 +350,7 @@ int main(int argc, char* argv[])
     FLY_LOG("Shutdown successful");
 
     ShutdownLogger();
+    ShutdownJobSystem();
     ReleaseThreadContext();
     return 0;
 }
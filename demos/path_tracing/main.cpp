@@ -7,6 +7,7 @@
 #include "core/thread_context.h"
 
 #include "math/mat.h"
+#include "math/random.h"
 
 #include "rhi/acceleration_structure.h"
 #include "rhi/buffer.h"
@@ -37,6 +38,7 @@ struct SphereData
 };
 
 static u32 sInstanceCount = 500;
+static u64 sSceneSeed = 2025;
 static u32 sCurrentSample = 0;
 static u32 sSampleCount = 16384;
 static bool sWindowResized = false;
@@ -212,18 +214,21 @@ static bool CreateResources(RHI::Device& device)
     sphereData[0].center = Math::Vec3(0.0f, -348500.0f, 0.0f);
     sphereData[0].radius = 348500.0f;
     sphereData[0].albedo = Math::Vec3(0.8f);
-    sphereData[0].reflectionCoeff = Math::RandomF32(0.0f, 1.0f);
+    // One stream per instance, the layout does not depend on generation order
+    Math::RandomStream rng = Math::CreateRandomStream(sSceneSeed, 0);
+    sphereData[0].reflectionCoeff = Math::NextF32(rng);
 
     for (u32 i = 1; i < sInstanceCount; i++)
     {
-        sphereData[i].center = Math::Vec3(Math::RandomF32(-100.0f, 100.0f),
-                                          Math::RandomF32(0.0f, 50.0f),
-                                          Math::RandomF32(-100.0f, 100.0f));
-        sphereData[i].radius = Math::RandomF32(0.25f, 8.0f);
+        rng = Math::CreateRandomStream(sSceneSeed, i);
+        sphereData[i].center = Math::Vec3(Math::NextF32(rng, -100.0f, 100.0f),
+                                          Math::NextF32(rng, 0.0f, 50.0f),
+                                          Math::NextF32(rng, -100.0f, 100.0f));
+        sphereData[i].radius = Math::NextF32(rng, 0.25f, 8.0f);
         sphereData[i].albedo =
-            Math::Vec3(Math::RandomF32(0.0f, 1.0f), Math::RandomF32(0.0f, 1.0f),
-                       Math::RandomF32(0.0f, 1.0f));
-        sphereData[i].reflectionCoeff = Math::RandomF32(0.0f, 1.0f);
+            Math::Vec3(Math::NextF32(rng), Math::NextF32(rng),
+                       Math::NextF32(rng));
+        sphereData[i].reflectionCoeff = Math::NextF32(rng);
     }
 
     for (u32 i = 0; i < sInstanceCount; i++)
@@ -5,10 +5,20 @@ def _cook_images_impl(ctx):
         outs.append(out)
 
     extra_options = []
-    if ctx.attr.generate_mips:
+    if ctx.attr.generate_mips and ctx.attr.mips_from_base_level:
+        extra_options.append("-mhq")
+    elif ctx.attr.generate_mips:
         extra_options.append("-m")
-    if ctx.attr.eq2cube:
+    if ctx.attr.eq2cube and ctx.attr.eq2cube_filter != "gpu":
+        extra_options.append("-eq2cube-cpu")
+        extra_options.append(ctx.attr.eq2cube_filter)
+    elif ctx.attr.eq2cube:
         extra_options.append("-eq2cube")
+    extra_options.append("-q")
+    extra_options.append(ctx.attr.bc_quality)
+    if ctx.attr.memory_budget_mb > 0:
+        extra_options.append("-budget")
+        extra_options.append(str(ctx.attr.memory_budget_mb))
 
     ctx.actions.run(
         inputs = ctx.files.inputs,
@@ -56,6 +66,10 @@ def _cook_scenes_impl(ctx):
         extra_options.append("-nn")
     if not ctx.attr.export_materials:
         extra_options.append("-nm")
+    if not ctx.attr.compress_geometry:
+        extra_options.append("-nc")
+    if ctx.attr.orm_bc7:
+        extra_options.append("-orm7")
 
     ctx.actions.run(
         inputs = ctx.files.inputs,
@@ -106,7 +120,17 @@ cook_images = rule(
             allow_files = True,
         ),
         "generate_mips": attr.bool(),
+        "mips_from_base_level": attr.bool(),
         "eq2cube": attr.bool(),
+        "eq2cube_filter": attr.string(
+            default = "gpu",
+            values = ["gpu", "nearest", "bilinear", "bicubic"],
+        ),
+        "bc_quality": attr.string(
+            default = "normal",
+            values = ["fast", "normal", "high"],
+        ),
+        "memory_budget_mb": attr.int(default = 0),
         "_command": attr.label(
             cfg = "exec",
             executable = True,
@@ -158,6 +182,12 @@ cook_scenes = rule(
         "export_materials": attr.bool(
             default = True,
         ),
+        "compress_geometry": attr.bool(
+            default = True,
+        ),
+        "orm_bc7": attr.bool(
+            default = False,
+        ),
     },
 )
 
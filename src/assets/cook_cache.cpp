@@ -0,0 +1,127 @@
+#include <atomic>
+#include <stdio.h>
+
+#include "core/filesystem.h"
+#include "core/memory.h"
+#include "core/thread_context.h"
+
+#include "cook_cache.h"
+
+#if defined(FLY_PLATFORM_OS_WINDOWS)
+#include <process.h>
+#define FLY_GET_PROCESS_ID() _getpid()
+#else
+#include <unistd.h>
+#define FLY_GET_PROCESS_ID() getpid()
+#endif
+
+namespace Fly
+{
+
+static String8 GetExtension(String8 path)
+{
+    String8 extension = String8::FindLast(path, '.');
+    String8 separator = String8::FindLast(path, '/');
+    if (separator && extension.Size() > separator.Size())
+    {
+        return String8();
+    }
+    return extension;
+}
+
+bool HashCookInput(String8 path, u64& key)
+{
+    // Mapped, so inputs of any size stay out of the arenas
+    MappedFile file;
+    if (!MapFile(path, file))
+    {
+        // MapFile rejects empty files
+        if (!FileExists(path))
+        {
+            return false;
+        }
+        HashCookInput(nullptr, 0, key);
+        return true;
+    }
+
+    HashCookInput(file.data, file.size, key);
+    UnmapFile(file);
+    return true;
+}
+
+void HashCookInput(const void* data, u64 size, u64& key)
+{
+    HashCookOption(size, key);
+    if (size > 0)
+    {
+        key = Hash64(data, size, key);
+    }
+}
+
+String8 GetCookCachePath(Arena& arena, String8 directory, u64 key,
+                         String8 extension)
+{
+    // Separator, 16 hex digits and the null terminator
+    u64 size = directory.Size() + extension.Size() + 18;
+    char* buffer = FLY_PUSH_ARENA(arena, char, size);
+    i32 length = snprintf(buffer, size, "%.*s/%016llx%.*s",
+                          static_cast<int>(directory.Size()), directory.Data(),
+                          static_cast<unsigned long long>(key),
+                          static_cast<int>(extension.Size()),
+                          extension.Data());
+    return String8(buffer, static_cast<u64>(length));
+}
+
+String8 GetCookCacheTempPath(Arena& arena, String8 cachePath,
+                             String8 extension)
+{
+    // Lanes and other cooker processes may store the same key at once
+    static std::atomic<u64> sTmpCounter{0};
+    u64 tmpIndex = sTmpCounter.fetch_add(1, std::memory_order_relaxed);
+    u64 size = cachePath.Size() + extension.Size() + 64;
+    char* buffer = FLY_PUSH_ARENA(arena, char, size);
+    i32 length = snprintf(buffer, size, "%.*s.%lld.%llu.tmp%.*s",
+                          static_cast<int>(cachePath.Size()), cachePath.Data(),
+                          static_cast<long long>(FLY_GET_PROCESS_ID()),
+                          static_cast<unsigned long long>(tmpIndex),
+                          static_cast<int>(extension.Size()),
+                          extension.Data());
+    return String8(buffer, static_cast<u64>(length));
+}
+
+bool FetchFromCookCache(String8 directory, u64 key, String8 outputPath)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    String8 cachePath =
+        GetCookCachePath(scratch, directory, key, GetExtension(outputPath));
+    bool result =
+        FileExists(cachePath) && LinkOrCopyFile(cachePath, outputPath);
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool StoreInCookCache(String8 directory, u64 key, String8 outputPath)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    String8 cachePath =
+        GetCookCachePath(scratch, directory, key, GetExtension(outputPath));
+    String8 tmpPath = GetCookCacheTempPath(scratch, cachePath);
+
+    bool result = CreateDirectories(cachePath) &&
+                  LinkOrCopyFile(outputPath, tmpPath);
+    if (result && !RenameFile(tmpPath, cachePath))
+    {
+        RemoveFile(tmpPath);
+        result = false;
+    }
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+} // namespace Fly
@@ -0,0 +1,47 @@
+#ifndef FLY_ASSETS_COOK_CACHE_H
+#define FLY_ASSETS_COOK_CACHE_H
+
+#include "core/hash.h"
+#include "core/string8.h"
+
+// Bump whenever a cooker writes different output for the same input
+#define FLY_COOK_CACHE_VERSION 9ull
+
+namespace Fly
+{
+struct Arena;
+
+// Cooked files live in a cache directory, named by a key and the extension
+// of the output. The key is the hash of the input bytes and of every option
+// that changes the output, seeded with FLY_COOK_CACHE_VERSION.
+
+// False if the file can not be read
+bool HashCookInput(String8 path, u64& key);
+void HashCookInput(const void* data, u64 size, u64& key);
+
+// Value must not contain padding bytes
+template <typename T>
+inline void HashCookOption(const T& value, u64& key)
+{
+    key = Hash64(&value, sizeof(T), key);
+}
+
+String8 GetCookCachePath(Arena& arena, String8 directory, u64 key,
+                         String8 extension);
+
+// Unique across cooker processes and calls. Entries are written here and
+// renamed to cachePath, so other cookers never see a partial file. The
+// extension is appended for writers that pick the format from it.
+String8 GetCookCacheTempPath(Arena& arena, String8 cachePath,
+                             String8 extension = String8());
+
+// Links or copies the entry to outputPath, false if there is none. The
+// output may share storage with the entry afterwards, remove it before
+// cooking into the same path again.
+bool FetchFromCookCache(String8 directory, u64 key, String8 outputPath);
+// Copies outputPath into the cache through GetCookCacheTempPath
+bool StoreInCookCache(String8 directory, u64 key, String8 outputPath);
+
+} // namespace Fly
+
+#endif /* FLY_ASSETS_COOK_CACHE_H */
@@ -0,0 +1,1357 @@
+#include <string.h>
+
+#include "core/assert.h"
+#include "math/functions.h"
+#include "math/simd.h"
+
+#include "bc_compression.h"
+
+// BC block encoders. Endpoints start on the principal axis of the texels of a
+// subset and are refined with least squares against the chosen indices,
+// index search is vectorized over four texels at a time.
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+namespace Fly
+{
+
+using Math::F32x4;
+
+static const u8 sWeights2[4] = {0, 21, 43, 64};
+static const u8 sWeights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const u8 sWeights4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                 34, 38, 43, 47, 51, 55, 60, 64};
+
+// Bit i is set when texel i belongs to the second subset
+static const u16 sPartitions2[64] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22};
+
+// Anchor texel of the second subset, its index has an implicit zero msb
+static const u8 sAnchors2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2,  8,  2,  2,  8,  8,  15, 2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15, 6,  8,  2,  8,  15, 15, 2,  8,  2,  2,  2,  15, 15, 6,
+    6,  2,  6,  8,  15, 15, 2,  2,  15, 15, 15, 15, 15, 2,  2,  15};
+
+static const u8* GetWeights(u32 indexBits)
+{
+    switch (indexBits)
+    {
+        case 2:
+        {
+            return sWeights2;
+        }
+        case 3:
+        {
+            return sWeights3;
+        }
+        default:
+        {
+            return sWeights4;
+        }
+    }
+}
+
+struct BlockWriter
+{
+    u64 bits[2] = {};
+    u32 offset = 0;
+
+    void Write(u32 value, u32 count)
+    {
+        for (u32 i = 0; i < count; i++, offset++)
+        {
+            u64 bit = (value >> i) & 1u;
+            bits[offset >> 6] |= bit << (offset & 63);
+        }
+    }
+
+    void Store(u8* dst) const
+    {
+        FLY_ASSERT(offset == 128);
+        for (u32 i = 0; i < 16; i++)
+        {
+            dst[i] = static_cast<u8>(bits[i >> 3] >> ((i & 7) * 8));
+        }
+    }
+};
+
+// Texels of one subset as structure of arrays. Lanes past count repeat the
+// first texel so that whole vectors can always be loaded.
+struct SubsetTexels
+{
+    f32 c[4][16];
+    u32 count = 0;
+    u32 channelCount = 0;
+};
+
+static void PadSubset(SubsetTexels& texels)
+{
+    FLY_ASSERT(texels.count);
+    u32 paddedCount = (texels.count + 3) & ~3u;
+    for (u32 i = texels.count; i < paddedCount; i++)
+    {
+        for (u32 c = 0; c < 4; c++)
+        {
+            texels.c[c][i] = texels.c[c][0];
+        }
+    }
+}
+
+static void PrincipalAxis(const SubsetTexels& texels, f32 mean[4],
+                          f32 axis[4])
+{
+    const u32 channelCount = texels.channelCount;
+    const f32 invCount = 1.0f / texels.count;
+
+    for (u32 c = 0; c < 4; c++)
+    {
+        mean[c] = 0.0f;
+        axis[c] = 0.0f;
+    }
+    for (u32 c = 0; c < channelCount; c++)
+    {
+        for (u32 i = 0; i < texels.count; i++)
+        {
+            mean[c] += texels.c[c][i];
+        }
+        mean[c] *= invCount;
+    }
+
+    f32 cov[4][4] = {};
+    for (u32 i = 0; i < texels.count; i++)
+    {
+        f32 d[4];
+        for (u32 c = 0; c < channelCount; c++)
+        {
+            d[c] = texels.c[c][i] - mean[c];
+        }
+        for (u32 a = 0; a < channelCount; a++)
+        {
+            for (u32 b = a; b < channelCount; b++)
+            {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    // Power iteration, starting from the channel with the largest variance
+    u32 maxChannel = 0;
+    for (u32 a = 0; a < channelCount; a++)
+    {
+        for (u32 b = 0; b < a; b++)
+        {
+            cov[a][b] = cov[b][a];
+        }
+        if (cov[a][a] > cov[maxChannel][maxChannel])
+        {
+            maxChannel = a;
+        }
+    }
+
+    f32 v[4] = {};
+    for (u32 a = 0; a < channelCount; a++)
+    {
+        v[a] = cov[maxChannel][a];
+    }
+    for (u32 iteration = 0; iteration < 8; iteration++)
+    {
+        f32 next[4] = {};
+        f32 maxComponent = 0.0f;
+        for (u32 a = 0; a < channelCount; a++)
+        {
+            for (u32 b = 0; b < channelCount; b++)
+            {
+                next[a] += cov[a][b] * v[b];
+            }
+            maxComponent = MAX(maxComponent, next[a] < 0 ? -next[a] : next[a]);
+        }
+        if (maxComponent < 1e-12f)
+        {
+            break;
+        }
+        for (u32 a = 0; a < channelCount; a++)
+        {
+            v[a] = next[a] / maxComponent;
+        }
+    }
+
+    f32 lengthSqr = 0.0f;
+    for (u32 a = 0; a < channelCount; a++)
+    {
+        lengthSqr += v[a] * v[a];
+    }
+    if (lengthSqr < 1e-12f)
+    {
+        // Constant subset
+        axis[0] = 1.0f;
+        return;
+    }
+    f32 invLength = 1.0f / Math::Sqrt(lengthSqr);
+    for (u32 a = 0; a < channelCount; a++)
+    {
+        axis[a] = v[a] * invLength;
+    }
+}
+
+static void AxisEndpoints(const SubsetTexels& texels, f32 maxValue,
+                          f32 endpoints[2][4])
+{
+    f32 mean[4];
+    f32 axis[4];
+    PrincipalAxis(texels, mean, axis);
+
+    f32 minT = MaxF32();
+    f32 maxT = -MaxF32();
+    for (u32 i = 0; i < texels.count; i++)
+    {
+        f32 t = 0.0f;
+        for (u32 c = 0; c < texels.channelCount; c++)
+        {
+            t += (texels.c[c][i] - mean[c]) * axis[c];
+        }
+        minT = MIN(minT, t);
+        maxT = MAX(maxT, t);
+    }
+
+    for (u32 c = 0; c < texels.channelCount; c++)
+    {
+        endpoints[0][c] = Math::Clamp(mean[c] + axis[c] * minT, 0.0f, maxValue);
+        endpoints[1][c] = Math::Clamp(mean[c] + axis[c] * maxT, 0.0f, maxValue);
+    }
+}
+
+// Picks the closest palette entry for every texel, returns the summed
+// squared error
+static f32 FindIndices(const SubsetTexels& texels, const f32 palette[][4],
+                       u32 paletteSize, u8* indices)
+{
+    const u32 channelCount = texels.channelCount;
+
+    f32 error = 0.0f;
+    for (u32 i = 0; i < texels.count; i += 4)
+    {
+        F32x4 values[4];
+        for (u32 c = 0; c < channelCount; c++)
+        {
+            values[c] = Math::LoadF32x4(texels.c[c] + i);
+        }
+
+        F32x4 bestError = Math::SplatF32x4(MaxF32());
+        F32x4 bestIndex = Math::SplatF32x4(0.0f);
+        for (u32 k = 0; k < paletteSize; k++)
+        {
+            F32x4 d = values[0] - Math::SplatF32x4(palette[k][0]);
+            F32x4 e = d * d;
+            for (u32 c = 1; c < channelCount; c++)
+            {
+                d = values[c] - Math::SplatF32x4(palette[k][c]);
+                e = Math::MulAdd(d, d, e);
+            }
+            F32x4 less = Math::CmpLt(e, bestError);
+            bestError = Math::Select(less, e, bestError);
+            F32x4 index = Math::SplatF32x4(static_cast<f32>(k));
+            bestIndex = Math::Select(less, index, bestIndex);
+        }
+
+        f32 laneErrors[4];
+        f32 laneIndices[4];
+        Math::StoreF32x4(laneErrors, bestError);
+        Math::StoreF32x4(laneIndices, bestIndex);
+        for (u32 j = 0; j < 4 && i + j < texels.count; j++)
+        {
+            error += laneErrors[j];
+            indices[i + j] = static_cast<u8>(laneIndices[j]);
+        }
+    }
+    return error;
+}
+
+// Endpoints that minimize the squared error for fixed indices. The weight
+// of the second endpoint for index k is weights[k] * weightScale.
+static bool LeastSquaresEndpoints(const SubsetTexels& texels, const u8* indices,
+                                  const u8* weights, f32 weightScale,
+                                  f32 maxValue, f32 endpoints[2][4])
+{
+    f32 aa = 0.0f;
+    f32 ab = 0.0f;
+    f32 bb = 0.0f;
+    f32 ax[4] = {};
+    f32 bx[4] = {};
+    for (u32 i = 0; i < texels.count; i++)
+    {
+        f32 b = weights[indices[i]] * weightScale;
+        f32 a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (u32 c = 0; c < texels.channelCount; c++)
+        {
+            ax[c] += a * texels.c[c][i];
+            bx[c] += b * texels.c[c][i];
+        }
+    }
+
+    f32 det = aa * bb - ab * ab;
+    if (det < 1e-6f)
+    {
+        return false;
+    }
+
+    f32 invDet = 1.0f / det;
+    for (u32 c = 0; c < texels.channelCount; c++)
+    {
+        f32 e0 = (bb * ax[c] - ab * bx[c]) * invDet;
+        f32 e1 = (aa * bx[c] - ab * ax[c]) * invDet;
+        endpoints[0][c] = Math::Clamp(e0, 0.0f, maxValue);
+        endpoints[1][c] = Math::Clamp(e1, 0.0f, maxValue);
+    }
+    return true;
+}
+
+static u32 IterationCount(BCQuality quality)
+{
+    switch (quality)
+    {
+        case BCQuality::Fast:
+        {
+            return 1;
+        }
+        case BCQuality::Normal:
+        {
+            return 2;
+        }
+        default:
+        {
+            return 4;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////
+// BC7
+
+enum BC7PBit
+{
+    BC7_PBIT_NONE,
+    BC7_PBIT_SHARED,
+    BC7_PBIT_UNIQUE,
+};
+
+struct BC7Format
+{
+    u32 bits;
+    BC7PBit pbit;
+    u32 indexBits;
+};
+
+struct BC7Endpoints
+{
+    u8 q[2][4] = {};
+    u8 p[2] = {};
+    u8 decoded[2][4] = {};
+};
+
+static u8 DequantizeBC7(u32 q, u32 p, u32 bits, bool hasPBit)
+{
+    u32 value = hasPBit ? (q << 1) | p : q;
+    u32 precision = bits + (hasPBit ? 1 : 0);
+    if (precision >= 8)
+    {
+        return static_cast<u8>(value);
+    }
+    value <<= 8 - precision;
+    return static_cast<u8>(value | (value >> precision));
+}
+
+static void QuantizeBC7(const f32 endpoints[2][4], u32 channelCount,
+                        const BC7Format& format, u32 p0, u32 p1,
+                        BC7Endpoints& result)
+{
+    const bool hasPBit = format.pbit != BC7_PBIT_NONE;
+    const u32 maxQ = (1u << format.bits) - 1;
+
+    result.p[0] = static_cast<u8>(p0);
+    result.p[1] = static_cast<u8>(p1);
+    for (u32 k = 0; k < 2; k++)
+    {
+        for (u32 c = 0; c < channelCount; c++)
+        {
+            f32 target = endpoints[k][c];
+            i32 guess = static_cast<i32>(target * maxQ / 255.0f + 0.5f);
+
+            u32 bestQ = 0;
+            f32 bestError = MaxF32();
+            for (i32 q = guess - 1; q <= guess + 1; q++)
+            {
+                if (q < 0 || q > static_cast<i32>(maxQ))
+                {
+                    continue;
+                }
+                f32 d =
+                    DequantizeBC7(q, result.p[k], format.bits, hasPBit) -
+                    target;
+                if (d * d < bestError)
+                {
+                    bestError = d * d;
+                    bestQ = q;
+                }
+            }
+            result.q[k][c] = static_cast<u8>(bestQ);
+            result.decoded[k][c] =
+                DequantizeBC7(bestQ, result.p[k], format.bits, hasPBit);
+        }
+    }
+}
+
+static f32 EvaluateBC7(const SubsetTexels& texels, const BC7Format& format,
+                       const BC7Endpoints& endpoints, u8* indices)
+{
+    const u8* weights = GetWeights(format.indexBits);
+    const u32 paletteSize = 1u << format.indexBits;
+
+    f32 palette[16][4];
+    for (u32 k = 0; k < paletteSize; k++)
+    {
+        for (u32 c = 0; c < texels.channelCount; c++)
+        {
+            u32 e0 = endpoints.decoded[0][c];
+            u32 e1 = endpoints.decoded[1][c];
+            palette[k][c] = static_cast<f32>(
+                ((64 - weights[k]) * e0 + weights[k] * e1 + 32) >> 6);
+        }
+    }
+    return FindIndices(texels, palette, paletteSize, indices);
+}
+
+static f32 FitBC7(const SubsetTexels& texels, const BC7Format& format,
+                  u32 iterationCount, BC7Endpoints& bestEndpoints,
+                  u8* bestIndices)
+{
+    f32 endpoints[2][4] = {};
+    AxisEndpoints(texels, 255.0f, endpoints);
+
+    u32 pbitComboCount = 1;
+    if (format.pbit == BC7_PBIT_SHARED)
+    {
+        pbitComboCount = 2;
+    }
+    else if (format.pbit == BC7_PBIT_UNIQUE)
+    {
+        pbitComboCount = 4;
+    }
+
+    f32 bestError = MaxF32();
+    for (u32 iteration = 0; iteration < iterationCount; iteration++)
+    {
+        f32 iterationError = bestError;
+        for (u32 combo = 0; combo < pbitComboCount; combo++)
+        {
+            u32 p0 = combo & 1;
+            u32 p1 = format.pbit == BC7_PBIT_SHARED ? p0 : combo >> 1;
+
+            BC7Endpoints candidate;
+            u8 indices[16];
+            QuantizeBC7(endpoints, texels.channelCount, format, p0, p1,
+                        candidate);
+            f32 error = EvaluateBC7(texels, format, candidate, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestEndpoints = candidate;
+                memcpy(bestIndices, indices, texels.count);
+            }
+        }
+
+        if (bestError == 0.0f || bestError >= iterationError ||
+            !LeastSquaresEndpoints(texels, bestIndices,
+                                   GetWeights(format.indexBits), 1.0f / 64.0f,
+                                   255.0f, endpoints))
+        {
+            break;
+        }
+    }
+    return bestError;
+}
+
+// Swaps the endpoints when the anchor index has its msb set, as the msb of
+// anchor indices is not stored
+static void FixAnchor(BC7Endpoints& endpoints, u32 indexBits, u8* indices,
+                      u32 count)
+{
+    const u32 maxIndex = (1u << indexBits) - 1;
+    if (!(indices[0] >> (indexBits - 1)))
+    {
+        return;
+    }
+
+    for (u32 c = 0; c < 4; c++)
+    {
+        u8 tmp = endpoints.q[0][c];
+        endpoints.q[0][c] = endpoints.q[1][c];
+        endpoints.q[1][c] = tmp;
+    }
+    u8 tmp = endpoints.p[0];
+    endpoints.p[0] = endpoints.p[1];
+    endpoints.p[1] = tmp;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        indices[i] = static_cast<u8>(maxIndex - indices[i]);
+    }
+}
+
+struct BC7Block
+{
+    u8 texels[16][4];
+    bool opaque;
+};
+
+static void GatherSubset(const BC7Block& block, u16 mask, u32 subset,
+                         u32 channelCount, SubsetTexels& texels, u8* order)
+{
+    texels.count = 0;
+    texels.channelCount = channelCount;
+    for (u32 i = 0; i < 16; i++)
+    {
+        if (((mask >> i) & 1u) != subset)
+        {
+            continue;
+        }
+        for (u32 c = 0; c < channelCount; c++)
+        {
+            texels.c[c][texels.count] = block.texels[i][c];
+        }
+        order[texels.count++] = static_cast<u8>(i);
+    }
+    PadSubset(texels);
+}
+
+static f32 EncodeBC7Mode6(const BC7Block& block, BCQuality quality,
+                          BlockWriter& writer)
+{
+    const BC7Format format = {7, BC7_PBIT_UNIQUE, 4};
+
+    SubsetTexels texels;
+    u8 order[16];
+    GatherSubset(block, 0, 0, 4, texels, order);
+
+    BC7Endpoints endpoints;
+    u8 indices[16];
+    f32 error =
+        FitBC7(texels, format, IterationCount(quality), endpoints, indices);
+    FixAnchor(endpoints, format.indexBits, indices, 16);
+
+    writer.Write(1u << 6, 7);
+    for (u32 c = 0; c < 4; c++)
+    {
+        writer.Write(endpoints.q[0][c], 7);
+        writer.Write(endpoints.q[1][c], 7);
+    }
+    writer.Write(endpoints.p[0], 1);
+    writer.Write(endpoints.p[1], 1);
+    for (u32 i = 0; i < 16; i++)
+    {
+        writer.Write(indices[i], i == 0 ? 3 : 4);
+    }
+    return error;
+}
+
+static f32 EncodeBC7Mode5(const BC7Block& block, BCQuality quality,
+                          BlockWriter& writer)
+{
+    const BC7Format colorFormat = {7, BC7_PBIT_NONE, 2};
+    const BC7Format alphaFormat = {8, BC7_PBIT_NONE, 2};
+    const u32 iterationCount = IterationCount(quality);
+    const u32 rotationCount = quality == BCQuality::High ? 4 : 1;
+
+    f32 bestError = MaxF32();
+    u32 bestRotation = 0;
+    BC7Endpoints bestColor;
+    BC7Endpoints bestAlpha;
+    u8 bestColorIndices[16];
+    u8 bestAlphaIndices[16];
+
+    for (u32 rotation = 0; rotation < rotationCount; rotation++)
+    {
+        // Rotation r swaps alpha with channel r - 1 after decoding
+        SubsetTexels color;
+        SubsetTexels alpha;
+        color.count = alpha.count = 16;
+        color.channelCount = 3;
+        alpha.channelCount = 1;
+        for (u32 i = 0; i < 16; i++)
+        {
+            for (u32 c = 0; c < 3; c++)
+            {
+                color.c[c][i] = block.texels[i][c];
+            }
+            alpha.c[0][i] = block.texels[i][3];
+            if (rotation)
+            {
+                color.c[rotation - 1][i] = block.texels[i][3];
+                alpha.c[0][i] = block.texels[i][rotation - 1];
+            }
+        }
+
+        BC7Endpoints colorEndpoints;
+        BC7Endpoints alphaEndpoints;
+        u8 colorIndices[16];
+        u8 alphaIndices[16];
+        f32 error = FitBC7(color, colorFormat, iterationCount, colorEndpoints,
+                           colorIndices);
+        error += FitBC7(alpha, alphaFormat, iterationCount, alphaEndpoints,
+                        alphaIndices);
+        if (error < bestError)
+        {
+            bestError = error;
+            bestRotation = rotation;
+            bestColor = colorEndpoints;
+            bestAlpha = alphaEndpoints;
+            memcpy(bestColorIndices, colorIndices, 16);
+            memcpy(bestAlphaIndices, alphaIndices, 16);
+        }
+    }
+
+    FixAnchor(bestColor, colorFormat.indexBits, bestColorIndices, 16);
+    FixAnchor(bestAlpha, alphaFormat.indexBits, bestAlphaIndices, 16);
+
+    writer.Write(1u << 5, 6);
+    writer.Write(bestRotation, 2);
+    for (u32 c = 0; c < 3; c++)
+    {
+        writer.Write(bestColor.q[0][c], 7);
+        writer.Write(bestColor.q[1][c], 7);
+    }
+    writer.Write(bestAlpha.q[0][0], 8);
+    writer.Write(bestAlpha.q[1][0], 8);
+    for (u32 i = 0; i < 16; i++)
+    {
+        writer.Write(bestColorIndices[i], i == 0 ? 1 : 2);
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+        writer.Write(bestAlphaIndices[i], i == 0 ? 1 : 2);
+    }
+    return bestError;
+}
+
+// Error left after projecting every subset on its principal axis, a cheap
+// estimate of how well a partition can be encoded
+static f32 EstimatePartitionError(const BC7Block& block, u16 mask)
+{
+    f32 error = 0.0f;
+    for (u32 subset = 0; subset < 2; subset++)
+    {
+        SubsetTexels texels;
+        u8 order[16];
+        GatherSubset(block, mask, subset, 3, texels, order);
+
+        f32 mean[4];
+        f32 axis[4];
+        PrincipalAxis(texels, mean, axis);
+        for (u32 i = 0; i < texels.count; i++)
+        {
+            f32 d[3];
+            f32 t = 0.0f;
+            for (u32 c = 0; c < 3; c++)
+            {
+                d[c] = texels.c[c][i] - mean[c];
+                t += d[c] * axis[c];
+            }
+            for (u32 c = 0; c < 3; c++)
+            {
+                f32 r = d[c] - t * axis[c];
+                error += r * r;
+            }
+        }
+    }
+    return error;
+}
+
+static u32 SelectPartitions(const BC7Block& block, u32 maxCount,
+                            u32* partitions)
+{
+    f32 errors[64];
+    for (u32 i = 0; i < 64; i++)
+    {
+        errors[i] = EstimatePartitionError(block, sPartitions2[i]);
+    }
+
+    // Partial selection sort of the best candidates
+    u32 count = 0;
+    for (; count < maxCount; count++)
+    {
+        u32 best = 0;
+        for (u32 i = 1; i < 64; i++)
+        {
+            if (errors[i] < errors[best])
+            {
+                best = i;
+            }
+        }
+        partitions[count] = best;
+        errors[best] = MaxF32();
+    }
+    return count;
+}
+
+// Modes 1 and 3, two subsets without alpha
+static f32 EncodeBC7TwoSubsets(const BC7Block& block, u32 mode,
+                               const u32* partitions, u32 partitionCount,
+                               BCQuality quality, BlockWriter& writer)
+{
+    const BC7Format format = mode == 1 ? BC7Format{6, BC7_PBIT_SHARED, 3}
+                                       : BC7Format{7, BC7_PBIT_UNIQUE, 2};
+    const u32 iterationCount = IterationCount(quality);
+
+    f32 bestError = MaxF32();
+    u32 bestPartition = 0;
+    BC7Endpoints bestEndpoints[2];
+    u8 bestIndices[16] = {};
+
+    for (u32 n = 0; n < partitionCount; n++)
+    {
+        const u32 partition = partitions[n];
+        const u16 mask = sPartitions2[partition];
+
+        f32 error = 0.0f;
+        BC7Endpoints endpoints[2];
+        u8 indices[16];
+        for (u32 subset = 0; subset < 2 && error < bestError; subset++)
+        {
+            SubsetTexels texels;
+            u8 order[16];
+            u8 subsetIndices[16];
+            GatherSubset(block, mask, subset, 3, texels, order);
+            error += FitBC7(texels, format, iterationCount, endpoints[subset],
+                            subsetIndices);
+
+            // Anchors are texel 0 and the partition's anchor texel
+            u32 anchor = subset ? sAnchors2[partition] : 0;
+            u32 anchorPosition = 0;
+            while (order[anchorPosition] != anchor)
+            {
+                anchorPosition++;
+            }
+            u8 tmp = subsetIndices[0];
+            subsetIndices[0] = subsetIndices[anchorPosition];
+            subsetIndices[anchorPosition] = tmp;
+            FixAnchor(endpoints[subset], format.indexBits, subsetIndices,
+                      texels.count);
+            tmp = subsetIndices[0];
+            subsetIndices[0] = subsetIndices[anchorPosition];
+            subsetIndices[anchorPosition] = tmp;
+
+            for (u32 i = 0; i < texels.count; i++)
+            {
+                indices[order[i]] = subsetIndices[i];
+            }
+        }
+
+        if (error < bestError)
+        {
+            bestError = error;
+            bestPartition = partition;
+            bestEndpoints[0] = endpoints[0];
+            bestEndpoints[1] = endpoints[1];
+            memcpy(bestIndices, indices, 16);
+        }
+    }
+
+    const u32 anchor = sAnchors2[bestPartition];
+    writer.Write(1u << mode, mode + 1);
+    writer.Write(bestPartition, 6);
+    for (u32 c = 0; c < 3; c++)
+    {
+        for (u32 subset = 0; subset < 2; subset++)
+        {
+            writer.Write(bestEndpoints[subset].q[0][c], format.bits);
+            writer.Write(bestEndpoints[subset].q[1][c], format.bits);
+        }
+    }
+    for (u32 subset = 0; subset < 2; subset++)
+    {
+        writer.Write(bestEndpoints[subset].p[0], 1);
+        if (format.pbit == BC7_PBIT_UNIQUE)
+        {
+            writer.Write(bestEndpoints[subset].p[1], 1);
+        }
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+        bool isAnchor = i == 0 || i == anchor;
+        writer.Write(bestIndices[i], format.indexBits - (isAnchor ? 1 : 0));
+    }
+    return bestError;
+}
+
+void CompressBlockBC7(u8* dst, const u8* texels, BCQuality quality)
+{
+    FLY_ASSERT(dst);
+    FLY_ASSERT(texels);
+
+    BC7Block block;
+    memcpy(block.texels, texels, sizeof(block.texels));
+    block.opaque = true;
+    for (u32 i = 0; i < 16; i++)
+    {
+        block.opaque = block.opaque && texels[i * 4 + 3] == 255;
+    }
+
+    BlockWriter best;
+    f32 bestError = EncodeBC7Mode6(block, quality, best);
+
+    if (quality != BCQuality::Fast && bestError > 0.0f)
+    {
+        BlockWriter writer;
+        f32 error = EncodeBC7Mode5(block, quality, writer);
+        if (error < bestError)
+        {
+            bestError = error;
+            best = writer;
+        }
+    }
+
+    if (quality != BCQuality::Fast && block.opaque && bestError > 0.0f)
+    {
+        u32 partitions[64];
+        u32 partitionCount = SelectPartitions(
+            block, quality == BCQuality::High ? 8 : 2, partitions);
+
+        BlockWriter writer;
+        f32 error = EncodeBC7TwoSubsets(block, 1, partitions, partitionCount,
+                                        quality, writer);
+        if (error < bestError)
+        {
+            bestError = error;
+            best = writer;
+        }
+
+        if (quality == BCQuality::High)
+        {
+            writer = BlockWriter();
+            error = EncodeBC7TwoSubsets(block, 3, partitions, partitionCount,
+                                        quality, writer);
+            if (error < bestError)
+            {
+                bestError = error;
+                best = writer;
+            }
+        }
+    }
+
+    best.Store(dst);
+}
+
+////////////////////////////////////////////////////////////////////////////
+// BC6H
+
+// Encoding works on half bit patterns, which BC6H interpolates linearly.
+// Only mode 11, one region with 10 bit endpoints, is used.
+#define BC6H_MAX_HALF 31743.0f // 0x7bff
+
+static u32 UnquantizeBC6H(u32 q)
+{
+    if (q == 0)
+    {
+        return 0;
+    }
+    if (q == 1023)
+    {
+        return 0xffff;
+    }
+    return ((q << 16) + 0x8000) >> 10;
+}
+
+static u32 FinishUnquantizeBC6H(u32 value) { return (value * 31) >> 6; }
+
+static u32 QuantizeBC6H(f32 value)
+{
+    // Unquantize followed by the final scale is close to q * 31
+    i32 guess = static_cast<i32>(value / 31.0f);
+    u32 best = 0;
+    f32 bestError = MaxF32();
+    for (i32 q = guess - 1; q <= guess + 2; q++)
+    {
+        if (q < 0 || q > 1023)
+        {
+            continue;
+        }
+        f32 d = FinishUnquantizeBC6H(UnquantizeBC6H(q)) - value;
+        if (d * d < bestError)
+        {
+            bestError = d * d;
+            best = q;
+        }
+    }
+    return best;
+}
+
+static f32 EvaluateBC6H(const SubsetTexels& texels, const u32 q[2][3],
+                        u8* indices)
+{
+    f32 palette[16][4];
+    for (u32 k = 0; k < 16; k++)
+    {
+        for (u32 c = 0; c < 3; c++)
+        {
+            u32 e0 = UnquantizeBC6H(q[0][c]);
+            u32 e1 = UnquantizeBC6H(q[1][c]);
+            u32 value =
+                (e0 * (64 - sWeights4[k]) + e1 * sWeights4[k] + 32) >> 6;
+            palette[k][c] = static_cast<f32>(FinishUnquantizeBC6H(value));
+        }
+    }
+    return FindIndices(texels, palette, 16, indices);
+}
+
+void CompressBlockBC6H(u8* dst, const f16* texels, u32 channelCount,
+                       BCQuality quality)
+{
+    FLY_ASSERT(dst);
+    FLY_ASSERT(texels);
+    FLY_ASSERT(channelCount >= 3);
+
+    SubsetTexels block;
+    block.count = 16;
+    block.channelCount = 3;
+    for (u32 i = 0; i < 16; i++)
+    {
+        for (u32 c = 0; c < 3; c++)
+        {
+            u16 bits = texels[i * channelCount + c].data;
+            // Negative values, infinities and nans clamp to [0, max half]
+            f32 value = static_cast<f32>(bits);
+            if (bits & 0x8000)
+            {
+                value = 0.0f;
+            }
+            block.c[c][i] = MIN(value, BC6H_MAX_HALF);
+        }
+    }
+
+    f32 endpoints[2][4] = {};
+    AxisEndpoints(block, BC6H_MAX_HALF, endpoints);
+
+    u32 bestQ[2][3] = {};
+    u8 bestIndices[16] = {};
+    f32 bestError = MaxF32();
+    const u32 iterationCount = IterationCount(quality);
+    for (u32 iteration = 0; iteration < iterationCount; iteration++)
+    {
+        u32 q[2][3];
+        for (u32 k = 0; k < 2; k++)
+        {
+            for (u32 c = 0; c < 3; c++)
+            {
+                q[k][c] = QuantizeBC6H(endpoints[k][c]);
+            }
+        }
+
+        u8 indices[16];
+        f32 error = EvaluateBC6H(block, q, indices);
+        if (error >= bestError)
+        {
+            break;
+        }
+        bestError = error;
+        memcpy(bestQ, q, sizeof(q));
+        memcpy(bestIndices, indices, sizeof(indices));
+
+        if (error == 0.0f ||
+            !LeastSquaresEndpoints(block, bestIndices, sWeights4,
+                                   1.0f / 64.0f, BC6H_MAX_HALF, endpoints))
+        {
+            break;
+        }
+    }
+
+    // Anchor index msb is implicit zero, weights are symmetric so swapping
+    // endpoints mirrors the indices
+    if (bestIndices[0] & 8)
+    {
+        for (u32 c = 0; c < 3; c++)
+        {
+            u32 tmp = bestQ[0][c];
+            bestQ[0][c] = bestQ[1][c];
+            bestQ[1][c] = tmp;
+        }
+        for (u32 i = 0; i < 16; i++)
+        {
+            bestIndices[i] = static_cast<u8>(15 - bestIndices[i]);
+        }
+    }
+
+    BlockWriter writer;
+    writer.Write(0x03, 5);
+    for (u32 k = 0; k < 2; k++)
+    {
+        for (u32 c = 0; c < 3; c++)
+        {
+            writer.Write(bestQ[k][c], 10);
+        }
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+        writer.Write(bestIndices[i], i == 0 ? 3 : 4);
+    }
+    writer.Store(dst);
+}
+
+////////////////////////////////////////////////////////////////////////////
+// BC1 - BC5
+
+// Weights of the second endpoint in thirds and sevenths, in index order
+static const u8 sWeightsBC1[4] = {0, 3, 1, 2};
+static const u8 sWeightsBC4[8] = {0, 7, 1, 2, 3, 4, 5, 6};
+
+// Deinterleaves 16 rgba8 texels into floats, four texels per vector
+static void LoadTexelsRGBA(const u8* texels, SubsetTexels& block)
+{
+    const Math::I32x4 mask = Math::SplatI32x4(0xff);
+    for (u32 i = 0; i < 16; i += 4)
+    {
+        Math::I32x4 packed = Math::BitCastToI32(
+            Math::LoadF32x4(reinterpret_cast<const f32*>(texels + i * 4)));
+        for (u32 c = 0; c < 4; c++)
+        {
+            Math::I32x4 channel =
+                Math::ShiftRightLogical(packed, static_cast<i32>(c * 8)) & mask;
+            Math::StoreF32x4(block.c[c] + i, Math::ConvertToF32(channel));
+        }
+    }
+    block.count = 16;
+}
+
+static void LoadTexelsChannel(const u8* texels, u32 stride, SubsetTexels& block)
+{
+    for (u32 i = 0; i < 16; i++)
+    {
+        block.c[0][i] = texels[i * stride];
+    }
+    block.count = 16;
+    block.channelCount = 1;
+}
+
+static bool IsSolidBlock(const SubsetTexels& block)
+{
+    u32 mask = 0xf;
+    for (u32 c = 0; c < block.channelCount; c++)
+    {
+        F32x4 first = Math::SplatF32x4(block.c[c][0]);
+        for (u32 i = 0; i < 16; i += 4)
+        {
+            F32x4 values = Math::LoadF32x4(block.c[c] + i);
+            mask &= Math::MoveMask(Math::CmpEq(values, first));
+        }
+    }
+    return mask == 0xf;
+}
+
+static u32 Expand5(u32 value) { return (value << 3) | (value >> 2); }
+static u32 Expand6(u32 value) { return (value << 2) | (value >> 4); }
+
+static u16 PackRGB565(const f32 color[4])
+{
+    u32 r = static_cast<u32>(color[0] * (31.0f / 255.0f) + 0.5f);
+    u32 g = static_cast<u32>(color[1] * (63.0f / 255.0f) + 0.5f);
+    u32 b = static_cast<u32>(color[2] * (31.0f / 255.0f) + 0.5f);
+    return static_cast<u16>((MIN(r, 31u) << 11) | (MIN(g, 63u) << 5) |
+                            MIN(b, 31u));
+}
+
+static void UnpackRGB565(u16 color, u32 rgb[3])
+{
+    rgb[0] = Expand5(color >> 11);
+    rgb[1] = Expand6((color >> 5) & 63);
+    rgb[2] = Expand5(color & 31);
+}
+
+static void BuildSingleColorMatches(u32 bits, u8 (*matches)[2])
+{
+    const u32 maxValue = (1u << bits) - 1;
+    for (u32 v = 0; v < 256; v++)
+    {
+        u32 bestError = FLY_MAX_U32;
+        for (u32 a = 0; a <= maxValue; a++)
+        {
+            for (u32 b = 0; b <= maxValue; b++)
+            {
+                u32 ea = bits == 5 ? Expand5(a) : Expand6(a);
+                u32 eb = bits == 5 ? Expand5(b) : Expand6(b);
+                u32 value = (2 * ea + eb) / 3;
+                u32 error = value > v ? value - v : v - value;
+                if (error < bestError)
+                {
+                    bestError = error;
+                    matches[v][0] = static_cast<u8>(a);
+                    matches[v][1] = static_cast<u8>(b);
+                }
+            }
+        }
+    }
+}
+
+// Endpoint pairs whose two thirds interpolant reproduces every 8 bit value
+// best, used for solid blocks
+struct SingleColorTable
+{
+    u8 match5[256][2];
+    u8 match6[256][2];
+
+    SingleColorTable()
+    {
+        BuildSingleColorMatches(5, match5);
+        BuildSingleColorMatches(6, match6);
+    }
+};
+
+static const SingleColorTable& GetSingleColorTable()
+{
+    static const SingleColorTable table;
+    return table;
+}
+
+static void WriteColorBlock(u8* dst, u16 c0, u16 c1, const u8* indices)
+{
+    // Four color mode needs c0 > c1, swapping the endpoints swaps index 0
+    // with 1 and 2 with 3
+    u32 indexXor = 0;
+    if (c0 < c1)
+    {
+        u16 tmp = c0;
+        c0 = c1;
+        c1 = tmp;
+        indexXor = 1;
+    }
+
+    u32 packed = 0;
+    for (u32 i = 0; i < 16 && c0 != c1; i++)
+    {
+        packed |= (indices[i] ^ indexXor) << (i * 2);
+    }
+
+    dst[0] = static_cast<u8>(c0);
+    dst[1] = static_cast<u8>(c0 >> 8);
+    dst[2] = static_cast<u8>(c1);
+    dst[3] = static_cast<u8>(c1 >> 8);
+    memcpy(dst + 4, &packed, sizeof(packed));
+}
+
+static f32 EvaluateColorBlock(const SubsetTexels& block, u16 c0, u16 c1,
+                              u8* indices)
+{
+    u32 e0[3];
+    u32 e1[3];
+    UnpackRGB565(c0, e0);
+    UnpackRGB565(c1, e1);
+
+    f32 palette[4][4];
+    for (u32 c = 0; c < 3; c++)
+    {
+        palette[0][c] = static_cast<f32>(e0[c]);
+        palette[1][c] = static_cast<f32>(e1[c]);
+        palette[2][c] = static_cast<f32>((2 * e0[c] + e1[c]) / 3);
+        palette[3][c] = static_cast<f32>((e0[c] + 2 * e1[c]) / 3);
+    }
+    return FindIndices(block, palette, c0 == c1 ? 1 : 4, indices);
+}
+
+static void EncodeColorBlock(u8* dst, SubsetTexels& block)
+{
+    block.channelCount = 3;
+
+    if (IsSolidBlock(block))
+    {
+        const SingleColorTable& table = GetSingleColorTable();
+        u32 r = static_cast<u32>(block.c[0][0]);
+        u32 g = static_cast<u32>(block.c[1][0]);
+        u32 b = static_cast<u32>(block.c[2][0]);
+        u16 c0 = static_cast<u16>((table.match5[r][0] << 11) |
+                                  (table.match6[g][0] << 5) |
+                                  table.match5[b][0]);
+        u16 c1 = static_cast<u16>((table.match5[r][1] << 11) |
+                                  (table.match6[g][1] << 5) |
+                                  table.match5[b][1]);
+        u8 indices[16];
+        memset(indices, 2, sizeof(indices));
+        WriteColorBlock(dst, c0, c1, indices);
+        return;
+    }
+
+    f32 endpoints[2][4] = {};
+    AxisEndpoints(block, 255.0f, endpoints);
+
+    u16 best[2] = {};
+    u8 bestIndices[16] = {};
+    f32 bestError = MaxF32();
+    for (u32 iteration = 0; iteration < 3; iteration++)
+    {
+        u16 c0 = PackRGB565(endpoints[0]);
+        u16 c1 = PackRGB565(endpoints[1]);
+
+        u8 indices[16];
+        f32 error = EvaluateColorBlock(block, c0, c1, indices);
+        if (error >= bestError)
+        {
+            break;
+        }
+        bestError = error;
+        best[0] = c0;
+        best[1] = c1;
+        memcpy(bestIndices, indices, sizeof(indices));
+
+        if (error == 0.0f ||
+            !LeastSquaresEndpoints(block, bestIndices, sWeightsBC1,
+                                   1.0f / 3.0f, 255.0f, endpoints))
+        {
+            break;
+        }
+    }
+
+    WriteColorBlock(dst, best[0], best[1], bestIndices);
+}
+
+static void EncodeAlphaBlock(u8* dst, const SubsetTexels& block)
+{
+    F32x4 minValue = Math::LoadF32x4(block.c[0]);
+    F32x4 maxValue = minValue;
+    for (u32 i = 4; i < 16; i += 4)
+    {
+        F32x4 values = Math::LoadF32x4(block.c[0] + i);
+        minValue = Math::Min(minValue, values);
+        maxValue = Math::Max(maxValue, values);
+    }
+    f32 mins[4];
+    f32 maxs[4];
+    Math::StoreF32x4(mins, minValue);
+    Math::StoreF32x4(maxs, maxValue);
+
+    f32 endpoints[2][4] = {};
+    endpoints[0][0] = MIN(MIN(mins[0], mins[1]), MIN(mins[2], mins[3]));
+    endpoints[1][0] = MAX(MAX(maxs[0], maxs[1]), MAX(maxs[2], maxs[3]));
+
+    u32 best[2] = {static_cast<u32>(endpoints[0][0]),
+                   static_cast<u32>(endpoints[1][0])};
+    u8 bestIndices[16] = {};
+    f32 bestError = MaxF32();
+    for (u32 iteration = 0; iteration < 3 && best[0] != best[1]; iteration++)
+    {
+        u32 a0 = static_cast<u32>(endpoints[0][0] + 0.5f);
+        u32 a1 = static_cast<u32>(endpoints[1][0] + 0.5f);
+
+        f32 palette[8][4];
+        palette[0][0] = static_cast<f32>(a0);
+        palette[1][0] = static_cast<f32>(a1);
+        for (u32 k = 2; k < 8; k++)
+        {
+            palette[k][0] = static_cast<f32>(
+                ((7 - sWeightsBC4[k]) * a0 + sWeightsBC4[k] * a1) / 7);
+        }
+
+        u8 indices[16];
+        f32 error = FindIndices(block, palette, 8, indices);
+        if (error >= bestError)
+        {
+            break;
+        }
+        bestError = error;
+        best[0] = a0;
+        best[1] = a1;
+        memcpy(bestIndices, indices, sizeof(indices));
+
+        if (error == 0.0f ||
+            !LeastSquaresEndpoints(block, bestIndices, sWeightsBC4,
+                                   1.0f / 7.0f, 255.0f, endpoints))
+        {
+            break;
+        }
+    }
+
+    // Eight value mode needs a0 > a1, swapping the endpoints mirrors the
+    // interpolated indices
+    if (best[0] < best[1])
+    {
+        u32 tmp = best[0];
+        best[0] = best[1];
+        best[1] = tmp;
+        for (u32 i = 0; i < 16; i++)
+        {
+            u8 index = bestIndices[i];
+            bestIndices[i] = static_cast<u8>(index < 2 ? index ^ 1 : 9 - index);
+        }
+    }
+
+    u64 packed = 0;
+    for (u32 i = 0; i < 16 && best[0] != best[1]; i++)
+    {
+        packed |= static_cast<u64>(bestIndices[i]) << (i * 3);
+    }
+
+    dst[0] = static_cast<u8>(best[0]);
+    dst[1] = static_cast<u8>(best[1]);
+    for (u32 i = 0; i < 6; i++)
+    {
+        dst[2 + i] = static_cast<u8>(packed >> (i * 8));
+    }
+}
+
+void CompressBlockBC1(u8* dst, const u8* texels)
+{
+    FLY_ASSERT(dst);
+    FLY_ASSERT(texels);
+
+    SubsetTexels block;
+    LoadTexelsRGBA(texels, block);
+    EncodeColorBlock(dst, block);
+}
+
+void CompressBlockBC3(u8* dst, const u8* texels)
+{
+    FLY_ASSERT(dst);
+    FLY_ASSERT(texels);
+
+    SubsetTexels block;
+    LoadTexelsRGBA(texels, block);
+
+    SubsetTexels alpha;
+    alpha.count = 16;
+    alpha.channelCount = 1;
+    memcpy(alpha.c[0], block.c[3], sizeof(alpha.c[0]));
+
+    EncodeAlphaBlock(dst, alpha);
+    EncodeColorBlock(dst + 8, block);
+}
+
+void CompressBlockBC4(u8* dst, const u8* texels)
+{
+    FLY_ASSERT(dst);
+    FLY_ASSERT(texels);
+
+    SubsetTexels block;
+    LoadTexelsChannel(texels, 1, block);
+    EncodeAlphaBlock(dst, block);
+}
+
+void CompressBlockBC5(u8* dst, const u8* texels)
+{
+    FLY_ASSERT(dst);
+    FLY_ASSERT(texels);
+
+    SubsetTexels block;
+    LoadTexelsChannel(texels, 2, block);
+    EncodeAlphaBlock(dst, block);
+    LoadTexelsChannel(texels + 1, 2, block);
+    EncodeAlphaBlock(dst + 8, block);
+}
+
+} // namespace Fly
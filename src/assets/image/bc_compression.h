@@ -0,0 +1,37 @@
+#ifndef FLY_ASSETS_BC_COMPRESSION_H
+#define FLY_ASSETS_BC_COMPRESSION_H
+
+#include "core/types.h"
+
+namespace Fly
+{
+
+enum class BCQuality : u8
+{
+    Fast,
+    Normal,
+    High,
+};
+
+// Block encoders take the 16 texels of a 4x4 block in row major order and
+// write one 8 (BC1, BC4) or 16 byte block.
+
+// Rgba8 texels, BC1 ignores alpha and always uses four color mode
+void CompressBlockBC1(u8* dst, const u8* texels);
+void CompressBlockBC3(u8* dst, const u8* texels);
+// One and two channel u8 texels
+void CompressBlockBC4(u8* dst, const u8* texels);
+void CompressBlockBC5(u8* dst, const u8* texels);
+
+// Rgba8 texels. Fast only uses mode 6, Normal adds modes 1 and 5, High also
+// tries mode 3, all rotations of mode 5 and more partitions.
+void CompressBlockBC7(u8* dst, const u8* texels, BCQuality quality);
+
+// Unsigned BC6H from half texels with channelCount interleaved channels,
+// only the first three are encoded. Negative values are clamped to zero.
+void CompressBlockBC6H(u8* dst, const f16* texels, u32 channelCount,
+                       BCQuality quality);
+
+} // namespace Fly
+
+#endif /* FLY_ASSETS_BC_COMPRESSION_H */
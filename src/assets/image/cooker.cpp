@@ -1,14 +1,21 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "core/clock.h"
 #include "core/filesystem.h"
+#include "core/job_system.h"
 #include "core/memory.h"
 #include "core/thread_context.h"
 
 #include "rhi/context.h"
 #include "rhi/pipeline.h"
 
+#include "assets/cook_cache.h"
+
 #include "export_image.h"
 #include "image.h"
 #include "import_image.h"
@@ -17,6 +24,12 @@
 #include "glsl/eq2cube_frag_spv.inl"
 #include "glsl/eq2cube_vert_spv.inl"
 
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// Cook memory per input byte when the image header can not be read, the
+// decoded image and its copy are a few times the size of a png or jpg
+#define FLY_COOK_MEMORY_FILE_SIZE_FACTOR 16ull
+
 using namespace Fly;
 
 enum class TransformType
@@ -37,7 +50,17 @@ struct Input
     i32 resizeY = 0;
     bool resize = false;
     bool generateMips = false;
+    bool mipsFromBaseLevel = false;
     bool eq2cube = false;
+    // Resample on the cpu instead of the gpu, needs no vulkan device
+    bool eq2cubeCpu = false;
+    Eq2CubeFilter eq2cubeFilter = Eq2CubeFilter::Bilinear;
+    BCQuality quality = BCQuality::Normal;
+    u64 memoryBudget = 64 * 1024 * 1024;
+    // Zero cooks as many files at once as there are threads
+    u32 parallelFileCount = 0;
+    u64 batchMemoryBudget = 4096ull * 1024 * 1024;
+    String8 cacheDirectory;
 };
 
 static bool IsOption(String8 str) { return str[0] == '-'; }
@@ -107,10 +130,107 @@ static void ParseCommandLine(Arena& arena, u32 argc, String8* argv, Input& data)
         {
             data.generateMips = true;
         }
+        else if (argv[i] == FLY_STRING8_LITERAL("-mhq"))
+        {
+            data.generateMips = true;
+            data.mipsFromBaseLevel = true;
+        }
         else if (argv[i] == FLY_STRING8_LITERAL("-eq2cube"))
         {
             data.eq2cube = true;
         }
+        else if (argv[i] == FLY_STRING8_LITERAL("-eq2cube-cpu"))
+        {
+            data.eq2cube = true;
+            data.eq2cubeCpu = true;
+
+            String8 filter = i + 1 < argc ? argv[++i] : String8();
+            if (filter == FLY_STRING8_LITERAL("nearest"))
+            {
+                data.eq2cubeFilter = Eq2CubeFilter::Nearest;
+            }
+            else if (filter == FLY_STRING8_LITERAL("bilinear"))
+            {
+                data.eq2cubeFilter = Eq2CubeFilter::Bilinear;
+            }
+            else if (filter == FLY_STRING8_LITERAL("bicubic"))
+            {
+                data.eq2cubeFilter = Eq2CubeFilter::Bicubic;
+            }
+            else
+            {
+                fprintf(stderr, "Parse error: eq2cube filter must be nearest, "
+                                "bilinear or bicubic\n");
+                exit(-19);
+            }
+        }
+        else if (argv[i] == FLY_STRING8_LITERAL("-budget"))
+        {
+            i32 megabytes = 0;
+            if (i + 1 >= argc || !String8::ParseI32(argv[++i], megabytes) ||
+                megabytes <= 0)
+            {
+                fprintf(stderr, "Parse error: memory budget must be a "
+                                "positive number of megabytes\n");
+                exit(-15);
+            }
+            data.memoryBudget = static_cast<u64>(megabytes) * 1024 * 1024;
+        }
+        else if (argv[i] == FLY_STRING8_LITERAL("-j"))
+        {
+            i32 count = 0;
+            if (i + 1 >= argc || !String8::ParseI32(argv[++i], count) ||
+                count <= 0)
+            {
+                fprintf(stderr, "Parse error: parallel file count must be "
+                                "positive\n");
+                exit(-16);
+            }
+            data.parallelFileCount = static_cast<u32>(count);
+        }
+        else if (argv[i] == FLY_STRING8_LITERAL("-mem"))
+        {
+            i32 megabytes = 0;
+            if (i + 1 >= argc || !String8::ParseI32(argv[++i], megabytes) ||
+                megabytes <= 0)
+            {
+                fprintf(stderr, "Parse error: batch memory budget must be a "
+                                "positive number of megabytes\n");
+                exit(-17);
+            }
+            data.batchMemoryBudget = static_cast<u64>(megabytes) * 1024 * 1024;
+        }
+        else if (argv[i] == FLY_STRING8_LITERAL("-cache"))
+        {
+            if (i + 1 >= argc || IsOption(argv[i + 1]))
+            {
+                fprintf(stderr, "Parse error: no cache directory specified\n");
+                exit(-18);
+            }
+            data.cacheDirectory = argv[++i];
+        }
+        else if (argv[i] == FLY_STRING8_LITERAL("-q"))
+        {
+            String8 quality = i + 1 < argc ? argv[++i] : String8();
+            if (quality == FLY_STRING8_LITERAL("fast"))
+            {
+                data.quality = BCQuality::Fast;
+            }
+            else if (quality == FLY_STRING8_LITERAL("normal"))
+            {
+                data.quality = BCQuality::Normal;
+            }
+            else if (quality == FLY_STRING8_LITERAL("high"))
+            {
+                data.quality = BCQuality::High;
+            }
+            else
+            {
+                fprintf(stderr, "Parse error: quality must be fast, normal "
+                                "or high\n");
+                exit(-14);
+            }
+        }
     }
 }
 
@@ -183,6 +303,14 @@ static u8 GetImageChannelCount(String8 inputPath, String8 outputPath)
     {
         return 2;
     }
+    else if (String8::EndsWith(outputPath, FLY_STRING8_LITERAL(".fbc6")))
+    {
+        return 4;
+    }
+    else if (String8::EndsWith(outputPath, FLY_STRING8_LITERAL(".fbc7")))
+    {
+        return 4;
+    }
     else if (String8::EndsWith(inputPath, FLY_STRING8_LITERAL(".jpg")))
     {
         return 4;
@@ -254,7 +382,62 @@ static bool CreateEq2CubePipeline(RHI::Device& device,
     return true;
 }
 
-static bool CompressOutputImage(String8 path, Image& image)
+static ImageStorageType GetOutputCodec(String8 path)
+{
+    String8 extensions[] = {
+        FLY_STRING8_LITERAL(".fbc1"), FLY_STRING8_LITERAL(".fbc3"),
+        FLY_STRING8_LITERAL(".fbc4"), FLY_STRING8_LITERAL(".fbc5"),
+        FLY_STRING8_LITERAL(".fbc6"), FLY_STRING8_LITERAL(".fbc7"),
+    };
+    ImageStorageType codecs[] = {
+        ImageStorageType::BC1, ImageStorageType::BC3, ImageStorageType::BC4,
+        ImageStorageType::BC5, ImageStorageType::BC6, ImageStorageType::BC7,
+    };
+
+    for (u32 i = 0; i < STACK_ARRAY_COUNT(extensions); i++)
+    {
+        if (String8::EndsWith(path, extensions[i]))
+        {
+            return codecs[i];
+        }
+    }
+    return ImageStorageType::Invalid;
+}
+
+// Images that go straight from decode to a block compressed output are
+// resized, mipmapped and compressed band by band. Eq2Cube needs the whole
+// image on the gpu and keeps the regular path.
+static bool GetStreamSettings(const Input& input, String8 outputPath,
+                              const Image& image,
+                              ImageStreamSettings& settings)
+{
+    if (input.eq2cube || image.mipCount != 1 ||
+        (image.storageType != ImageStorageType::Byte &&
+         image.storageType != ImageStorageType::Half &&
+         image.storageType != ImageStorageType::Float))
+    {
+        return false;
+    }
+
+    settings.codec = GetOutputCodec(outputPath);
+    if (settings.codec == ImageStorageType::Invalid)
+    {
+        return false;
+    }
+
+    if (input.resize)
+    {
+        settings.width = static_cast<u32>(input.resizeX);
+        settings.height = static_cast<u32>(input.resizeY);
+    }
+    settings.generateMips = input.generateMips;
+    settings.fromBaseLevel = input.mipsFromBaseLevel;
+    settings.quality = input.quality;
+    settings.memoryBudget = input.memoryBudget;
+    return true;
+}
+
+static bool CompressOutputImage(String8 path, BCQuality quality, Image& image)
 {
     if (String8::EndsWith(path, FLY_STRING8_LITERAL(".fbc1")) &&
         image.storageType != ImageStorageType::BC1)
@@ -279,128 +462,343 @@ static bool CompressOutputImage(String8 path, Image& image)
     else if (String8::EndsWith(path, FLY_STRING8_LITERAL(".fbc6")) &&
              image.storageType != ImageStorageType::BC6)
     {
-        return false;
+        return CompressImage(ImageStorageType::BC6, image, quality);
     }
     else if (String8::EndsWith(path, FLY_STRING8_LITERAL(".fbc7")) &&
              image.storageType != ImageStorageType::BC7)
     {
-        return false;
+        return CompressImage(ImageStorageType::BC7, image, quality);
     }
     return true;
 }
 
-void ProcessInput(Input& input)
+struct BatchState
 {
-    RHI::Context context;
+    const Input* input = nullptr;
     RHI::Device* device = nullptr;
-    RHI::GraphicsPipeline eq2cubePipeline;
+    RHI::GraphicsPipeline* eq2cubePipeline = nullptr;
+
+    // There is a single device, Eq2Cube jobs take turns on it
+    std::mutex deviceMutex;
+
+    // A file reserves its estimated memory before it starts decoding and
+    // waits while the reservation does not fit next to the files in flight.
+    // A single file larger than the budget runs alone.
+    std::mutex memoryMutex;
+    std::condition_variable memoryReleased;
+    u64 memoryInFlight = 0;
+
+    std::atomic<u32> nextFile{0};
+    std::atomic<i32> result{0};
+};
 
-    if (input.eq2cube)
+static void ReserveMemory(BatchState& state, u64 size)
+{
+    std::unique_lock<std::mutex> lock(state.memoryMutex);
+    state.memoryReleased.wait(lock, [&state, size] {
+        return state.memoryInFlight == 0 ||
+               state.memoryInFlight + size <= state.input->batchMemoryBudget;
+    });
+    state.memoryInFlight += size;
+}
+
+// The decoded image plus roughly one transformed copy. Formats without a
+// header that can be read on its own are estimated from the file size.
+static u64 EstimateCookMemory(String8 inputPath, u8 channelCount)
+{
+    Image info;
+    if (LoadImageInfoFromFile(inputPath, info, channelCount))
     {
-        if (!CreateContext(context))
+        return GetImageSize(info) * 2;
+    }
+
+    MappedFile file;
+    if (!MapFile(inputPath, file))
+    {
+        return 0;
+    }
+    u64 size = file.size * FLY_COOK_MEMORY_FILE_SIZE_FACTOR;
+    UnmapFile(file);
+    return size;
+}
+
+static void UpdateMemoryInFlight(BatchState& state, u64 acquired, u64 released)
+{
+    {
+        std::lock_guard<std::mutex> lock(state.memoryMutex);
+        state.memoryInFlight += acquired;
+        state.memoryInFlight -= released;
+    }
+    if (released)
+    {
+        state.memoryReleased.notify_all();
+    }
+}
+
+static i32 TransformImage(BatchState& state, String8 inputPath,
+                          String8 outputPath, Image& image)
+{
+    const Input& input = *state.input;
+
+    ImageStreamSettings streamSettings;
+    if (GetStreamSettings(input, outputPath, image, streamSettings))
+    {
+        if (!StreamTransformImage(streamSettings, image))
         {
-            fprintf(stderr, "Failed to create context\n");
-            exit(-32);
+            fprintf(stderr, "Transform error: Failed to compress %.*s\n",
+                    static_cast<int>(outputPath.Size()), outputPath.Data());
+            return -13;
         }
+        return 0;
+    }
 
-        device = &(context.devices[0]);
-        if (!CreateEq2CubePipeline(*device, eq2cubePipeline))
+    if (input.resize)
+    {
+        // TODO: Pass linear / srgb flag
+        if (!ResizeImageSRGB(input.resizeX, input.resizeY, image))
         {
-            fprintf(stderr, "Failed to create eq2cube pipeline \n");
-            exit(-32);
+            fprintf(stderr, "Transform error: Failed to resize %.*s\n",
+                    static_cast<int>(inputPath.Size()), inputPath.Data());
+            return -10;
         }
     }
 
-    for (u32 i = 0; i < input.inputCount; i++)
+    if (input.eq2cubeCpu)
     {
-        Image image{};
-        u32 channelCount =
-            GetImageChannelCount(input.inputs[i], input.outputs[i]);
-        if (channelCount == 0 && input.generateMips)
+        if (!Eq2Cube(image, input.eq2cubeFilter))
         {
-            fprintf(stderr, "Transform error: Mipmaps are only allowed for "
-                            "compressed bc formats\n");
-            exit(-11);
+            fprintf(stderr,
+                    "Transform error: failed to transform "
+                    "equirectangular to cube %.*s\n",
+                    static_cast<int>(inputPath.Size()), inputPath.Data());
+            return -32;
         }
-
-        if (!LoadImageFromFile(input.inputs[i], image, channelCount))
+    }
+    else if (input.eq2cube)
+    {
+        std::lock_guard<std::mutex> lock(state.deviceMutex);
+        if (!Eq2Cube(*state.device, *state.eq2cubePipeline, image))
         {
-            fprintf(stderr, "Import error: failed to load image %.*s\n",
-                    static_cast<int>(input.inputs[i].Size()),
-                    input.inputs[i].Data());
-            exit(-7);
+            fprintf(stderr,
+                    "Transform error: failed to transform "
+                    "equirectangular to cube %.*s\n",
+                    static_cast<int>(inputPath.Size()), inputPath.Data());
+            return -32;
         }
+    }
 
-        if (input.resize)
+    if (input.generateMips)
+    {
+        // TODO: Pass linear / srgb flag
+        if (!GenerateMips(image, false, input.mipsFromBaseLevel))
         {
-            // TODO: Pass linear / srgb flag
-            if (!ResizeImageSRGB(input.resizeX, input.resizeY, image))
-            {
-                Free(image.data);
-                fprintf(stderr, "Transform error: Failed to resize %.*s\n",
-                        static_cast<int>(input.inputs[i].Size()),
-                        input.inputs[i].Data());
-                exit(-10);
-            }
+            fprintf(stderr,
+                    "Transform error: Failed to generate mipmaps %.*s\n",
+                    static_cast<int>(inputPath.Size()), inputPath.Data());
+            return -12;
         }
+    }
+
+    if (!CompressOutputImage(outputPath, input.quality, image))
+    {
+        fprintf(stderr, "Transform error: Failed to compress %.*s\n",
+                static_cast<int>(outputPath.Size()), outputPath.Data());
+        return -13;
+    }
+
+    return 0;
+}
+
+// Everything that changes the output except the memory budgets, streaming
+// writes the same data as the in memory path
+static bool GetCookKey(const Input& input, String8 inputPath,
+                       String8 outputPath, u64& key)
+{
+    key = FLY_COOK_CACHE_VERSION;
+    if (!HashCookInput(inputPath, key))
+    {
+        return false;
+    }
+
+    String8 inputExtension = String8::FindLast(inputPath, '.');
+    String8 outputExtension = String8::FindLast(outputPath, '.');
+    HashCookInput(inputExtension.Data(), inputExtension.Size(), key);
+    HashCookInput(outputExtension.Data(), outputExtension.Size(), key);
+
+    HashCookOption(input.resize, key);
+    if (input.resize)
+    {
+        HashCookOption(input.resizeX, key);
+        HashCookOption(input.resizeY, key);
+    }
+    HashCookOption(input.generateMips, key);
+    HashCookOption(input.mipsFromBaseLevel, key);
+    HashCookOption(input.eq2cube, key);
+    HashCookOption(input.eq2cubeCpu, key);
+    if (input.eq2cubeCpu)
+    {
+        HashCookOption(input.eq2cubeFilter, key);
+    }
+    HashCookOption(input.quality, key);
+
+    return true;
+}
+
+static i32 CookImage(BatchState& state, u32 index)
+{
+    const Input& input = *state.input;
+    String8 inputPath = input.inputs[index];
+    String8 outputPath = input.outputs[index];
+
+    u8 channelCount = GetImageChannelCount(inputPath, outputPath);
+    if (channelCount == 0 && input.generateMips)
+    {
+        fprintf(stderr, "Transform error: Mipmaps are only allowed for "
+                        "compressed bc formats\n");
+        return -11;
+    }
+
+    u64 key = 0;
+    u64 hashStart = ClockNow();
+    bool useCache = input.cacheDirectory &&
+                    GetCookKey(input, inputPath, outputPath, key);
+    if (useCache && FetchFromCookCache(input.cacheDirectory, key, outputPath))
+    {
+        printf("Cached %.*s in %.2f ms\n", static_cast<int>(outputPath.Size()),
+               outputPath.Data(), ToMilliseconds(ClockNow() - hashStart));
+        return 0;
+    }
+    // Outputs of earlier runs may be hard links into the cook cache, writing
+    // into them would change the cached entry
+    RemoveFile(outputPath);
+
+    u64 memory = EstimateCookMemory(inputPath, channelCount);
+    ReserveMemory(state, memory);
 
-        if (input.eq2cube)
+    u64 start = ClockNow();
+    Image image{};
+    if (!LoadImageFromFile(inputPath, image, channelCount))
+    {
+        UpdateMemoryInFlight(state, 0, memory);
+        fprintf(stderr, "Import error: failed to load image %.*s\n",
+                static_cast<int>(inputPath.Size()), inputPath.Data());
+        return -7;
+    }
+
+    // The image is already decoded, so a low estimate is only corrected
+    u64 decodedMemory = GetImageSize(image) * 2;
+    UpdateMemoryInFlight(state, decodedMemory, memory);
+    memory = decodedMemory;
+    u64 loaded = ClockNow();
+
+    i32 res = TransformImage(state, inputPath, outputPath, image);
+    u64 transformed = ClockNow();
+
+    if (res == 0 && !ExportImage(outputPath, image))
+    {
+        fprintf(stderr, "Export error: failed to write image %.*s\n",
+                static_cast<int>(outputPath.Size()), outputPath.Data());
+        res = -8;
+    }
+    u64 exported = ClockNow();
+
+    if (res == 0 && useCache &&
+        !StoreInCookCache(input.cacheDirectory, key, outputPath))
+    {
+        fprintf(stderr, "Cache warning: failed to store %.*s\n",
+                static_cast<int>(outputPath.Size()), outputPath.Data());
+    }
+
+    Free(image.data);
+    UpdateMemoryInFlight(state, 0, memory);
+
+    if (res == 0)
+    {
+        printf("Cooked %.*s in %.2f ms (load %.2f ms, transform %.2f ms, "
+               "export %.2f ms)\n",
+               static_cast<int>(outputPath.Size()), outputPath.Data(),
+               ToMilliseconds(exported - start),
+               ToMilliseconds(loaded - start),
+               ToMilliseconds(transformed - loaded),
+               ToMilliseconds(exported - transformed));
+    }
+    return res;
+}
+
+// Each lane cooks whole files until none are left, block compression and
+// resampling inside a file still spread over all workers
+static void CookFiles(u32, void* userData)
+{
+    BatchState& state = *static_cast<BatchState*>(userData);
+    for (;;)
+    {
+        u32 index = state.nextFile.fetch_add(1);
+        if (index >= state.input->inputCount)
         {
-            if (!Eq2Cube(*device, eq2cubePipeline, image))
-            {
-                Free(image.data);
-                fprintf(stderr,
-                        "Transform error: failed to transform "
-                        "equirectangular to cube %.*s\n",
-                        static_cast<int>(input.inputs[i].Size()),
-                        input.inputs[i].Data());
-                exit(-32);
-            }
+            break;
         }
 
-        if (input.generateMips)
+        i32 res = CookImage(state, index);
+        i32 expected = 0;
+        if (res != 0)
         {
-            // TODO: Pass linear / srgb flag
-            if (!GenerateMips(image, false))
-            {
-                fprintf(stderr,
-                        "Transform error: Failed to generate mipmaps %.*s\n",
-                        static_cast<int>(input.inputs[i].Size()),
-                        input.inputs[i].Data());
-                exit(-12);
-            }
+            state.result.compare_exchange_strong(expected, res);
         }
+    }
+}
+
+static i32 ProcessInput(const Input& input)
+{
+    RHI::Context context;
+    RHI::GraphicsPipeline eq2cubePipeline;
 
-        if (!CompressOutputImage(input.outputs[i], image))
+    BatchState state;
+    state.input = &input;
+
+    bool useDevice = input.eq2cube && !input.eq2cubeCpu;
+    if (useDevice)
+    {
+        if (!CreateContext(context))
         {
-            fprintf(stderr, "Transform error: Failed to compress %.*s\n",
-                    static_cast<int>(input.outputs[i].Size()),
-                    input.outputs[i].Data());
-            exit(-13);
+            fprintf(stderr, "Failed to create context\n");
+            return -32;
         }
 
-        if (!ExportImage(input.outputs[i], image))
+        state.device = &(context.devices[0]);
+        state.eq2cubePipeline = &eq2cubePipeline;
+        if (!CreateEq2CubePipeline(*state.device, eq2cubePipeline))
         {
-            fprintf(stderr, "Export error: failed to write image %.*s\n",
-                    static_cast<int>(input.outputs[i].Size()),
-                    input.outputs[i].Data());
-            exit(-8);
+            fprintf(stderr, "Failed to create eq2cube pipeline \n");
+            return -32;
         }
+    }
 
-        Free(image.data);
+    u32 laneCount = input.parallelFileCount;
+    if (laneCount == 0)
+    {
+        laneCount = GetJobWorkerCount() + 1;
     }
+    laneCount = MIN(laneCount, input.inputCount);
+
+    u64 start = ClockNow();
+    ParallelFor(laneCount, CookFiles, &state);
+    printf("Cooked %u images in %.2f ms\n", input.inputCount,
+           ToMilliseconds(ClockNow() - start));
 
-    if (input.eq2cube)
+    if (useDevice)
     {
-        RHI::WaitDeviceIdle(*device);
-        RHI::DestroyGraphicsPipeline(*device, eq2cubePipeline);
+        RHI::WaitDeviceIdle(*state.device);
+        RHI::DestroyGraphicsPipeline(*state.device, eq2cubePipeline);
         RHI::DestroyContext(context);
     }
+
+    return state.result.load();
 }
 
 int main(int argc, char* argv[])
 {
     InitArenas();
+    InitJobSystem();
 
     Arena& arena = GetScratchArena();
     String8* argvStrings = FLY_PUSH_ARENA(arena, String8, argc);
@@ -413,8 +811,9 @@ int main(int argc, char* argv[])
     ParseCommandLine(arena, argc, argvStrings, input);
     CheckSemantic(input);
     FillOutputs(arena, input);
-    ProcessInput(input);
+    i32 res = ProcessInput(input);
 
+    ShutdownJobSystem();
     ReleaseThreadContext();
-    return 0;
+    return res;
 }
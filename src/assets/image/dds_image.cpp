@@ -1,5 +1,6 @@
 #include <stdio.h>
 
+#include "core/assert.h"
 #include "core/memory.h"
 
 #include "dds_image.h"
@@ -373,7 +374,10 @@ static ImageStorageType GetImageStorageType(u32 fmt)
     }
 }
 
-bool ReadDXT10(FILE* file, const Header& header, Image& image)
+// DDS stores every mip of a layer before the next layer, the texels are
+// reordered to mip major while reading
+static bool ReadDXT10(FILE* file, const Header& header, Image& image,
+                      ImageAllocator allocator, void* userData)
 {
     HeaderDXT10 dxt10{};
     if (fread(&dxt10, 1, sizeof(HeaderDXT10), file) != sizeof(HeaderDXT10))
@@ -395,33 +399,45 @@ bool ReadDXT10(FILE* file, const Header& header, Image& image)
 
     image.width = header.width;
     image.height = header.height;
-    image.mipCount = header.mipMapCount;
+    image.mipCount = MAX(header.mipMapCount, 1);
     image.layerCount = dxt10.arraySize;
+    if (dxt10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+    {
+        image.layerCount *= 6;
+    }
 
-    u64 imageSize = GetImageSize(image);
-    image.data = static_cast<u8*>(Alloc(imageSize));
+    u8* data = allocator(image, GetImageSize(image), userData);
+    if (!data)
+    {
+        return false;
+    }
 
-    u64 offset = 0;
-    for (u32 i = 0; i < image.mipCount; i++)
+    for (u32 layer = 0; layer < image.layerCount; layer++)
     {
-        u32 mipWidth = MAX(image.width >> i, 1);
-        u32 mipHeight = MAX(image.height >> i, 1);
-        u64 mipSize = GetImageLayerSize(mipWidth, mipHeight, image.channelCount,
-                                        image.storageType) *
-                      image.layerCount;
-        if (fread(image.data + offset, 1, mipSize, file) != mipSize)
+        u64 mipOffset = 0;
+        for (u32 i = 0; i < image.mipCount; i++)
         {
-            Free(image.data);
-            return false;
+            u32 mipWidth = MAX(image.width >> i, 1);
+            u32 mipHeight = MAX(image.height >> i, 1);
+            u64 layerSize = GetImageLayerSize(
+                mipWidth, mipHeight, image.channelCount, image.storageType);
+            u8* dst = data + mipOffset + layerSize * layer;
+            if (fread(dst, 1, layerSize, file) != layerSize)
+            {
+                return false;
+            }
+            mipOffset += layerSize * image.layerCount;
         }
-        offset += mipSize;
     }
 
     return true;
 }
 
-bool LoadDDSImage(String8 path, Image& image)
+bool LoadDDSImage(String8 path, Image& image, ImageAllocator allocator,
+                  void* userData)
 {
+    FLY_ASSERT(allocator);
+
     FILE* file = fopen(path.Data(), "rb");
     Header header{};
 
@@ -456,7 +472,7 @@ bool LoadDDSImage(String8 path, Image& image)
         goto failure;
     }
 
-    if (!ReadDXT10(file, header, image))
+    if (!ReadDXT10(file, header, image, allocator, userData))
     {
         goto failure;
     }
@@ -472,4 +488,27 @@ failure:
     return false;
 }
 
+static u8* AllocImageData(const Image& image, u64 size, void* userData)
+{
+    u8*& data = *static_cast<u8**>(userData);
+    data = static_cast<u8*>(Alloc(size));
+    return data;
+}
+
+bool LoadDDSImage(String8 path, Image& image)
+{
+    u8* data = nullptr;
+    if (!LoadDDSImage(path, image, AllocImageData, &data))
+    {
+        if (data)
+        {
+            Free(data);
+        }
+        return false;
+    }
+
+    image.data = data;
+    return true;
+}
+
 } // namespace Fly
@@ -4,11 +4,15 @@
 #include "core/string8.h"
 #include "core/types.h"
 
+#include "image.h"
+
 namespace Fly
 {
 
-struct Image;
 bool LoadDDSImage(String8 path, Image& image);
+// Reads the texels straight into memory from allocator, image.data stays null
+bool LoadDDSImage(String8 path, Image& image, ImageAllocator allocator,
+                  void* userData);
 
 } // namespace Fly
 
@@ -2,6 +2,8 @@
 
 #include "core/assert.h"
 #include "core/filesystem.h"
+#include "core/half.h"
+#include "core/job_system.h"
 #include "core/log.h"
 #include "core/memory.h"
 #include "core/thread_context.h"
@@ -19,6 +21,11 @@
 #include <ktx.h>
 #include <tinyexr.h>
 
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// Rows per job when splitting texels into the planar channels of exr files
+#define FLY_EXR_ROW_BAND 64
+
 namespace Fly
 {
 
@@ -72,7 +79,7 @@ static bool ExportCookedImage(String8 path, const Image& image)
     header->channelCount = image.channelCount;
     header->layerCount = image.layerCount;
     header->mipCount = image.mipCount;
-    header->storageType = ImageStorageType::Byte;
+    header->storageType = image.storageType;
 
     u8* imageData = data + sizeof(ImageHeader);
     memcpy(imageData, image.data, imageSize);
@@ -194,9 +201,68 @@ static bool ExportKTX2(String8 path, const Image& image)
     return result == KTX_SUCCESS;
 }
 
+struct ExrPlanarJob
+{
+    const Image* image = nullptr;
+    f16* channels[4] = {};
+};
+
+// Float rows are converted to half on the fly, so a float image never needs
+// a full half copy next to the planar channels
+static void ExrPlanarRows(u32 band, void* userData)
+{
+    const ExrPlanarJob& job = *static_cast<ExrPlanarJob*>(userData);
+    const Image& image = *job.image;
+    u32 rowCount = image.height * image.layerCount;
+    u64 rowSize = static_cast<u64>(image.width) * image.channelCount;
+
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+    f16* row = nullptr;
+    if (image.storageType == ImageStorageType::Float)
+    {
+        row = FLY_PUSH_ARENA(scratch, f16, rowSize);
+    }
+
+    u32 firstRow = band * FLY_EXR_ROW_BAND;
+    u32 lastRow = MIN(firstRow + FLY_EXR_ROW_BAND, rowCount);
+    for (u32 j = firstRow; j < lastRow; j++)
+    {
+        const f16* src = nullptr;
+        if (row)
+        {
+            ConvertF32ToF16(row,
+                            reinterpret_cast<const f32*>(image.data) +
+                                rowSize * j,
+                            rowSize);
+            src = row;
+        }
+        else
+        {
+            src = reinterpret_cast<const f16*>(image.data) + rowSize * j;
+        }
+
+        u64 rowOffset = static_cast<u64>(j) * image.width;
+        for (u32 k = 0; k < image.channelCount; k++)
+        {
+            f16* dst = job.channels[k] + rowOffset;
+            for (u32 i = 0; i < image.width; i++)
+            {
+                dst[i] = src[i * image.channelCount + k];
+            }
+        }
+    }
+
+    ArenaPopToMarker(scratch, marker);
+}
+
+// Always writes half channels, float images are converted while the
+// channels are split into planes
 static bool ExportEXR(String8 path, const Image& image)
 {
-    FLY_ASSERT(image.storageType == ImageStorageType::Half);
+    FLY_ASSERT(image.storageType == ImageStorageType::Half ||
+               image.storageType == ImageStorageType::Float);
+    FLY_ASSERT(image.channelCount <= 4);
 
     EXRHeader exrHeader;
     InitEXRHeader(&exrHeader);
@@ -221,16 +287,8 @@ static bool ExportEXR(String8 path, const Image& image)
             static_cast<int*>(Fly::Alloc(sizeof(int) * image.channelCount));
         for (int i = 0; i < image.channelCount; i++)
         {
-            if (image.storageType == ImageStorageType::Half)
-            {
-                exrHeader.pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
-                exrHeader.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
-            }
-            else if (image.storageType == ImageStorageType::Float)
-            {
-                exrHeader.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
-                exrHeader.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
-            }
+            exrHeader.pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
+            exrHeader.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
         }
     }
 
@@ -244,31 +302,21 @@ static bool ExportEXR(String8 path, const Image& image)
 
         f16** images =
             static_cast<f16**>(Fly::Alloc(sizeof(f16*) * image.channelCount));
+        ExrPlanarJob job;
+        job.image = &image;
         for (u32 i = 0; i < image.channelCount; i++)
         {
             images[i] = static_cast<f16*>(Fly::Alloc(
                 sizeof(f16) * image.layerCount * image.width * image.height));
         }
-
-        const f16* imageData = reinterpret_cast<const f16*>(image.data);
-        for (u32 n = 0; n < image.layerCount; n++)
+        for (u32 k = 0; k < image.channelCount; k++)
         {
-            for (u32 i = 0; i < image.height; i++)
-            {
-                for (u32 j = 0; j < image.width; j++)
-                {
-                    for (u32 k = 0; k < image.channelCount; k++)
-                    {
-                        images[channelMap[k]][n * image.height * image.width +
-                                              i * image.width + j] =
-                            imageData[n * image.height * image.width *
-                                          image.channelCount +
-                                      i * image.width * image.channelCount +
-                                      j * image.channelCount + k];
-                    }
-                }
-            }
+            job.channels[k] = images[channelMap[k]];
         }
+
+        u32 rowCount = image.height * image.layerCount;
+        ParallelFor((rowCount + FLY_EXR_ROW_BAND - 1) / FLY_EXR_ROW_BAND,
+                    ExrPlanarRows, &job);
         exrImage.images = reinterpret_cast<unsigned char**>(images);
     }
 
@@ -288,10 +336,10 @@ static bool ExportEXR(String8 path, const Image& image)
     if (ret != TINYEXR_SUCCESS)
     {
         FreeEXRErrorMessage(err);
-        return ret;
+        return false;
     }
 
-    return ret == TINYEXR_SUCCESS;
+    return true;
 }
 
 bool ExportImage(String8 path, const Image& image)
@@ -371,7 +419,7 @@ bool ExportImage(String8 path, const Image& image)
         {
             if (String8::EndsWith(path, FLY_STRING8_LITERAL(".fbc5")))
             {
-                ExportCookedImage(path, image);
+                return ExportCookedImage(path, image);
             }
             break;
         }
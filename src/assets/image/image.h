@@ -43,6 +43,10 @@ struct Image
     ImageStorageType storageType = ImageStorageType::Byte;
 };
 
+// Returns size bytes that receive the texels of image, mip major with the
+// layers of a mip next to each other, or null to fail the load
+typedef u8* (*ImageAllocator)(const Image& image, u64 size, void* userData);
+
 u32 GetImageStorageTypeSize(ImageStorageType type);
 u64 GetImageSize(const Image& image);
 u64 GetImageSize(u32 width, u32 height, u8 channelCount, u8 layerCount,
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <string.h>
 
 #include "image.h"
@@ -5,6 +6,7 @@
 
 #include "core/assert.h"
 #include "core/filesystem.h"
+#include "core/job_system.h"
 #include "core/thread_context.h"
 #include "core/log.h"
 #include "core/memory.h"
@@ -23,40 +25,80 @@
 #include "assets/image/dds_image.h"
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// Rows per job when interleaving the planar channels of exr files
+#define FLY_EXR_ROW_BAND 64
 
 namespace Fly
 {
 
-static bool LoadCompressedImageFromFile(String8 path, Image& image)
+static u8* AllocImageData(const Image& image, u64 size, void* userData)
+{
+    u8*& data = *static_cast<u8**>(userData);
+    data = static_cast<u8*>(Alloc(size));
+    return data;
+}
+
+static bool LoadCompressedImageFromFile(String8 path, Image& image,
+                                        ImageAllocator allocator,
+                                        void* userData)
 {
     FLY_ASSERT(path);
 
     Arena& scratch = GetScratchArena();
     ArenaMarker marker = ArenaGetMarker(scratch);
 
-    u64 size = 0;
-    char* data = ReadFileToCStr(scratch, path, size);
+    FILE* file = fopen(String8::PushCStr(scratch, path), "rb");
+    ArenaPopToMarker(scratch, marker);
+    if (!file)
+    {
+        return false;
+    }
 
-    const ImageHeader* header = reinterpret_cast<const ImageHeader*>(data);
-    image.width = header->width;
-    image.height = header->height;
-    image.channelCount = header->channelCount;
-    image.layerCount = header->layerCount;
-    image.mipCount = header->mipCount;
-    image.storageType = header->storageType;
+    ImageHeader header;
+    u8* data = nullptr;
+    bool res = fread(&header, 1, sizeof(ImageHeader), file) ==
+               sizeof(ImageHeader);
+    if (res)
+    {
+        image.width = header.width;
+        image.height = header.height;
+        image.channelCount = header.channelCount;
+        image.layerCount = header.layerCount;
+        image.mipCount = header.mipCount;
+        image.storageType = header.storageType;
+
+        data = allocator(image, header.size, userData);
+        res = data && fseek(file, static_cast<long>(header.offset),
+                            SEEK_SET) == 0;
+    }
+    res = res && fread(data, 1, header.size, file) == header.size;
 
-    u64 imageSize = header->size;
-    u8* imageData = static_cast<u8*>(Alloc(imageSize));
-    memcpy(imageData, data + sizeof(ImageHeader), imageSize);
+    fclose(file);
+    return res;
+}
 
-    ArenaPopToMarker(scratch, marker);
-    image.data = imageData;
+static bool LoadCompressedImageFromFile(String8 path, Image& image)
+{
+    u8* data = nullptr;
+    if (!LoadCompressedImageFromFile(path, image, AllocImageData, &data))
+    {
+        if (data)
+        {
+            Free(data);
+        }
+        return false;
+    }
 
+    image.data = data;
     return true;
 }
 
+// Only the first mip, flipped to top to bottom rows. Basis textures are
+// transcoded to rgba8 first, so their texels are copied once.
 static bool LoadKtx2ImageFromFile(String8 path, Image& image,
-                                  u8 desiredChannelCount)
+                                  ImageAllocator allocator, void* userData)
 {
     ktxTexture2* texture = nullptr;
     KTX_error_code result = ktxTexture2_CreateFromNamedFile(
@@ -85,27 +127,45 @@ static bool LoadKtx2ImageFromFile(String8 path, Image& image,
     // TODO: Load mips too
     image.mipCount = 1;
 
-    u64 imageSize =
-        ktxTexture_GetLevelSize(reinterpret_cast<ktxTexture*>(texture), 0);
-    ktx_size_t offset = 0;
-    ktxTexture2_GetImageOffset(texture, 0, 0, 0, &offset);
+    u64 layerSize =
+        ktxTexture_GetImageSize(reinterpret_cast<ktxTexture*>(texture), 0);
+    u8* imageData = allocator(image, layerSize * image.layerCount, userData);
+    if (!imageData)
+    {
+        ktxTexture2_Destroy(texture);
+        return false;
+    }
 
-    u8* imageData = static_cast<u8*>(Alloc(imageSize));
-    memcpy(imageData, texture->pData + offset, imageSize);
+    u64 rowSize = static_cast<u64>(image.width) * image.channelCount;
+    for (u32 layer = 0; layer < image.layerCount; layer++)
+    {
+        ktx_size_t offset = 0;
+        ktxTexture2_GetImageOffset(texture, 0, layer, 0, &offset);
 
-    // Flip image
+        const u8* src = texture->pData + offset;
+        u8* dst = imageData + layerSize * layer;
+        for (u32 y = 0; y < image.height; y++)
+        {
+            memcpy(dst + (image.height - 1 - y) * rowSize, src + y * rowSize,
+                   rowSize);
+        }
+    }
+
+    ktxTexture2_Destroy(texture);
+    return true;
+}
+
+static bool LoadKtx2ImageFromFile(String8 path, Image& image,
+                                  u8 desiredChannelCount)
+{
+    u8* imageData = nullptr;
+    if (!LoadKtx2ImageFromFile(path, image, AllocImageData, &imageData))
     {
-        u8* tmpRow = static_cast<u8*>(Alloc(image.width * image.channelCount));
-        for (u32 y = 0; y < image.height / 2; y++)
+        if (imageData)
         {
-            u8* rowTop = imageData + y * image.width * image.channelCount;
-            u8* rowBottom = imageData + (image.height - 1 - y) * image.width *
-                                            image.channelCount;
-            memcpy(tmpRow, rowTop, image.width * image.channelCount);
-            memcpy(rowTop, rowBottom, image.width * image.channelCount);
-            memcpy(rowBottom, tmpRow, image.width * image.channelCount);
+            Free(imageData);
         }
-        Free(tmpRow);
+        return false;
     }
 
     // Fix channel counts
@@ -150,10 +210,38 @@ static bool LoadKtx2ImageFromFile(String8 path, Image& image,
         Free(imageData);
     }
 
-    ktxTexture2_Destroy(texture);
     return true;
 }
 
+struct ExrInterleaveJob
+{
+    Image* image = nullptr;
+    const f16* channels[4] = {};
+};
+
+static void ExrInterleaveRows(u32 band, void* userData)
+{
+    const ExrInterleaveJob& job = *static_cast<ExrInterleaveJob*>(userData);
+    const Image& image = *job.image;
+    f16* data = reinterpret_cast<f16*>(image.data);
+
+    u32 firstRow = band * FLY_EXR_ROW_BAND;
+    u32 lastRow = MIN(firstRow + FLY_EXR_ROW_BAND, image.height);
+    for (u32 j = firstRow; j < lastRow; j++)
+    {
+        u64 rowOffset = static_cast<u64>(j) * image.width;
+        f16* dst = data + rowOffset * image.channelCount;
+        for (u32 k = 0; k < image.channelCount; k++)
+        {
+            const f16* src = job.channels[k] + rowOffset;
+            for (u32 i = 0; i < image.width; i++)
+            {
+                dst[i * image.channelCount + k] = src[i];
+            }
+        }
+    }
+}
+
 static bool LoadExrImageFromFile(String8 path, Image& image)
 {
     FLY_ASSERT(path);
@@ -221,10 +309,9 @@ static bool LoadExrImageFromFile(String8 path, Image& image)
 
     FLY_ASSERT(exrImage.images);
 
-    u16* data =
-        static_cast<u16*>(Fly::Alloc(sizeof(u16) * exrImage.width *
-                                     exrImage.height * exrImage.num_channels));
-    image.data = reinterpret_cast<u8*>(data);
+    image.data = static_cast<u8*>(
+        Fly::Alloc(sizeof(f16) * exrImage.width * exrImage.height *
+                   exrImage.num_channels));
     image.channelCount = exrImage.num_channels;
     image.width = exrImage.width;
     image.height = exrImage.height;
@@ -233,19 +320,15 @@ static bool LoadExrImageFromFile(String8 path, Image& image)
     image.storageType = ImageStorageType::Half;
 
     // Change channel layout
-    for (u32 j = 0; j < image.height; j++)
+    ExrInterleaveJob job;
+    job.image = &image;
+    for (u32 k = 0; k < image.channelCount; k++)
     {
-        for (u32 i = 0; i < image.width; i++)
-        {
-            for (u32 k = 0; k < image.channelCount; k++)
-            {
-                data[j * image.width * image.channelCount +
-                     i * image.channelCount + k] =
-                    reinterpret_cast<u16*>(
-                        exrImage.images[channelMap[k]])[j * exrImage.width + i];
-            }
-        }
+        job.channels[k] = reinterpret_cast<const f16*>(
+            exrImage.images[channelMap[k]]);
     }
+    ParallelFor((image.height + FLY_EXR_ROW_BAND - 1) / FLY_EXR_ROW_BAND,
+                ExrInterleaveRows, &job);
 
     FreeEXRImage(&exrImage);
     FreeEXRHeader(&exrHeader);
@@ -332,6 +415,105 @@ bool LoadImageFromFile(String8 path, Image& image, u8 desiredChannelCount)
     return image.data;
 }
 
+bool LoadImageFromFile(String8 path, Image& image, ImageAllocator allocator,
+                       void* userData)
+{
+    FLY_ASSERT(path);
+    FLY_ASSERT(allocator);
+
+    String8 extension = String8::FindLast(path, '.');
+    if (String8::StartsWith(extension, FLY_STRING8_LITERAL(".fbc")))
+    {
+        return LoadCompressedImageFromFile(path, image, allocator, userData);
+    }
+    else if (String8::StartsWith(extension, FLY_STRING8_LITERAL(".ktx2")))
+    {
+        return LoadKtx2ImageFromFile(path, image, allocator, userData);
+    }
+    else if (String8::StartsWith(extension, FLY_STRING8_LITERAL(".dds")))
+    {
+        return LoadDDSImage(path, image, allocator, userData);
+    }
+
+    return false;
+}
+
+static u8* RecordImageSize(const Image&, u64 size, void* userData)
+{
+    *static_cast<u64*>(userData) = size;
+    return nullptr;
+}
+
+static bool LoadExrImageInfoFromFile(String8 path, Image& image)
+{
+    EXRVersion exrVersion;
+    if (ParseEXRVersionFromFile(&exrVersion, path.Data()) != 0 ||
+        exrVersion.multipart != 0)
+    {
+        return false;
+    }
+
+    EXRHeader exrHeader;
+    InitEXRHeader(&exrHeader);
+    const char* err = nullptr;
+    if (ParseEXRHeaderFromFile(&exrHeader, &exrVersion, path.Data(), &err) !=
+        0)
+    {
+        FreeEXRErrorMessage(err);
+        return false;
+    }
+
+    image.width = static_cast<u32>(exrHeader.data_window.max_x -
+                                   exrHeader.data_window.min_x + 1);
+    image.height = static_cast<u32>(exrHeader.data_window.max_y -
+                                    exrHeader.data_window.min_y + 1);
+    image.channelCount = static_cast<u8>(exrHeader.num_channels);
+    image.mipCount = 1;
+    image.layerCount = 1;
+    image.storageType = ImageStorageType::Half;
+
+    FreeEXRHeader(&exrHeader);
+    return true;
+}
+
+bool LoadImageInfoFromFile(String8 path, Image& image,
+                           u8 desiredChannelCount)
+{
+    FLY_ASSERT(path);
+
+    image = {};
+    String8 extension = String8::FindLast(path, '.');
+    if (String8::StartsWith(extension, FLY_STRING8_LITERAL(".fbc")) ||
+        String8::StartsWith(extension, FLY_STRING8_LITERAL(".ktx2")) ||
+        String8::StartsWith(extension, FLY_STRING8_LITERAL(".dds")))
+    {
+        // The loaders fill in the image before they ask for memory
+        u64 size = 0;
+        LoadImageFromFile(path, image, RecordImageSize, &size);
+        return size != 0;
+    }
+    else if (String8::StartsWith(extension, FLY_STRING8_LITERAL(".exr")))
+    {
+        return LoadExrImageInfoFromFile(path, image);
+    }
+
+    int x = 0, y = 0, n = 0;
+    if (!stbi_info(path.Data(), &x, &y, &n))
+    {
+        return false;
+    }
+
+    image.storageType = stbi_is_hdr(path.Data()) ? ImageStorageType::Float
+                                                 : ImageStorageType::Byte;
+    image.mipCount = 1;
+    image.layerCount = 1;
+    image.width = static_cast<u32>(x);
+    image.height = static_cast<u32>(y);
+    image.channelCount =
+        desiredChannelCount ? desiredChannelCount : static_cast<u8>(n);
+    return true;
+}
+
 u64 GetImageLayerSize(u32 width, u32 height, u32 channelCount,
                       ImageStorageType storageType)
 {
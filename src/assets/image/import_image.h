@@ -4,14 +4,23 @@
 #include "core/string8.h"
 #include "core/types.h"
 
+#include "image.h"
+
 namespace Fly
 {
 
-struct Image;
-
 bool LoadImageFromMemory(u8* buffer, u64 size, Image& image,
                          u8 desiredChannelCount = 4);
 bool LoadImageFromFile(String8 path, Image& image, u8 desiredChannelCount = 4);
+// Cooked .fbc*, DDS and KTX2 files only. Texels go to memory from allocator,
+// e.g. a mapped staging buffer, instead of image.data, which stays null.
+// Cooked and DDS texels are read from the file straight into it.
+bool LoadImageFromFile(String8 path, Image& image, ImageAllocator allocator,
+                       void* userData);
+// Reads only the header, image.data stays null. Fails for files that
+// LoadImageFromFile can not read.
+bool LoadImageInfoFromFile(String8 path, Image& image,
+                           u8 desiredChannelCount = 4);
 void DestroyImage(Image& image);
 
 } // namespace Fly
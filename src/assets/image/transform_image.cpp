@@ -1,15 +1,23 @@
+#include <math.h>
 #include <string.h>
 
 #include "core/assert.h"
+#include "core/half.h"
+#include "core/job_system.h"
 #include "core/memory.h"
 #include "core/thread_context.h"
 
+#include "math/functions.h"
+#include "math/simd.h"
+#include "math/vec.h"
+
 #include "rhi/buffer.h"
 #include "rhi/command_buffer.h"
 #include "rhi/device.h"
 #include "rhi/pipeline.h"
 #include "rhi/texture.h"
 
+#include "bc_compression.h"
 #include "export_image.h"
 #include "transform_image.h"
 
@@ -21,14 +29,20 @@
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include "stb_image_resize2.h"
 
-#define STB_DXT_IMPLEMENTATION
-#include "stb_dxt.h"
-
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-using BlockCompressionFunc = void (*)(unsigned char* dst,
-                                      const unsigned char* src);
+// Values converted at a time on the stack by the color kernels, a multiple
+// of 4 so the alpha of 4 channel texels always lands in the last lane
+#define FLY_COLOR_CHUNK_SIZE 1024
+// Texels per job of the whole image color conversions
+#define FLY_COLOR_JOB_SIZE 16384
+// Previous level rows kept on either side of a streamed band, more than the
+// support of the stbir downsampling filters
+#define FLY_STREAM_ROW_MARGIN 8
+// Rows a mip window holds on top of its bands, the margins on both sides
+// and the rounding of GetFootprintRows
+#define FLY_STREAM_WINDOW_MARGIN_ROWS (2 * FLY_STREAM_ROW_MARGIN + 4)
 
 static u32 Log2(u32 x)
 {
@@ -40,19 +54,24 @@ static u32 Log2(u32 x)
     return result;
 }
 
-static void CompressBlockBC1(unsigned char* dst, const unsigned char* src)
-{
-    stb_compress_dxt_block(dst, src, 0, STB_DXT_NORMAL);
-}
-
-static void CompressBlockBC3(unsigned char* dst, const unsigned char* src)
-{
-    stb_compress_dxt_block(dst, src, 1, STB_DXT_NORMAL);
-}
-
 static void CopyImageBlock(u8* block, const u8* data, u32 width, u32 height,
                            u32 x, u32 y, u32 elemSize)
 {
+    const u32 rowSize = 4 * elemSize;
+
+    // Interior blocks copy whole rows, only edge blocks need clamping
+    if (x * 4 + 4 <= width && y * 4 + 4 <= height)
+    {
+        const u8* srcPtr =
+            data + (static_cast<u64>(width) * y * 4 + x * 4) * elemSize;
+        for (u32 i = 0; i < 4; i++)
+        {
+            memcpy(block + i * rowSize, srcPtr, rowSize);
+            srcPtr += width * elemSize;
+        }
+        return;
+    }
+
     for (u32 i = 0; i < 4; i++)
     {
         for (u32 j = 0; j < 4; j++)
@@ -71,44 +90,96 @@ static void CopyImageBlock(u8* block, const u8* data, u32 width, u32 height,
 namespace Fly
 {
 
+struct CompressRowJob
+{
+    u8* dst = nullptr;
+    const u8* src = nullptr;
+    u32 width = 0;
+    u32 height = 0;
+    u32 channelCount = 0;
+    ImageStorageType codec = ImageStorageType::Invalid;
+    BCQuality quality = BCQuality::Normal;
+};
+
+static void CompressImageRow(u32 row, void* userData)
+{
+    const CompressRowJob& job = *static_cast<const CompressRowJob*>(userData);
+
+    const u32 elemSize =
+        job.channelCount *
+        (job.codec == ImageStorageType::BC6 ? sizeof(f16) : sizeof(u8));
+    const u32 blockSize = GetImageLayerSize(4, 4, job.channelCount, job.codec);
+    const u32 blockWidth = (job.width + 3) / 4;
+
+    // Largest block is 16 texels of four half channels
+    alignas(8) u8 block[16 * 4 * sizeof(f16)];
+    u8* dst = job.dst + row * blockWidth * blockSize;
+    for (u32 j = 0; j < blockWidth; j++, dst += blockSize)
+    {
+        CopyImageBlock(block, job.src, job.width, job.height, j, row,
+                       elemSize);
+        switch (job.codec)
+        {
+            case ImageStorageType::BC1:
+            {
+                CompressBlockBC1(dst, block);
+                break;
+            }
+            case ImageStorageType::BC3:
+            {
+                CompressBlockBC3(dst, block);
+                break;
+            }
+            case ImageStorageType::BC4:
+            {
+                CompressBlockBC4(dst, block);
+                break;
+            }
+            case ImageStorageType::BC5:
+            {
+                CompressBlockBC5(dst, block);
+                break;
+            }
+            case ImageStorageType::BC6:
+            {
+                CompressBlockBC6H(dst, reinterpret_cast<const f16*>(block),
+                                  job.channelCount, job.quality);
+                break;
+            }
+            case ImageStorageType::BC7:
+            {
+                CompressBlockBC7(dst, block, job.quality);
+                break;
+            }
+            default:
+            {
+                FLY_ASSERT(false);
+                break;
+            }
+        }
+    }
+}
+
 static void CompressImageLayer(u8* dst, const u8* src, u32 srcWidth,
-                               u32 srcHeight, ImageStorageType codec)
+                               u32 srcHeight, u32 channelCount,
+                               ImageStorageType codec, BCQuality quality)
 {
     FLY_ASSERT(dst);
     FLY_ASSERT(src);
     FLY_ASSERT(srcWidth);
     FLY_ASSERT(srcHeight);
 
-    static BlockCompressionFunc compressionFuncs[4] = {
-        CompressBlockBC1,
-        CompressBlockBC3,
-        stb_compress_bc4_block,
-        stb_compress_bc5_block,
-    };
-
-    static u8 channelCounts[4] = {4, 4, 1, 2};
-    static u8 blockSizes[4] = {8, 16, 8, 16};
-
-    BlockCompressionFunc compressionFunc =
-        compressionFuncs[static_cast<u8>(codec)];
-    const u32 elemSize = channelCounts[static_cast<u8>(codec)];
-    const u32 blockSize = blockSizes[static_cast<u8>(codec)];
-
-    Arena& arena = GetScratchArena();
-    ArenaMarker marker = ArenaGetMarker(arena);
-    u8* block = FLY_PUSH_ARENA(arena, u8, 16 * elemSize);
-
-    const u32 blockWidth = (srcWidth + 3) / 4;
-    const u32 blockHeight = (srcHeight + 3) / 4;
-    for (u32 i = 0; i < blockHeight; i++)
-    {
-        for (u32 j = 0; j < blockWidth; j++)
-        {
-            CopyImageBlock(block, src, srcWidth, srcHeight, j, i, elemSize);
-            compressionFunc(dst + (i * blockWidth + j) * blockSize, block);
-        }
-    }
-    ArenaPopToMarker(arena, marker);
+    CompressRowJob job;
+    job.dst = dst;
+    job.src = src;
+    job.width = srcWidth;
+    job.height = srcHeight;
+    job.channelCount = channelCount;
+    job.codec = codec;
+    job.quality = quality;
+
+    // Rows of blocks are independent and write disjoint parts of dst
+    ParallelFor((srcHeight + 3) / 4, CompressImageRow, &job);
 }
 
 static VkFormat ImageVulkanFormat(ImageStorageType storageType, u8 channelCount)
@@ -322,7 +393,40 @@ void CopyImage(const Image& srcImage, Image& dstImage)
     memcpy(dstImage.data, srcImage.data, srcImageSize);
 }
 
-bool GenerateMips(Image& image, bool linearResize)
+static stbir_datatype MipDataType(ImageStorageType storageType,
+                                  bool linearResize)
+{
+    switch (storageType)
+    {
+        case ImageStorageType::Byte:
+        {
+            return linearResize ? STBIR_TYPE_UINT8 : STBIR_TYPE_UINT8_SRGB;
+        }
+        case ImageStorageType::Half:
+        {
+            return STBIR_TYPE_HALF_FLOAT;
+        }
+        default:
+        {
+            return STBIR_TYPE_FLOAT;
+        }
+    }
+}
+
+struct MipResizeJob
+{
+    STBIR_RESIZE* resize = nullptr;
+    i32 split = 0;
+    bool result = false;
+};
+
+static void ResizeMipSplit(u32 index, void* userData)
+{
+    MipResizeJob& job = static_cast<MipResizeJob*>(userData)[index];
+    job.result = stbir_resize_extended_split(job.resize, job.split, 1);
+}
+
+bool GenerateMips(Image& image, bool linearResize, bool fromBaseLevel)
 {
     FLY_ASSERT(image.data);
     FLY_ASSERT(image.width);
@@ -330,61 +434,127 @@ bool GenerateMips(Image& image, bool linearResize)
     FLY_ASSERT(image.channelCount);
     FLY_ASSERT(image.layerCount);
     FLY_ASSERT(image.mipCount);
-    FLY_ASSERT(image.storageType == ImageStorageType::Byte);
+    FLY_ASSERT(image.storageType == ImageStorageType::Byte ||
+               image.storageType == ImageStorageType::Half ||
+               image.storageType == ImageStorageType::Float);
+
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
 
     u32 mipCount = Log2(MAX(image.width, image.height)) + 1;
+    u64* mipOffsets = FLY_PUSH_ARENA(arena, u64, mipCount);
+    u64* layerSizes = FLY_PUSH_ARENA(arena, u64, mipCount);
     u64 totalSize = 0;
     for (u32 i = 0; i < mipCount; i++)
     {
         u32 mipWidth = MAX(image.width >> i, 1);
         u32 mipHeight = MAX(image.height >> i, 1);
-        totalSize +=
-            mipWidth * mipHeight * image.channelCount * image.layerCount;
+        layerSizes[i] = GetImageLayerSize(
+            mipWidth, mipHeight, image.channelCount, image.storageType);
+        mipOffsets[i] = totalSize;
+        totalSize += layerSizes[i] * image.layerCount;
     }
 
-    u8* data = static_cast<u8*>(Alloc(totalSize));
+    // Level 0 stays where it is, the rest of the chain is written in place
+    image.data = static_cast<u8*>(Realloc(image.data, totalSize));
+
+    stbir_datatype dataType = MipDataType(image.storageType, linearResize);
+    stbir_pixel_layout pixelLayout =
+        static_cast<stbir_pixel_layout>(image.channelCount);
+    u32 maxSplitCount = GetJobWorkerCount() + 1;
+
+    // Each level depends on the previous one, unless all of them are
+    // resampled from level 0. Levels are split in horizontal bands so that
+    // even a single layer keeps every worker busy.
+    u32 passCount = fromBaseLevel ? MIN(mipCount - 1, 1) : mipCount - 1;
+    u32 levelsPerPass = fromBaseLevel ? mipCount - 1 : 1;
+    bool res = true;
+    for (u32 pass = 0; pass < passCount && res; pass++)
+    {
+        ArenaMarker passMarker = ArenaGetMarker(arena);
 
-    u64 offset =
-        image.width * image.height * image.channelCount * image.layerCount;
-    memcpy(data, image.data, offset);
+        u32 resizeCount = levelsPerPass * image.layerCount;
+        STBIR_RESIZE* resizes =
+            FLY_PUSH_ARENA(arena, STBIR_RESIZE, resizeCount);
+        i32* splitCounts = FLY_PUSH_ARENA(arena, i32, resizeCount);
+        u32 jobCount = 0;
 
-    for (u32 i = 1; i < mipCount; i++)
-    {
-        u32 mipWidth = MAX(image.width >> i, 1);
-        u32 mipHeight = MAX(image.height >> i, 1);
+        for (u32 i = 0; i < levelsPerPass; i++)
+        {
+            u32 level = pass + i + 1;
+            u32 srcLevel = fromBaseLevel ? 0 : level - 1;
+            u32 srcWidth = MAX(image.width >> srcLevel, 1);
+            u32 srcHeight = MAX(image.height >> srcLevel, 1);
+            u32 dstWidth = MAX(image.width >> level, 1);
+            u32 dstHeight = MAX(image.height >> level, 1);
+            const u8* srcData = image.data + mipOffsets[srcLevel];
+            u8* dstData = image.data + mipOffsets[level];
+
+            u64 minSplitPixels = 64 * 1024;
+            u32 splitCount = static_cast<u32>(MIN(
+                static_cast<u64>(dstWidth) * dstHeight / minSplitPixels + 1,
+                maxSplitCount));
+
+            for (u32 j = 0; j < image.layerCount; j++)
+            {
+                u32 index = i * image.layerCount + j;
+                const u8* src = srcData + layerSizes[srcLevel] * j;
+                u8* dst = dstData + layerSizes[level] * j;
+
+                STBIR_RESIZE& resize = resizes[index];
+                stbir_resize_init(&resize, src, srcWidth, srcHeight, 0, dst,
+                                  dstWidth, dstHeight, 0, pixelLayout,
+                                  dataType);
+                stbir_set_edgemodes(&resize, STBIR_EDGE_CLAMP,
+                                    STBIR_EDGE_CLAMP);
+                splitCounts[index] =
+                    stbir_build_samplers_with_splits(&resize, splitCount);
+                res = res && splitCounts[index] > 0;
+                jobCount += MAX(splitCounts[index], 0);
+            }
+        }
 
-        Image resized{};
-        CopyImage(image, resized);
-        if (linearResize)
+        MipResizeJob* jobs = FLY_PUSH_ARENA(arena, MipResizeJob, jobCount);
+        u32 jobIndex = 0;
+        for (u32 i = 0; i < resizeCount; i++)
         {
-            if (!ResizeImageLinear(mipWidth, mipHeight, resized))
+            for (i32 j = 0; j < splitCounts[i]; j++)
             {
-                Free(data);
-                Free(resized.data);
-                return false;
+                jobs[jobIndex].resize = &resizes[i];
+                jobs[jobIndex].split = j;
+                jobs[jobIndex].result = false;
+                jobIndex++;
             }
         }
-        else
+
+        if (res)
         {
-            if (!ResizeImageSRGB(mipWidth, mipHeight, resized))
+            ParallelFor(jobCount, ResizeMipSplit, jobs);
+        }
+
+        for (u32 i = 0; i < jobCount; i++)
+        {
+            res = res && jobs[i].result;
+        }
+        for (u32 i = 0; i < resizeCount; i++)
+        {
+            if (splitCounts[i] > 0)
             {
-                Free(data);
-                Free(resized.data);
-                return false;
+                stbir_free_samplers(&resizes[i]);
             }
         }
 
-        u64 resizedSize = GetImageSize(resized);
-        memcpy(data + offset, resized.data, resizedSize);
-        offset += resizedSize;
+        ArenaPopToMarker(arena, passMarker);
+    }
 
-        Free(resized.data);
+    ArenaPopToMarker(arena, marker);
+
+    if (!res)
+    {
+        return false;
     }
 
-    Free(image.data);
-    image.data = data;
     image.mipCount = mipCount;
-
     return true;
 }
 
@@ -399,11 +569,16 @@ bool Eq2Cube(RHI::Device& device, RHI::GraphicsPipeline& eq2cubePipeline,
     FLY_ASSERT(image.mipCount);
     FLY_ASSERT(image.storageType == ImageStorageType::Byte);
 
+    // Three channel formats are rarely supported for sampling
+    if (image.channelCount == 3)
+    {
+        ConvertImageChannels(4, image);
+    }
+
     u32 side = image.width / 4;
+    u32 channelCount = image.channelCount;
     VkFormat inputImageFormat =
         ImageVulkanFormat(image.storageType, image.channelCount);
-
-    u32 channelCount = (image.channelCount == 3) ? 4 : image.channelCount;
     VkFormat cubemapFormat = ImageVulkanFormat(image.storageType, channelCount);
 
     RHI::Texture texture2D{};
@@ -487,31 +662,434 @@ bool Eq2Cube(RHI::Device& device, RHI::GraphicsPipeline& eq2cubePipeline,
     return true;
 }
 
-bool CompressImage(ImageStorageType codec, Image& image)
+struct SRGBToLinearTable
+{
+    f32 values[256];
+};
+
+static SRGBToLinearTable BuildSRGBToLinearTable()
+{
+    SRGBToLinearTable table;
+    for (u32 i = 0; i < 256; i++)
+    {
+        f32 value = i / 255.0f;
+        table.values[i] = (value <= 0.04045f)
+                              ? value / 12.92f
+                              : Math::Pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    return table;
+}
+
+static const f32* GetSRGBToLinearTable()
+{
+    static const SRGBToLinearTable table = BuildSRGBToLinearTable();
+    return table.values;
+}
+
+// All lanes true for the alpha of 4 channel texels, all false otherwise
+static Math::F32x4 AlphaLaneMask(u8 channelCount)
+{
+    const f32 lanes[4] = {0.0f, 0.0f, 0.0f, channelCount == 4 ? 1.0f : 0.0f};
+    return Math::CmpEq(Math::LoadF32x4(lanes), Math::SplatF32x4(1.0f));
+}
+
+// values holds count linear values followed by padding up to a multiple of
+// 4, it is used as scratch
+static void EncodeSRGBChunk(u8* dst, f32* values, u32 count, u8 channelCount)
+{
+    using namespace Math;
+
+    F32x4 zero = SplatF32x4(0.0f);
+    F32x4 one = SplatF32x4(1.0f);
+    F32x4 alphaMask = AlphaLaneMask(channelCount);
+    u32 paddedCount = (count + 3) & ~3u;
+    for (u32 i = 0; i < paddedCount; i += 4)
+    {
+        StoreF32x4(values + i, Min(Max(LoadF32x4(values + i), zero), one));
+    }
+
+    f32 curve[FLY_COLOR_CHUNK_SIZE];
+    FastPow(values, 1.0f / 2.4f, curve, paddedCount);
+
+    F32x4 threshold = SplatF32x4(0.0031308f);
+    for (u32 i = 0; i < paddedCount; i += 4)
+    {
+        F32x4 linear = LoadF32x4(values + i);
+        F32x4 srgb = Select(
+            CmpGe(threshold, linear), linear * SplatF32x4(12.92f),
+            MulAdd(LoadF32x4(curve + i), SplatF32x4(1.055f),
+                   SplatF32x4(-0.055f)));
+        srgb = Select(alphaMask, linear, srgb);
+        StoreF32x4(curve + i,
+                   MulAdd(srgb, SplatF32x4(255.0f), SplatF32x4(0.5f)));
+    }
+
+    for (u32 i = 0; i < count; i++)
+    {
+        dst[i] = static_cast<u8>(curve[i]);
+    }
+}
+
+void SRGBToLinear(f32* dst, const u8* src, u64 texelCount, u8 channelCount)
+{
+    FLY_ASSERT(channelCount > 0 && channelCount <= 4);
+
+    const f32* table = GetSRGBToLinearTable();
+    u64 count = texelCount * channelCount;
+    if (channelCount != 4)
+    {
+        for (u64 i = 0; i < count; i++)
+        {
+            dst[i] = table[src[i]];
+        }
+        return;
+    }
+
+    for (u64 i = 0; i < count; i += 4)
+    {
+        dst[i] = table[src[i]];
+        dst[i + 1] = table[src[i + 1]];
+        dst[i + 2] = table[src[i + 2]];
+        dst[i + 3] = src[i + 3] * (1.0f / 255.0f);
+    }
+}
+
+void LinearToSRGB(u8* dst, const f32* src, u64 texelCount, u8 channelCount)
+{
+    FLY_ASSERT(channelCount > 0 && channelCount <= 4);
+
+    f32 values[FLY_COLOR_CHUNK_SIZE];
+    u64 count = texelCount * channelCount;
+    for (u64 i = 0; i < count; i += FLY_COLOR_CHUNK_SIZE)
+    {
+        u32 chunkSize = static_cast<u32>(MIN(count - i, FLY_COLOR_CHUNK_SIZE));
+        memcpy(values, src + i, sizeof(f32) * chunkSize);
+        for (u32 j = chunkSize; j < ((chunkSize + 3) & ~3u); j++)
+        {
+            values[j] = 0.0f;
+        }
+        EncodeSRGBChunk(dst + i, values, chunkSize, channelCount);
+    }
+}
+
+struct Eq2CubeJob
+{
+    u8* dst = nullptr;
+    const u8* src = nullptr;
+    u32 srcWidth = 0;
+    u32 srcHeight = 0;
+    u32 side = 0;
+    u8 srcChannelCount = 0;
+    u8 dstChannelCount = 0;
+    ImageStorageType storageType = ImageStorageType::Invalid;
+    Eq2CubeFilter filter = Eq2CubeFilter::Bilinear;
+};
+
+// Same face orientation as eq2cube.frag, coord is in [-1, 1] with y up
+static Math::Vec3 GetCubeDirection(u32 face, f32 x, f32 y)
+{
+    switch (face)
+    {
+        case 0:
+            return Math::Vec3(1.0f, -y, -x);
+        case 1:
+            return Math::Vec3(-1.0f, -y, x);
+        case 2:
+            return Math::Vec3(x, -1.0f, -y);
+        case 3:
+            return Math::Vec3(x, 1.0f, y);
+        case 4:
+            return Math::Vec3(x, -y, 1.0f);
+        default:
+            return Math::Vec3(-x, -y, -1.0f);
+    }
+}
+
+static Math::F32x4 LoadTexel(const Eq2CubeJob& job, i32 x, i32 y)
+{
+    // Longitude wraps around, rows past a pole continue on the opposite
+    // meridian, so filters see no seam at either edge
+    i32 width = static_cast<i32>(job.srcWidth);
+    i32 height = static_cast<i32>(job.srcHeight);
+    if (y < 0)
+    {
+        y = -1 - y;
+        x += width / 2;
+    }
+    else if (y >= height)
+    {
+        y = 2 * height - 1 - y;
+        x += width / 2;
+    }
+    y = Math::Clamp(y, 0, height - 1);
+    x %= width;
+    if (x < 0)
+    {
+        x += width;
+    }
+
+    u64 offset = (static_cast<u64>(y) * job.srcWidth + x) * job.srcChannelCount;
+    f32 texel[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    if (job.storageType == ImageStorageType::Byte)
+    {
+        // Filtered in linear space like the srgb sampler of the gpu path
+        SRGBToLinear(texel, job.src + offset, 1, job.srcChannelCount);
+    }
+    else
+    {
+        const f32* src = reinterpret_cast<const f32*>(job.src) + offset;
+        if (job.srcChannelCount == 4)
+        {
+            return Math::LoadF32x4(src);
+        }
+        for (u8 c = 0; c < job.srcChannelCount; c++)
+        {
+            texel[c] = src[c];
+        }
+    }
+    return Math::LoadF32x4(texel);
+}
+
+// Catmull-Rom, interpolates the texels and keeps gradients continuous
+static void CubicWeights(f32 t, f32 weights[4])
+{
+    weights[0] = t * (-0.5f + t * (1.0f - 0.5f * t));
+    weights[1] = 1.0f + t * t * (-2.5f + 1.5f * t);
+    weights[2] = t * (0.5f + t * (2.0f - 1.5f * t));
+    weights[3] = t * t * (-0.5f + 0.5f * t);
+}
+
+// x and y are texel space coordinates of the sample in the source
+static Math::F32x4 SampleEquirectangular(const Eq2CubeJob& job, f32 x, f32 y)
+{
+    using namespace Math;
+
+    switch (job.filter)
+    {
+        case Eq2CubeFilter::Nearest:
+        {
+            return LoadTexel(job, static_cast<i32>(Floor(x)),
+                             static_cast<i32>(Floor(y)));
+        }
+        case Eq2CubeFilter::Bilinear:
+        {
+            x -= 0.5f;
+            y -= 0.5f;
+            f32 x0 = Floor(x);
+            f32 y0 = Floor(y);
+            F32x4 tx = SplatF32x4(x - x0);
+            F32x4 ty = SplatF32x4(y - y0);
+            i32 ix = static_cast<i32>(x0);
+            i32 iy = static_cast<i32>(y0);
+
+            F32x4 t00 = LoadTexel(job, ix, iy);
+            F32x4 t10 = LoadTexel(job, ix + 1, iy);
+            F32x4 t01 = LoadTexel(job, ix, iy + 1);
+            F32x4 t11 = LoadTexel(job, ix + 1, iy + 1);
+            F32x4 top = MulAdd(t10 - t00, tx, t00);
+            F32x4 bottom = MulAdd(t11 - t01, tx, t01);
+            return MulAdd(bottom - top, ty, top);
+        }
+        case Eq2CubeFilter::Bicubic:
+        {
+            x -= 0.5f;
+            y -= 0.5f;
+            f32 x0 = Floor(x);
+            f32 y0 = Floor(y);
+            f32 wx[4];
+            f32 wy[4];
+            CubicWeights(x - x0, wx);
+            CubicWeights(y - y0, wy);
+            i32 ix = static_cast<i32>(x0) - 1;
+            i32 iy = static_cast<i32>(y0) - 1;
+
+            F32x4 result = SplatF32x4(0.0f);
+            for (i32 j = 0; j < 4; j++)
+            {
+                F32x4 row = SplatF32x4(0.0f);
+                for (i32 i = 0; i < 4; i++)
+                {
+                    row = MulAdd(LoadTexel(job, ix + i, iy + j),
+                                 SplatF32x4(wx[i]), row);
+                }
+                result = MulAdd(row, SplatF32x4(wy[j]), result);
+            }
+            return result;
+        }
+        default:
+        {
+            FLY_ASSERT(false);
+            return SplatF32x4(0.0f);
+        }
+    }
+}
+
+static void Eq2CubeRow(u32 index, void* userData)
+{
+    using namespace Math;
+
+    const Eq2CubeJob& job = *static_cast<const Eq2CubeJob*>(userData);
+    u32 face = index / job.side;
+    u32 row = index % job.side;
+    u64 rowOffset = static_cast<u64>(index) * job.side * job.dstChannelCount;
+
+    // Byte rows are filtered into linear floats and encoded at the end
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+    f32* dstRow = reinterpret_cast<f32*>(job.dst) + rowOffset;
+    if (job.storageType == ImageStorageType::Byte)
+    {
+        dstRow = FLY_PUSH_ARENA(scratch, f32,
+                                static_cast<u64>(job.side) *
+                                    job.dstChannelCount);
+    }
+
+    // The gpu path renders with uv (0, 0) at the bottom left of the face
+    f32 invSide = 1.0f / job.side;
+    f32 y = 1.0f - 2.0f * (row + 0.5f) * invSide;
+    for (u32 col = 0; col < job.side; col++)
+    {
+        f32 x = 2.0f * (col + 0.5f) * invSide - 1.0f;
+        Vec3 dir = GetCubeDirection(face, x, y);
+
+        f32 u = (Atan2(dir.z, dir.x) + FLY_MATH_PI) / FLY_MATH_TWO_PI;
+        f32 v = (Atan2(dir.y, Sqrt(dir.x * dir.x + dir.z * dir.z)) +
+                 FLY_MATH_HALF_PI) /
+                FLY_MATH_PI;
+        F32x4 texel =
+            SampleEquirectangular(job, u * job.srcWidth, v * job.srcHeight);
+
+        f32 values[4];
+        StoreF32x4(values, texel);
+        // Matches eq2cube.frag, which writes an opaque alpha
+        if (job.dstChannelCount == 4)
+        {
+            values[3] = 1.0f;
+        }
+        f32* dst = dstRow + static_cast<u64>(col) * job.dstChannelCount;
+        for (u8 c = 0; c < job.dstChannelCount; c++)
+        {
+            dst[c] = values[c];
+        }
+    }
+
+    if (job.storageType == ImageStorageType::Byte)
+    {
+        LinearToSRGB(job.dst + rowOffset, dstRow, job.side,
+                     job.dstChannelCount);
+    }
+    ArenaPopToMarker(scratch, marker);
+}
+
+bool Eq2Cube(Image& image, Eq2CubeFilter filter)
 {
     FLY_ASSERT(image.data);
     FLY_ASSERT(image.width);
     FLY_ASSERT(image.height);
+    FLY_ASSERT(image.channelCount);
     FLY_ASSERT(image.layerCount);
     FLY_ASSERT(image.mipCount);
-    FLY_ASSERT(image.storageType == ImageStorageType::Byte);
 
-    if (codec != ImageStorageType::BC1 && codec != ImageStorageType::BC3 &&
-        codec != ImageStorageType::BC4 && codec != ImageStorageType::BC5)
+    if (image.storageType != ImageStorageType::Byte &&
+        image.storageType != ImageStorageType::Half &&
+        image.storageType != ImageStorageType::Float)
     {
         return false;
     }
 
-    if ((codec == ImageStorageType::BC1 || codec == ImageStorageType::BC3) &&
-        image.channelCount != 4)
+    u32 side = image.width / 4;
+    if (side == 0)
     {
         return false;
     }
-    else if (codec == ImageStorageType::BC4 && image.channelCount != 1)
+
+    // Half is filtered as Float and converted back once at the end
+    ImageStorageType storageType = image.storageType;
+    if (storageType == ImageStorageType::Half)
     {
-        return false;
+        ConvertImageStorage(ImageStorageType::Float, image);
+    }
+
+    Eq2CubeJob job;
+    job.src = image.data;
+    job.srcWidth = image.width;
+    job.srcHeight = image.height;
+    job.side = side;
+    job.srcChannelCount = image.channelCount;
+    job.dstChannelCount = (image.channelCount == 3) ? 4 : image.channelCount;
+    job.storageType = image.storageType;
+    job.filter = filter;
+
+    job.dst = static_cast<u8*>(Alloc(GetImageSize(
+        side, side, job.dstChannelCount, 6, 1, image.storageType)));
+    ParallelFor(6 * side, Eq2CubeRow, &job);
+
+    Free(image.data);
+    image.data = job.dst;
+    image.width = side;
+    image.height = side;
+    image.channelCount = job.dstChannelCount;
+    image.layerCount = 6;
+    image.mipCount = 1;
+
+    if (storageType == ImageStorageType::Half)
+    {
+        ConvertImageStorage(ImageStorageType::Half, image);
+    }
+
+    return true;
+}
+
+// BC6 encodes Half texels, every other codec Byte texels. Float sources
+// are converted or resampled to Half before they reach BC6.
+static bool IsCompressionSupported(ImageStorageType codec,
+                                   ImageStorageType storageType,
+                                   u8 channelCount)
+{
+    switch (codec)
+    {
+        case ImageStorageType::BC1:
+        case ImageStorageType::BC3:
+        case ImageStorageType::BC7:
+        {
+            return storageType == ImageStorageType::Byte && channelCount == 4;
+        }
+        case ImageStorageType::BC4:
+        {
+            return storageType == ImageStorageType::Byte && channelCount == 1;
+        }
+        case ImageStorageType::BC5:
+        {
+            return storageType == ImageStorageType::Byte && channelCount == 2;
+        }
+        case ImageStorageType::BC6:
+        {
+            return (storageType == ImageStorageType::Half ||
+                    storageType == ImageStorageType::Float) &&
+                   channelCount >= 3;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+bool CompressImage(ImageStorageType codec, Image& image, BCQuality quality)
+{
+    FLY_ASSERT(image.data);
+    FLY_ASSERT(image.width);
+    FLY_ASSERT(image.height);
+    FLY_ASSERT(image.layerCount);
+    FLY_ASSERT(image.mipCount);
+
+    if (codec == ImageStorageType::BC6 &&
+        image.storageType == ImageStorageType::Float)
+    {
+        ConvertImageStorage(ImageStorageType::Half, image);
     }
-    else if (codec == ImageStorageType::BC5 && image.channelCount != 2)
+
+    if (!IsCompressionSupported(codec, image.storageType, image.channelCount))
     {
         return false;
     }
@@ -530,7 +1108,8 @@ bool CompressImage(ImageStorageType codec, Image& image)
         for (u32 j = 0; j < image.layerCount; j++)
         {
             CompressImageLayer(data + dataOffset, image.data + imageOffset,
-                               mipWidth, mipHeight, codec);
+                               mipWidth, mipHeight, image.channelCount, codec,
+                               quality);
             imageOffset += GetImageSize(mipWidth, mipHeight, image.channelCount,
                                         1, 1, image.storageType);
             dataOffset += GetImageSize(mipWidth, mipHeight, image.channelCount,
@@ -541,7 +1120,7 @@ bool CompressImage(ImageStorageType codec, Image& image)
         mipHeight = MAX(mipHeight >> 1, 1);
     }
 
-    if (codec == ImageStorageType::BC1)
+    if (codec == ImageStorageType::BC1 || codec == ImageStorageType::BC6)
     {
         image.channelCount = 3;
     }
@@ -553,13 +1132,300 @@ bool CompressImage(ImageStorageType codec, Image& image)
     return true;
 }
 
-static u8 Reinhard(f32 value)
+// Rows [firstRow, firstRow + rowCount) of a width x height level of a layer
+struct LevelRows
+{
+    const u8* data = nullptr;
+    u32 width = 0;
+    u32 height = 0;
+    u32 firstRow = 0;
+    u32 rowCount = 0;
+};
+
+// Rows [first, last) of a srcHeight level that the filter reads to resample
+// rows [y, y + rowCount) of a height level
+static void GetFootprintRows(u32 y, u32 rowCount, u32 height, u32 srcHeight,
+                             u32& first, u32& last)
+{
+    f64 scale = static_cast<f64>(srcHeight) / height;
+    i64 firstRow = static_cast<i64>(floor(y * scale)) - FLY_STREAM_ROW_MARGIN;
+    i64 lastRow = static_cast<i64>(ceil((y + rowCount) * scale)) +
+                  FLY_STREAM_ROW_MARGIN;
+    first = static_cast<u32>(MAX(firstRow, 0));
+    last = static_cast<u32>(MIN(lastRow, static_cast<i64>(srcHeight)));
+}
+
+// Resamples rows [y, y + rowCount) of a width x height level of the layer
+// into band. The input subrect keeps the filter footprint of a full resize,
+// so src only needs the rows GetFootprintRows returns.
+static bool ResampleBand(const LevelRows& src, stbir_datatype inputType,
+                         u8 channelCount, u32 width, u32 height, u32 y,
+                         u32 rowCount, stbir_datatype outputType, u8* band)
+{
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+
+    f64 scale = static_cast<f64>(src.height) / height;
+    f64 top = (y * scale - src.firstRow) / src.rowCount;
+    f64 bottom = ((y + rowCount) * scale - src.firstRow) / src.rowCount;
+
+    STBIR_RESIZE resize;
+    stbir_resize_init(&resize, src.data, src.width, src.rowCount, 0, band,
+                      width, rowCount, 0,
+                      static_cast<stbir_pixel_layout>(channelCount),
+                      inputType);
+    stbir_set_datatypes(&resize, inputType, outputType);
+    stbir_set_edgemodes(&resize, STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP);
+    stbir_set_input_subrect(&resize, 0.0, MAX(top, 0.0), 1.0,
+                            MIN(bottom, 1.0));
+
+    u64 minSplitPixels = 64 * 1024;
+    u32 splitCount = static_cast<u32>(
+        MIN(static_cast<u64>(width) * rowCount / minSplitPixels + 1,
+            GetJobWorkerCount() + 1));
+    i32 builtSplitCount = stbir_build_samplers_with_splits(&resize, splitCount);
+    if (builtSplitCount <= 0)
+    {
+        ArenaPopToMarker(arena, marker);
+        return false;
+    }
+
+    MipResizeJob* jobs = FLY_PUSH_ARENA(arena, MipResizeJob, builtSplitCount);
+    for (i32 i = 0; i < builtSplitCount; i++)
+    {
+        jobs[i].resize = &resize;
+        jobs[i].split = i;
+        jobs[i].result = false;
+    }
+    ParallelFor(builtSplitCount, ResizeMipSplit, jobs);
+
+    bool res = true;
+    for (i32 i = 0; i < builtSplitCount; i++)
+    {
+        res = res && jobs[i].result;
+    }
+    stbir_free_samplers(&resize);
+
+    ArenaPopToMarker(arena, marker);
+    return res;
+}
+
+struct ImageStream
+{
+    const ImageStreamSettings* settings = nullptr;
+    const Image* image = nullptr;
+    u8* data = nullptr;
+    // Offset of every level in data
+    u64* levelOffsets = nullptr;
+    // Rows of levels 1 to mipCount - 2 that the next level still reads, in
+    // windowBuffers
+    LevelRows* windows = nullptr;
+    u8** windowBuffers = nullptr;
+    // Next row of every level to resample
+    u32* nextRows = nullptr;
+    u8* band = nullptr;
+    u32 bandRows = 0;
+    u32 width = 0;
+    u32 height = 0;
+    u32 mipCount = 0;
+    u8 channelCount = 0;
+    ImageStorageType bandStorageType = ImageStorageType::Invalid;
+    stbir_datatype srcType = STBIR_TYPE_UINT8;
+    stbir_datatype bandType = STBIR_TYPE_UINT8;
+    bool chainLevels = false;
+};
+
+static bool IsLevelKept(const ImageStream& stream, u32 level)
+{
+    return stream.chainLevels && level >= 1 && level + 1 < stream.mipCount;
+}
+
+static bool IsLevelChained(const ImageStream& stream, u32 level)
+{
+    return stream.chainLevels && level >= 2;
+}
+
+// A window holds at most the footprint of the next level's band and one
+// band of its own
+static u32 GetWindowRowCount(const ImageStream& stream, u32 level)
+{
+    u64 rowCount = 3ull * stream.bandRows + FLY_STREAM_WINDOW_MARGIN_ROWS;
+    return static_cast<u32>(
+        MIN(rowCount, static_cast<u64>(MAX(stream.height >> level, 1))));
+}
+
+// A chained level waits until the previous level has every row its next
+// band reads
+static bool CanStreamLevelBand(const ImageStream& stream, u32 level)
+{
+    u32 mipHeight = MAX(stream.height >> level, 1);
+    u32 y = stream.nextRows[level];
+    if (y >= mipHeight)
+    {
+        return false;
+    }
+    if (!IsLevelChained(stream, level))
+    {
+        return true;
+    }
+
+    const LevelRows& prev = stream.windows[level - 1];
+    u32 first = 0;
+    u32 last = 0;
+    GetFootprintRows(y, MIN(stream.bandRows, mipHeight - y), mipHeight,
+                     prev.height, first, last);
+    return prev.firstRow + prev.rowCount >= last;
+}
+
+// Resamples and compresses the next band of a level. Kept levels append the
+// band to their window after dropping the rows the next level is done with.
+static bool StreamLevelBand(ImageStream& stream, u32 layer, u32 level)
+{
+    const ImageStreamSettings& settings = *stream.settings;
+    const Image& image = *stream.image;
+    u32 mipWidth = MAX(stream.width >> level, 1);
+    u32 mipHeight = MAX(stream.height >> level, 1);
+    u32 y = stream.nextRows[level];
+    u32 rowCount = MIN(stream.bandRows, mipHeight - y);
+    u64 rowSize = GetImageLayerSize(mipWidth, 1, stream.channelCount,
+                                    stream.bandStorageType);
+
+    u8* rows = stream.band;
+    if (IsLevelKept(stream, level))
+    {
+        LevelRows& window = stream.windows[level];
+        u32 nextHeight = MAX(mipHeight >> 1, 1);
+        u32 nextY = stream.nextRows[level + 1];
+        u32 first = 0;
+        u32 last = 0;
+        GetFootprintRows(nextY, MIN(stream.bandRows, nextHeight - nextY),
+                         nextHeight, mipHeight, first, last);
+        u32 dropCount = MIN(first - MIN(first, window.firstRow),
+                            window.rowCount);
+        u8* buffer = stream.windowBuffers[level];
+        memmove(buffer, buffer + rowSize * dropCount,
+                rowSize * (window.rowCount - dropCount));
+        window.firstRow += dropCount;
+        window.rowCount -= dropCount;
+        FLY_ASSERT(window.firstRow + window.rowCount == y);
+        FLY_ASSERT(window.rowCount + rowCount <=
+                   GetWindowRowCount(stream, level));
+        rows = buffer + rowSize * window.rowCount;
+    }
+
+    const u8* src =
+        image.data + GetImageLayerSize(image.width, image.height,
+                                       stream.channelCount, image.storageType) *
+                         layer;
+    bool res = true;
+    if (level == 0 && image.width == stream.width &&
+        image.height == stream.height)
+    {
+        // Only Float to Half remains for an unscaled level 0
+        const f32* srcRows = reinterpret_cast<const f32*>(src) +
+                             static_cast<u64>(y) * mipWidth *
+                                 stream.channelCount;
+        ConvertF32ToF16(reinterpret_cast<f16*>(rows), srcRows,
+                        static_cast<u64>(rowCount) * mipWidth *
+                            stream.channelCount);
+    }
+    else if (IsLevelChained(stream, level))
+    {
+        res = ResampleBand(stream.windows[level - 1], stream.bandType,
+                           stream.channelCount, mipWidth, mipHeight, y,
+                           rowCount, stream.bandType, rows);
+    }
+    else
+    {
+        LevelRows srcRows;
+        srcRows.data = src;
+        srcRows.width = image.width;
+        srcRows.height = image.height;
+        srcRows.rowCount = image.height;
+        res = ResampleBand(srcRows, stream.srcType, stream.channelCount,
+                           mipWidth, mipHeight, y, rowCount, stream.bandType,
+                           rows);
+    }
+    if (!res)
+    {
+        return false;
+    }
+
+    u64 dstLayerSize = GetImageLayerSize(mipWidth, mipHeight,
+                                         stream.channelCount, settings.codec);
+    u64 blockRowSize =
+        GetImageLayerSize(mipWidth, 4, stream.channelCount, settings.codec);
+    CompressImageLayer(stream.data + stream.levelOffsets[level] +
+                           dstLayerSize * layer + blockRowSize * (y / 4),
+                       rows, mipWidth, rowCount, stream.channelCount,
+                       settings.codec, settings.quality);
+
+    if (IsLevelKept(stream, level))
+    {
+        stream.windows[level].rowCount += rowCount;
+    }
+    stream.nextRows[level] += rowCount;
+    return true;
+}
+
+static bool StreamLayer(ImageStream& stream, u32 layer)
 {
-    value = value / (1.0f + value);
-    return static_cast<u8>(value * 255.0f + 0.5f);
+    const Image& image = *stream.image;
+    for (u32 level = 0; level < stream.mipCount; level++)
+    {
+        stream.nextRows[level] = 0;
+        stream.windows[level].firstRow = 0;
+        stream.windows[level].rowCount = 0;
+    }
+
+    if (image.width == stream.width && image.height == stream.height &&
+        image.storageType == stream.bandStorageType)
+    {
+        const u8* src =
+            image.data + GetImageLayerSize(image.width, image.height,
+                                           stream.channelCount,
+                                           image.storageType) *
+                             layer;
+        u64 dstLayerSize =
+            GetImageLayerSize(stream.width, stream.height, stream.channelCount,
+                              stream.settings->codec);
+        CompressImageLayer(stream.data + dstLayerSize * layer, src,
+                           stream.width, stream.height, stream.channelCount,
+                           stream.settings->codec, stream.settings->quality);
+        stream.nextRows[0] = stream.height;
+    }
+
+    bool res = true;
+    for (u32 level = 0; level < stream.mipCount && res; level++)
+    {
+        if (IsLevelChained(stream, level))
+        {
+            continue;
+        }
+
+        while (res && CanStreamLevelBand(stream, level))
+        {
+            res = StreamLevelBand(stream, layer, level);
+
+            // Every band of level 1 lets the chained levels catch up, so
+            // each window only ever holds a few bands
+            for (u32 next = level + 1; next < stream.mipCount &&
+                                       IsLevelChained(stream, next) && res;
+                 next++)
+            {
+                while (res && CanStreamLevelBand(stream, next))
+                {
+                    res = StreamLevelBand(stream, layer, next);
+                }
+            }
+        }
+    }
+    FLY_ASSERT(!res || stream.nextRows[stream.mipCount - 1] ==
+                           MAX(stream.height >> (stream.mipCount - 1), 1));
+    return res;
 }
 
-void TonemapHalf(Image& image)
+bool StreamTransformImage(const ImageStreamSettings& settings, Image& image)
 {
     FLY_ASSERT(image.data);
     FLY_ASSERT(image.width);
@@ -567,53 +1433,221 @@ void TonemapHalf(Image& image)
     FLY_ASSERT(image.channelCount);
     FLY_ASSERT(image.layerCount);
     FLY_ASSERT(image.mipCount == 1);
-    FLY_ASSERT(image.storageType == ImageStorageType::Half);
 
-    u64 dataSize = GetImageSize(image.width, image.height, image.channelCount,
-                                image.layerCount, 1, ImageStorageType::Byte);
-    u8* data = static_cast<u8*>(Alloc(dataSize));
-    f16* imageData = reinterpret_cast<f16*>(image.data);
+    if (!IsCompressionSupported(settings.codec, image.storageType,
+                                image.channelCount))
+    {
+        return false;
+    }
+
+    ImageStream stream;
+    stream.settings = &settings;
+    stream.image = &image;
+    stream.width = settings.width ? settings.width : image.width;
+    stream.height = settings.height ? settings.height : image.height;
+    stream.mipCount =
+        settings.generateMips ? Log2(MAX(stream.width, stream.height)) + 1 : 1;
+    stream.channelCount = image.channelCount;
+    stream.srcType = MipDataType(image.storageType, settings.linearResize);
+    // Levels from 2 on are downsampled from the previous level. Level 1
+    // reads the source, so that a resized level 0 never exists in full.
+    stream.chainLevels = stream.mipCount > 2 && !settings.fromBaseLevel;
+
+    // Bands hold resampled texels in the layout the encoder expects
+    stream.bandStorageType = ImageStorageType::Byte;
+    stream.bandType =
+        MipDataType(ImageStorageType::Byte, settings.linearResize);
+    if (settings.codec == ImageStorageType::BC6)
+    {
+        stream.bandStorageType = ImageStorageType::Half;
+        stream.bandType = STBIR_TYPE_HALF_FLOAT;
+    }
 
-    for (u32 n = 0; n < image.layerCount; n++)
+    // Windows halve in width with every level, together with the band they
+    // take 4 bands and the window margin of level 0 rows
+    const u64 bandRowSize = GetImageLayerSize(
+        stream.width, 1, stream.channelCount, stream.bandStorageType);
+    u64 budgetRows = settings.memoryBudget / bandRowSize;
+    if (stream.chainLevels)
     {
-        for (u32 i = 0; i < image.height; i++)
+        budgetRows = budgetRows > FLY_STREAM_WINDOW_MARGIN_ROWS
+                         ? (budgetRows - FLY_STREAM_WINDOW_MARGIN_ROWS) / 4
+                         : 0;
+    }
+    stream.bandRows = static_cast<u32>(MIN(budgetRows,
+                                           static_cast<u64>(stream.height) +
+                                               3)) &
+                      ~3u;
+    stream.bandRows = MAX(stream.bandRows, 4);
+    stream.band = static_cast<u8*>(Alloc(bandRowSize * stream.bandRows));
+
+    u64 windowSize = 0;
+    for (u32 level = 0; level < stream.mipCount; level++)
+    {
+        if (IsLevelKept(stream, level))
         {
-            for (u32 j = 0; j < image.width; j++)
-            {
-                for (u32 k = 0; k < MIN(image.channelCount, 3); k++)
-                {
-                    f32 value = imageData[n * image.height * image.width *
-                                              image.channelCount +
-                                          image.width * image.channelCount * i +
-                                          image.channelCount * j + k];
-
-                    data[n * image.height * image.width * image.channelCount +
-                         image.width * image.channelCount * i +
-                         image.channelCount * j + k] = Reinhard(value);
-                }
+            windowSize += GetImageLayerSize(
+                MAX(stream.width >> level, 1), GetWindowRowCount(stream, level),
+                stream.channelCount, stream.bandStorageType);
+        }
+    }
+    u8* windowData = windowSize ? static_cast<u8*>(Alloc(windowSize)) : nullptr;
 
-                if (image.channelCount == 4)
-                {
-                    f32 value = imageData[n * image.height * image.width *
-                                              image.channelCount +
-                                          image.width * image.channelCount * i +
-                                          image.channelCount * j + 3];
-
-                    data[n * image.height * image.width * image.channelCount +
-                         image.width * image.channelCount * i +
-                         image.channelCount * j + 3] =
-                        static_cast<u8>(value * 255.0f + 0.5f);
-                }
-            }
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+    stream.levelOffsets = FLY_PUSH_ARENA(arena, u64, stream.mipCount);
+    stream.windows = FLY_PUSH_ARENA(arena, LevelRows, stream.mipCount);
+    stream.windowBuffers = FLY_PUSH_ARENA(arena, u8*, stream.mipCount);
+    stream.nextRows = FLY_PUSH_ARENA(arena, u32, stream.mipCount);
+
+    u64 dataSize = 0;
+    u64 windowOffset = 0;
+    for (u32 level = 0; level < stream.mipCount; level++)
+    {
+        u32 mipWidth = MAX(stream.width >> level, 1);
+        u32 mipHeight = MAX(stream.height >> level, 1);
+        stream.levelOffsets[level] = dataSize;
+        dataSize += GetImageSize(mipWidth, mipHeight, stream.channelCount,
+                                 image.layerCount, 1, settings.codec);
+
+        LevelRows& window = stream.windows[level];
+        window = {};
+        window.width = mipWidth;
+        window.height = mipHeight;
+        stream.windowBuffers[level] = nullptr;
+        if (IsLevelKept(stream, level))
+        {
+            stream.windowBuffers[level] = windowData + windowOffset;
+            window.data = windowData + windowOffset;
+            windowOffset += GetImageLayerSize(
+                mipWidth, GetWindowRowCount(stream, level),
+                stream.channelCount, stream.bandStorageType);
         }
     }
+    stream.data = static_cast<u8*>(Alloc(dataSize));
+
+    bool res = true;
+    for (u32 layer = 0; layer < image.layerCount && res; layer++)
+    {
+        res = StreamLayer(stream, layer);
+    }
+
+    ArenaPopToMarker(arena, marker);
+    Free(windowData);
+    Free(stream.band);
+    if (!res)
+    {
+        Free(stream.data);
+        return false;
+    }
 
     Free(image.data);
-    image.data = data;
-    image.storageType = ImageStorageType::Byte;
+    image.data = stream.data;
+    image.width = stream.width;
+    image.height = stream.height;
+    image.mipCount = stream.mipCount;
+    image.storageType = settings.codec;
+    if (settings.codec == ImageStorageType::BC1 ||
+        settings.codec == ImageStorageType::BC6)
+    {
+        image.channelCount = 3;
+    }
+
+    return true;
+}
+
+struct ColorJob
+{
+    u8* dst = nullptr;
+    const u8* src = nullptr;
+    u64 texelCount = 0;
+    u8 srcChannelCount = 0;
+    u8 dstChannelCount = 0;
+    ImageStorageType srcStorageType = ImageStorageType::Invalid;
+    ImageStorageType dstStorageType = ImageStorageType::Invalid;
+    TonemapOperator op = TonemapOperator::Reinhard;
+};
+
+static void GetColorJobRange(const ColorJob& job, u32 index, u64& first,
+                             u64& last)
+{
+    first = static_cast<u64>(index) * FLY_COLOR_JOB_SIZE;
+    last = MIN(first + FLY_COLOR_JOB_SIZE, job.texelCount);
+}
+
+static u32 GetColorJobCount(u64 texelCount)
+{
+    return static_cast<u32>((texelCount + FLY_COLOR_JOB_SIZE - 1) /
+                            FLY_COLOR_JOB_SIZE);
+}
+
+// Alpha lanes are left alone and clamped by the srgb encode
+static void TonemapChunk(f32* values, u32 paddedCount, u8 channelCount,
+                         TonemapOperator op)
+{
+    using namespace Math;
+
+    F32x4 zero = SplatF32x4(0.0f);
+    F32x4 one = SplatF32x4(1.0f);
+    F32x4 alphaMask = AlphaLaneMask(channelCount);
+    for (u32 i = 0; i < paddedCount; i += 4)
+    {
+        F32x4 value = LoadF32x4(values + i);
+        F32x4 x = Max(value, zero);
+        F32x4 mapped;
+        if (op == TonemapOperator::Reinhard)
+        {
+            mapped = x / (one + x);
+        }
+        else
+        {
+            F32x4 numerator =
+                x * MulAdd(x, SplatF32x4(2.51f), SplatF32x4(0.03f));
+            F32x4 denominator =
+                MulAdd(x, MulAdd(x, SplatF32x4(2.43f), SplatF32x4(0.59f)),
+                       SplatF32x4(0.14f));
+            mapped = numerator / denominator;
+        }
+        StoreF32x4(values + i, Select(alphaMask, value, mapped));
+    }
+}
+
+static void TonemapBand(u32 index, void* userData)
+{
+    const ColorJob& job = *static_cast<const ColorJob*>(userData);
+    u64 firstTexel = 0;
+    u64 lastTexel = 0;
+    GetColorJobRange(job, index, firstTexel, lastTexel);
+
+    // Jobs and chunks start on texel boundaries, the alpha lane stays put
+    f32 values[FLY_COLOR_CHUNK_SIZE];
+    u64 first = firstTexel * job.srcChannelCount;
+    u64 last = lastTexel * job.srcChannelCount;
+    for (u64 i = first; i < last; i += FLY_COLOR_CHUNK_SIZE)
+    {
+        u32 chunkSize = static_cast<u32>(MIN(last - i, FLY_COLOR_CHUNK_SIZE));
+        u32 paddedSize = (chunkSize + 3) & ~3u;
+        if (job.srcStorageType == ImageStorageType::Half)
+        {
+            ConvertF16ToF32(values, reinterpret_cast<const f16*>(job.src) + i,
+                            chunkSize);
+        }
+        else
+        {
+            memcpy(values, reinterpret_cast<const f32*>(job.src) + i,
+                   sizeof(f32) * chunkSize);
+        }
+        for (u32 j = chunkSize; j < paddedSize; j++)
+        {
+            values[j] = 0.0f;
+        }
+
+        TonemapChunk(values, paddedSize, job.srcChannelCount, job.op);
+        EncodeSRGBChunk(job.dst + i, values, chunkSize, job.srcChannelCount);
+    }
 }
 
-void TonemapFloat(Image& image)
+static void Tonemap(TonemapOperator op, Image& image)
 {
     FLY_ASSERT(image.data);
     FLY_ASSERT(image.width);
@@ -621,50 +1655,196 @@ void TonemapFloat(Image& image)
     FLY_ASSERT(image.channelCount);
     FLY_ASSERT(image.layerCount);
     FLY_ASSERT(image.mipCount == 1);
+
+    ColorJob job;
+    job.src = image.data;
+    job.texelCount = static_cast<u64>(image.width) * image.height *
+                     image.layerCount;
+    job.srcChannelCount = image.channelCount;
+    job.srcStorageType = image.storageType;
+    job.op = op;
+    job.dst = static_cast<u8*>(Alloc(job.texelCount * image.channelCount));
+    ParallelFor(GetColorJobCount(job.texelCount), TonemapBand, &job);
+
+    Free(image.data);
+    image.data = job.dst;
+    image.storageType = ImageStorageType::Byte;
+}
+
+void TonemapHalf(Image& image, TonemapOperator op)
+{
+    FLY_ASSERT(image.storageType == ImageStorageType::Half);
+    Tonemap(op, image);
+}
+
+void TonemapFloat(Image& image, TonemapOperator op)
+{
     FLY_ASSERT(image.storageType == ImageStorageType::Float);
+    Tonemap(op, image);
+}
 
-    u64 dataSize = GetImageSize(image.width, image.height, image.channelCount,
-                                image.layerCount, 1, ImageStorageType::Byte);
-    u8* data = static_cast<u8*>(Alloc(dataSize));
-    f32* imageData = reinterpret_cast<f32*>(image.data);
+static void ConvertStorageBand(u32 index, void* userData)
+{
+    const ColorJob& job = *static_cast<const ColorJob*>(userData);
+    u64 first = 0;
+    u64 last = 0;
+    GetColorJobRange(job, index, first, last);
+
+    if (job.dstStorageType == ImageStorageType::Half)
+    {
+        ConvertF32ToF16(reinterpret_cast<f16*>(job.dst) + first,
+                        reinterpret_cast<const f32*>(job.src) + first,
+                        last - first);
+    }
+    else
+    {
+        ConvertF16ToF32(reinterpret_cast<f32*>(job.dst) + first,
+                        reinterpret_cast<const f16*>(job.src) + first,
+                        last - first);
+    }
+}
+
+void ConvertImageStorage(ImageStorageType storageType, Image& image)
+{
+    FLY_ASSERT(image.data);
+    FLY_ASSERT(storageType == ImageStorageType::Half ||
+               storageType == ImageStorageType::Float);
+    FLY_ASSERT(image.storageType == ImageStorageType::Half ||
+               image.storageType == ImageStorageType::Float);
 
-    for (u32 n = 0; n < image.layerCount; n++)
+    if (image.storageType == storageType)
     {
-        for (u32 i = 0; i < image.height; i++)
+        return;
+    }
+
+    // Channels are converted independently, each value counts as a texel
+    ColorJob job;
+    job.src = image.data;
+    job.texelCount = GetImageSize(image.width, image.height,
+                                  image.channelCount, image.layerCount,
+                                  image.mipCount, ImageStorageType::Byte);
+    job.dstStorageType = storageType;
+    job.dst = static_cast<u8*>(Alloc(GetImageSize(
+        image.width, image.height, image.channelCount, image.layerCount,
+        image.mipCount, storageType)));
+    ParallelFor(GetColorJobCount(job.texelCount), ConvertStorageBand, &job);
+
+    Free(image.data);
+    image.data = job.dst;
+    image.storageType = storageType;
+}
+
+// The common rgb <-> rgba cases get loops the compiler can vectorize
+template <typename T>
+static void ConvertChannels(T* dst, const T* src, u64 first, u64 last,
+                            u8 srcChannelCount, u8 dstChannelCount, T one)
+{
+    if (srcChannelCount == 3 && dstChannelCount == 4)
+    {
+        for (u64 i = first; i < last; i++)
         {
-            for (u32 j = 0; j < image.width; j++)
-            {
-                for (u32 k = 0; k < MIN(image.channelCount, 3); k++)
-                {
-                    f32 value = imageData[n * image.height * image.width *
-                                              image.channelCount +
-                                          image.width * image.channelCount * i +
-                                          image.channelCount * j + k];
-
-                    data[n * image.height * image.width * image.channelCount +
-                         image.width * image.channelCount * i +
-                         image.channelCount * j + k] = Reinhard(value);
-                }
+            dst[4 * i] = src[3 * i];
+            dst[4 * i + 1] = src[3 * i + 1];
+            dst[4 * i + 2] = src[3 * i + 2];
+            dst[4 * i + 3] = one;
+        }
+        return;
+    }
 
-                if (image.channelCount == 4)
-                {
-                    f32 value = imageData[n * image.height * image.width *
-                                              image.channelCount +
-                                          image.width * image.channelCount * i +
-                                          image.channelCount * j + 3];
-
-                    data[n * image.height * image.width * image.channelCount +
-                         image.width * image.channelCount * i +
-                         image.channelCount * j + 3] =
-                        static_cast<u8>(value * 255.0f + 0.5f);
-                }
-            }
+    if (srcChannelCount == 4 && dstChannelCount == 3)
+    {
+        for (u64 i = first; i < last; i++)
+        {
+            dst[3 * i] = src[4 * i];
+            dst[3 * i + 1] = src[4 * i + 1];
+            dst[3 * i + 2] = src[4 * i + 2];
+        }
+        return;
+    }
+
+    u8 copyCount = MIN(srcChannelCount, dstChannelCount);
+    for (u64 i = first; i < last; i++)
+    {
+        for (u8 c = 0; c < copyCount; c++)
+        {
+            dst[dstChannelCount * i + c] = src[srcChannelCount * i + c];
+        }
+        for (u8 c = copyCount; c < dstChannelCount; c++)
+        {
+            dst[dstChannelCount * i + c] = (c == 3) ? one : T(0.0f);
+        }
+    }
+}
+
+static void ConvertChannelsBand(u32 index, void* userData)
+{
+    const ColorJob& job = *static_cast<const ColorJob*>(userData);
+    u64 first = 0;
+    u64 last = 0;
+    GetColorJobRange(job, index, first, last);
+
+    switch (job.srcStorageType)
+    {
+        case ImageStorageType::Byte:
+        {
+            ConvertChannels(job.dst, job.src, first, last,
+                            job.srcChannelCount, job.dstChannelCount,
+                            static_cast<u8>(255));
+            break;
+        }
+        case ImageStorageType::Half:
+        {
+            ConvertChannels(reinterpret_cast<f16*>(job.dst),
+                            reinterpret_cast<const f16*>(job.src), first, last,
+                            job.srcChannelCount, job.dstChannelCount,
+                            f16(1.0f));
+            break;
+        }
+        case ImageStorageType::Float:
+        {
+            ConvertChannels(reinterpret_cast<f32*>(job.dst),
+                            reinterpret_cast<const f32*>(job.src), first, last,
+                            job.srcChannelCount, job.dstChannelCount, 1.0f);
+            break;
+        }
+        default:
+        {
+            FLY_ASSERT(false);
+            break;
         }
     }
+}
+
+void ConvertImageChannels(u8 channelCount, Image& image)
+{
+    FLY_ASSERT(image.data);
+    FLY_ASSERT(channelCount > 0 && channelCount <= 4);
+    FLY_ASSERT(image.storageType == ImageStorageType::Byte ||
+               image.storageType == ImageStorageType::Half ||
+               image.storageType == ImageStorageType::Float);
+
+    if (image.channelCount == channelCount)
+    {
+        return;
+    }
+
+    ColorJob job;
+    job.src = image.data;
+    job.texelCount = GetImageSize(image.width, image.height, 1,
+                                  image.layerCount, image.mipCount,
+                                  ImageStorageType::Byte);
+    job.srcChannelCount = image.channelCount;
+    job.dstChannelCount = channelCount;
+    job.srcStorageType = image.storageType;
+    job.dst = static_cast<u8*>(
+        Alloc(GetImageSize(image.width, image.height, channelCount,
+                           image.layerCount, image.mipCount,
+                           image.storageType)));
+    ParallelFor(GetColorJobCount(job.texelCount), ConvertChannelsBand, &job);
 
     Free(image.data);
-    image.data = data;
-    image.storageType = ImageStorageType::Byte;
+    image.data = job.dst;
+    image.channelCount = channelCount;
 }
 
 } // namespace Fly
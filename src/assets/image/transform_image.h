@@ -1,6 +1,7 @@
 #ifndef FLY_TRANSFORM_IMAGE_H
 #define FLY_TRANSFORM_IMAGE_H
 
+#include "bc_compression.h"
 #include "image.h"
 
 namespace Fly
@@ -17,12 +18,77 @@ struct GraphicsPipeline;
 void CopyImage(const Image& srcImage, Image& dstImage);
 bool ResizeImageSRGB(u32 width, u32 height, Image& image);
 bool ResizeImageLinear(u32 width, u32 height, Image& image);
-bool GenerateMips(Image& image, bool linearResize = false);
+// Writes the whole mip chain after level 0 of every layer. Each level is
+// downsampled from the previous one, fromBaseLevel resamples every level
+// from level 0 instead, which is slower but does not accumulate blur.
+bool GenerateMips(Image& image, bool linearResize = false,
+                  bool fromBaseLevel = false);
 bool Eq2Cube(RHI::Device& device, RHI::GraphicsPipeline& eq2cubePipeline,
              Image& image);
-bool CompressImage(ImageStorageType codec, Image& image);
-void TonemapHalf(Image& image);
-void TonemapFloat(Image& image);
+
+enum class Eq2CubeFilter : u8
+{
+    Nearest,
+    Bilinear,
+    Bicubic,
+};
+
+// CPU version of Eq2Cube for Byte, Half and Float images, with the same face
+// size, order and orientation as the gpu path. Nearest samples like the gpu
+// sampler, the other filters wrap around in longitude and across the poles.
+bool Eq2Cube(Image& image, Eq2CubeFilter filter = Eq2CubeFilter::Bilinear);
+// BC1, BC3, BC7 take 4 channel Byte images, BC4 1 and BC5 2 channels. BC6
+// takes Half or Float images with at least 3 channels. Quality only affects
+// BC6 and BC7.
+bool CompressImage(ImageStorageType codec, Image& image,
+                   BCQuality quality = BCQuality::Normal);
+
+struct ImageStreamSettings
+{
+    // Zero keeps the source size
+    u32 width = 0;
+    u32 height = 0;
+    bool generateMips = false;
+    // Resamples every level from the source instead of the previous level
+    bool fromBaseLevel = false;
+    bool linearResize = false;
+    ImageStorageType codec = ImageStorageType::Invalid;
+    BCQuality quality = BCQuality::Normal;
+    // Size of the uncompressed texels between resampling and compression,
+    // the band and the rows of the previous level that chained levels read.
+    // Bands are at least one block row.
+    u64 memoryBudget = 64 * 1024 * 1024;
+};
+
+// Resizes, generates mips and compresses a single level image in bands of
+// rows. Levels 0 and 1 are resampled from the source band by band, later
+// levels from a rolling window of previous level rows like GenerateMips.
+// Peak memory is the source, the compressed result and memoryBudget instead
+// of several full copies.
+bool StreamTransformImage(const ImageStreamSettings& settings, Image& image);
+
+enum class TonemapOperator : u8
+{
+    Reinhard,
+    // Narkowicz fit of the ACES filmic curve
+    Aces,
+};
+
+// Tonemaps color channels to srgb encoded Byte texels, the alpha of 4
+// channel images is only clamped
+void TonemapHalf(Image& image,
+                 TonemapOperator op = TonemapOperator::Reinhard);
+void TonemapFloat(Image& image,
+                  TonemapOperator op = TonemapOperator::Reinhard);
+// Converts between Half and Float storage, all mips and layers
+void ConvertImageStorage(ImageStorageType storageType, Image& image);
+// Adds or strips channels of Byte, Half and Float images, all mips and
+// layers. Added color channels are zero and an added alpha is opaque.
+void ConvertImageChannels(u8 channelCount, Image& image);
+// 8 bit srgb texels to linear floats with a table and back with a
+// polynomial pow, the alpha of 4 channel texels stays linear
+void SRGBToLinear(f32* dst, const u8* src, u64 texelCount, u8 channelCount);
+void LinearToSRGB(u8* dst, const f32* src, u64 texelCount, u8 channelCount);
 
 } // namespace Fly
 
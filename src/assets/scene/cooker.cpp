@@ -2,8 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "core/filesystem.h"
+#include "core/job_system.h"
 #include "core/thread_context.h"
 
+#include "assets/cook_cache.h"
 #include "assets/scene/geometry.h"
 #include "assets/scene/scene_data.h"
 
@@ -14,6 +17,7 @@ struct Input
     String8* inputs = nullptr;
     String8* outputs = nullptr;
     SceneExportOptions options{};
+    String8 cacheDirectory;
     u32 inputCount = 0;
     u32 outputCount = 0;
 };
@@ -139,6 +143,23 @@ static void ParseCommandLine(Arena& arena, u32 argc, String8* argv, Input& data)
         {
             data.options.exportMaterials = false;
         }
+        else if (argv[i] == FLY_STRING8_LITERAL("-nc"))
+        {
+            data.options.compressGeometry = false;
+        }
+        else if (argv[i] == FLY_STRING8_LITERAL("-orm7"))
+        {
+            data.options.ormBC7 = true;
+        }
+        else if (argv[i] == FLY_STRING8_LITERAL("-cache"))
+        {
+            if (i + 1 >= argc || IsOption(argv[i + 1]))
+            {
+                fprintf(stderr, "Parse error: no cache directory specified\n");
+                exit(-7);
+            }
+            data.cacheDirectory = argv[++i];
+        }
     }
 }
 
@@ -191,24 +212,48 @@ static void ProcessInput(Input& input)
 {
     for (u32 i = 0; i < input.inputCount; i++)
     {
+        String8 outputPath = input.outputs[i];
+
+        u64 key = FLY_COOK_CACHE_VERSION;
+        bool useCache =
+            input.cacheDirectory &&
+            HashSceneInputs(input.inputs[i], input.options, key);
+        if (useCache &&
+            FetchFromCookCache(input.cacheDirectory, key, outputPath))
+        {
+            continue;
+        }
+        // Outputs of earlier runs may be hard links into the cook cache
+        RemoveFile(outputPath);
+
         SceneData sceneData{};
-        if (!CookSceneData(input.inputs[i], input.options, sceneData))
+        if (!CookSceneData(input.inputs[i], input.options, sceneData,
+                           input.cacheDirectory))
         {
             exit(-5);
         }
 
-        if (!ExportSceneData(input.outputs[i], sceneData))
+        if (!ExportSceneData(outputPath, sceneData,
+                             input.options.compressGeometry))
         {
             exit(-6);
         }
 
         DestroySceneData(sceneData);
+
+        if (useCache &&
+            !StoreInCookCache(input.cacheDirectory, key, outputPath))
+        {
+            fprintf(stderr, "Cache warning: failed to store %.*s\n",
+                    static_cast<int>(outputPath.Size()), outputPath.Data());
+        }
     }
 }
 
 int main(int argc, char* argv[])
 {
     InitArenas();
+    InitJobSystem();
 
     Arena& arena = GetScratchArena();
     String8* argvStrings = FLY_PUSH_ARENA(arena, String8, argc);
@@ -223,6 +268,7 @@ int main(int argc, char* argv[])
     FillOutputs(arena, input);
     ProcessInput(input);
 
+    ShutdownJobSystem();
     ReleaseThreadContext();
     return 0;
 }
@@ -1,14 +1,15 @@
+#include <atomic>
 #include <stdio.h>
+#include <string.h>
 
 #include "core/filesystem.h"
+#include "core/half.h"
+#include "core/hash.h"
+#include "core/hash_trie.h"
+#include "core/job_system.h"
 #include "core/memory.h"
 #include "core/thread_context.h"
 
-#define FAST_OBJ_REALLOC Fly::Realloc
-#define FAST_OBJ_FREE Fly::Free
-#define FAST_OBJ_IMPLEMENTATION
-#include <fast_obj.h>
-
 #define CGLTF_MALLOC(size) (Fly::Alloc(size))
 #define CGLTF_FREE(size) (Fly::Free(size))
 #define CGLTF_IMPLEMENTATION
@@ -195,6 +196,7 @@ static void CalculateTangents(Geometry& geometry)
 {
     Math::Vec3* tangents = static_cast<Math::Vec3*>(
         Alloc(sizeof(Math::Vec3) * geometry.vertexCount * 2));
+    MemZero(tangents, sizeof(Math::Vec3) * geometry.vertexCount * 2);
     Math::Vec3* bitangents = tangents + geometry.vertexCount;
 
     for (u32 i = 0; i < geometry.indexCount / 3; i++)
@@ -240,88 +242,662 @@ static void CalculateTangents(Geometry& geometry)
     Free(tangents);
 }
 
-static void ExtractGeometryDataFromObj(const fastObjMesh& mesh,
-                                       const fastObjGroup& object,
-                                       Geometry& geometry, u8 vertexMask)
+// OBJ files are mapped and split into chunks at line boundaries. A counting
+// pass sizes every array, so the parsing pass writes attributes straight to
+// their place and deduplicates the position, texcoord and normal tuples of
+// the faces in each chunk while it reads them. Chunk tuples are merged in file
+// order, which keeps the vertex order independent of how tasks are scheduled.
+
+// Attribute indices are zero based, FLY_MAX_U32 when the face leaves the
+// attribute out
+struct ObjTuple
 {
-    geometry = {};
-    geometry.lodCount = 1;
-    geometry.vertexMask = vertexMask;
+    u32 object;
+    u32 position;
+    u32 texcoord;
+    u32 normal;
+};
 
-    DynamicArray<Subgeometry> subgeometries;
-    DynamicArray<Vertex> vertices;
-    DynamicArray<u32> indices;
+// Open addressing table of indices into an array of unique tuples
+struct ObjTupleTable
+{
+    u32* slots = nullptr;
+    u64 mask = 0;
+};
+
+static void CreateObjTupleTable(u64 maxTupleCount, ObjTupleTable& table)
+{
+    u64 capacity = 16;
+    while (capacity < 2 * maxTupleCount)
+    {
+        capacity *= 2;
+    }
+    table.slots = static_cast<u32*>(Alloc(sizeof(u32) * capacity));
+    memset(table.slots, 0xff, sizeof(u32) * capacity);
+    table.mask = capacity - 1;
+}
+
+static void DestroyObjTupleTable(ObjTupleTable& table)
+{
+    Free(table.slots);
+    table = {};
+}
+
+// Returns the index of tuple in tuples, appending it when it is new
+static u32 FindOrAddObjTuple(ObjTupleTable& table, ObjTuple* tuples,
+                             u32& tupleCount, const ObjTuple& tuple)
+{
+    u64 slot = Hash64(&tuple, sizeof(ObjTuple)) & table.mask;
+    while (table.slots[slot] != FLY_MAX_U32)
+    {
+        const ObjTuple& other = tuples[table.slots[slot]];
+        if (other.object == tuple.object && other.position == tuple.position &&
+            other.texcoord == tuple.texcoord && other.normal == tuple.normal)
+        {
+            return table.slots[slot];
+        }
+        slot = (slot + 1) & table.mask;
+    }
+
+    table.slots[slot] = tupleCount;
+    tuples[tupleCount] = tuple;
+    return tupleCount++;
+}
+
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    // Elements of the chunk, and after the counting pass the number of
+    // elements in the chunks before it
+    u64 positionCount = 0;
+    u64 texcoordCount = 0;
+    u64 normalCount = 0;
+    u64 triangleCount = 0;
+    u64 firstPosition = 0;
+    u64 firstTexcoord = 0;
+    u64 firstNormal = 0;
+    u64 firstTriangle = 0;
+    // o and usemtl lines
+    u32 objectCount = 0;
+    u32 materialCount = 0;
+    u32 firstObject = 0;
+    u32 firstMaterial = 0;
+    // Unique tuples of the chunk in the order faces first use them, and the
+    // object vertex each of them merges into
+    ObjTuple* tuples = nullptr;
+    u32* tupleVertices = nullptr;
+    u32 tupleCount = 0;
+};
+
+// Faces from triangle on use the material
+struct ObjMaterialEvent
+{
+    u64 triangle;
+    String8 name;
+    u32 material;
+};
+
+struct ObjObject
+{
+    u64 firstTriangle = 0;
+    u64 triangleCount = 0;
+    u64 firstVertex = 0;
+    u32 vertexCount = 0;
+    // First material event after the first triangle, and the material the
+    // object starts with
+    u32 firstMaterialEvent = 0;
+    u32 material = 0;
+    u32 geometryIndex = FLY_MAX_U32;
+};
+
+struct ImportObjJob
+{
+    ObjChunk* chunks = nullptr;
+    ObjObject* objects = nullptr;
+    ObjMaterialEvent* materialEvents = nullptr;
+    f32* positions = nullptr;
+    f32* texcoords = nullptr;
+    f32* normals = nullptr;
+    // Chunk tuple of every triangle corner, then the object vertex
+    u32* corners = nullptr;
+    ObjTuple* vertexTuples = nullptr;
+    Geometry* geometries = nullptr;
+    u64 positionCount = 0;
+    u64 texcoordCount = 0;
+    u64 normalCount = 0;
+    u32 materialEventCount = 0;
+    u8 vertexMask = FLY_VERTEX_NONE_BIT;
+    std::atomic<bool> res{true};
+};
+
+static bool IsObjSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static bool IsObjDigit(char c) { return c >= '0' && c <= '9'; }
+
+static const char* SkipObjSpaces(const char* c, const char* end)
+{
+    while (c < end && IsObjSpace(*c))
+    {
+        c++;
+    }
+    return c;
+}
+
+static const char* FindObjLineEnd(const char* c, const char* end)
+{
+    const char* lineEnd =
+        static_cast<const char*>(memchr(c, '\n', static_cast<u64>(end - c)));
+    return lineEnd ? lineEnd : end;
+}
+
+// Continued lines could span chunks and are not supported
+static bool IsObjLineContinued(const char* c, const char* lineEnd)
+{
+    while (lineEnd > c && IsObjSpace(lineEnd[-1]))
+    {
+        lineEnd--;
+    }
+    return lineEnd > c && *c != '#' && lineEnd[-1] == '\\';
+}
+
+// Keyword followed by a space, at the start of a line
+static bool IsObjKeyword(const char* c, const char* end, const char* keyword,
+                         u32 size)
+{
+    return static_cast<u64>(end - c) > size && memcmp(c, keyword, size) == 0 &&
+           IsObjSpace(c[size]);
+}
+
+// Decimal floats with an optional exponent, up to 19 significant digits are
+// kept which is plenty for f32
+static bool ParseObjFloat(const char*& c, const char* end, f32& value)
+{
+    static const f64 powersOf10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+'))
+    {
+        negative = *c == '-';
+        c++;
+    }
+
+    u64 mantissa = 0;
+    i32 exponent = 0;
+    u32 digitCount = 0;
+    bool hasDigits = false;
+    while (c < end && IsObjDigit(*c))
+    {
+        if (digitCount < 19)
+        {
+            mantissa = mantissa * 10 + static_cast<u64>(*c - '0');
+            digitCount += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+        }
+        hasDigits = true;
+        c++;
+    }
+    if (c < end && *c == '.')
+    {
+        c++;
+        while (c < end && IsObjDigit(*c))
+        {
+            if (digitCount < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<u64>(*c - '0');
+                digitCount += mantissa != 0;
+                exponent--;
+            }
+            hasDigits = true;
+            c++;
+        }
+    }
+    if (!hasDigits)
+    {
+        return false;
+    }
+
+    if (c < end && (*c == 'e' || *c == 'E'))
+    {
+        c++;
+        bool negativeExponent = false;
+        if (c < end && (*c == '-' || *c == '+'))
+        {
+            negativeExponent = *c == '-';
+            c++;
+        }
+        if (c == end || !IsObjDigit(*c))
+        {
+            return false;
+        }
+        i32 e = 0;
+        while (c < end && IsObjDigit(*c))
+        {
+            e = Math::Min(e * 10 + (*c - '0'), 100000);
+            c++;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    f64 result = static_cast<f64>(mantissa);
+    while (exponent > 22)
+    {
+        result *= powersOf10[22];
+        exponent -= 22;
+    }
+    while (exponent < -22)
+    {
+        result /= powersOf10[22];
+        exponent += 22;
+    }
+    result = exponent >= 0 ? result * powersOf10[exponent]
+                           : result / powersOf10[-exponent];
+    value = static_cast<f32>(negative ? -result : result);
+    return true;
+}
+
+// One based and negative indices relative to count, the number of elements
+// defined so far
+static bool ParseObjIndex(const char*& c, const char* end, u64 count,
+                          u64 totalCount, u32& index)
+{
+    bool negative = false;
+    if (c < end && *c == '-')
+    {
+        negative = true;
+        c++;
+    }
+    if (c == end || !IsObjDigit(*c))
+    {
+        return false;
+    }
+
+    u64 value = 0;
+    while (c < end && IsObjDigit(*c))
+    {
+        value = value * 10 + static_cast<u64>(*c - '0');
+        if (value > FLY_MAX_U32)
+        {
+            return false;
+        }
+        c++;
+    }
 
-    i32 currMaterialIndex = -1;
-    u32 subgeometryIndexCount = 0;
-    for (u32 i = 0; i < object.face_count; i++)
+    if (value == 0 || (negative && value > count) ||
+        (!negative && value > totalCount))
     {
-        i32 materialIndex =
-            static_cast<i32>(mesh.face_materials[object.face_offset + i]);
-        if (materialIndex != currMaterialIndex)
+        return false;
+    }
+    index = static_cast<u32>(negative ? count - value : value - 1);
+    return true;
+}
+
+static bool ParseObjFloats(const char* c, const char* end, u32 count,
+                           f32* values)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        c = SkipObjSpaces(c, end);
+        if (!ParseObjFloat(c, end, values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static u32 CountObjFaceVertices(const char* c, const char* end)
+{
+    u32 count = 0;
+    while (true)
+    {
+        c = SkipObjSpaces(c, end);
+        if (c == end || *c == '#')
+        {
+            return count;
+        }
+        count++;
+        while (c < end && !IsObjSpace(*c))
+        {
+            c++;
+        }
+    }
+}
+
+static void CountObjChunkTask(u32 index, void* userData)
+{
+    ImportObjJob& job = *static_cast<ImportObjJob*>(userData);
+    ObjChunk& chunk = job.chunks[index];
+
+    const char* c = chunk.begin;
+    while (c < chunk.end)
+    {
+        const char* lineEnd = FindObjLineEnd(c, chunk.end);
+        c = SkipObjSpaces(c, lineEnd);
+
+        if (IsObjKeyword(c, lineEnd, "v", 1))
         {
-            if (i != 0 && subgeometryIndexCount > 0)
+            chunk.positionCount++;
+        }
+        else if (IsObjKeyword(c, lineEnd, "vt", 2))
+        {
+            chunk.texcoordCount++;
+        }
+        else if (IsObjKeyword(c, lineEnd, "vn", 2))
+        {
+            chunk.normalCount++;
+        }
+        else if (IsObjKeyword(c, lineEnd, "f", 1))
+        {
+            // Polygons are triangulated as fans
+            u32 vertexCount = CountObjFaceVertices(c + 1, lineEnd);
+            if (vertexCount >= 3)
             {
-                Subgeometry& last = *(subgeometries.Last());
-                last.lods[0].indexCount = subgeometryIndexCount;
-                subgeometryIndexCount = 0;
+                chunk.triangleCount += vertexCount - 2;
             }
+        }
+        else if (IsObjKeyword(c, lineEnd, "o", 1))
+        {
+            chunk.objectCount++;
+        }
+        else if (IsObjKeyword(c, lineEnd, "usemtl", 6))
+        {
+            chunk.materialCount++;
+        }
+
+        c = lineEnd + 1;
+    }
+}
+
+struct ObjChunkParser
+{
+    ObjTupleTable table;
+    u64 positionCount = 0;
+    u64 texcoordCount = 0;
+    u64 normalCount = 0;
+    u64 triangleCount = 0;
+    u32 object = 0;
+    u32 materialCount = 0;
+};
 
-            Subgeometry subgeometry{};
-            subgeometry.lods[0].firstIndex = 3 * i;
-            subgeometries.Add(subgeometry);
-            currMaterialIndex = materialIndex;
+static bool ParseObjFace(ImportObjJob& job, ObjChunk& chunk,
+                         ObjChunkParser& parser, const char* c,
+                         const char* end)
+{
+    u32 firstCorner = 0;
+    u32 prevCorner = 0;
+    u32 vertexCount = 0;
+    while (true)
+    {
+        c = SkipObjSpaces(c, end);
+        if (c == end || *c == '#')
+        {
+            break;
         }
 
-        for (u32 j = 0; j < 3; j++)
+        ObjTuple tuple = {parser.object, FLY_MAX_U32, FLY_MAX_U32,
+                          FLY_MAX_U32};
+        if (!ParseObjIndex(c, end, chunk.firstPosition + parser.positionCount,
+                           job.positionCount, tuple.position))
+        {
+            return false;
+        }
+        // Empty slots leave the attribute out, as in 1//3, 1/ or 1//
+        if (c < end && *c == '/')
         {
-            fastObjIndex index = mesh.indices[object.index_offset + 3 * i + j];
-            Vertex vertex{};
-            vertex.position =
-                *reinterpret_cast<Math::Vec3*>(&(mesh.positions[3 * index.p]));
-            if (geometry.vertexMask & FLY_VERTEX_NORMAL_BIT)
+            c++;
+            if (c < end && *c != '/' && !IsObjSpace(*c) &&
+                !ParseObjIndex(c, end,
+                               chunk.firstTexcoord + parser.texcoordCount,
+                               job.texcoordCount, tuple.texcoord))
             {
-                vertex.normal = *reinterpret_cast<Math::Vec3*>(
-                    &(mesh.normals[3 * index.n]));
+                return false;
             }
-            if (geometry.vertexMask & FLY_VERTEX_TEXCOORD_BIT)
+            if (c < end && *c == '/')
             {
-                vertex.u = mesh.texcoords[2 * index.t];
-                vertex.v = mesh.texcoords[2 * index.t + 1];
+                c++;
+                if (c < end && !IsObjSpace(*c) &&
+                    !ParseObjIndex(c, end,
+                                   chunk.firstNormal + parser.normalCount,
+                                   job.normalCount, tuple.normal))
+                {
+                    return false;
+                }
             }
-            vertices.Add(vertex);
-            indices.Add(3 * i + j);
-            subgeometryIndexCount++;
         }
+        if (c < end && !IsObjSpace(*c))
+        {
+            return false;
+        }
+
+        u32 corner = FindOrAddObjTuple(parser.table, chunk.tuples,
+                                       chunk.tupleCount, tuple);
+        if (vertexCount == 0)
+        {
+            firstCorner = corner;
+        }
+        else if (vertexCount >= 2)
+        {
+            u32* triangle =
+                job.corners +
+                3 * (chunk.firstTriangle + parser.triangleCount++);
+            triangle[0] = firstCorner;
+            triangle[1] = prevCorner;
+            triangle[2] = corner;
+        }
+        prevCorner = corner;
+        vertexCount++;
     }
 
-    if (subgeometryIndexCount > 0)
+    return true;
+}
+
+static bool ParseObjChunk(ImportObjJob& job, ObjChunk& chunk,
+                          ObjChunkParser& parser)
+{
+    const char* c = chunk.begin;
+    while (c < chunk.end)
     {
-        Subgeometry& last = *(subgeometries.Last());
-        last.lods[0].indexCount = subgeometryIndexCount;
+        const char* lineEnd = FindObjLineEnd(c, chunk.end);
+        c = SkipObjSpaces(c, lineEnd);
+        if (IsObjLineContinued(c, lineEnd))
+        {
+            return false;
+        }
+
+        if (IsObjKeyword(c, lineEnd, "v", 1))
+        {
+            f32* position =
+                job.positions +
+                3 * (chunk.firstPosition + parser.positionCount++);
+            if (!ParseObjFloats(c + 1, lineEnd, 3, position))
+            {
+                return false;
+            }
+        }
+        else if (IsObjKeyword(c, lineEnd, "vt", 2))
+        {
+            f32* texcoord =
+                job.texcoords +
+                2 * (chunk.firstTexcoord + parser.texcoordCount++);
+            if (!ParseObjFloats(c + 2, lineEnd, 2, texcoord))
+            {
+                return false;
+            }
+        }
+        else if (IsObjKeyword(c, lineEnd, "vn", 2))
+        {
+            f32* normal =
+                job.normals + 3 * (chunk.firstNormal + parser.normalCount++);
+            if (!ParseObjFloats(c + 2, lineEnd, 3, normal))
+            {
+                return false;
+            }
+        }
+        else if (IsObjKeyword(c, lineEnd, "f", 1))
+        {
+            if (!ParseObjFace(job, chunk, parser, c + 1, lineEnd))
+            {
+                return false;
+            }
+        }
+        else if (IsObjKeyword(c, lineEnd, "o", 1))
+        {
+            parser.object++;
+            job.objects[parser.object].firstTriangle =
+                chunk.firstTriangle + parser.triangleCount;
+        }
+        else if (IsObjKeyword(c, lineEnd, "usemtl", 6))
+        {
+            const char* name = SkipObjSpaces(c + 6, lineEnd);
+            const char* nameEnd = lineEnd;
+            while (nameEnd > name && IsObjSpace(nameEnd[-1]))
+            {
+                nameEnd--;
+            }
+
+            ObjMaterialEvent& event =
+                job.materialEvents[chunk.firstMaterial +
+                                   parser.materialCount++];
+            event.triangle = chunk.firstTriangle + parser.triangleCount;
+            event.name = String8(name, static_cast<u64>(nameEnd - name));
+            event.material = 0;
+        }
+
+        c = lineEnd + 1;
     }
 
+    return true;
+}
+
+static void ParseObjChunkTask(u32 index, void* userData)
+{
+    ImportObjJob& job = *static_cast<ImportObjJob*>(userData);
+    ObjChunk& chunk = job.chunks[index];
+
+    // Sized for the worst case and shrunk once the chunk is parsed
+    u64 cornerCount = 3 * chunk.triangleCount;
+    chunk.tuples =
+        static_cast<ObjTuple*>(Alloc(sizeof(ObjTuple) * (cornerCount + 1)));
+
+    ObjChunkParser parser;
+    parser.object = chunk.firstObject;
+    CreateObjTupleTable(cornerCount, parser.table);
+    if (!ParseObjChunk(job, chunk, parser))
     {
-        geometry.subgeometries = static_cast<Subgeometry*>(
-            Alloc(sizeof(Subgeometry) * subgeometries.Count()));
-        geometry.subgeometryCount = subgeometries.Count();
-        memcpy(geometry.subgeometries, subgeometries.Data(),
-               sizeof(Subgeometry) * subgeometries.Count());
+        job.res = false;
+    }
+    DestroyObjTupleTable(parser.table);
+
+    chunk.tuples = static_cast<ObjTuple*>(
+        Realloc(chunk.tuples, sizeof(ObjTuple) * (chunk.tupleCount + 1)));
+}
+
+static void RemapObjChunkTask(u32 index, void* userData)
+{
+    ImportObjJob& job = *static_cast<ImportObjJob*>(userData);
+    const ObjChunk& chunk = job.chunks[index];
+
+    u32* corners = job.corners + 3 * chunk.firstTriangle;
+    for (u64 i = 0; i < 3 * chunk.triangleCount; i++)
+    {
+        corners[i] = chunk.tupleVertices[corners[i]];
     }
+}
+
+static void BuildObjSubgeometries(const ImportObjJob& job,
+                                  const ObjObject& object,
+                                  Geometry& geometry)
+{
+    DynamicArray<Subgeometry> subgeometries;
+
+    Subgeometry subgeometry{};
+    u32 material = object.material;
+    u64 endTriangle = object.firstTriangle + object.triangleCount;
+    for (u32 i = object.firstMaterialEvent; i < job.materialEventCount &&
+                                            job.materialEvents[i].triangle <
+                                                endTriangle;
+         i++)
     {
-        geometry.vertices =
-            static_cast<Vertex*>(Alloc(sizeof(Vertex) * vertices.Count()));
-        memcpy(geometry.vertices, vertices.Data(),
-               sizeof(Vertex) * vertices.Count());
-        geometry.vertexCount = vertices.Count();
+        // Only the last of several usemtl lines between two faces counts
+        const ObjMaterialEvent& event = job.materialEvents[i];
+        if ((i + 1 < job.materialEventCount &&
+             job.materialEvents[i + 1].triangle == event.triangle) ||
+            event.material == material)
+        {
+            continue;
+        }
+
+        u32 firstIndex =
+            static_cast<u32>(3 * (event.triangle - object.firstTriangle));
+        subgeometry.lods[0].indexCount =
+            firstIndex - subgeometry.lods[0].firstIndex;
+        subgeometries.Add(subgeometry);
+
+        subgeometry = {};
+        subgeometry.lods[0].firstIndex = firstIndex;
+        material = event.material;
     }
+    subgeometry.lods[0].indexCount =
+        geometry.indexCount - subgeometry.lods[0].firstIndex;
+    subgeometries.Add(subgeometry);
+
+    geometry.subgeometries = static_cast<Subgeometry*>(
+        Alloc(sizeof(Subgeometry) * subgeometries.Count()));
+    geometry.subgeometryCount = subgeometries.Count();
+    memcpy(geometry.subgeometries, subgeometries.Data(),
+           sizeof(Subgeometry) * subgeometries.Count());
+}
+
+static void BuildObjGeometryTask(u32 index, void* userData)
+{
+    ImportObjJob& job = *static_cast<ImportObjJob*>(userData);
+    const ObjObject& object = job.objects[index];
+    if (object.geometryIndex == FLY_MAX_U32)
     {
-        geometry.indices =
-            static_cast<u32*>(Alloc(sizeof(u32) * indices.Count()));
-        memcpy(geometry.indices, indices.Data(), sizeof(u32) * indices.Count());
-        geometry.indexCount = indices.Count();
+        return;
     }
 
+    Geometry& geometry = job.geometries[object.geometryIndex];
+    geometry = {};
+    geometry.lodCount = 1;
+    geometry.vertexMask = job.vertexMask;
+
+    geometry.vertexCount = object.vertexCount;
+    geometry.vertices =
+        static_cast<Vertex*>(Alloc(sizeof(Vertex) * geometry.vertexCount));
+    for (u32 i = 0; i < geometry.vertexCount; i++)
+    {
+        const ObjTuple& tuple = job.vertexTuples[object.firstVertex + i];
+        Vertex& vertex = geometry.vertices[i];
+        vertex = {};
+        memcpy(vertex.position.data, job.positions + 3 * tuple.position,
+               sizeof(Math::Vec3));
+        if (tuple.normal != FLY_MAX_U32)
+        {
+            memcpy(vertex.normal.data, job.normals + 3 * tuple.normal,
+                   sizeof(Math::Vec3));
+        }
+        if (tuple.texcoord != FLY_MAX_U32)
+        {
+            vertex.u = job.texcoords[2 * tuple.texcoord];
+            vertex.v = job.texcoords[2 * tuple.texcoord + 1];
+        }
+    }
+
+    geometry.indexCount = static_cast<u32>(3 * object.triangleCount);
+    geometry.indices =
+        static_cast<u32*>(Alloc(sizeof(u32) * geometry.indexCount));
+    memcpy(geometry.indices, job.corners + 3 * object.firstTriangle,
+           sizeof(u32) * geometry.indexCount);
+
+    BuildObjSubgeometries(job, object, geometry);
+
     if ((geometry.vertexMask & FLY_VERTEX_TEXCOORD_BIT) &&
         (geometry.vertexMask & FLY_VERTEX_NORMAL_BIT))
     {
@@ -330,58 +906,302 @@ static void ExtractGeometryDataFromObj(const fastObjMesh& mesh,
     }
 }
 
-bool ImportGeometriesObj(const void* pMesh, Geometry** ppGeometries,
-                         u32& geometryCount)
+// Splits the file at line boundaries and turns the chunk counts into the
+// offsets of the first element of every chunk
+static bool CountObjChunks(const char* data, u64 size, u64 chunkSize,
+                           ImportObjJob& job, u32& chunkCount,
+                           u32& objectCount, u32& materialEventCount,
+                           u64& triangleCount)
 {
-    FLY_ASSERT(ppGeometries);
-    geometryCount = 0;
+    chunkCount = static_cast<u32>((size + chunkSize - 1) / chunkSize);
+    job.chunks = static_cast<ObjChunk*>(Alloc(sizeof(ObjChunk) * chunkCount));
+
+    const char* end = data + size;
+    const char* begin = data;
+    for (u32 i = 0; i < chunkCount; i++)
+    {
+        const char* chunkEnd = end;
+        if (i + 1 < chunkCount)
+        {
+            // A line longer than a chunk leaves the chunk empty
+            chunkEnd = data + (i + 1) * chunkSize;
+            if (chunkEnd > begin)
+            {
+                chunkEnd = FindObjLineEnd(chunkEnd, end);
+                chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+            }
+            else
+            {
+                chunkEnd = begin;
+            }
+        }
 
-    const fastObjMesh* mesh = static_cast<const fastObjMesh*>(pMesh);
+        job.chunks[i] = {};
+        job.chunks[i].begin = begin;
+        job.chunks[i].end = chunkEnd;
+        begin = chunkEnd;
+    }
+
+    ParallelFor(chunkCount, CountObjChunkTask, &job);
 
-    if (!mesh || mesh->object_count == 0)
+    u64 triangleCountSum = 0;
+    u32 objectLineCount = 0;
+    u32 materialLineCount = 0;
+    for (u32 i = 0; i < chunkCount; i++)
+    {
+        ObjChunk& chunk = job.chunks[i];
+        chunk.firstPosition = job.positionCount;
+        chunk.firstTexcoord = job.texcoordCount;
+        chunk.firstNormal = job.normalCount;
+        chunk.firstTriangle = triangleCountSum;
+        chunk.firstObject = objectLineCount;
+        chunk.firstMaterial = materialLineCount;
+        job.positionCount += chunk.positionCount;
+        job.texcoordCount += chunk.texcoordCount;
+        job.normalCount += chunk.normalCount;
+        triangleCountSum += chunk.triangleCount;
+        objectLineCount += chunk.objectCount;
+        materialLineCount += chunk.materialCount;
+    }
+
+    // Object 0 holds the faces before the first o line
+    objectCount = objectLineCount + 1;
+    materialEventCount = materialLineCount;
+    triangleCount = triangleCountSum;
+    return job.positionCount > 0 && triangleCount > 0;
+}
+
+// Gives every usemtl name an id in order of first use and finds the
+// material each object starts with
+static void ResolveObjMaterials(ImportObjJob& job, u32 objectCount)
+{
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+
+    // Faces before the first usemtl use material 0
+    HashTrie<String8, u32> materialIds;
+    for (u32 i = 0; i < job.materialEventCount; i++)
+    {
+        ObjMaterialEvent& event = job.materialEvents[i];
+        if (const u32* material = materialIds.Find(event.name))
+        {
+            event.material = *material;
+            continue;
+        }
+        event.material = static_cast<u32>(materialIds.Count()) + 1;
+        materialIds.Insert(arena, event.name, event.material);
+    }
+
+    u32 eventIndex = 0;
+    u32 material = 0;
+    for (u32 i = 0; i < objectCount; i++)
+    {
+        ObjObject& object = job.objects[i];
+        while (eventIndex < job.materialEventCount &&
+               job.materialEvents[eventIndex].triangle <= object.firstTriangle)
+        {
+            material = job.materialEvents[eventIndex++].material;
+        }
+        object.material = material;
+        object.firstMaterialEvent = eventIndex;
+    }
+
+    ArenaPopToMarker(arena, marker);
+}
+
+// Merges the chunk tuples in file order into the vertices of every object
+static bool MergeObjTuples(ImportObjJob& job, u32 chunkCount,
+                           u32 objectCount)
+{
+    u64 tupleCount = 0;
+    for (u32 i = 0; i < chunkCount; i++)
+    {
+        tupleCount += job.chunks[i].tupleCount;
+    }
+    if (tupleCount > FLY_MAX_U32)
     {
         return false;
     }
 
-    if (mesh->position_count < 3)
+    ObjTuple* mergedTuples =
+        static_cast<ObjTuple*>(Alloc(sizeof(ObjTuple) * tupleCount));
+    u32* mergedVertices = static_cast<u32*>(Alloc(sizeof(u32) * tupleCount));
+    u32 mergedCount = 0;
+    ObjTupleTable table;
+    CreateObjTupleTable(tupleCount, table);
+
+    for (u32 i = 0; i < chunkCount; i++)
+    {
+        ObjChunk& chunk = job.chunks[i];
+        chunk.tupleVertices =
+            static_cast<u32*>(Alloc(sizeof(u32) * (chunk.tupleCount + 1)));
+        for (u32 j = 0; j < chunk.tupleCount; j++)
+        {
+            const ObjTuple& tuple = chunk.tuples[j];
+            u32 count = mergedCount;
+            u32 merged =
+                FindOrAddObjTuple(table, mergedTuples, mergedCount, tuple);
+            if (merged == count)
+            {
+                ObjObject& object = job.objects[tuple.object];
+                mergedVertices[merged] = object.vertexCount++;
+            }
+            chunk.tupleVertices[j] = mergedVertices[merged];
+        }
+        Free(chunk.tuples);
+        chunk.tuples = nullptr;
+    }
+    DestroyObjTupleTable(table);
+
+    u64 vertexCount = 0;
+    for (u32 i = 0; i < objectCount; i++)
+    {
+        job.objects[i].firstVertex = vertexCount;
+        vertexCount += job.objects[i].vertexCount;
+    }
+
+    job.vertexTuples =
+        static_cast<ObjTuple*>(Alloc(sizeof(ObjTuple) * (vertexCount + 1)));
+    for (u32 i = 0; i < mergedCount; i++)
+    {
+        const ObjTuple& tuple = mergedTuples[i];
+        job.vertexTuples[job.objects[tuple.object].firstVertex +
+                         mergedVertices[i]] = tuple;
+    }
+
+    Free(mergedTuples);
+    Free(mergedVertices);
+    return true;
+}
+
+static void DestroyImportObjJob(ImportObjJob& job, u32 chunkCount)
+{
+    for (u32 i = 0; i < chunkCount; i++)
+    {
+        Free(job.chunks[i].tuples);
+        Free(job.chunks[i].tupleVertices);
+    }
+    Free(job.chunks);
+    Free(job.objects);
+    Free(job.materialEvents);
+    Free(job.positions);
+    Free(job.texcoords);
+    Free(job.normals);
+    Free(job.corners);
+    Free(job.vertexTuples);
+}
+
+bool ImportGeometriesObj(String8 path, Geometry** ppGeometries,
+                         u32& geometryCount, u64 chunkSize)
+{
+    FLY_ASSERT(ppGeometries);
+    geometryCount = 0;
+
+    MappedFile file;
+    if (!MapFile(path, file))
     {
         return false;
     }
-    u8 vertexMask = FLY_VERTEX_POSITION_BIT;
 
-    if (mesh->normal_count > 0)
+    bool res = ImportGeometriesObj(reinterpret_cast<const char*>(file.data),
+                                   file.size, ppGeometries, geometryCount,
+                                   chunkSize);
+    UnmapFile(file);
+    return res;
+}
+
+bool ImportGeometriesObj(const char* data, u64 size, Geometry** ppGeometries,
+                         u32& geometryCount, u64 chunkSize)
+{
+    FLY_ASSERT(data || !size);
+    FLY_ASSERT(ppGeometries);
+    FLY_ASSERT(chunkSize);
+    geometryCount = 0;
+
+    ImportObjJob job;
+    u32 chunkCount = 0;
+    u32 objectCount = 0;
+    u64 triangleCount = 0;
+    bool res = CountObjChunks(data, size, chunkSize, job, chunkCount,
+                              objectCount, job.materialEventCount,
+                              triangleCount);
+    if (!res)
     {
-        vertexMask |= FLY_VERTEX_NORMAL_BIT;
+        goto exit;
     }
 
-    if (mesh->texcoord_count > 0)
+    job.objects =
+        static_cast<ObjObject*>(Alloc(sizeof(ObjObject) * objectCount));
+    for (u32 i = 0; i < objectCount; i++)
+    {
+        job.objects[i] = {};
+    }
+    job.materialEvents = static_cast<ObjMaterialEvent*>(
+        Alloc(sizeof(ObjMaterialEvent) * (job.materialEventCount + 1)));
+    job.positions =
+        static_cast<f32*>(Alloc(sizeof(f32) * 3 * job.positionCount));
+    job.texcoords =
+        static_cast<f32*>(Alloc(sizeof(f32) * 2 * (job.texcoordCount + 1)));
+    job.normals =
+        static_cast<f32*>(Alloc(sizeof(f32) * 3 * (job.normalCount + 1)));
+    job.corners = static_cast<u32*>(Alloc(sizeof(u32) * 3 * triangleCount));
+
+    ParallelFor(chunkCount, ParseObjChunkTask, &job);
+    res = job.res;
+    if (!res)
     {
-        vertexMask |= FLY_VERTEX_TEXCOORD_BIT;
+        goto exit;
     }
 
-    // Check triangulation
-    for (u32 i = 0; i < mesh->face_count; i++)
+    // Objects without faces are dropped
+    for (u32 i = 0; i < objectCount; i++)
     {
-        // TODO: triangulation
-        if (mesh->face_vertices[i] != 3)
+        ObjObject& object = job.objects[i];
+        u64 endTriangle = i + 1 < objectCount
+                              ? job.objects[i + 1].firstTriangle
+                              : triangleCount;
+        object.triangleCount = endTriangle - object.firstTriangle;
+        if (object.triangleCount > FLY_MAX_U32 / 3)
         {
-            FLY_ASSERT(false);
-            return false;
+            res = false;
+            goto exit;
+        }
+        if (object.triangleCount)
+        {
+            object.geometryIndex = geometryCount++;
         }
     }
 
-    geometryCount = mesh->object_count;
-    *ppGeometries =
-        static_cast<Geometry*>(Alloc(sizeof(Geometry) * geometryCount));
-    Geometry* pGeometries = *ppGeometries;
+    ResolveObjMaterials(job, objectCount);
+    res = MergeObjTuples(job, chunkCount, objectCount);
+    if (!res)
+    {
+        goto exit;
+    }
+    ParallelFor(chunkCount, RemapObjChunkTask, &job);
 
-    for (u32 i = 0; i < mesh->object_count; i++)
+    job.vertexMask = FLY_VERTEX_POSITION_BIT;
+    if (job.normalCount > 0)
     {
-        ExtractGeometryDataFromObj(*mesh, mesh->objects[i], pGeometries[i],
-                                   vertexMask);
+        job.vertexMask |= FLY_VERTEX_NORMAL_BIT;
+    }
+    if (job.texcoordCount > 0)
+    {
+        job.vertexMask |= FLY_VERTEX_TEXCOORD_BIT;
     }
 
-    return true;
+    job.geometries =
+        static_cast<Geometry*>(Alloc(sizeof(Geometry) * geometryCount));
+    ParallelFor(objectCount, BuildObjGeometryTask, &job);
+    *ppGeometries = job.geometries;
+
+exit:
+    if (!res)
+    {
+        geometryCount = 0;
+    }
+    DestroyImportObjJob(job, chunkCount);
+    return res;
 }
 
 bool ImportGeometriesGltf(const cgltf_data* data, Geometry** ppGeometries,
@@ -685,6 +1505,18 @@ void DestroyGeometry(Geometry& geometry)
     {
         Fly::Free(geometry.subgeometries);
     }
+    if (geometry.meshlets)
+    {
+        Fly::Free(geometry.meshlets);
+    }
+    if (geometry.meshletVertices)
+    {
+        Fly::Free(geometry.meshletVertices);
+    }
+    if (geometry.meshletTriangles)
+    {
+        Fly::Free(geometry.meshletTriangles);
+    }
     geometry = {};
 }
 
@@ -696,6 +1528,84 @@ static u32 HeuristicDetermineLODCount(Geometry& geometry)
            1;
 }
 
+struct GenerateLODsJob
+{
+    Geometry* geometry = nullptr;
+    // Start of the pool region of every subgeometry, room for lodCount - 1
+    // copies of its lod 0
+    u64* regionStarts = nullptr;
+    f32 errorScale = 1.0f;
+};
+
+// Simplifies every lod of one subgeometry from its lod 0 and writes them
+// back to back at the start of the subgeometry pool region. firstIndex of
+// the lods is relative to the region until the pool is compacted.
+static void GenerateSubgeometryLODsTask(u32 index, void* userData)
+{
+    GenerateLODsJob& job = *static_cast<GenerateLODsJob*>(userData);
+    Geometry& geometry = *job.geometry;
+    Subgeometry& sg = geometry.subgeometries[index];
+    u32* region = geometry.indices + job.regionStarts[index];
+
+    const f32 baseTargetError = 0.0001f;
+    u32 regionOffset = 0;
+    for (u32 i = 1; i < geometry.lodCount; i++)
+    {
+        u32* dst = region + regionOffset;
+        const u32 minSgIndexCount =
+            Math::Min(sg.lods[i - 1].indexCount, 256u * 3u);
+
+        if (sg.lods[i - 1].indexCount == minSgIndexCount)
+        {
+            const u32* prev = i == 1 ? geometry.indices + sg.lods[0].firstIndex
+                                     : region + sg.lods[i - 1].firstIndex;
+            memcpy(dst, prev, sizeof(u32) * sg.lods[i - 1].indexCount);
+            sg.lods[i] = {regionOffset, sg.lods[i - 1].indexCount};
+            sg.lods[i].error = sg.lods[i - 1].error;
+        }
+        else
+        {
+            u32 targetIndexCount = Math::Max(
+                static_cast<u32>(Math::Ceil((sg.lods[0].indexCount / 3) *
+                                            Math::Pow(0.5f, i))) *
+                    3,
+                minSgIndexCount);
+            f32 targetError = baseTargetError * Math::Pow(2.0f, i);
+
+            u32 lodIndexCount = 0;
+            f32 resultError = 0.0f;
+            for (u32 k = 0; k < 5; k++)
+            {
+                lodIndexCount = meshopt_simplify<u32>(
+                    dst, geometry.indices + sg.lods[0].firstIndex,
+                    sg.lods[0].indexCount,
+                    reinterpret_cast<const float*>(geometry.vertices),
+                    geometry.vertexCount, sizeof(Vertex), targetIndexCount,
+                    targetError, 0, &resultError);
+                if (lodIndexCount <= targetIndexCount)
+                {
+                    break;
+                }
+                targetError *= 1.5f;
+                if (k == 4)
+                {
+                    fprintf(stderr,
+                            "Warning: mesh simplifier failed to reach "
+                            "target index "
+                            "count %u (current index count is %u), "
+                            "subgeometry index %u\n",
+                            targetIndexCount, lodIndexCount, index);
+                }
+            }
+            sg.lods[i] = {regionOffset, lodIndexCount};
+            // Coarser lods never report a smaller error than finer ones
+            sg.lods[i].error = Math::Max(resultError * job.errorScale,
+                                         sg.lods[i - 1].error);
+        }
+        regionOffset += sg.lods[i].indexCount;
+    }
+}
+
 void GenerateGeometryLODs(Geometry& geometry)
 {
     u32 lodCount = HeuristicDetermineLODCount(geometry);
@@ -705,98 +1615,225 @@ void GenerateGeometryLODs(Geometry& geometry)
         return;
     }
 
+    // No lod is larger than lod 0, so the pool is allocated once with room
+    // for lodCount - 1 copies of every subgeometry. Only the pages that are
+    // written get committed and the pool is compacted and shrunk afterwards.
+    u64* regionStarts = static_cast<u64*>(
+        Alloc(sizeof(u64) * geometry.subgeometryCount));
+    u64 poolSize = geometry.indexCount;
+    for (u32 i = 0; i < geometry.subgeometryCount; i++)
+    {
+        regionStarts[i] = poolSize;
+        poolSize +=
+            static_cast<u64>(geometry.subgeometries[i].lods[0].indexCount) *
+            (lodCount - 1);
+    }
+    geometry.indices = static_cast<u32*>(
+        Realloc(geometry.indices, sizeof(u32) * poolSize));
+
+    GenerateLODsJob job;
+    job.geometry = &geometry;
+    job.regionStarts = regionStarts;
+    job.errorScale = meshopt_simplifyScale(
+        reinterpret_cast<const float*>(geometry.vertices),
+        geometry.vertexCount, sizeof(Vertex));
+    ParallelFor(geometry.subgeometryCount, GenerateSubgeometryLODsTask, &job);
+
     u32 totalIndexCount = geometry.indexCount;
+    for (u32 i = 0; i < geometry.subgeometryCount; i++)
+    {
+        Subgeometry& sg = geometry.subgeometries[i];
+        for (u32 j = 1; j < lodCount; j++)
+        {
+            u64 firstIndex = regionStarts[i] + sg.lods[j].firstIndex;
+            memmove(geometry.indices + totalIndexCount,
+                    geometry.indices + firstIndex,
+                    sizeof(u32) * sg.lods[j].indexCount);
+            sg.lods[j].firstIndex = totalIndexCount;
+            totalIndexCount += sg.lods[j].indexCount;
+        }
+    }
+    Free(regionStarts);
 
-    const f32 baseTargetError = 0.0001f;
-    for (u32 i = 1; i < geometry.lodCount; i++)
+    geometry.indices = static_cast<u32*>(
+        Realloc(geometry.indices, sizeof(u32) * totalIndexCount));
+    geometry.indexCount = totalIndexCount;
+}
+
+static void BuildLODMeshlets(Geometry& geometry, LOD& lod,
+                             meshopt_Meshlet* meshoptMeshlets)
+{
+    const f32 coneWeight = 0.25f;
+
+    u32* meshletVertices =
+        geometry.meshletVertices + geometry.meshletVertexCount;
+    u8* meshletTriangles =
+        geometry.meshletTriangles + geometry.meshletTriangleCount;
+
+    u32 meshletCount = static_cast<u32>(meshopt_buildMeshlets(
+        meshoptMeshlets, meshletVertices, meshletTriangles,
+        geometry.indices + lod.firstIndex, lod.indexCount,
+        reinterpret_cast<const f32*>(geometry.vertices), geometry.vertexCount,
+        sizeof(Vertex), FLY_MESHLET_MAX_VERTEX_COUNT,
+        FLY_MESHLET_MAX_TRIANGLE_COUNT, coneWeight));
+
+    lod.firstMeshlet = geometry.meshletCount;
+    lod.meshletCount = meshletCount;
+
+    u32 vertexCount = 0;
+    u32 triangleCount = 0;
+    for (u32 i = 0; i < meshletCount; i++)
+    {
+        const meshopt_Meshlet& src = meshoptMeshlets[i];
+        meshopt_Bounds bounds = meshopt_computeMeshletBounds(
+            meshletVertices + src.vertex_offset,
+            meshletTriangles + src.triangle_offset, src.triangle_count,
+            reinterpret_cast<const f32*>(geometry.vertices),
+            geometry.vertexCount, sizeof(Vertex));
+
+        Meshlet& meshlet = geometry.meshlets[geometry.meshletCount + i];
+        meshlet = {};
+        meshlet.sphereCenter =
+            Math::Vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
+        meshlet.sphereRadius = bounds.radius;
+        meshlet.coneApex = Math::Vec3(bounds.cone_apex[0], bounds.cone_apex[1],
+                                      bounds.cone_apex[2]);
+        meshlet.coneAxis = Math::Vec3(bounds.cone_axis[0], bounds.cone_axis[1],
+                                      bounds.cone_axis[2]);
+        meshlet.coneCutoff = bounds.cone_cutoff;
+        meshlet.vertexOffset = geometry.meshletVertexCount + src.vertex_offset;
+        meshlet.triangleOffset =
+            geometry.meshletTriangleCount + src.triangle_offset;
+        meshlet.vertexCount = src.vertex_count;
+        meshlet.triangleCount = src.triangle_count;
+
+        vertexCount =
+            Math::Max(vertexCount, src.vertex_offset + src.vertex_count);
+        triangleCount = Math::Max(
+            triangleCount, src.triangle_offset + src.triangle_count * 3);
+    }
+
+    geometry.meshletCount += meshletCount;
+    geometry.meshletVertexCount += vertexCount;
+    // Keeps the triangles of every lod 4 byte aligned
+    geometry.meshletTriangleCount += (triangleCount + 3) & ~3u;
+}
+
+// Splits every lod of every subgeometry into meshlets with culling bounds.
+// Lods that are copies of the previous one share its meshlets.
+static void BuildGeometryMeshlets(Geometry& geometry)
+{
+    u64 meshletBound = 0;
+    u32 maxLodMeshletBound = 0;
+    for (u32 i = 0; i < geometry.subgeometryCount; i++)
     {
-        geometry.indices = static_cast<u32*>(
-            Realloc(geometry.indices,
-                    sizeof(u32) * (totalIndexCount + geometry.indexCount)));
-        for (u32 j = 0; j < geometry.subgeometryCount; j++)
+        for (u32 j = 0; j < geometry.lodCount; j++)
         {
-            Subgeometry& sg = geometry.subgeometries[j];
-            const u32 minSgIndexCount =
-                Math::Min(sg.lods[i - 1].indexCount, 256u * 3u);
+            u32 bound = static_cast<u32>(meshopt_buildMeshletsBound(
+                geometry.subgeometries[i].lods[j].indexCount,
+                FLY_MESHLET_MAX_VERTEX_COUNT, FLY_MESHLET_MAX_TRIANGLE_COUNT));
+            meshletBound += bound;
+            maxLodMeshletBound = Math::Max(maxLodMeshletBound, bound);
+        }
+    }
 
-            if (sg.lods[i - 1].indexCount == minSgIndexCount)
-            {
-                memcpy(geometry.indices + totalIndexCount,
-                       geometry.indices + sg.lods[i - 1].firstIndex,
-                       sizeof(u32) * sg.lods[i - 1].indexCount);
-                sg.lods[i] = {totalIndexCount, sg.lods[i - 1].indexCount};
-            }
-            else
+    if (!meshletBound)
+    {
+        return;
+    }
+
+    geometry.meshlets =
+        static_cast<Meshlet*>(Alloc(sizeof(Meshlet) * meshletBound));
+    geometry.meshletVertices = static_cast<u32*>(
+        Alloc(sizeof(u32) * meshletBound * FLY_MESHLET_MAX_VERTEX_COUNT));
+    geometry.meshletTriangles = static_cast<u8*>(
+        Alloc(sizeof(u8) * meshletBound * FLY_MESHLET_MAX_TRIANGLE_COUNT * 3));
+    meshopt_Meshlet* meshoptMeshlets = static_cast<meshopt_Meshlet*>(
+        Alloc(sizeof(meshopt_Meshlet) * maxLodMeshletBound));
+
+    for (u32 i = 0; i < geometry.subgeometryCount; i++)
+    {
+        Subgeometry& sg = geometry.subgeometries[i];
+        for (u32 j = 0; j < geometry.lodCount; j++)
+        {
+            LOD& lod = sg.lods[j];
+            if (j > 0 && lod.indexCount == sg.lods[j - 1].indexCount &&
+                memcmp(geometry.indices + lod.firstIndex,
+                       geometry.indices + sg.lods[j - 1].firstIndex,
+                       sizeof(u32) * lod.indexCount) == 0)
             {
-                u32 targetIndexCount = Math::Max(
-                    static_cast<u32>(Math::Ceil((sg.lods[0].indexCount / 3) *
-                                                Math::Pow(0.5f, i))) *
-                        3,
-                    minSgIndexCount);
-                f32 targetError = baseTargetError * Math::Pow(2.0f, i);
-
-                u32 lodIndexCount = 0;
-                for (u32 k = 0; k < 5; k++)
-                {
-                    f32 resultError = 0.0f;
-                    lodIndexCount = meshopt_simplify<u32>(
-                        geometry.indices + totalIndexCount,
-                        geometry.indices + sg.lods[0].firstIndex,
-                        sg.lods[0].indexCount,
-                        reinterpret_cast<const float*>(geometry.vertices),
-                        geometry.vertexCount, sizeof(Vertex), targetIndexCount,
-                        targetError, 0, &resultError);
-                    if (lodIndexCount <= targetIndexCount)
-                    {
-                        break;
-                    }
-                    targetError *= 1.5f;
-                    if (k == 4)
-                    {
-                        fprintf(stderr,
-                                "Warning: mesh simplifier failed to reach "
-                                "target index "
-                                "count %u (current index count is %u), "
-                                "subgeometry index %u\n",
-                                targetIndexCount, lodIndexCount, i);
-                    }
-                }
-                sg.lods[i] = {totalIndexCount, lodIndexCount};
+                lod.firstMeshlet = sg.lods[j - 1].firstMeshlet;
+                lod.meshletCount = sg.lods[j - 1].meshletCount;
+                continue;
             }
-            totalIndexCount += sg.lods[i].indexCount;
+
+            BuildLODMeshlets(geometry, lod, meshoptMeshlets);
         }
     }
-    geometry.indices = static_cast<u32*>(
-        Realloc(geometry.indices, sizeof(u32) * totalIndexCount));
-    geometry.indexCount = totalIndexCount;
+
+    Free(meshoptMeshlets);
+    geometry.meshlets = static_cast<Meshlet*>(
+        Realloc(geometry.meshlets, sizeof(Meshlet) * geometry.meshletCount));
+    geometry.meshletVertices = static_cast<u32*>(Realloc(
+        geometry.meshletVertices, sizeof(u32) * geometry.meshletVertexCount));
+    geometry.meshletTriangles = static_cast<u8*>(
+        Realloc(geometry.meshletTriangles,
+                sizeof(u8) * geometry.meshletTriangleCount));
 }
 
 void QuantizeGeometry(Geometry& geometry)
 {
     QVertex* qvertices =
         static_cast<QVertex*>(Alloc(sizeof(QVertex) * geometry.vertexCount));
-    for (u32 i = 0; i < geometry.vertexCount; i++)
+
+    // Half components are converted in chunks so that the bulk conversion
+    // can use hardware instructions
+    const u32 chunkSize = 256;
+    const u32 halfCount = 5;
+    f32 src[chunkSize * halfCount];
+    f16 dst[chunkSize * halfCount];
+
+    for (u32 first = 0; first < geometry.vertexCount; first += chunkSize)
     {
-        const Vertex& vertex = geometry.vertices[i];
-        QVertex& qvertex = qvertices[i];
-        qvertex = {};
-        qvertex.positionX = vertex.position.x;
-        qvertex.positionY = vertex.position.y;
-        qvertex.positionZ = vertex.position.z;
-        qvertex.normal =
-            (meshopt_quantizeUnorm((vertex.normal.x + 1.0f) / 2.0f, 10) << 20) |
-            (meshopt_quantizeUnorm((vertex.normal.y + 1.0f) / 2.0f, 10) << 10) |
-            meshopt_quantizeUnorm((vertex.normal.z + 1.0f) / 2.0f, 10);
-        u32 handness = (vertex.tangent.w > 0.0f) ? 1 : 0;
-        qvertex.tangent =
-            (handness << 21) |
-            (meshopt_quantizeUnorm((vertex.tangent.x + 1.0f) / 2.0f, 10)
-             << 20) |
-            (meshopt_quantizeUnorm((vertex.tangent.y + 1.0f) / 2.0f, 10)
-             << 10) |
-            meshopt_quantizeUnorm((vertex.tangent.z + 1.0f) / 2.0f, 10);
-        qvertex.u = vertex.u;
-        qvertex.v = vertex.v;
+        u32 count = Math::Min(chunkSize, geometry.vertexCount - first);
+        for (u32 i = 0; i < count; i++)
+        {
+            const Vertex& vertex = geometry.vertices[first + i];
+            f32* values = src + i * halfCount;
+            values[0] = vertex.position.x;
+            values[1] = vertex.position.y;
+            values[2] = vertex.position.z;
+            values[3] = vertex.u;
+            values[4] = vertex.v;
+        }
+        ConvertF32ToF16(dst, src, count * halfCount);
+
+        for (u32 i = 0; i < count; i++)
+        {
+            const Vertex& vertex = geometry.vertices[first + i];
+            const f16* values = dst + i * halfCount;
+            QVertex& qvertex = qvertices[first + i];
+            qvertex = {};
+            qvertex.positionX = values[0];
+            qvertex.positionY = values[1];
+            qvertex.positionZ = values[2];
+            qvertex.u = values[3];
+            qvertex.v = values[4];
+            qvertex.normal =
+                (meshopt_quantizeUnorm((vertex.normal.x + 1.0f) / 2.0f, 10)
+                 << 20) |
+                (meshopt_quantizeUnorm((vertex.normal.y + 1.0f) / 2.0f, 10)
+                 << 10) |
+                meshopt_quantizeUnorm((vertex.normal.z + 1.0f) / 2.0f, 10);
+            u32 handness = (vertex.tangent.w > 0.0f) ? 1 : 0;
+            qvertex.tangent =
+                (handness << 21) |
+                (meshopt_quantizeUnorm((vertex.tangent.x + 1.0f) / 2.0f, 10)
+                 << 20) |
+                (meshopt_quantizeUnorm((vertex.tangent.y + 1.0f) / 2.0f, 10)
+                 << 10) |
+                meshopt_quantizeUnorm((vertex.tangent.z + 1.0f) / 2.0f, 10);
+        }
     }
     Free(geometry.vertices);
     geometry.qvertices = qvertices;
@@ -842,6 +1879,13 @@ static void CalculateBoundingSphere(Geometry& geometry)
     geometry.sphereRadius = Math::Length(max - min) * 0.5f;
 }
 
+static void SelectGeometryIndexSize(Geometry& geometry)
+{
+    // 0xffff stays free for primitive restart
+    geometry.indexSize =
+        geometry.vertexCount <= FLY_MAX_U16 ? sizeof(u16) : sizeof(u32);
+}
+
 void CookGeometry(Geometry& geometry)
 {
     VertexDeduplication(geometry);
@@ -849,7 +1893,9 @@ void CookGeometry(Geometry& geometry)
     OptimizeGeometryOverdraw(geometry, 1.05f);
     CalculateBoundingSphere(geometry);
     GenerateGeometryLODs(geometry);
+    BuildGeometryMeshlets(geometry);
     QuantizeGeometry(geometry);
+    SelectGeometryIndexSize(geometry);
 }
 
 } // namespace Fly
@@ -31,6 +31,10 @@ struct SceneExportOptions
     CoordSystem coordSystem = CoordSystem::XYZ;
     bool exportNodes = true;
     bool exportMaterials = true;
+    bool compressGeometry = true;
+    // Packed occlusion, roughness and metallic textures are BC7 instead of
+    // BC1, which keeps more precision for roughness at twice the size
+    bool ormBC7 = false;
 };
 
 struct Subgeometry
@@ -49,17 +53,37 @@ struct Geometry
         QVertex* qvertices;
     };
     u32* indices = nullptr;
+    Meshlet* meshlets = nullptr;
+    u32* meshletVertices = nullptr;
+    u8* meshletTriangles = nullptr;
 
     f32 sphereRadius = 0.0f;
     u32 indexCount = 0;
+    u32 meshletCount = 0;
+    u32 meshletVertexCount = 0;
+    u32 meshletTriangleCount = 0;
     u32 vertexCount = 0;
     u32 subgeometryCount = 0;
     u8 vertexMask = FLY_VERTEX_NONE_BIT;
     u8 lodCount = 0;
+    // Byte width of the exported indices, cooking picks 2 when every vertex
+    // can be addressed by a u16
+    u8 indexSize = sizeof(u32);
 };
 
-bool ImportGeometriesObj(const void* mesh, Geometry** ppGeometries,
-                         u32& geometryCount);
+#define FLY_OBJ_CHUNK_SIZE (8ull * 1024 * 1024)
+
+// Parses the file in chunks of about chunkSize bytes on the job system,
+// every o line starts a geometry and usemtl lines split it into
+// subgeometries. Empty index slots such as in f 1// 2// 3// leave the
+// attribute out. Lines continued with a backslash are rejected.
+bool ImportGeometriesObj(String8 path, Geometry** ppGeometries,
+                         u32& geometryCount,
+                         u64 chunkSize = FLY_OBJ_CHUNK_SIZE);
+// Same for an OBJ file already in memory
+bool ImportGeometriesObj(const char* data, u64 size, Geometry** ppGeometries,
+                         u32& geometryCount,
+                         u64 chunkSize = FLY_OBJ_CHUNK_SIZE);
 bool ImportGeometriesGltf(const cgltf_data* data, Geometry** ppGeometries,
                           u32& geometryCount);
 void TransformGeometry(f32 scale, CoordSystem coordSystem, bool flipRight,
@@ -1,4 +1,6 @@
 #include "core/filesystem.h"
+#include "core/hash.h"
+#include "core/job_system.h"
 #include "core/memory.h"
 #include "core/string8.h"
 #include "core/thread_context.h"
@@ -10,20 +12,30 @@
 
 #include "scene.h"
 
+#include <meshoptimizer.h>
+
+#include <atomic>
+
 namespace Fly
 {
 
-static VkFormat CompressedStorageToVkFormat(ImageStorageType storageType)
+// Color textures are sampled as srgb unless textureFlags has
+// FLY_SCENE_TEXTURE_LINEAR_BIT
+static VkFormat CompressedStorageToVkFormat(ImageStorageType storageType,
+                                            u32 textureFlags)
 {
+    bool isLinear = textureFlags & FLY_SCENE_TEXTURE_LINEAR_BIT;
     switch (storageType)
     {
         case ImageStorageType::BC1:
         {
-            return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+            return isLinear ? VK_FORMAT_BC1_RGB_UNORM_BLOCK
+                            : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
         }
         case ImageStorageType::BC3:
         {
-            return VK_FORMAT_BC3_SRGB_BLOCK;
+            return isLinear ? VK_FORMAT_BC3_UNORM_BLOCK
+                            : VK_FORMAT_BC3_SRGB_BLOCK;
         }
         case ImageStorageType::BC4:
         {
@@ -39,7 +51,8 @@ static VkFormat CompressedStorageToVkFormat(ImageStorageType storageType)
         }
         case ImageStorageType::BC7:
         {
-            return VK_FORMAT_BC7_SRGB_BLOCK;
+            return isLinear ? VK_FORMAT_BC7_UNORM_BLOCK
+                            : VK_FORMAT_BC7_SRGB_BLOCK;
         }
         default:
         {
@@ -52,7 +65,8 @@ static VkFormat CompressedStorageToVkFormat(ImageStorageType storageType)
 static bool ImportTextures(RHI::Device& device,
                            const SceneFileHeader* fileHeader,
                            const ImageHeader* imageHeaderStart,
-                           const char* imageDataStart, Scene& scene)
+                           const u32* textureFlagStart,
+                           const u8* imageDataStart, Scene& scene)
 {
     if (!fileHeader->textureCount)
     {
@@ -67,8 +81,8 @@ static bool ImportTextures(RHI::Device& device,
     for (u32 i = 0; i < scene.textureCount; i++)
     {
         const ImageHeader& imageHeader = *(imageHeaderStart + i);
-        VkFormat imageFormat =
-            CompressedStorageToVkFormat(imageHeader.storageType);
+        VkFormat imageFormat = CompressedStorageToVkFormat(
+            imageHeader.storageType, textureFlagStart[i]);
 
         if (!RHI::CreateTexture2D(
                 device,
@@ -87,39 +101,174 @@ static bool ImportTextures(RHI::Device& device,
     return true;
 }
 
+static bool ImportMeshletBuffers(RHI::Device& device,
+                                 const SceneFileHeader* fileHeader,
+                                 const Meshlet* meshletStart,
+                                 const u32* meshletVertexStart,
+                                 const u8* meshletTriangleStart, Scene& scene)
+{
+    if (!fileHeader->totalMeshletCount)
+    {
+        return true;
+    }
+
+    if (!RHI::CreateBuffer(device, false,
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           meshletStart,
+                           sizeof(Meshlet) * fileHeader->totalMeshletCount,
+                           scene.meshletBuffer) ||
+        !RHI::CreateBuffer(
+            device, false,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            meshletVertexStart,
+            sizeof(u32) * fileHeader->totalMeshletVertexCount,
+            scene.meshletVertexBuffer) ||
+        !RHI::CreateBuffer(
+            device, false,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            meshletTriangleStart,
+            sizeof(u8) * fileHeader->totalMeshletTriangleCount,
+            scene.meshletTriangleBuffer))
+    {
+        DestroyScene(device, scene);
+        return false;
+    }
+
+    return true;
+}
+
+struct DecodeGeometryJob
+{
+    const SceneFileHeader* fileHeader = nullptr;
+    const MeshHeader* meshHeaders = nullptr;
+    const u8* geometryData = nullptr;
+    QVertex* vertices = nullptr;
+    u32* indices = nullptr;
+    u16* indices16 = nullptr;
+    std::atomic<bool> res{true};
+};
+
+static bool DecodeMeshGeometry(const SceneFileHeader* fileHeader,
+                               const MeshHeader& meshHeader,
+                               const u8* geometryData, QVertex* vertices,
+                               void* indices)
+{
+    const u8* vertexData = geometryData + meshHeader.vertexDataOffset;
+    const u8* indexData = geometryData + meshHeader.indexDataOffset;
+    if (!(fileHeader->flags & FLY_SCENE_FILE_COMPRESSED_GEOMETRY_BIT))
+    {
+        memcpy(vertices, vertexData, sizeof(QVertex) * meshHeader.vertexCount);
+        memcpy(indices, indexData,
+               meshHeader.indexSize * meshHeader.indexCount);
+        return true;
+    }
+
+    return meshopt_decodeVertexBuffer(vertices, meshHeader.vertexCount,
+                                      sizeof(QVertex), vertexData,
+                                      meshHeader.vertexDataSize) == 0 &&
+           meshopt_decodeIndexBuffer(indices, meshHeader.indexCount,
+                                     meshHeader.indexSize, indexData,
+                                     meshHeader.indexDataSize) == 0;
+}
+
+static void DecodeGeometryTask(u32 index, void* userData)
+{
+    DecodeGeometryJob& job = *static_cast<DecodeGeometryJob*>(userData);
+    const MeshHeader& meshHeader = job.meshHeaders[index];
+    void* indices = nullptr;
+    if (meshHeader.indexSize == sizeof(u16))
+    {
+        indices = job.indices16 + meshHeader.firstIndex;
+    }
+    else
+    {
+        indices = job.indices + meshHeader.firstIndex;
+    }
+
+    if (!DecodeMeshGeometry(job.fileHeader, meshHeader, job.geometryData,
+                            job.vertices + meshHeader.firstVertex, indices))
+    {
+        job.res = false;
+    }
+}
+
+// Decodes or copies the vertices and indices of all meshes in parallel
+// straight into one staging buffer, then copies it to the device buffers
 static bool ImportBuffers(RHI::Device& device,
                           const SceneFileHeader* fileHeader,
-                          const QVertex* vertexStart, const u32* indexStart,
-                          Scene& scene)
+                          const MeshHeader* meshHeaderStart,
+                          const u8* geometryDataStart, Scene& scene)
 {
-    if (fileHeader->totalVertexCount)
+    u64 vertexSize = sizeof(QVertex) * fileHeader->totalVertexCount;
+    u64 indexSize = sizeof(u32) * fileHeader->totalIndexCount;
+    u64 index16Size = sizeof(u16) * fileHeader->totalIndex16Count;
+    if (!vertexSize)
     {
-        if (!RHI::CreateBuffer(device, false,
-                               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                               vertexStart,
-                               sizeof(QVertex) * fileHeader->totalVertexCount,
-                               scene.vertexBuffer))
-        {
-            DestroyScene(device, scene);
-            return false;
-        }
+        return true;
+    }
+
+    RHI::Buffer stagingBuffer;
+    if (!RHI::CreateBuffer(device, true, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           nullptr, vertexSize + indexSize + index16Size,
+                           stagingBuffer))
+    {
+        DestroyScene(device, scene);
+        return false;
     }
 
-    if (fileHeader->totalIndexCount)
+    u8* stagingData = static_cast<u8*>(RHI::BufferMappedPtr(stagingBuffer));
+    DecodeGeometryJob job;
+    job.fileHeader = fileHeader;
+    job.meshHeaders = meshHeaderStart;
+    job.geometryData = geometryDataStart;
+    job.vertices = reinterpret_cast<QVertex*>(stagingData);
+    job.indices = reinterpret_cast<u32*>(stagingData + vertexSize);
+    job.indices16 =
+        reinterpret_cast<u16*>(stagingData + vertexSize + indexSize);
+    ParallelFor(fileHeader->meshCount, DecodeGeometryTask, &job);
+
+    if (!job.res ||
+        !RHI::CreateBuffer(device, false,
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           nullptr, vertexSize, scene.vertexBuffer) ||
+        (indexSize &&
+         !RHI::CreateBuffer(device, false,
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                            nullptr, indexSize, scene.indexBuffer)) ||
+        (index16Size &&
+         !RHI::CreateBuffer(device, false,
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                            nullptr, index16Size, scene.indexBuffer16)))
     {
+        RHI::DestroyBuffer(device, stagingBuffer);
+        DestroyScene(device, scene);
+        return false;
+    }
 
-        if (!RHI::CreateBuffer(device, false,
-                               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                               indexStart,
-                               sizeof(u32) * fileHeader->totalIndexCount,
-                               scene.indexBuffer))
+    RHI::BeginOneTimeSubmit(device);
+    {
+        RHI::CommandBuffer& cmd = RHI::OneTimeSubmitCommandBuffer(device);
+        RHI::CopyBufferToBuffer(cmd, scene.vertexBuffer, stagingBuffer,
+                                vertexSize);
+        if (indexSize)
         {
-            DestroyScene(device, scene);
-            return false;
+            RHI::CopyBufferToBuffer(cmd, scene.indexBuffer, stagingBuffer,
+                                    indexSize, vertexSize);
+        }
+        if (index16Size)
+        {
+            RHI::CopyBufferToBuffer(cmd, scene.indexBuffer16, stagingBuffer,
+                                    index16Size, vertexSize + indexSize);
         }
     }
+    RHI::EndOneTimeSubmit(device);
+    RHI::DestroyBuffer(device, stagingBuffer);
 
     return true;
 }
@@ -169,24 +318,31 @@ static void ImportNodes(const SceneFileHeader* fileHeader,
     }
 }
 
-static bool ImportMaterials(RHI::Device& device,
-                            const SceneFileHeader* fileHeader,
-                            const SerializedPBRMaterial* pbrMaterialStart,
-                            Scene& scene)
+// Textures that are not resident fall back to the white and flat normal
+// textures, white keeps the material factors of a missing ORM texture
+static u32 MaterialTextureHandle(const Scene& scene, i32 textureIndex,
+                                 const RHI::Texture& fallback)
 {
-    scene.materialCount = fileHeader->materialCount + 1;
-
-    Arena& arena = GetScratchArena();
-    ArenaMarker marker = ArenaGetMarker(arena);
-    PBRMaterial* pbrMaterials =
-        FLY_PUSH_ARENA(arena, PBRMaterial, scene.materialCount);
+    if (textureIndex == -1 ||
+        scene.textures[textureIndex].image == VK_NULL_HANDLE)
+    {
+        return fallback.bindlessHandle;
+    }
+    return scene.textures[textureIndex].bindlessHandle;
+}
 
+static void FillPBRMaterials(const SceneFileHeader* fileHeader,
+                             const SerializedPBRMaterial* pbrMaterialStart,
+                             const Scene& scene, PBRMaterial* pbrMaterials)
+{
     pbrMaterials[0] = {};
     pbrMaterials[0].baseColor = Math::Vec4(1.0f, 0.0f, 1.0f, 1.0f);
     pbrMaterials[0].baseColorTextureBindlessHandle =
         scene.whiteTexture.bindlessHandle;
     pbrMaterials[0].normalTextureBindlessHandle =
         scene.flatNormalTexture.bindlessHandle;
+    pbrMaterials[0].ormTextureBindlessHandle =
+        scene.whiteTexture.bindlessHandle;
 
     for (u32 i = 0; i < fileHeader->materialCount; i++)
     {
@@ -194,25 +350,29 @@ static bool ImportMaterials(RHI::Device& device,
         PBRMaterial& material = pbrMaterials[i + 1];
         material = {};
 
-        material.baseColorTextureBindlessHandle =
-            scene.whiteTexture.bindlessHandle;
-        material.normalTextureBindlessHandle =
-            scene.flatNormalTexture.bindlessHandle;
+        material.baseColorTextureBindlessHandle = MaterialTextureHandle(
+            scene, serializedMaterial.baseColorTextureIndex,
+            scene.whiteTexture);
+        material.normalTextureBindlessHandle = MaterialTextureHandle(
+            scene, serializedMaterial.normalTextureIndex,
+            scene.flatNormalTexture);
+        material.ormTextureBindlessHandle = MaterialTextureHandle(
+            scene, serializedMaterial.ormTextureIndex, scene.whiteTexture);
+    }
+}
 
-        if (serializedMaterial.baseColorTextureIndex != -1)
-        {
-            material.baseColorTextureBindlessHandle =
-                scene.textures[serializedMaterial.baseColorTextureIndex]
-                    .bindlessHandle;
-        }
+static bool ImportMaterials(RHI::Device& device,
+                            const SceneFileHeader* fileHeader,
+                            const SerializedPBRMaterial* pbrMaterialStart,
+                            Scene& scene)
+{
+    scene.materialCount = fileHeader->materialCount + 1;
 
-        if (serializedMaterial.normalTextureIndex != -1)
-        {
-            material.normalTextureBindlessHandle =
-                scene.textures[serializedMaterial.normalTextureIndex]
-                    .bindlessHandle;
-        }
-    }
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+    PBRMaterial* pbrMaterials =
+        FLY_PUSH_ARENA(arena, PBRMaterial, scene.materialCount);
+    FillPBRMaterials(fileHeader, pbrMaterialStart, scene, pbrMaterials);
 
     bool res = RHI::CreateBuffer(
         device, false,
@@ -257,6 +417,10 @@ static void ImportMeshes(const SceneFileHeader* fileHeader,
         mesh.indexCount = meshHeader.indexCount;
         mesh.submeshCount = meshHeader.submeshCount;
         mesh.lodCount = meshHeader.lodCount;
+        mesh.resident = true;
+        mesh.indexType = meshHeader.indexSize == sizeof(u16)
+                             ? VK_INDEX_TYPE_UINT16
+                             : VK_INDEX_TYPE_UINT32;
         mesh.vertexOffset = vertexOffset;
         mesh.submeshes = submeshes + submeshOffset;
 
@@ -314,139 +478,1482 @@ static bool CreateFallbackTextures(RHI::Device& device, Scene& scene)
     return true;
 }
 
-bool ImportScene(String8 path, RHI::Device& device, Scene& scene)
+struct SceneFileSections
 {
-    DestroyScene(device, scene);
+    const u8* data[static_cast<u32>(SceneSectionType::Count)] = {};
+    u64 sizes[static_cast<u32>(SceneSectionType::Count)] = {};
+};
 
-    if (!CreateFallbackTextures(device, scene))
+struct ChecksumSectionsJob
+{
+    const MappedFile* file = nullptr;
+    const SceneFileSection* sections = nullptr;
+    bool checkGeometryAndImageData = true;
+    std::atomic<bool> res{true};
+};
+
+static void ChecksumSectionTask(u32 index, void* userData)
+{
+    ChecksumSectionsJob& job = *static_cast<ChecksumSectionsJob*>(userData);
+    const SceneFileSection& section = job.sections[index];
+    if (!job.checkGeometryAndImageData &&
+        (section.type == SceneSectionType::GeometryData ||
+         section.type == SceneSectionType::ImageData))
+    {
+        return;
+    }
+    u64 checksum = 0;
+    if (section.size)
+    {
+        checksum = Hash64(job.file->data + section.offset, section.size);
+    }
+    if (checksum != section.checksum)
+    {
+        job.res = false;
+    }
+}
+
+static bool IsSceneSectionInFile(const MappedFile& file, u64 offset, u64 size)
+{
+    return offset % FLY_SCENE_SECTION_ALIGNMENT == 0 && offset <= file.size &&
+           size <= file.size - offset;
+}
+
+// Validates the header, the section table and the section checksums and
+// points every known section into the mapping. Streaming skips the
+// geometry and image data, their ranges are checked when they are read.
+static bool ReadSceneSections(const MappedFile& file,
+                              bool checkGeometryAndImageData,
+                              SceneFileSections& sections)
+{
+    if (file.size < sizeof(SceneFileHeader))
     {
         return false;
     }
 
-    if (!String8::EndsWith(path, FLY_STRING8_LITERAL(".fscene")))
+    const SceneFileHeader& header =
+        *reinterpret_cast<const SceneFileHeader*>(file.data);
+    if (header.magic != FLY_SCENE_FILE_MAGIC ||
+        header.version.major != FLY_SCENE_FILE_VERSION_MAJOR ||
+        header.sectionCount > file.size / sizeof(SceneFileSection))
     {
         return false;
     }
 
-    Arena& scratch = GetScratchArena();
-    ArenaMarker marker = ArenaGetMarker(scratch);
-    bool result = false;
+    u64 tableSize = sizeof(SceneFileSection) * header.sectionCount;
+    if (!IsSceneSectionInFile(file, header.sectionTableOffset, tableSize))
+    {
+        return false;
+    }
 
-    u64 totalSize = 0;
-    u64 offset = 0;
-    char* data = ReadFileToCStr(scratch, path, totalSize);
+    const SceneFileSection* table = reinterpret_cast<const SceneFileSection*>(
+        file.data + header.sectionTableOffset);
+    if (Hash64(table, tableSize) != header.sectionTableChecksum)
+    {
+        return false;
+    }
 
-    const SceneFileHeader* fileHeader =
-        reinterpret_cast<const SceneFileHeader*>(data);
-    offset += sizeof(SceneFileHeader);
+    for (u32 i = 0; i < header.sectionCount; i++)
+    {
+        if (!IsSceneSectionInFile(file, table[i].offset, table[i].size))
+        {
+            return false;
+        }
+    }
+
+    ChecksumSectionsJob job;
+    job.file = &file;
+    job.sections = table;
+    job.checkGeometryAndImageData = checkGeometryAndImageData;
+    ParallelFor(header.sectionCount, ChecksumSectionTask, &job);
+    if (!job.res)
+    {
+        return false;
+    }
+
+    for (u32 i = 0; i < header.sectionCount; i++)
+    {
+        u32 type = static_cast<u32>(table[i].type);
+        if (type < static_cast<u32>(SceneSectionType::Count))
+        {
+            sections.data[type] = file.data + table[i].offset;
+            sections.sizes[type] = table[i].size;
+        }
+    }
 
-    const ImageHeader* imageHeaderStart =
-        reinterpret_cast<const ImageHeader*>(data + offset);
-    offset += sizeof(ImageHeader) * fileHeader->textureCount;
+    return true;
+}
 
-    const SerializedPBRMaterial* pbrMaterialStart =
-        reinterpret_cast<const SerializedPBRMaterial*>(data + offset);
-    offset += sizeof(SerializedPBRMaterial) * fileHeader->materialCount;
+static const u8* GetSceneSection(const SceneFileSections& sections,
+                                 SceneSectionType type, u64 expectedSize,
+                                 bool& valid)
+{
+    u32 index = static_cast<u32>(type);
+    if (sections.sizes[index] != expectedSize)
+    {
+        valid = false;
+    }
+    return sections.data[index];
+}
 
-    const MeshHeader* meshHeaderStart =
-        reinterpret_cast<const MeshHeader*>(data + offset);
-    offset += sizeof(MeshHeader) * fileHeader->meshCount;
+// Sections of a validated scene file, pointing into the mapping
+struct SceneFileView
+{
+    const SceneFileHeader* fileHeader = nullptr;
+    const ImageHeader* imageHeaders = nullptr;
+    const u32* textureFlags = nullptr;
+    const SerializedPBRMaterial* materials = nullptr;
+    const MeshHeader* meshHeaders = nullptr;
+    const SerializedSceneNode* nodes = nullptr;
+    const LOD* lods = nullptr;
+    const i32* submeshMaterialIndices = nullptr;
+    const u8* geometryData = nullptr;
+    const Meshlet* meshlets = nullptr;
+    const u32* meshletVertices = nullptr;
+    const u8* meshletTriangles = nullptr;
+    const u8* imageData = nullptr;
+    const u64* meshChecksums = nullptr;
+    const u64* mipChecksums = nullptr;
+};
+
+static bool IsTextureIndexValid(const SceneFileHeader* fileHeader, i32 index)
+{
+    return index == -1 ||
+           (index >= 0 && static_cast<u32>(index) < fileHeader->textureCount);
+}
 
-    const SerializedSceneNode* sceneNodeStart =
-        reinterpret_cast<const SerializedSceneNode*>(data + offset);
-    offset += sizeof(SerializedSceneNode) * fileHeader->nodeCount;
+static bool IsRangeValid(u64 first, u64 count, u64 total)
+{
+    return first <= total && count <= total - first;
+}
 
-    const LOD* lodStart = reinterpret_cast<const LOD*>(data + offset);
-    offset += sizeof(LOD) * fileHeader->totalLodCount;
+// Vertex, index and meshlet ranges must lie in the scene pools and lod
+// ranges in the ranges of their mesh, raw geometry must fill its byte ranges
+static bool IsMeshHeaderValid(const SceneFileHeader* fileHeader,
+                              const MeshHeader& meshHeader)
+{
+    u64 indexPoolCount = meshHeader.indexSize == sizeof(u16)
+                             ? fileHeader->totalIndex16Count
+                             : fileHeader->totalIndexCount;
+    if ((meshHeader.indexSize != sizeof(u16) &&
+         meshHeader.indexSize != sizeof(u32)) ||
+        meshHeader.lodCount > FLY_MAX_LOD_COUNT ||
+        !IsRangeValid(meshHeader.vertexDataOffset, meshHeader.vertexDataSize,
+                      fileHeader->geometryDataSize) ||
+        !IsRangeValid(meshHeader.indexDataOffset, meshHeader.indexDataSize,
+                      fileHeader->geometryDataSize) ||
+        !IsRangeValid(meshHeader.firstVertex, meshHeader.vertexCount,
+                      fileHeader->totalVertexCount) ||
+        !IsRangeValid(meshHeader.firstIndex, meshHeader.indexCount,
+                      indexPoolCount) ||
+        !IsRangeValid(meshHeader.firstMeshlet, meshHeader.meshletCount,
+                      fileHeader->totalMeshletCount) ||
+        !IsRangeValid(meshHeader.firstMeshletVertex,
+                      meshHeader.meshletVertexCount,
+                      fileHeader->totalMeshletVertexCount) ||
+        !IsRangeValid(meshHeader.firstMeshletTriangle,
+                      meshHeader.meshletTriangleCount,
+                      fileHeader->totalMeshletTriangleCount))
+    {
+        return false;
+    }
 
-    const i32* submeshMaterialIndexStart =
-        reinterpret_cast<i32*>(data + offset);
-    offset += sizeof(i32) * fileHeader->totalSubmeshCount;
+    if (!(fileHeader->flags & FLY_SCENE_FILE_COMPRESSED_GEOMETRY_BIT) &&
+        (meshHeader.vertexDataSize <
+             sizeof(QVertex) * static_cast<u64>(meshHeader.vertexCount) ||
+         meshHeader.indexDataSize <
+             static_cast<u64>(meshHeader.indexSize) * meshHeader.indexCount))
+    {
+        return false;
+    }
 
-    const QVertex* vertexStart =
-        reinterpret_cast<const QVertex*>(data + offset);
-    offset += sizeof(QVertex) * fileHeader->totalVertexCount;
+    return true;
+}
 
-    const u32* indexStart = reinterpret_cast<const u32*>(data + offset);
-    offset += sizeof(u32) * fileHeader->totalIndexCount;
+static bool IsLodValid(const MeshHeader& meshHeader, const LOD& lod)
+{
+    return lod.firstIndex >= meshHeader.firstIndex &&
+           IsRangeValid(lod.firstIndex - meshHeader.firstIndex,
+                        lod.indexCount, meshHeader.indexCount) &&
+           lod.firstMeshlet >= meshHeader.firstMeshlet &&
+           IsRangeValid(lod.firstMeshlet - meshHeader.firstMeshlet,
+                        lod.meshletCount, meshHeader.meshletCount);
+}
 
-    const char* imageDataStart = data + offset;
+// Checks the section sizes against the header counts and the ranges that
+// meshes, lods, images, materials and nodes refer to
+static bool GetSceneFileView(const MappedFile& file,
+                             bool checkGeometryAndImageData,
+                             SceneFileView& view)
+{
+    SceneFileSections sections;
+    if (!ReadSceneSections(file, checkGeometryAndImageData, sections))
+    {
+        return false;
+    }
 
-    if (!ImportTextures(device, fileHeader, imageHeaderStart, imageDataStart,
-                        scene))
+    const SceneFileHeader* fileHeader =
+        reinterpret_cast<const SceneFileHeader*>(file.data);
+    bool valid = true;
+
+    view.fileHeader = fileHeader;
+    view.imageHeaders = reinterpret_cast<const ImageHeader*>(GetSceneSection(
+        sections, SceneSectionType::ImageHeaders,
+        sizeof(ImageHeader) * fileHeader->textureCount, valid));
+    view.textureFlags = reinterpret_cast<const u32*>(
+        GetSceneSection(sections, SceneSectionType::TextureFlags,
+                        sizeof(u32) * fileHeader->textureCount, valid));
+    view.materials =
+        reinterpret_cast<const SerializedPBRMaterial*>(GetSceneSection(
+            sections, SceneSectionType::Materials,
+            sizeof(SerializedPBRMaterial) * fileHeader->materialCount, valid));
+    view.meshHeaders = reinterpret_cast<const MeshHeader*>(
+        GetSceneSection(sections, SceneSectionType::MeshHeaders,
+                        sizeof(MeshHeader) * fileHeader->meshCount, valid));
+    view.nodes = reinterpret_cast<const SerializedSceneNode*>(GetSceneSection(
+        sections, SceneSectionType::Nodes,
+        sizeof(SerializedSceneNode) * fileHeader->nodeCount, valid));
+    view.lods = reinterpret_cast<const LOD*>(
+        GetSceneSection(sections, SceneSectionType::Lods,
+                        sizeof(LOD) * fileHeader->totalLodCount, valid));
+    view.submeshMaterialIndices = reinterpret_cast<const i32*>(
+        GetSceneSection(sections, SceneSectionType::SubmeshMaterialIndices,
+                        sizeof(i32) * fileHeader->totalSubmeshCount, valid));
+    view.geometryData =
+        GetSceneSection(sections, SceneSectionType::GeometryData,
+                        fileHeader->geometryDataSize, valid);
+    view.meshlets = reinterpret_cast<const Meshlet*>(GetSceneSection(
+        sections, SceneSectionType::Meshlets,
+        sizeof(Meshlet) * fileHeader->totalMeshletCount, valid));
+    view.meshletVertices = reinterpret_cast<const u32*>(GetSceneSection(
+        sections, SceneSectionType::MeshletVertices,
+        sizeof(u32) * fileHeader->totalMeshletVertexCount, valid));
+    view.meshletTriangles = GetSceneSection(
+        sections, SceneSectionType::MeshletTriangles,
+        sizeof(u8) * fileHeader->totalMeshletTriangleCount, valid);
+    view.meshChecksums = reinterpret_cast<const u64*>(
+        GetSceneSection(sections, SceneSectionType::MeshChecksums,
+                        sizeof(u64) * fileHeader->meshCount, valid));
+    view.mipChecksums = reinterpret_cast<const u64*>(
+        GetSceneSection(sections, SceneSectionType::MipChecksums,
+                        sizeof(u64) * fileHeader->totalMipCount, valid));
+    u32 imageDataIndex = static_cast<u32>(SceneSectionType::ImageData);
+    view.imageData = sections.data[imageDataIndex];
+    u64 imageDataSize = sections.sizes[imageDataIndex];
+    if (!valid)
     {
-        goto exit;
+        return false;
     }
 
-    if (!ImportBuffers(device, fileHeader, vertexStart, indexStart, scene))
+    // Lods and submeshes of the meshes follow each other in mesh order
+    u64 lodCount = 0;
+    u64 submeshCount = 0;
+    for (u32 i = 0; i < fileHeader->meshCount; i++)
     {
-        goto exit;
+        const MeshHeader& meshHeader = view.meshHeaders[i];
+        if (!IsMeshHeaderValid(fileHeader, meshHeader) ||
+            meshHeader.firstLod != lodCount)
+        {
+            return false;
+        }
+
+        lodCount +=
+            static_cast<u64>(meshHeader.submeshCount) * meshHeader.lodCount;
+        submeshCount += meshHeader.submeshCount;
+        if (lodCount > fileHeader->totalLodCount)
+        {
+            return false;
+        }
+        for (u64 j = meshHeader.firstLod; j < lodCount; j++)
+        {
+            if (!IsLodValid(meshHeader, view.lods[j]))
+            {
+                return false;
+            }
+        }
+    }
+    if (lodCount != fileHeader->totalLodCount ||
+        submeshCount != fileHeader->totalSubmeshCount)
+    {
+        return false;
     }
 
-    if (!ImportMaterials(device, fileHeader, pbrMaterialStart, scene))
+    for (u32 i = 0; i < fileHeader->totalSubmeshCount; i++)
     {
-        goto exit;
+        i32 materialIndex = view.submeshMaterialIndices[i];
+        if (materialIndex != -1 &&
+            (materialIndex < 0 ||
+             static_cast<u32>(materialIndex) >= fileHeader->materialCount))
+        {
+            return false;
+        }
     }
 
-    ImportMeshes(fileHeader, meshHeaderStart, lodStart,
-                 submeshMaterialIndexStart, scene);
-    ImportNodes(fileHeader, sceneNodeStart, scene);
+    // Parents precede their children, which also rules out cycles
+    for (u32 i = 0; i < fileHeader->nodeCount; i++)
+    {
+        const SerializedSceneNode& node = view.nodes[i];
+        if ((node.parentIndex != -1 &&
+             (node.parentIndex < 0 || node.parentIndex >= i)) ||
+            (node.meshIndex != -1 &&
+             (node.meshIndex < 0 || node.meshIndex >= fileHeader->meshCount)))
+        {
+            return false;
+        }
+    }
 
-    result = true;
-exit:
-    ArenaPopToMarker(scratch, marker);
-    return result;
+    u64 mipCount = 0;
+    for (u32 i = 0; i < fileHeader->textureCount; i++)
+    {
+        const ImageHeader& imageHeader = view.imageHeaders[i];
+        mipCount += imageHeader.mipCount;
+        if (imageHeader.offset > imageDataSize ||
+            imageHeader.size > imageDataSize - imageHeader.offset ||
+            imageHeader.mipCount == 0 ||
+            GetImageSize(imageHeader.width, imageHeader.height,
+                         imageHeader.channelCount, imageHeader.layerCount,
+                         imageHeader.mipCount,
+                         imageHeader.storageType) > imageHeader.size)
+        {
+            return false;
+        }
+    }
+    if (mipCount != fileHeader->totalMipCount)
+    {
+        return false;
+    }
+
+    for (u32 i = 0; i < fileHeader->materialCount; i++)
+    {
+        const SerializedPBRMaterial& material = view.materials[i];
+        if (!IsTextureIndexValid(fileHeader, material.baseColorTextureIndex) ||
+            !IsTextureIndexValid(fileHeader, material.normalTextureIndex) ||
+            !IsTextureIndexValid(fileHeader, material.ormTextureIndex))
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
-void DestroyScene(RHI::Device& device, Scene& scene)
+bool ImportScene(String8 path, RHI::Device& device, Scene& scene)
 {
-    if (scene.meshes && scene.meshCount)
+    DestroyScene(device, scene);
+
+    if (!CreateFallbackTextures(device, scene))
     {
-        Free(scene.meshes[0].submeshes);
-        Free(scene.meshes);
-        scene.meshes = nullptr;
-        scene.meshCount = 0;
+        return false;
     }
 
-    if (scene.textures && scene.textureCount)
+    if (!String8::EndsWith(path, FLY_STRING8_LITERAL(".fscene")))
     {
-        for (u32 i = 0; i < scene.textureCount; i++)
-        {
-            RHI::DestroyTexture(device, scene.textures[i]);
-        }
-        Free(scene.textures);
-        scene.textures = nullptr;
-        scene.textureCount = 0;
+        return false;
     }
 
-    if (scene.whiteTexture.image != VK_NULL_HANDLE)
+    // Sections are read and uploaded straight from the mapping
+    MappedFile file;
+    if (!MapFile(path, file))
     {
-        RHI::DestroyTexture(device, scene.whiteTexture);
+        return false;
     }
 
-    if (scene.flatNormalTexture.image != VK_NULL_HANDLE)
+    SceneFileView view;
+    bool result = false;
+    if (!GetSceneFileView(file, true, view))
     {
-        RHI::DestroyTexture(device, scene.flatNormalTexture);
+        goto exit;
     }
 
-    if (scene.nodes && scene.nodeCount)
+    if (!ImportTextures(device, view.fileHeader, view.imageHeaders,
+                        view.textureFlags, view.imageData, scene))
     {
-        Free(scene.nodes);
-        scene.nodes = nullptr;
-        scene.nodeCount = 0;
+        goto exit;
     }
 
-    if (scene.pbrMaterialBuffer.handle != VK_NULL_HANDLE)
+    if (!ImportBuffers(device, view.fileHeader, view.meshHeaders,
+                       view.geometryData, scene))
     {
-        RHI::DestroyBuffer(device, scene.pbrMaterialBuffer);
+        goto exit;
     }
-    if (scene.indexBuffer.handle != VK_NULL_HANDLE)
+
+    if (!ImportMeshletBuffers(device, view.fileHeader, view.meshlets,
+                              view.meshletVertices, view.meshletTriangles,
+                              scene))
     {
-        RHI::DestroyBuffer(device, scene.indexBuffer);
+        goto exit;
     }
-    if (scene.vertexBuffer.handle != VK_NULL_HANDLE)
+
+    if (!ImportMaterials(device, view.fileHeader, view.materials, scene))
     {
-        RHI::DestroyBuffer(device, scene.vertexBuffer);
+        goto exit;
     }
+
+    ImportMeshes(view.fileHeader, view.meshHeaders, view.lods,
+                 view.submeshMaterialIndices, scene);
+    ImportNodes(view.fileHeader, view.nodes, scene);
+
+    result = true;
+exit:
+    UnmapFile(file);
+    return result;
 }
+
+bool ValidateSceneFile(String8 path)
+{
+    MappedFile file;
+    if (!MapFile(path, file))
+    {
+        return false;
+    }
+
+    SceneFileView view;
+    bool result = GetSceneFileView(file, true, view);
+    UnmapFile(file);
+    return result;
+}
+
+static void CreateRangeAllocator(u32 size, u32 maxFreeRangeCount,
+                                 SceneRangeAllocator& allocator)
+{
+    allocator.freeRanges = static_cast<SceneRange*>(
+        Alloc(sizeof(SceneRange) * maxFreeRangeCount));
+    allocator.maxFreeRangeCount = maxFreeRangeCount;
+    allocator.freeRangeCount = 0;
+    allocator.size = size;
+    if (size)
+    {
+        allocator.freeRanges[allocator.freeRangeCount++] = {0, size};
+    }
+}
+
+static void DestroyRangeAllocator(SceneRangeAllocator& allocator)
+{
+    Free(allocator.freeRanges);
+    allocator = {};
+}
+
+static bool AllocateRange(SceneRangeAllocator& allocator, u32 count,
+                          SceneRange& range)
+{
+    range = {0, count};
+    if (!count)
+    {
+        return true;
+    }
+
+    for (u32 i = 0; i < allocator.freeRangeCount; i++)
+    {
+        SceneRange& freeRange = allocator.freeRanges[i];
+        if (freeRange.count < count)
+        {
+            continue;
+        }
+
+        range.offset = freeRange.offset;
+        freeRange.offset += count;
+        freeRange.count -= count;
+        if (!freeRange.count)
+        {
+            memmove(allocator.freeRanges + i, allocator.freeRanges + i + 1,
+                    sizeof(SceneRange) * (allocator.freeRangeCount - i - 1));
+            allocator.freeRangeCount--;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+// Inserts the range in offset order and merges it with its neighbours
+static void FreeRange(SceneRangeAllocator& allocator, SceneRange range)
+{
+    if (!range.count)
+    {
+        return;
+    }
+
+    u32 i = 0;
+    while (i < allocator.freeRangeCount &&
+           allocator.freeRanges[i].offset < range.offset)
+    {
+        i++;
+    }
+
+    SceneRange* prev = i > 0 ? &allocator.freeRanges[i - 1] : nullptr;
+    SceneRange* next =
+        i < allocator.freeRangeCount ? &allocator.freeRanges[i] : nullptr;
+    bool mergePrev = prev && prev->offset + prev->count == range.offset;
+    bool mergeNext = next && range.offset + range.count == next->offset;
+
+    if (mergePrev && mergeNext)
+    {
+        prev->count += range.count + next->count;
+        memmove(allocator.freeRanges + i, allocator.freeRanges + i + 1,
+                sizeof(SceneRange) * (allocator.freeRangeCount - i - 1));
+        allocator.freeRangeCount--;
+    }
+    else if (mergePrev)
+    {
+        prev->count += range.count;
+    }
+    else if (mergeNext)
+    {
+        next->offset = range.offset;
+        next->count += range.count;
+    }
+    else
+    {
+        FLY_ASSERT(allocator.freeRangeCount < allocator.maxFreeRangeCount);
+        memmove(allocator.freeRanges + i + 1, allocator.freeRanges + i,
+                sizeof(SceneRange) * (allocator.freeRangeCount - i));
+        allocator.freeRanges[i] = range;
+        allocator.freeRangeCount++;
+    }
+}
+
+// Pool 0 holds vertices, 1 u32 and 2 u16 indices
+static const u64 sPoolElementSizes[] = {sizeof(QVertex), sizeof(u32),
+                                        sizeof(u16)};
+
+static u8 MeshIndexPool(const MeshHeader& meshHeader)
+{
+    return meshHeader.indexSize == sizeof(u16) ? 2 : 1;
+}
+
+static u64 MeshGeometrySize(const MeshHeader& meshHeader)
+{
+    return sizeof(QVertex) * meshHeader.vertexCount +
+           static_cast<u64>(meshHeader.indexSize) * meshHeader.indexCount;
+}
+
+// Bytes of the mips before firstMip, which is also where firstMip starts
+static u64 GetMipChainOffset(const ImageHeader& imageHeader, u8 firstMip)
+{
+    return GetImageSize(imageHeader.width, imageHeader.height,
+                        imageHeader.channelCount, imageHeader.layerCount,
+                        firstMip, imageHeader.storageType);
+}
+
+static u64 GetMipChainSize(const ImageHeader& imageHeader, u8 firstMip)
+{
+    return GetMipChainOffset(imageHeader, imageHeader.mipCount) -
+           GetMipChainOffset(imageHeader, firstMip);
+}
+
+static void RetireRange(SceneStreamer& streamer, u8 pool, SceneRange range)
+{
+    if (!range.count)
+    {
+        return;
+    }
+
+    FLY_ASSERT(streamer.retiredRangeCount <
+               streamer.fileHeader->meshCount * 2 *
+                   (FLY_FRAME_IN_FLIGHT_COUNT + 1));
+    RetiredSceneRange& retired =
+        streamer.retiredRanges[streamer.retiredRangeCount++];
+    retired.range = range;
+    retired.frame = streamer.frame;
+    retired.pool = pool;
+}
+
+static void EvictMesh(Scene& scene, SceneStreamer& streamer, u32 meshIndex)
+{
+    const MeshHeader& meshHeader = streamer.meshHeaders[meshIndex];
+    StreamedMesh& streamedMesh = streamer.meshes[meshIndex];
+    scene.meshes[meshIndex].resident = false;
+    RetireRange(streamer, 0, streamedMesh.vertices);
+    RetireRange(streamer, MeshIndexPool(meshHeader), streamedMesh.indices);
+    streamedMesh.vertices = {};
+    streamedMesh.indices = {};
+    streamer.residentGeometrySize -= MeshGeometrySize(meshHeader);
+}
+
+static void EvictTexture(Scene& scene, SceneStreamer& streamer,
+                         u32 textureIndex)
+{
+    const ImageHeader& imageHeader = streamer.imageHeaders[textureIndex];
+    StreamedTexture& streamedTexture = streamer.textures[textureIndex];
+
+    FLY_ASSERT(streamer.retiredTextureCount <
+               streamer.fileHeader->textureCount *
+                   (FLY_FRAME_IN_FLIGHT_COUNT + 1));
+    RetiredSceneTexture& retired =
+        streamer.retiredTextures[streamer.retiredTextureCount++];
+    retired.texture = scene.textures[textureIndex];
+    retired.frame = streamer.frame;
+
+    scene.textures[textureIndex] = {};
+    streamer.residentTextureSize -=
+        GetMipChainSize(imageHeader, streamedTexture.residentMip);
+    streamedTexture.residentMip = imageHeader.mipCount;
+}
+
+// Evicts the least recently used resident mesh that was not requested this
+// frame and returns its size, or zero if there is none
+static u64 EvictLeastRecentlyUsedMesh(Scene& scene, SceneStreamer& streamer)
+{
+    u32 meshIndex = FLY_MAX_U32;
+    u64 oldestFrame = streamer.frame;
+    for (u32 i = 0; i < scene.meshCount; i++)
+    {
+        if (scene.meshes[i].resident &&
+            streamer.meshes[i].lastUsedFrame < oldestFrame)
+        {
+            oldestFrame = streamer.meshes[i].lastUsedFrame;
+            meshIndex = i;
+        }
+    }
+
+    if (meshIndex == FLY_MAX_U32)
+    {
+        return 0;
+    }
+    EvictMesh(scene, streamer, meshIndex);
+    return MeshGeometrySize(streamer.meshHeaders[meshIndex]);
+}
+
+static bool EvictLeastRecentlyUsedTexture(Scene& scene,
+                                          SceneStreamer& streamer)
+{
+    u32 textureIndex = FLY_MAX_U32;
+    u64 oldestFrame = streamer.frame;
+    for (u32 i = 0; i < scene.textureCount; i++)
+    {
+        if (scene.textures[i].image != VK_NULL_HANDLE &&
+            streamer.textures[i].lastUsedFrame < oldestFrame)
+        {
+            oldestFrame = streamer.textures[i].lastUsedFrame;
+            textureIndex = i;
+        }
+    }
+
+    if (textureIndex == FLY_MAX_U32)
+    {
+        return false;
+    }
+    EvictTexture(scene, streamer, textureIndex);
+    return true;
+}
+
+// Frees what frames in flight can no longer read, or everything
+static void ReleaseRetiredResources(RHI::Device& device,
+                                    SceneStreamer& streamer, bool all)
+{
+    u32 keptCount = 0;
+    for (u32 i = 0; i < streamer.retiredRangeCount; i++)
+    {
+        RetiredSceneRange& retired = streamer.retiredRanges[i];
+        if (all || retired.frame + FLY_FRAME_IN_FLIGHT_COUNT <= streamer.frame)
+        {
+            FreeRange(streamer.pools[retired.pool], retired.range);
+        }
+        else
+        {
+            streamer.retiredRanges[keptCount++] = retired;
+        }
+    }
+    streamer.retiredRangeCount = keptCount;
+
+    keptCount = 0;
+    for (u32 i = 0; i < streamer.retiredTextureCount; i++)
+    {
+        RetiredSceneTexture& retired = streamer.retiredTextures[i];
+        if (all || retired.frame + FLY_FRAME_IN_FLIGHT_COUNT <= streamer.frame)
+        {
+            RHI::DestroyTexture(device, retired.texture);
+        }
+        else
+        {
+            streamer.retiredTextures[keptCount++] = retired;
+        }
+    }
+    streamer.retiredTextureCount = keptCount;
+}
+
+struct StreamedMeshUpload
+{
+    u32 meshIndex;
+    u64 vertexOffset;
+    u64 indexOffset;
+};
+
+// Geometry data is not checked when a streaming scene is opened, every mesh
+// is checked the first time it is uploaded
+static bool CheckMeshChecksum(const SceneStreamer* streamer, u32 meshIndex)
+{
+    const MeshHeader& meshHeader = streamer->meshHeaders[meshIndex];
+    u64 seed = Hash64(streamer->geometryData + meshHeader.indexDataOffset,
+                      meshHeader.indexDataSize);
+    return Hash64(streamer->geometryData + meshHeader.vertexDataOffset,
+                  meshHeader.vertexDataSize,
+                  seed) == streamer->meshChecksums[meshIndex];
+}
+
+struct DecodeStreamedMeshesJob
+{
+    const SceneStreamer* streamer = nullptr;
+    const StreamedMeshUpload* uploads = nullptr;
+    u8* stagingData = nullptr;
+    std::atomic<bool> res{true};
+};
+
+static void DecodeStreamedMeshTask(u32 index, void* userData)
+{
+    DecodeStreamedMeshesJob& job =
+        *static_cast<DecodeStreamedMeshesJob*>(userData);
+    const StreamedMeshUpload& upload = job.uploads[index];
+    if (!job.streamer->meshes[upload.meshIndex].checked &&
+        !CheckMeshChecksum(job.streamer, upload.meshIndex))
+    {
+        job.res = false;
+        return;
+    }
+    if (!DecodeMeshGeometry(
+            job.streamer->fileHeader,
+            job.streamer->meshHeaders[upload.meshIndex],
+            job.streamer->geometryData,
+            reinterpret_cast<QVertex*>(job.stagingData + upload.vertexOffset),
+            job.stagingData + upload.indexOffset))
+    {
+        job.res = false;
+    }
+}
+
+// Points the mesh and its lods at the pool ranges it was uploaded to
+static void PlaceStreamedMesh(Scene& scene, SceneStreamer& streamer,
+                              u32 meshIndex)
+{
+    const MeshHeader& meshHeader = streamer.meshHeaders[meshIndex];
+    const StreamedMesh& streamedMesh = streamer.meshes[meshIndex];
+    Mesh& mesh = scene.meshes[meshIndex];
+
+    for (u32 i = 0; i < mesh.submeshCount; i++)
+    {
+        const LOD* lods =
+            streamer.lods + meshHeader.firstLod + i * meshHeader.lodCount;
+        for (u32 j = 0; j < meshHeader.lodCount; j++)
+        {
+            mesh.submeshes[i].lods[j].firstIndex = lods[j].firstIndex -
+                                                   meshHeader.firstIndex +
+                                                   streamedMesh.indices.offset;
+        }
+    }
+    mesh.vertexOffset = static_cast<i32>(streamedMesh.vertices.offset);
+    mesh.resident = true;
+    streamer.residentGeometrySize += MeshGeometrySize(meshHeader);
+}
+
+static bool AllocateStreamedMesh(SceneStreamer& streamer, u32 meshIndex)
+{
+    const MeshHeader& meshHeader = streamer.meshHeaders[meshIndex];
+    StreamedMesh& streamedMesh = streamer.meshes[meshIndex];
+    SceneRangeAllocator& indexPool =
+        streamer.pools[MeshIndexPool(meshHeader)];
+
+    if (!AllocateRange(streamer.pools[0], meshHeader.vertexCount,
+                       streamedMesh.vertices))
+    {
+        return false;
+    }
+    if (!AllocateRange(indexPool, meshHeader.indexCount, streamedMesh.indices))
+    {
+        FreeRange(streamer.pools[0], streamedMesh.vertices);
+        streamedMesh.vertices = {};
+        return false;
+    }
+    return true;
+}
+
+// Uploads requested meshes that fit into the pools. When one does not,
+// least recently used meshes are evicted to make room for a later update,
+// their ranges are reused once no frame in flight reads them.
+static bool StreamMeshes(RHI::Device& device, Scene& scene,
+                         SceneStreamer& streamer, u64& uploadSize)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+    StreamedMeshUpload* uploads =
+        FLY_PUSH_ARENA(scratch, StreamedMeshUpload, scene.meshCount);
+    u32 uploadCount = 0;
+    u64 stagingSize = 0;
+
+    for (u32 i = 0; i < scene.meshCount; i++)
+    {
+        if (scene.meshes[i].resident ||
+            streamer.meshes[i].lastUsedFrame != streamer.frame)
+        {
+            continue;
+        }
+
+        const MeshHeader& meshHeader = streamer.meshHeaders[i];
+        // Keeps the vertices of the next mesh in the staging buffer aligned
+        u64 vertexSize = (sizeof(QVertex) * meshHeader.vertexCount + 3) & ~3ull;
+        u64 indexSize =
+            (static_cast<u64>(meshHeader.indexSize) * meshHeader.indexCount +
+             3) &
+            ~3ull;
+        if (uploadSize &&
+            uploadSize + vertexSize + indexSize >
+                streamer.settings.uploadBudget)
+        {
+            break;
+        }
+
+        if (!AllocateStreamedMesh(streamer, i))
+        {
+            // Ranges retired by earlier updates are about to be reusable
+            u64 evictedSize = 0;
+            for (u32 j = 0; j < streamer.retiredRangeCount; j++)
+            {
+                const RetiredSceneRange& retired = streamer.retiredRanges[j];
+                evictedSize +=
+                    sPoolElementSizes[retired.pool] * retired.range.count;
+            }
+            while (evictedSize < MeshGeometrySize(meshHeader))
+            {
+                u64 size = EvictLeastRecentlyUsedMesh(scene, streamer);
+                if (!size)
+                {
+                    break;
+                }
+                evictedSize += size;
+            }
+            continue;
+        }
+
+        StreamedMeshUpload& upload = uploads[uploadCount++];
+        upload.meshIndex = i;
+        upload.vertexOffset = stagingSize;
+        upload.indexOffset = stagingSize + vertexSize;
+        stagingSize += vertexSize + indexSize;
+        uploadSize += vertexSize + indexSize;
+    }
+
+    bool res = true;
+    RHI::Buffer stagingBuffer;
+    if (!uploadCount)
+    {
+        goto exit;
+    }
+
+    if (!RHI::CreateBuffer(device, true, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           nullptr, stagingSize, stagingBuffer))
+    {
+        res = false;
+    }
+    else
+    {
+        DecodeStreamedMeshesJob job;
+        job.streamer = &streamer;
+        job.uploads = uploads;
+        job.stagingData =
+            static_cast<u8*>(RHI::BufferMappedPtr(stagingBuffer));
+        ParallelFor(uploadCount, DecodeStreamedMeshTask, &job);
+        res = job.res;
+    }
+
+    if (!res)
+    {
+        // Nothing was copied yet, the ranges can be reused right away
+        for (u32 i = 0; i < uploadCount; i++)
+        {
+            u32 meshIndex = uploads[i].meshIndex;
+            StreamedMesh& streamedMesh = streamer.meshes[meshIndex];
+            FreeRange(streamer.pools[0], streamedMesh.vertices);
+            FreeRange(
+                streamer.pools[MeshIndexPool(streamer.meshHeaders[meshIndex])],
+                streamedMesh.indices);
+            streamedMesh.vertices = {};
+            streamedMesh.indices = {};
+        }
+        if (stagingBuffer.handle != VK_NULL_HANDLE)
+        {
+            RHI::DestroyBuffer(device, stagingBuffer);
+        }
+        goto exit;
+    }
+
+    RHI::BeginOneTimeSubmit(device);
+    {
+        RHI::CommandBuffer& cmd = RHI::OneTimeSubmitCommandBuffer(device);
+        RHI::Buffer* indexBuffers[] = {nullptr, &scene.indexBuffer,
+                                       &scene.indexBuffer16};
+        for (u32 i = 0; i < uploadCount; i++)
+        {
+            const StreamedMeshUpload& upload = uploads[i];
+            const MeshHeader& meshHeader =
+                streamer.meshHeaders[upload.meshIndex];
+            const StreamedMesh& streamedMesh =
+                streamer.meshes[upload.meshIndex];
+
+            if (meshHeader.vertexCount)
+            {
+                RHI::CopyBufferToBuffer(
+                    cmd, scene.vertexBuffer, stagingBuffer,
+                    sizeof(QVertex) * meshHeader.vertexCount,
+                    upload.vertexOffset,
+                    sizeof(QVertex) * streamedMesh.vertices.offset);
+            }
+            if (meshHeader.indexCount)
+            {
+                RHI::CopyBufferToBuffer(
+                    cmd, *indexBuffers[MeshIndexPool(meshHeader)],
+                    stagingBuffer,
+                    static_cast<u64>(meshHeader.indexSize) *
+                        meshHeader.indexCount,
+                    upload.indexOffset,
+                    static_cast<u64>(meshHeader.indexSize) *
+                        streamedMesh.indices.offset);
+            }
+        }
+    }
+    RHI::EndOneTimeSubmit(device);
+    RHI::DestroyBuffer(device, stagingBuffer);
+
+    for (u32 i = 0; i < uploadCount; i++)
+    {
+        PlaceStreamedMesh(scene, streamer, uploads[i].meshIndex);
+        streamer.meshes[uploads[i].meshIndex].checked = true;
+    }
+
+exit:
+    ArenaPopToMarker(scratch, marker);
+    return res;
+}
+
+// Replaces the texture with one that holds the mips from firstMip on
+static bool LoadTextureMips(RHI::Device& device, Scene& scene,
+                            SceneStreamer& streamer, u32 textureIndex,
+                            u8 firstMip)
+{
+    const ImageHeader& imageHeader = streamer.imageHeaders[textureIndex];
+    StreamedTexture& streamedTexture = streamer.textures[textureIndex];
+    const u8* data = streamer.imageData + imageHeader.offset +
+                     GetMipChainOffset(imageHeader, firstMip);
+
+    // Only mips that were never uploaded before are checked
+    for (u8 mip = firstMip; mip < streamedTexture.checkedMip; mip++)
+    {
+        u64 offset = GetMipChainOffset(imageHeader, mip);
+        u64 size = GetMipChainOffset(imageHeader, static_cast<u8>(mip + 1)) -
+                   offset;
+        if (Hash64(streamer.imageData + imageHeader.offset + offset, size) !=
+            streamer.mipChecksums[streamedTexture.firstMipChecksum + mip])
+        {
+            return false;
+        }
+    }
+    streamedTexture.checkedMip =
+        static_cast<u8>(Math::Min(static_cast<u32>(streamedTexture.checkedMip),
+                                  static_cast<u32>(firstMip)));
+
+    RHI::Texture texture{};
+    if (!RHI::CreateTexture2D(
+            device,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, data,
+            Math::Max(imageHeader.width >> firstMip, 1u),
+            Math::Max(imageHeader.height >> firstMip, 1u),
+            CompressedStorageToVkFormat(imageHeader.storageType,
+                                        streamer.textureFlags[textureIndex]),
+            RHI::Sampler::FilterMode::Anisotropy8x,
+            RHI::Sampler::WrapMode::Repeat, imageHeader.mipCount - firstMip,
+            texture))
+    {
+        return false;
+    }
+
+    if (scene.textures[textureIndex].image != VK_NULL_HANDLE)
+    {
+        EvictTexture(scene, streamer, textureIndex);
+    }
+    scene.textures[textureIndex] = texture;
+    streamedTexture.residentMip = firstMip;
+    streamer.residentTextureSize += GetMipChainSize(imageHeader, firstMip);
+    return true;
+}
+
+// Requested textures that are not resident get their mip tail first. Finer
+// mips are loaded once every requested texture has something to sample.
+static bool StreamTextures(RHI::Device& device, Scene& scene,
+                           SceneStreamer& streamer, u64& uploadSize,
+                           bool& texturesChanged)
+{
+    bool pendingTails = false;
+    for (u32 pass = 0; pass < 2 && !pendingTails; pass++)
+    {
+        for (u32 i = 0; i < scene.textureCount; i++)
+        {
+            const ImageHeader& imageHeader = streamer.imageHeaders[i];
+            StreamedTexture& streamedTexture = streamer.textures[i];
+            bool resident = streamedTexture.residentMip < imageHeader.mipCount;
+            if (streamedTexture.lastUsedFrame != streamer.frame ||
+                resident != (pass == 1))
+            {
+                continue;
+            }
+            pendingTails |= pass == 0;
+
+            u8 firstMip = static_cast<u8>(
+                Math::Min(static_cast<u32>(streamedTexture.requestedMip),
+                          static_cast<u32>(imageHeader.mipCount - 1)));
+            if (pass == 0)
+            {
+                firstMip = static_cast<u8>(
+                    Math::Max(static_cast<u32>(firstMip),
+                              static_cast<u32>(streamedTexture.tailMip)));
+            }
+            if (firstMip >= streamedTexture.residentMip)
+            {
+                continue;
+            }
+
+            u64 size = GetMipChainSize(imageHeader, firstMip);
+            if (uploadSize &&
+                uploadSize + size > streamer.settings.uploadBudget)
+            {
+                return true;
+            }
+
+            u64 residentSize =
+                resident ? GetMipChainSize(imageHeader,
+                                           streamedTexture.residentMip)
+                         : 0;
+            while (streamer.residentTextureSize - residentSize + size >
+                       streamer.settings.textureBudget &&
+                   EvictLeastRecentlyUsedTexture(scene, streamer))
+            {
+                texturesChanged = true;
+            }
+            if (streamer.residentTextureSize - residentSize + size >
+                streamer.settings.textureBudget)
+            {
+                continue;
+            }
+
+            if (!LoadTextureMips(device, scene, streamer, i, firstMip))
+            {
+                return false;
+            }
+            uploadSize += size;
+            texturesChanged = true;
+        }
+    }
+
+    return true;
+}
+
+static bool UpdateStreamedMaterials(RHI::Device& device, Scene& scene,
+                                    const SceneStreamer& streamer)
+{
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+    PBRMaterial* pbrMaterials =
+        FLY_PUSH_ARENA(arena, PBRMaterial, scene.materialCount);
+    FillPBRMaterials(streamer.fileHeader, streamer.materials, scene,
+                     pbrMaterials);
+
+    bool res = RHI::CopyDataToBuffer(device, pbrMaterials,
+                                     sizeof(PBRMaterial) * scene.materialCount,
+                                     0, scene.pbrMaterialBuffer);
+    ArenaPopToMarker(arena, marker);
+    return res;
+}
+
+// Pools share the geometry budget in proportion to the scene totals, but
+// always fit the largest mesh
+static bool CreateStreamingPools(RHI::Device& device, Scene& scene,
+                                 SceneStreamer& streamer)
+{
+    const SceneFileHeader* fileHeader = streamer.fileHeader;
+    const u64 totalCounts[3] = {fileHeader->totalVertexCount,
+                                fileHeader->totalIndexCount,
+                                fileHeader->totalIndex16Count};
+    u64 largestCounts[3] = {};
+    for (u32 i = 0; i < fileHeader->meshCount; i++)
+    {
+        const MeshHeader& meshHeader = streamer.meshHeaders[i];
+        u8 indexPool = MeshIndexPool(meshHeader);
+        if (meshHeader.vertexCount > largestCounts[0])
+        {
+            largestCounts[0] = meshHeader.vertexCount;
+        }
+        if (meshHeader.indexCount > largestCounts[indexPool])
+        {
+            largestCounts[indexPool] = meshHeader.indexCount;
+        }
+    }
+
+    u64 totalSize = 0;
+    for (u32 i = 0; i < 3; i++)
+    {
+        totalSize += sPoolElementSizes[i] * totalCounts[i];
+    }
+    f64 scale = 1.0;
+    if (totalSize > streamer.settings.geometryBudget)
+    {
+        scale = static_cast<f64>(streamer.settings.geometryBudget) / totalSize;
+    }
+
+    RHI::Buffer* buffers[3] = {&scene.vertexBuffer, &scene.indexBuffer,
+                               &scene.indexBuffer16};
+    const VkBufferUsageFlags usages[3] = {VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT};
+    for (u32 i = 0; i < 3; i++)
+    {
+        u64 count = static_cast<u64>(totalCounts[i] * scale);
+        if (count < largestCounts[i])
+        {
+            count = largestCounts[i];
+        }
+
+        CreateRangeAllocator(static_cast<u32>(count),
+                             fileHeader->meshCount + 1, streamer.pools[i]);
+        if (count &&
+            !RHI::CreateBuffer(device, false,
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT | usages[i],
+                               nullptr, sPoolElementSizes[i] * count,
+                               *buffers[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool OpenStreamingScene(String8 path, RHI::Device& device,
+                        const SceneStreamingSettings& settings, Scene& scene,
+                        SceneStreamer& streamer)
+{
+    FLY_ASSERT(!streamer.file.data);
+    DestroyScene(device, scene);
+
+    if (!CreateFallbackTextures(device, scene))
+    {
+        return false;
+    }
+
+    if (!String8::EndsWith(path, FLY_STRING8_LITERAL(".fscene")))
+    {
+        return false;
+    }
+
+    if (!MapFile(path, streamer.file))
+    {
+        return false;
+    }
+
+    SceneFileView view;
+    if (!GetSceneFileView(streamer.file, false, view))
+    {
+        UnmapFile(streamer.file);
+        return false;
+    }
+
+    const SceneFileHeader* fileHeader = view.fileHeader;
+    streamer.settings = settings;
+    streamer.fileHeader = fileHeader;
+    streamer.imageHeaders = view.imageHeaders;
+    streamer.textureFlags = view.textureFlags;
+    streamer.materials = view.materials;
+    streamer.meshHeaders = view.meshHeaders;
+    streamer.lods = view.lods;
+    streamer.geometryData = view.geometryData;
+    streamer.imageData = view.imageData;
+    streamer.meshChecksums = view.meshChecksums;
+    streamer.mipChecksums = view.mipChecksums;
+
+    streamer.meshes = static_cast<StreamedMesh*>(
+        Alloc(sizeof(StreamedMesh) * fileHeader->meshCount));
+    streamer.retiredRanges = static_cast<RetiredSceneRange*>(
+        Alloc(sizeof(RetiredSceneRange) * fileHeader->meshCount * 2 *
+              (FLY_FRAME_IN_FLIGHT_COUNT + 1)));
+    for (u32 i = 0; i < fileHeader->meshCount; i++)
+    {
+        streamer.meshes[i] = {};
+    }
+
+    streamer.textures = static_cast<StreamedTexture*>(
+        Alloc(sizeof(StreamedTexture) * fileHeader->textureCount));
+    streamer.retiredTextures = static_cast<RetiredSceneTexture*>(
+        Alloc(sizeof(RetiredSceneTexture) * fileHeader->textureCount *
+              (FLY_FRAME_IN_FLIGHT_COUNT + 1)));
+    if (fileHeader->textureCount)
+    {
+        scene.textureCount = fileHeader->textureCount;
+        scene.textures = static_cast<RHI::Texture*>(
+            Alloc(sizeof(RHI::Texture) * scene.textureCount));
+    }
+    u32 firstMipChecksum = 0;
+    for (u32 i = 0; i < fileHeader->textureCount; i++)
+    {
+        const ImageHeader& imageHeader = view.imageHeaders[i];
+        StreamedTexture& streamedTexture = streamer.textures[i];
+        streamedTexture = {};
+        streamedTexture.residentMip = imageHeader.mipCount;
+        streamedTexture.checkedMip = imageHeader.mipCount;
+        streamedTexture.firstMipChecksum = firstMipChecksum;
+        firstMipChecksum += imageHeader.mipCount;
+        while (streamedTexture.tailMip + 1 < imageHeader.mipCount &&
+               Math::Max(imageHeader.width, imageHeader.height) >>
+                       streamedTexture.tailMip >
+                   settings.mipTailSize)
+        {
+            streamedTexture.tailMip++;
+        }
+        scene.textures[i] = {};
+    }
+
+    if (!CreateStreamingPools(device, scene, streamer) ||
+        !ImportMeshletBuffers(device, fileHeader, view.meshlets,
+                              view.meshletVertices, view.meshletTriangles,
+                              scene) ||
+        !ImportMaterials(device, fileHeader, view.materials, scene))
+    {
+        CloseStreamingScene(device, scene, streamer);
+        return false;
+    }
+
+    ImportMeshes(fileHeader, view.meshHeaders, view.lods,
+                 view.submeshMaterialIndices, scene);
+    ImportNodes(fileHeader, view.nodes, scene);
+    for (u32 i = 0; i < scene.meshCount; i++)
+    {
+        scene.meshes[i].resident = false;
+    }
+
+    return true;
+}
+
+void CloseStreamingScene(RHI::Device& device, Scene& scene,
+                         SceneStreamer& streamer)
+{
+    ReleaseRetiredResources(device, streamer, true);
+    for (u32 i = 0; i < STACK_ARRAY_COUNT(streamer.pools); i++)
+    {
+        DestroyRangeAllocator(streamer.pools[i]);
+    }
+    Free(streamer.meshes);
+    Free(streamer.textures);
+    Free(streamer.retiredRanges);
+    Free(streamer.retiredTextures);
+
+    DestroyScene(device, scene);
+    UnmapFile(streamer.file);
+    streamer = {};
+}
+
+void RequestSceneMesh(SceneStreamer& streamer, u32 meshIndex)
+{
+    FLY_ASSERT(meshIndex < streamer.fileHeader->meshCount);
+    streamer.meshes[meshIndex].lastUsedFrame = streamer.frame;
+}
+
+void RequestSceneTexture(SceneStreamer& streamer, u32 textureIndex, u8 mip)
+{
+    FLY_ASSERT(textureIndex < streamer.fileHeader->textureCount);
+    StreamedTexture& streamedTexture = streamer.textures[textureIndex];
+    if (streamedTexture.lastUsedFrame != streamer.frame ||
+        mip < streamedTexture.requestedMip)
+    {
+        streamedTexture.requestedMip = mip;
+    }
+    streamedTexture.lastUsedFrame = streamer.frame;
+}
+
+void RequestSceneMaterial(SceneStreamer& streamer, u32 materialIndex, u8 mip)
+{
+    FLY_ASSERT(materialIndex <= streamer.fileHeader->materialCount);
+    // Material 0 is the default one without textures
+    if (materialIndex == 0)
+    {
+        return;
+    }
+
+    const SerializedPBRMaterial& material =
+        streamer.materials[materialIndex - 1];
+    if (material.baseColorTextureIndex != -1)
+    {
+        RequestSceneTexture(streamer, material.baseColorTextureIndex, mip);
+    }
+    if (material.normalTextureIndex != -1)
+    {
+        RequestSceneTexture(streamer, material.normalTextureIndex, mip);
+    }
+    if (material.ormTextureIndex != -1)
+    {
+        RequestSceneTexture(streamer, material.ormTextureIndex, mip);
+    }
+}
+
+bool UpdateSceneStreaming(RHI::Device& device, Scene& scene,
+                          SceneStreamer& streamer)
+{
+    ReleaseRetiredResources(device, streamer, false);
+
+    u64 uploadSize = 0;
+    bool texturesChanged = false;
+    bool res = StreamMeshes(device, scene, streamer, uploadSize);
+    res = StreamTextures(device, scene, streamer, uploadSize,
+                         texturesChanged) &&
+          res;
+    if (texturesChanged)
+    {
+        res = UpdateStreamedMaterials(device, scene, streamer) && res;
+    }
+
+    streamer.frame++;
+    return res;
+}
+
+void DestroyScene(RHI::Device& device, Scene& scene)
+{
+    if (scene.meshes && scene.meshCount)
+    {
+        Free(scene.meshes[0].submeshes);
+        Free(scene.meshes);
+        scene.meshes = nullptr;
+        scene.meshCount = 0;
+    }
+
+    if (scene.textures && scene.textureCount)
+    {
+        for (u32 i = 0; i < scene.textureCount; i++)
+        {
+            if (scene.textures[i].image != VK_NULL_HANDLE)
+            {
+                RHI::DestroyTexture(device, scene.textures[i]);
+            }
+        }
+        Free(scene.textures);
+        scene.textures = nullptr;
+        scene.textureCount = 0;
+    }
+
+    if (scene.whiteTexture.image != VK_NULL_HANDLE)
+    {
+        RHI::DestroyTexture(device, scene.whiteTexture);
+    }
+
+    if (scene.flatNormalTexture.image != VK_NULL_HANDLE)
+    {
+        RHI::DestroyTexture(device, scene.flatNormalTexture);
+    }
+
+    if (scene.nodes && scene.nodeCount)
+    {
+        Free(scene.nodes);
+        scene.nodes = nullptr;
+        scene.nodeCount = 0;
+    }
+
+    if (scene.pbrMaterialBuffer.handle != VK_NULL_HANDLE)
+    {
+        RHI::DestroyBuffer(device, scene.pbrMaterialBuffer);
+    }
+    if (scene.indexBuffer.handle != VK_NULL_HANDLE)
+    {
+        RHI::DestroyBuffer(device, scene.indexBuffer);
+    }
+    if (scene.indexBuffer16.handle != VK_NULL_HANDLE)
+    {
+        RHI::DestroyBuffer(device, scene.indexBuffer16);
+    }
+    if (scene.vertexBuffer.handle != VK_NULL_HANDLE)
+    {
+        RHI::DestroyBuffer(device, scene.vertexBuffer);
+    }
+    if (scene.meshletBuffer.handle != VK_NULL_HANDLE)
+    {
+        RHI::DestroyBuffer(device, scene.meshletBuffer);
+    }
+    if (scene.meshletVertexBuffer.handle != VK_NULL_HANDLE)
+    {
+        RHI::DestroyBuffer(device, scene.meshletVertexBuffer);
+    }
+    if (scene.meshletTriangleBuffer.handle != VK_NULL_HANDLE)
+    {
+        RHI::DestroyBuffer(device, scene.meshletTriangleBuffer);
+    }
+}
+
+void BindMeshIndexBuffer(RHI::CommandBuffer& cmd, Scene& scene,
+                         const Mesh& mesh)
+{
+    if (mesh.indexType == VK_INDEX_TYPE_UINT16)
+    {
+        RHI::BindIndexBuffer(cmd, scene.indexBuffer16, VK_INDEX_TYPE_UINT16);
+    }
+    else
+    {
+        RHI::BindIndexBuffer(cmd, scene.indexBuffer, VK_INDEX_TYPE_UINT32);
+    }
+}
+
+u8 SelectSubmeshLod(const Mesh& mesh, u32 submeshIndex, f32 distance,
+                    f32 pixelsPerUnit, f32 maxPixelError)
+{
+    FLY_ASSERT(submeshIndex < mesh.submeshCount);
+    const Submesh& submesh = mesh.submeshes[submeshIndex];
+
+    f32 maxError = maxPixelError * Math::Max(distance, 1e-6f) / pixelsPerUnit;
+    for (u8 i = mesh.lodCount; i > 1; i--)
+    {
+        if (submesh.lods[i - 1].error <= maxError)
+        {
+            return i - 1;
+        }
+    }
+    return 0;
+}
+
+Math::Sphere GetWorldBoundingSphere(const SceneNode& node)
+{
+    FLY_ASSERT(node.mesh);
+    return Math::TransformSphere(
+        Math::Sphere(node.mesh->sphereCenter, node.mesh->sphereRadius),
+        node.transform.GetWorldMatrix());
+}
+
+u32 CullSceneNodes(const Scene& scene, const Math::Frustum& frustum,
+                   u8* visible)
+{
+    FLY_ASSERT(visible || scene.nodeCount == 0);
+
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    f32* centerX = FLY_PUSH_ARENA(scratch, f32, scene.nodeCount);
+    f32* centerY = FLY_PUSH_ARENA(scratch, f32, scene.nodeCount);
+    f32* centerZ = FLY_PUSH_ARENA(scratch, f32, scene.nodeCount);
+    f32* radius = FLY_PUSH_ARENA(scratch, f32, scene.nodeCount);
+
+    for (u32 i = 0; i < scene.nodeCount; i++)
+    {
+        const SceneNode& node = scene.nodes[i];
+        if (!node.mesh)
+        {
+            // Nodes without geometry never pass the plane tests
+            centerX[i] = centerY[i] = centerZ[i] = 0.0f;
+            radius[i] = -MaxF32();
+            continue;
+        }
+
+        Math::Sphere sphere = GetWorldBoundingSphere(node);
+        centerX[i] = sphere.center.x;
+        centerY[i] = sphere.center.y;
+        centerZ[i] = sphere.center.z;
+        radius[i] = sphere.radius;
+    }
+
+    u32 visibleCount = Math::CullSpheres(frustum, centerX, centerY, centerZ,
+                                         radius, scene.nodeCount, visible);
+
+    ArenaPopToMarker(scratch, marker);
+    return visibleCount;
+}
+
 } // namespace Fly
@@ -1,19 +1,29 @@
 #ifndef FLY_ASSETS_SCENE_SCENE_H
 #define FLY_ASSETS_SCENE_SCENE_H
 
+#include "core/filesystem.h"
 #include "core/types.h"
 #include "core/string8.h"
 
+#include "math/frustum.h"
 #include "math/transform.h"
 
 #include "rhi/buffer.h"
 #include "rhi/texture.h"
 
+#include "assets/image/image.h"
 #include "assets/scene/scene_common.h"
 
 namespace Fly
 {
 
+namespace RHI
+{
+
+struct CommandBuffer;
+
+} // namespace RHI
+
 struct Submesh
 {
     LOD lods[FLY_MAX_LOD_COUNT];
@@ -29,7 +39,12 @@ struct Mesh
     u32 indexCount;
     f32 sphereRadius;
     i32 vertexOffset;
+    // Selects the scene index buffer that lod firstIndex points into
+    VkIndexType indexType;
     u8 lodCount;
+    // False while a streamed mesh has no vertices and indices in the scene
+    // buffers, see SceneStreamer
+    bool resident;
 };
 
 struct SceneNode
@@ -51,6 +66,12 @@ struct Scene
 {
     RHI::Buffer vertexBuffer{};
     RHI::Buffer indexBuffer{};
+    // Indices of meshes with few enough vertices for u16 indices
+    RHI::Buffer indexBuffer16{};
+    // Storage buffers with the meshlets of every lod, see Meshlet
+    RHI::Buffer meshletBuffer{};
+    RHI::Buffer meshletVertexBuffer{};
+    RHI::Buffer meshletTriangleBuffer{};
     RHI::Buffer pbrMaterialBuffer{};
     RHI::Texture whiteTexture{};
     RHI::Texture flatNormalTexture{};
@@ -63,8 +84,144 @@ struct Scene
     u32 materialCount = 0;
 };
 
+struct SceneStreamingSettings
+{
+    // Device memory of the vertex and index pools of resident meshes
+    u64 geometryBudget = 256ull * 1024 * 1024;
+    // Device memory of resident texture mips
+    u64 textureBudget = 512ull * 1024 * 1024;
+    // Bytes uploaded by one UpdateSceneStreaming call, a single mesh or
+    // texture larger than that is still uploaded on its own
+    u64 uploadBudget = 16ull * 1024 * 1024;
+    // Textures first become resident with the mips no larger than this
+    u32 mipTailSize = 64;
+};
+
+// Range of vertices or indices in one of the streaming pools
+struct SceneRange
+{
+    u32 offset = 0;
+    u32 count = 0;
+};
+
+// First fit allocator over a pool buffer, free ranges sorted by offset
+struct SceneRangeAllocator
+{
+    SceneRange* freeRanges = nullptr;
+    u32 freeRangeCount = 0;
+    u32 maxFreeRangeCount = 0;
+    u32 size = 0;
+};
+
+struct StreamedMesh
+{
+    u64 lastUsedFrame = 0;
+    SceneRange vertices;
+    SceneRange indices;
+    // The geometry data matched its checksum on an earlier upload
+    bool checked = false;
+};
+
+struct StreamedTexture
+{
+    u64 lastUsedFrame = 0;
+    // Finest mip the texture was requested with in lastUsedFrame
+    u8 requestedMip = 0;
+    // Finest resident mip, mipCount when the texture is not resident
+    u8 residentMip = 0;
+    // Finest mip of the tail that is loaded first
+    u8 tailMip = 0;
+    // Finest mip whose data matched its checksum
+    u8 checkedMip = 0;
+    // Index of the checksum of mip 0 in SceneStreamer::mipChecksums
+    u32 firstMipChecksum = 0;
+};
+
+// Resources that frames in flight may still read, released
+// FLY_FRAME_IN_FLIGHT_COUNT updates after they were evicted
+struct RetiredSceneTexture
+{
+    RHI::Texture texture;
+    u64 frame = 0;
+};
+
+struct RetiredSceneRange
+{
+    SceneRange range;
+    u64 frame = 0;
+    u8 pool = 0;
+};
+
+// Keeps the scene file mapped and loads meshes and texture mips on demand
+// within the budgets, least recently used ones are evicted first
+struct SceneStreamer
+{
+    SceneStreamingSettings settings;
+    MappedFile file;
+    const SceneFileHeader* fileHeader = nullptr;
+    const ImageHeader* imageHeaders = nullptr;
+    const u32* textureFlags = nullptr;
+    const SerializedPBRMaterial* materials = nullptr;
+    const MeshHeader* meshHeaders = nullptr;
+    const LOD* lods = nullptr;
+    const u8* geometryData = nullptr;
+    const u8* imageData = nullptr;
+    const u64* meshChecksums = nullptr;
+    const u64* mipChecksums = nullptr;
+    StreamedMesh* meshes = nullptr;
+    StreamedTexture* textures = nullptr;
+    // Vertex, u32 and u16 index pools
+    SceneRangeAllocator pools[3];
+    RetiredSceneTexture* retiredTextures = nullptr;
+    RetiredSceneRange* retiredRanges = nullptr;
+    u32 retiredTextureCount = 0;
+    u32 retiredRangeCount = 0;
+    u64 frame = 1;
+    u64 residentGeometrySize = 0;
+    u64 residentTextureSize = 0;
+};
+
 bool ImportScene(String8 path, RHI::Device& device, Scene& scene);
+// Runs the header, checksum and range checks of ImportScene without a device
+bool ValidateSceneFile(String8 path);
+// Loads nodes, meshes, materials and meshlets, vertices, indices and
+// textures are loaded by UpdateSceneStreaming. The scene vertex and index
+// buffers are pools sized by the geometry budget.
+bool OpenStreamingScene(String8 path, RHI::Device& device,
+                        const SceneStreamingSettings& settings, Scene& scene,
+                        SceneStreamer& streamer);
+// Expects the device to be idle, like DestroyScene
+void CloseStreamingScene(RHI::Device& device, Scene& scene,
+                         SceneStreamer& streamer);
+// Requests are kept for the next UpdateSceneStreaming call only
+void RequestSceneMesh(SceneStreamer& streamer, u32 meshIndex);
+// mip is the finest mip that should become resident
+void RequestSceneTexture(SceneStreamer& streamer, u32 textureIndex, u8 mip);
+// Requests the textures of a scene material, see Submesh::materialIndex
+void RequestSceneMaterial(SceneStreamer& streamer, u32 materialIndex, u8 mip);
+// Called once per frame before recording. Evicts what was not requested
+// when a budget is exceeded, then uploads requested meshes and textures,
+// coarse mip tails before finer mips.
+bool UpdateSceneStreaming(RHI::Device& device, Scene& scene,
+                          SceneStreamer& streamer);
 void DestroyScene(RHI::Device& device, Scene& scene);
+// Binds indexBuffer or indexBuffer16 depending on the mesh index type
+void BindMeshIndexBuffer(RHI::CommandBuffer& cmd, Scene& scene,
+                         const Mesh& mesh);
+
+// Coarsest lod of the submesh whose simplification error projects to at most
+// maxPixelError pixels. distance is in mesh units, pixelsPerUnit is the
+// viewport height divided by 2 * tan(fovY / 2).
+u8 SelectSubmeshLod(const Mesh& mesh, u32 submeshIndex, f32 distance,
+                    f32 pixelsPerUnit, f32 maxPixelError);
+
+// World space bounds of the node mesh, expects node.mesh to be set
+Math::Sphere GetWorldBoundingSphere(const SceneNode& node);
+
+// CPU frustum test of every scene node against its mesh bounding sphere.
+// visible must hold scene.nodeCount entries, nodes without a mesh are culled.
+u32 CullSceneNodes(const Scene& scene, const Math::Frustum& frustum,
+                   u8* visible);
 
 } // namespace Fly
 
@@ -2,6 +2,15 @@
 #define FLY_ASSETS_SCENE_SCENE_COMMON_H
 
 #define FLY_MAX_LOD_COUNT 8u
+#define FLY_MESHLET_MAX_VERTEX_COUNT 64u
+#define FLY_MESHLET_MAX_TRIANGLE_COUNT 124u
+
+// "FSCN"
+#define FLY_SCENE_FILE_MAGIC 0x4e435346u
+#define FLY_SCENE_FILE_VERSION_MAJOR 4u
+#define FLY_SCENE_FILE_VERSION_MINOR 0u
+// File offset alignment of the section table and of every section
+#define FLY_SCENE_SECTION_ALIGNMENT 64u
 
 #include "math/quat.h"
 #include "math/vec.h"
@@ -18,6 +27,21 @@ enum VertexFlags
     FLY_VERTEX_TEXCOORD_BIT = 1 << 3
 };
 
+enum SceneFileFlags
+{
+    FLY_SCENE_FILE_NONE_BIT = 0,
+    // Vertices and indices of every mesh are encoded with the meshoptimizer
+    // vertex and index codecs
+    FLY_SCENE_FILE_COMPRESSED_GEOMETRY_BIT = 1 << 0
+};
+
+enum SceneTextureFlags
+{
+    FLY_SCENE_TEXTURE_NONE_BIT = 0,
+    // Texels are not srgb encoded, like normals and packed ORM textures
+    FLY_SCENE_TEXTURE_LINEAR_BIT = 1 << 0
+};
+
 struct Vertex
 {
     Math::Vec3 position;
@@ -42,19 +66,56 @@ struct LOD
 {
     u32 firstIndex = 0;
     u32 indexCount = 0;
+    u32 firstMeshlet = 0;
+    u32 meshletCount = 0;
+    // Simplification error against lod 0 in mesh units, zero for lod 0
+    f32 error = 0.0f;
+};
+
+// Cluster of up to FLY_MESHLET_MAX_TRIANGLE_COUNT triangles of one lod.
+// Meshlet vertices are indices into the mesh vertices, same as the index
+// buffer, triangles are u8 triples indexing the meshlet vertices. The cluster
+// faces away from a viewer at position p when
+// dot(normalize(coneApex - p), coneAxis) >= coneCutoff.
+struct Meshlet
+{
+    Math::Vec3 sphereCenter;
+    f32 sphereRadius;
+    Math::Vec3 coneApex;
+    u32 vertexOffset;
+    Math::Vec3 coneAxis;
+    f32 coneCutoff;
+    u32 triangleOffset;
+    u32 vertexCount;
+    u32 triangleCount;
+    u32 pad = 0;
 };
 
 struct MeshHeader
 {
     Math::Vec3 sphereCenter;
     u64 firstLod;
+    // Byte ranges of the mesh vertices and indices in the geometry data
+    u64 vertexDataOffset;
+    u64 vertexDataSize;
+    u64 indexDataOffset;
+    u64 indexDataSize;
     u32 submeshCount;
     u32 vertexCount;
     u32 firstVertex;
     u32 indexCount;
+    // Offset into the index pool of indexSize wide indices, lods of the mesh
+    // index the same pool
     u32 firstIndex;
+    u32 meshletCount;
+    u32 firstMeshlet;
+    u32 meshletVertexCount;
+    u32 firstMeshletVertex;
+    u32 meshletTriangleCount;
+    u32 firstMeshletTriangle;
     f32 sphereRadius;
     u8 lodCount;
+    u8 indexSize;
 };
 
 struct SerializedSceneNode
@@ -73,25 +134,80 @@ struct SerializedPBRMaterial
     i32 normalTextureIndex = -1;
     f32 roughness = 0.5f;
     f32 metallic = 0.0f;
-    // i32 ormTextureIndex = -1;
+    // Occlusion in red, roughness in green and metallic in blue, roughness
+    // and metallic are multiplied by the factors above
+    i32 ormTextureIndex = -1;
+};
+
+enum class SceneSectionType : u32
+{
+    ImageHeaders,
+    Materials,
+    MeshHeaders,
+    Nodes,
+    Lods,
+    SubmeshMaterialIndices,
+    // Vertices and indices, see FLY_SCENE_FILE_COMPRESSED_GEOMETRY_BIT
+    GeometryData,
+    Meshlets,
+    MeshletVertices,
+    MeshletTriangles,
+    ImageData,
+    // SceneTextureFlags of every texture
+    TextureFlags,
+    // Hash64 of the vertex data of every mesh seeded with the Hash64 of its
+    // index data
+    MeshChecksums,
+    // Hash64 of every mip of every image, images in order, finest mip first
+    MipChecksums,
+    Count
+};
+
+// Byte range of a section in the file and the Hash64 of those bytes, 0 for
+// empty sections.
+// Streaming readers skip the checksums of GeometryData and ImageData and
+// check MeshChecksums and MipChecksums when they first read a range.
+struct SceneFileSection
+{
+    u64 offset = 0;
+    u64 size = 0;
+    u64 checksum = 0;
+    SceneSectionType type = SceneSectionType::Count;
+    u32 pad = 0;
 };
 
+// Followed by sectionCount SceneFileSection entries at sectionTableOffset.
+// Readers skip section types they do not know.
 struct SceneFileHeader
 {
+    u32 magic = FLY_SCENE_FILE_MAGIC;
     struct
     {
         u32 major;
         u32 minor;
         u32 patch;
     } version;
+    u64 sectionTableOffset = 0;
+    u64 sectionTableChecksum = 0;
+    u32 sectionCount = 0;
     u64 totalVertexCount = 0;
+    // Sizes of the u32 and the u16 index pools
     u64 totalIndexCount = 0;
+    u64 totalIndex16Count = 0;
+    u64 geometryDataSize = 0;
+    u32 flags = FLY_SCENE_FILE_NONE_BIT;
     u32 totalSubmeshCount = 0;
     u32 totalLodCount = 0;
+    u32 totalMeshletCount = 0;
+    u32 totalMeshletVertexCount = 0;
+    // Number of u8 meshlet triangle indices, three per triangle
+    u32 totalMeshletTriangleCount = 0;
     u32 textureCount = 0;
     u32 meshCount = 0;
     u32 materialCount = 0;
     u32 nodeCount = 0;
+    // Sum of the mip counts of all images
+    u32 totalMipCount = 0;
 };
 
 } // namespace Fly
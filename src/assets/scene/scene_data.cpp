@@ -1,13 +1,17 @@
 #include <cgltf.h>
-#include <fast_obj.h>
 
 #include "core/assert.h"
 #include "core/filesystem.h"
+#include "core/hash.h"
+#include "core/hash_trie.h"
+#include "core/job_system.h"
 #include "core/memory.h"
 #include "core/thread_context.h"
 
 #include "math/mat.h"
 
+#include "assets/cook_cache.h"
+#include "assets/image/export_image.h"
 #include "assets/image/image.h"
 #include "assets/image/import_image.h"
 #include "assets/image/transform_image.h"
@@ -16,7 +20,12 @@
 #include "scene_common.h"
 #include "scene_data.h"
 
+#include <meshoptimizer.h>
+
+#include <atomic>
+
 #include <limits.h>
+#include <stdio.h>
 #include <unistd.h>
 
 namespace Fly
@@ -110,115 +119,580 @@ private:
     T* data;
 };
 
-static bool CookImagesGltf(String8 path, const cgltf_data* data,
-                           const SceneExportOptions& options,
-                           SceneData& sceneData)
+static String8 GetRelativePath(Arena& arena, String8 path, const char* uri)
+{
+    String8 dirPath = ParentDirectory(path);
+    String8 uriPath = String8(uri, strlen(uri));
+
+    u64 bufferSize = dirPath.Size() + uriPath.Size() + 1;
+    char* buffer = FLY_PUSH_ARENA(arena, char, bufferSize);
+    MemZero(buffer, bufferSize);
+    memcpy(buffer, dirPath.Data(), dirPath.Size());
+    memcpy(buffer + dirPath.Size(), uriPath.Data(), uriPath.Size());
+
+    return String8(buffer, bufferSize - 1);
+}
+
+static String8 GetCookedImageExtension(ImageStorageType storageType)
 {
-    if (data->textures_count == 0 || !options.exportMaterials)
+    switch (storageType)
     {
-        return true;
+        case ImageStorageType::BC1:
+        {
+            return FLY_STRING8_LITERAL(".fbc1");
+        }
+        case ImageStorageType::BC3:
+        {
+            return FLY_STRING8_LITERAL(".fbc3");
+        }
+        case ImageStorageType::BC5:
+        {
+            return FLY_STRING8_LITERAL(".fbc5");
+        }
+        case ImageStorageType::BC7:
+        {
+            return FLY_STRING8_LITERAL(".fbc7");
+        }
+        default:
+        {
+            FLY_ASSERT(false);
+            return String8();
+        }
+    }
+}
+
+// Exported straight into the cache, see GetCookCacheTempPath
+static bool StoreImageInCookCache(String8 directory, u64 key,
+                                  const Image& image)
+{
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+
+    String8 extension = GetCookedImageExtension(image.storageType);
+    String8 cachePath = GetCookCachePath(arena, directory, key, extension);
+    String8 tmpPath = GetCookCacheTempPath(arena, cachePath, extension);
+    bool res = CreateDirectories(cachePath);
+    if (res && !(ExportImage(tmpPath, image) &&
+                 RenameFile(tmpPath, cachePath)))
+    {
+        RemoveFile(tmpPath);
+        res = false;
     }
 
-    sceneData.imageCount = data->textures_count;
-    sceneData.images =
-        static_cast<Image*>(Alloc(sizeof(Image) * data->textures_count));
+    ArenaPopToMarker(arena, marker);
+    return res;
+}
+
+// How a texture is cooked, taken from the first material that uses it
+struct CookedTextureSettings
+{
+    ImageStorageType storageType = ImageStorageType::Invalid;
+    u32 channelCount = 4;
+    bool isLinear = false;
+};
+
+// One cooked image shared by every texture with the same source and
+// settings. Packed ORM images take occlusion from the red channel of
+// occlusionTextureIndex and roughness and metallic from the green and blue
+// channels of textureIndex, either may be FLY_MAX_U32.
+struct CookedImageGltf
+{
+    // Cook cache key of the source bytes and the settings
+    u64 key = 0;
+    // First texture that uses the image
+    u32 textureIndex = 0;
+    u32 occlusionTextureIndex = FLY_MAX_U32;
+    f32 occlusionStrength = 1.0f;
+    bool isOrm = false;
+    CookedTextureSettings settings;
+};
 
+// Settings of all textures in a single pass over the materials. Textures no
+// material uses are cooked as color, textures only sampled for occlusion,
+// roughness or metallic are only cooked into packed ORM images.
+static void GetTextureSettingsGltf(const cgltf_data* data,
+                                   CookedTextureSettings* settings)
+{
     Arena& arena = GetScratchArena();
     ArenaMarker marker = ArenaGetMarker(arena);
 
-    for (u64 i = 0; i < data->textures_count; i++)
+    bool* ormTextures = FLY_PUSH_ARENA(arena, bool, data->textures_count);
+    for (cgltf_size i = 0; i < data->textures_count; i++)
+    {
+        settings[i] = {};
+        ormTextures[i] = false;
+    }
+
+    // TODO:
+    // Emissive texture
+    for (cgltf_size i = 0; i < data->materials_count; i++)
     {
-        bool isLinear = false;
-        cgltf_texture& texture = data->textures[i];
-        if (!texture.image)
+        const cgltf_material& mat = data->materials[i];
+
+        const cgltf_texture* baseColor =
+            mat.pbr_metallic_roughness.base_color_texture.texture;
+        if (baseColor)
         {
-            continue;
+            CookedTextureSettings& textureSettings =
+                settings[baseColor - data->textures];
+            if (textureSettings.storageType == ImageStorageType::Invalid)
+            {
+                textureSettings.channelCount = 4;
+                textureSettings.storageType =
+                    (mat.alpha_mode == cgltf_alpha_mode_opaque)
+                        ? ImageStorageType::BC1
+                        : ImageStorageType::BC3;
+            }
         }
 
-        ImageStorageType storageType = ImageStorageType::BC1;
-        u32 desiredChannelCount = 4;
-        for (cgltf_size i = 0; i < data->materials_count; i++)
+        const cgltf_texture* normal = mat.normal_texture.texture;
+        if (normal)
         {
-            cgltf_material* mat = &data->materials[i];
-
-            if (mat->pbr_metallic_roughness.base_color_texture.texture ==
-                &texture)
+            CookedTextureSettings& textureSettings =
+                settings[normal - data->textures];
+            if (textureSettings.storageType == ImageStorageType::Invalid)
             {
-                desiredChannelCount = 4;
-                storageType = (mat->alpha_mode == cgltf_alpha_mode_opaque)
-                                  ? ImageStorageType::BC1
-                                  : ImageStorageType::BC3;
-                break;
+                textureSettings.channelCount = 2;
+                textureSettings.storageType = ImageStorageType::BC5;
+                textureSettings.isLinear = true;
             }
+        }
 
-            // TODO:
-            // Combine Roughness, metallic, occlusion into single texture Use
-            // BC1 Put roughness in green channel (highest precision)
+        const cgltf_texture* metallicRoughness =
+            mat.pbr_metallic_roughness.metallic_roughness_texture.texture;
+        if (metallicRoughness)
+        {
+            ormTextures[metallicRoughness - data->textures] = true;
+        }
 
-            // TODO:
-            // Emissive texture
+        const cgltf_texture* occlusion = mat.occlusion_texture.texture;
+        if (occlusion)
+        {
+            ormTextures[occlusion - data->textures] = true;
+        }
+    }
 
-            if (mat->normal_texture.texture == &texture)
-            {
-                desiredChannelCount = 2;
-                storageType = ImageStorageType::BC5;
-                isLinear = true;
-                break;
-            }
+    for (cgltf_size i = 0; i < data->textures_count; i++)
+    {
+        if (settings[i].storageType == ImageStorageType::Invalid &&
+            !ormTextures[i])
+        {
+            settings[i].storageType = ImageStorageType::BC1;
         }
+    }
+
+    ArenaPopToMarker(arena, marker);
+}
+
+struct HashImageSourcesJob
+{
+    const cgltf_data* data = nullptr;
+    // Resolved path of every uri image, empty for embedded ones
+    const String8* paths = nullptr;
+    // Indices of the images to hash, one per distinct uri
+    const u32* imageIndices = nullptr;
+    u64* keys = nullptr;
+    std::atomic<bool> res{true};
+};
+
+static void HashImageSourceTask(u32 index, void* userData)
+{
+    HashImageSourcesJob& job = *static_cast<HashImageSourcesJob*>(userData);
+    u32 imageIndex = job.imageIndices[index];
+    u64& key = job.keys[imageIndex];
+    key = FLY_COOK_CACHE_VERSION;
 
-        if (texture.image->uri)
+    if (job.paths[imageIndex])
+    {
+        if (!HashCookInput(job.paths[imageIndex], key))
         {
-            String8 gltfDirPath = ParentDirectory(path);
-            String8 imagePath =
-                String8(texture.image->uri, strlen(texture.image->uri));
+            job.res = false;
+        }
+        return;
+    }
+
+    const cgltf_buffer_view* bv = job.data->images[imageIndex].buffer_view;
+    HashCookInput(static_cast<const u8*>(bv->buffer->data) + bv->offset,
+                  bv->size, key);
+}
 
-            u64 bufferSize = gltfDirPath.Size() + imagePath.Size() + 1;
-            char* buffer = FLY_PUSH_ARENA(arena, char, bufferSize);
-            MemZero(buffer, bufferSize);
-            memcpy(buffer, gltfDirPath.Data(), gltfDirPath.Size());
-            memcpy(buffer + gltfDirPath.Size(), imagePath.Data(),
-                   imagePath.Size());
+static void HashCookedTextureSettings(const CookedTextureSettings& settings,
+                                      u64& key)
+{
+    HashCookOption(settings.storageType, key);
+    HashCookOption(settings.channelCount, key);
+    HashCookOption(settings.isLinear, key);
+}
 
-            String8 relativeImagePath = String8(buffer, bufferSize - 1);
-            if (!LoadImageFromFile(relativeImagePath, sceneData.images[i],
-                                   desiredChannelCount))
+// Maps every texture to a cooked image and every material that samples
+// occlusion, roughness or metallic to a packed ORM image. Images with the
+// same uri are read and hashed once, textures whose source bytes and settings
+// hash the same share one cooked image, as do materials with the same ORM
+// sources. Textures that are only packed map to FLY_MAX_U32.
+static bool DeduplicateTexturesGltf(String8 path, const cgltf_data* data,
+                                    ImageStorageType ormStorageType,
+                                    CookedImageGltf* cookedImages,
+                                    u32* textureImageIndices,
+                                    u32* materialOrmImageIndices,
+                                    u32& cookedImageCount)
+{
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+
+    CookedTextureSettings* settings =
+        FLY_PUSH_ARENA(arena, CookedTextureSettings, data->textures_count);
+    GetTextureSettingsGltf(data, settings);
+
+    // Images that repeat the uri of an earlier image use its key
+    String8* paths = FLY_PUSH_ARENA(arena, String8, data->images_count);
+    u32* sourceImages = FLY_PUSH_ARENA(arena, u32, data->images_count);
+    u32* hashedImages = FLY_PUSH_ARENA(arena, u32, data->images_count);
+    u64* keys = FLY_PUSH_ARENA(arena, u64, data->images_count);
+    u32 hashedImageCount = 0;
+    HashTrie<String8, u32> uriImages;
+    for (u32 i = 0; i < data->images_count; i++)
+    {
+        paths[i] = String8();
+        sourceImages[i] = i;
+        keys[i] = 0;
+
+        const cgltf_image& image = data->images[i];
+        if (image.uri)
+        {
+            paths[i] = GetRelativePath(arena, path, image.uri);
+            if (const u32* sourceImage = uriImages.Find(paths[i]))
             {
-                return false;
+                sourceImages[i] = *sourceImage;
+                continue;
             }
+            uriImages.Insert(arena, paths[i], i);
         }
-        else
+        else if (!image.buffer_view)
         {
-            cgltf_buffer_view* bv = texture.image->buffer_view;
-            cgltf_buffer* buf = bv->buffer;
-            u8* buffer = static_cast<u8*>(buf->data) + bv->offset;
-            u64 size = bv->size;
+            continue;
+        }
+        hashedImages[hashedImageCount++] = i;
+    }
 
-            if (!LoadImageFromMemory(buffer, size, sceneData.images[i],
-                                     desiredChannelCount))
+    HashImageSourcesJob job;
+    job.data = data;
+    job.paths = paths;
+    job.imageIndices = hashedImages;
+    job.keys = keys;
+    ParallelFor(hashedImageCount, HashImageSourceTask, &job);
+    if (!job.res)
+    {
+        ArenaPopToMarker(arena, marker);
+        return false;
+    }
+
+    cookedImageCount = 0;
+    HashTrie<u64, u32> keyImages;
+    for (u32 i = 0; i < data->textures_count; i++)
+    {
+        const cgltf_texture& texture = data->textures[i];
+        CookedImageGltf cookedImage;
+        cookedImage.textureIndex = i;
+        cookedImage.settings = settings[i];
+
+        if (settings[i].storageType == ImageStorageType::Invalid)
+        {
+            textureImageIndices[i] = FLY_MAX_U32;
+            continue;
+        }
+
+        // Textures without an image each keep an empty one
+        if (texture.image)
+        {
+            cookedImage.key =
+                keys[sourceImages[texture.image - data->images]];
+            HashCookedTextureSettings(settings[i], cookedImage.key);
+
+            if (const u32* imageIndex = keyImages.Find(cookedImage.key))
             {
-                return false;
+                textureImageIndices[i] = *imageIndex;
+                continue;
             }
+            keyImages.Insert(arena, cookedImage.key, cookedImageCount);
         }
-        ArenaPopToMarker(arena, marker);
 
-        if (sceneData.images[i].storageType == ImageStorageType::Byte)
+        textureImageIndices[i] = cookedImageCount;
+        cookedImages[cookedImageCount++] = cookedImage;
+    }
+
+    for (u32 i = 0; i < data->materials_count; i++)
+    {
+        materialOrmImageIndices[i] = FLY_MAX_U32;
+
+        const cgltf_material& mat = data->materials[i];
+        const cgltf_texture* metallicRoughness =
+            mat.pbr_metallic_roughness.metallic_roughness_texture.texture;
+        const cgltf_texture* occlusion = mat.occlusion_texture.texture;
+        if (metallicRoughness && !metallicRoughness->image)
+        {
+            metallicRoughness = nullptr;
+        }
+        if (occlusion && !occlusion->image)
+        {
+            occlusion = nullptr;
+        }
+        if (!mat.has_pbr_metallic_roughness ||
+            (!metallicRoughness && !occlusion))
+        {
+            continue;
+        }
+
+        CookedImageGltf cookedImage;
+        cookedImage.textureIndex = FLY_MAX_U32;
+        cookedImage.isOrm = true;
+        cookedImage.settings.storageType = ormStorageType;
+        cookedImage.settings.channelCount = 4;
+        cookedImage.settings.isLinear = true;
+
+        u64 metallicRoughnessKey = 0;
+        u64 occlusionKey = 0;
+        if (metallicRoughness)
+        {
+            cookedImage.textureIndex =
+                static_cast<u32>(metallicRoughness - data->textures);
+            metallicRoughnessKey =
+                keys[sourceImages[metallicRoughness->image - data->images]];
+        }
+        if (occlusion)
+        {
+            cookedImage.occlusionTextureIndex =
+                static_cast<u32>(occlusion - data->textures);
+            cookedImage.occlusionStrength = mat.occlusion_texture.scale;
+            occlusionKey = keys[sourceImages[occlusion->image - data->images]];
+        }
+
+        cookedImage.key = FLY_COOK_CACHE_VERSION;
+        HashCookOption(cookedImage.isOrm, cookedImage.key);
+        HashCookOption(metallicRoughnessKey, cookedImage.key);
+        HashCookOption(occlusionKey, cookedImage.key);
+        HashCookOption(cookedImage.occlusionStrength, cookedImage.key);
+        HashCookedTextureSettings(cookedImage.settings, cookedImage.key);
+
+        if (const u32* imageIndex = keyImages.Find(cookedImage.key))
+        {
+            materialOrmImageIndices[i] = *imageIndex;
+            continue;
+        }
+        keyImages.Insert(arena, cookedImage.key, cookedImageCount);
+
+        materialOrmImageIndices[i] = cookedImageCount;
+        cookedImages[cookedImageCount++] = cookedImage;
+    }
+
+    ArenaPopToMarker(arena, marker);
+    return true;
+}
+
+static bool LoadTextureImageGltf(String8 path, const cgltf_texture& texture,
+                                 u32 desiredChannelCount, Image& image)
+{
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+
+    bool res = false;
+    if (texture.image->uri)
+    {
+        String8 relativeImagePath =
+            GetRelativePath(arena, path, texture.image->uri);
+        res = LoadImageFromFile(relativeImagePath, image, desiredChannelCount);
+    }
+    else
+    {
+        cgltf_buffer_view* bv = texture.image->buffer_view;
+        cgltf_buffer* buf = bv->buffer;
+        u8* buffer = static_cast<u8*>(buf->data) + bv->offset;
+        res = LoadImageFromMemory(buffer, bv->size, image,
+                                  desiredChannelCount);
+    }
+
+    ArenaPopToMarker(arena, marker);
+    return res;
+}
+
+static bool IsOrmSourceImage(const Image& image)
+{
+    return image.storageType == ImageStorageType::Byte &&
+           image.channelCount == 4 && image.layerCount == 1 &&
+           image.mipCount == 1;
+}
+
+// glTF keeps roughness in green and metallic in blue, so the
+// metallicRoughness texels are kept and occlusion is written to red. The
+// occlusion strength is baked in, missing channels are white so that the
+// material factors apply unchanged.
+static bool PackOrmImageGltf(String8 path, const cgltf_data* data,
+                             const CookedImageGltf& cookedImage, Image& image)
+{
+    const cgltf_texture* metallicRoughness =
+        cookedImage.textureIndex != FLY_MAX_U32
+            ? &data->textures[cookedImage.textureIndex]
+            : nullptr;
+    const cgltf_texture* occlusion =
+        cookedImage.occlusionTextureIndex != FLY_MAX_U32
+            ? &data->textures[cookedImage.occlusionTextureIndex]
+            : nullptr;
+
+    Image occlusionImage{};
+    bool res = true;
+    if (metallicRoughness)
+    {
+        res = LoadTextureImageGltf(path, *metallicRoughness, 4, image);
+    }
+    // Occlusion baked into the red channel of the metallicRoughness image
+    // is read in place
+    if (res && occlusion &&
+        (!metallicRoughness || occlusion->image != metallicRoughness->image))
+    {
+        res = LoadTextureImageGltf(path, *occlusion, 4,
+                                   metallicRoughness ? occlusionImage : image);
+    }
+    if (!res || !IsOrmSourceImage(image) ||
+        (occlusionImage.data && !IsOrmSourceImage(occlusionImage)))
+    {
+        goto exit;
+    }
+
+    // Both sources are resampled to the larger of their sizes
+    if (occlusionImage.data)
+    {
+        u32 width = Math::Max(image.width, occlusionImage.width);
+        u32 height = Math::Max(image.height, occlusionImage.height);
+        if ((width != image.width || height != image.height) &&
+            !ResizeImageLinear(width, height, image))
+        {
+            goto exit;
+        }
+        if ((width != occlusionImage.width ||
+             height != occlusionImage.height) &&
+            !ResizeImageLinear(width, height, occlusionImage))
+        {
+            goto exit;
+        }
+    }
+
+    {
+        u64 texelCount = static_cast<u64>(image.width) * image.height;
+        const u8* occlusionTexels =
+            occlusionImage.data ? occlusionImage.data : image.data;
+        f32 strength = Math::Clamp(cookedImage.occlusionStrength, 0.0f, 1.0f);
+        for (u64 i = 0; i < texelCount; i++)
         {
-            if (sceneData.images[i].mipCount == 1)
+            u8* texel = image.data + i * 4;
+            f32 ao = 255.0f;
+            if (occlusion)
+            {
+                ao = 255.0f + strength * (occlusionTexels[i * 4] - 255.0f);
+            }
+            if (!metallicRoughness)
             {
-                GenerateMips(sceneData.images[i], isLinear);
+                texel[1] = 255;
+                texel[2] = 255;
             }
-            CompressImage(storageType, sceneData.images[i]);
+            texel[0] = static_cast<u8>(ao + 0.5f);
+            texel[3] = 255;
         }
     }
 
+    if (occlusionImage.data)
+    {
+        Free(occlusionImage.data);
+    }
+    return true;
+
+exit:
+    if (image.data)
+    {
+        Free(image.data);
+    }
+    if (occlusionImage.data)
+    {
+        Free(occlusionImage.data);
+    }
+    image = {};
+    return false;
+}
+
+static bool CookImageGltf(String8 path, const cgltf_data* data,
+                          const CookedImageGltf& cookedImage, u32 index,
+                          String8 cacheDirectory, Image& image)
+{
+    image = {};
+
+    const cgltf_texture* texture =
+        cookedImage.isOrm ? nullptr : &data->textures[cookedImage.textureIndex];
+    if (texture && !texture->image)
+    {
+        return true;
+    }
+
+    ImageStorageType storageType = cookedImage.settings.storageType;
+    u32 desiredChannelCount = cookedImage.settings.channelCount;
+    bool isLinear = cookedImage.settings.isLinear;
+
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+
+    // Textures shared between scenes are cooked once, the key covers the
+    // encoded image and everything that changes how it is cooked
+    u64 key = cookedImage.key;
+    bool useCache = static_cast<bool>(cacheDirectory);
+    String8 cachePath;
+    if (useCache)
+    {
+        cachePath = GetCookCachePath(arena, cacheDirectory, key,
+                                     GetCookedImageExtension(storageType));
+    }
+
+    if (useCache && FileExists(cachePath) &&
+        LoadImageFromFile(cachePath, image))
+    {
+        ArenaPopToMarker(arena, marker);
+        return true;
+    }
     ArenaPopToMarker(arena, marker);
 
+    bool res = false;
+    if (texture)
+    {
+        res = LoadTextureImageGltf(path, *texture, desiredChannelCount, image);
+    }
+    else
+    {
+        res = PackOrmImageGltf(path, data, cookedImage, image);
+    }
+    if (!res)
+    {
+        return false;
+    }
+
+    if (image.storageType == ImageStorageType::Byte)
+    {
+        if (image.mipCount == 1)
+        {
+            GenerateMips(image, isLinear);
+        }
+        CompressImage(storageType, image);
+
+        if (useCache && image.storageType == storageType &&
+            !StoreImageInCookCache(cacheDirectory, key, image))
+        {
+            fprintf(stderr, "Cache warning: failed to store texture %u\n",
+                    index);
+        }
+    }
+
     return true;
 }
 
 static void CookMaterialsGltf(const cgltf_data* data,
                               const SceneExportOptions& options,
+                              const u32* textureImageIndices,
+                              const u32* materialOrmImageIndices,
                               SceneData& sceneData)
 {
     if (!data->materials_count || !options.exportMaterials)
@@ -258,14 +732,23 @@ static void CookMaterialsGltf(const cgltf_data* data,
         serializedMaterial.roughness = pbr.roughness_factor;
         if (pbr.base_color_texture.texture)
         {
-            serializedMaterial.baseColorTextureIndex = static_cast<i32>(
-                pbr.base_color_texture.texture - data->textures);
+            u64 textureIndex = pbr.base_color_texture.texture - data->textures;
+            serializedMaterial.baseColorTextureIndex =
+                static_cast<i32>(textureImageIndices[textureIndex]);
         }
 
         if (material.normal_texture.texture)
         {
-            serializedMaterial.normalTextureIndex = static_cast<i32>(
-                material.normal_texture.texture - data->textures);
+            u64 textureIndex = material.normal_texture.texture - data->textures;
+            serializedMaterial.normalTextureIndex =
+                static_cast<i32>(textureImageIndices[textureIndex]);
+        }
+
+        if (materialOrmImageIndices &&
+            materialOrmImageIndices[i] != FLY_MAX_U32)
+        {
+            serializedMaterial.ormTextureIndex =
+                static_cast<i32>(materialOrmImageIndices[i]);
         }
 
         materialCount++;
@@ -484,74 +967,151 @@ static void CookNodesGltf(const cgltf_data* data,
     }
 }
 
-static bool CookSceneObj(String8 path, const fastObjMesh* mesh,
-                         const SceneExportOptions& options,
+static void CookSceneGeometry(const SceneExportOptions& options,
+                              Geometry& geometry)
+{
+    if (options.scale != 1.0f || options.coordSystem != CoordSystem::XYZ ||
+        options.flipRight || options.flipUp || options.flipForward)
+    {
+        TransformGeometry(options.scale, options.coordSystem,
+                          options.flipRight, options.flipUp,
+                          options.flipForward, geometry);
+    }
+    if (options.flipWindingOrder)
+    {
+        FlipGeometryWindingOrder(geometry);
+    }
+    CookGeometry(geometry);
+}
+
+// Every texture and geometry is cooked as its own task into its own slot,
+// so the output does not depend on the order the tasks finish in. Textures
+// come first since they usually take the longest.
+struct CookSceneJob
+{
+    String8 path;
+    String8 cacheDirectory;
+    const cgltf_data* data = nullptr;
+    const CookedImageGltf* cookedImages = nullptr;
+    const SceneExportOptions* options = nullptr;
+    SceneData* sceneData = nullptr;
+    u32 imageCount = 0;
+    std::atomic<bool> res{true};
+};
+
+static void CookSceneTask(u32 index, void* userData)
+{
+    CookSceneJob& job = *static_cast<CookSceneJob*>(userData);
+    SceneData& sceneData = *job.sceneData;
+
+    if (index < job.imageCount)
+    {
+        if (!CookImageGltf(job.path, job.data, job.cookedImages[index], index,
+                           job.cacheDirectory, sceneData.images[index]))
+        {
+            job.res = false;
+        }
+        return;
+    }
+
+    CookSceneGeometry(*job.options,
+                      sceneData.geometries[index - job.imageCount]);
+}
+
+static bool CookSceneObj(String8 path, const SceneExportOptions& options,
                          SceneData& sceneData)
 {
     FLY_ASSERT(path);
-    FLY_ASSERT(mesh);
 
-    if (!ImportGeometriesObj(mesh, &sceneData.geometries,
+    if (!ImportGeometriesObj(path, &sceneData.geometries,
                              sceneData.geometryCount))
     {
         return false;
     }
 
-    for (u32 i = 0; i < sceneData.geometryCount; i++)
-    {
-        if (options.scale != 1.0f || options.coordSystem != CoordSystem::XYZ ||
-            options.flipRight || options.flipUp || options.flipForward)
-        {
-            TransformGeometry(options.scale, options.coordSystem,
-                              options.flipRight, options.flipUp,
-                              options.flipForward, sceneData.geometries[i]);
-        }
-        if (options.flipWindingOrder)
-        {
-            FlipGeometryWindingOrder(sceneData.geometries[i]);
-        }
-        CookGeometry(sceneData.geometries[i]);
-    }
+    CookSceneJob job;
+    job.options = &options;
+    job.sceneData = &sceneData;
+    ParallelFor(sceneData.geometryCount, CookSceneTask, &job);
 
     return true;
 }
 
 static bool CookSceneGltf(String8 path, const cgltf_data* data,
                           const SceneExportOptions& options,
-                          SceneData& sceneData)
+                          String8 cacheDirectory, SceneData& sceneData)
 {
     FLY_ASSERT(path);
     FLY_ASSERT(data);
 
-    if (!CookImagesGltf(path, data, options, sceneData))
-    {
-        return false;
-    }
-
     if (!ImportGeometriesGltf(data, &sceneData.geometries,
                               sceneData.geometryCount))
     {
         return false;
     }
 
-    for (u32 i = 0; i < sceneData.geometryCount; i++)
+    // Textures that share an image are cooked and exported once, every
+    // material may add a packed ORM image
+    CookedImageGltf* cookedImages = nullptr;
+    u32* textureImageIndices = nullptr;
+    u32* materialOrmImageIndices = nullptr;
+    if (data->textures_count && options.exportMaterials)
     {
-        if (options.scale != 1.0f || options.coordSystem != CoordSystem::XYZ ||
-            options.flipRight || options.flipUp || options.flipForward)
+        cookedImages = static_cast<CookedImageGltf*>(
+            Alloc(sizeof(CookedImageGltf) *
+                  (data->textures_count + data->materials_count)));
+        textureImageIndices =
+            static_cast<u32*>(Alloc(sizeof(u32) * data->textures_count));
+        materialOrmImageIndices =
+            static_cast<u32*>(Alloc(sizeof(u32) * data->materials_count));
+        ImageStorageType ormStorageType = options.ormBC7
+                                              ? ImageStorageType::BC7
+                                              : ImageStorageType::BC1;
+        if (!DeduplicateTexturesGltf(path, data, ormStorageType, cookedImages,
+                                     textureImageIndices,
+                                     materialOrmImageIndices,
+                                     sceneData.imageCount))
         {
-            TransformGeometry(options.scale, options.coordSystem,
-                              options.flipRight, options.flipUp,
-                              options.flipForward, sceneData.geometries[i]);
+            Free(cookedImages);
+            Free(textureImageIndices);
+            Free(materialOrmImageIndices);
+            return false;
         }
-        if (options.flipWindingOrder)
+        sceneData.images =
+            static_cast<Image*>(Alloc(sizeof(Image) * sceneData.imageCount));
+        sceneData.imageFlags =
+            static_cast<u32*>(Alloc(sizeof(u32) * sceneData.imageCount));
+        for (u32 i = 0; i < sceneData.imageCount; i++)
         {
-            FlipGeometryWindingOrder(sceneData.geometries[i]);
+            sceneData.imageFlags[i] = cookedImages[i].settings.isLinear
+                                          ? FLY_SCENE_TEXTURE_LINEAR_BIT
+                                          : FLY_SCENE_TEXTURE_NONE_BIT;
         }
-        CookGeometry(sceneData.geometries[i]);
+    }
+
+    CookSceneJob job;
+    job.path = path;
+    job.cacheDirectory = cacheDirectory;
+    job.data = data;
+    job.cookedImages = cookedImages;
+    job.options = &options;
+    job.sceneData = &sceneData;
+    job.imageCount = sceneData.imageCount;
+    ParallelFor(sceneData.imageCount + sceneData.geometryCount, CookSceneTask,
+                &job);
+    Free(cookedImages);
+    if (!job.res)
+    {
+        Free(textureImageIndices);
+        Free(materialOrmImageIndices);
+        return false;
     }
 
     CookNodesGltf(data, options, sceneData);
-    CookMaterialsGltf(data, options, sceneData);
+    CookMaterialsGltf(data, options, textureImageIndices,
+                      materialOrmImageIndices, sceneData);
+    Free(textureImageIndices);
+    Free(materialOrmImageIndices);
 
     return true;
 }
@@ -567,7 +1127,8 @@ static void SerializeNodes(const SceneData& sceneData,
 }
 
 static void SerializeImages(const SceneData& sceneData,
-                            ImageHeader* imageHeaderStart, u8* imageDataStart)
+                            ImageHeader* imageHeaderStart,
+                            u32* textureFlagStart, u8* imageDataStart)
 {
     u64 imageOffset = 0;
     for (u32 i = 0; i < sceneData.imageCount; i++)
@@ -583,6 +1144,10 @@ static void SerializeImages(const SceneData& sceneData,
         header.layerCount = image.layerCount;
         header.mipCount = image.mipCount;
         header.storageType = image.storageType;
+        if (sceneData.imageFlags)
+        {
+            textureFlagStart[i] = sceneData.imageFlags[i];
+        }
 
         memcpy(imageDataStart + imageOffset, image.data, header.size);
         imageOffset += header.size;
@@ -599,19 +1164,86 @@ static void SerializeMaterials(const SceneData& sceneData,
     }
 }
 
+struct EncodedGeometry
+{
+    u8* vertexData = nullptr;
+    u8* indexData = nullptr;
+    u64 vertexDataSize = 0;
+    u64 indexDataSize = 0;
+};
+
+struct EncodeGeometryJob
+{
+    const SceneData* sceneData = nullptr;
+    EncodedGeometry* encoded = nullptr;
+};
+
+static void EncodeGeometryTask(u32 index, void* userData)
+{
+    EncodeGeometryJob& job = *static_cast<EncodeGeometryJob*>(userData);
+    const Geometry& geometry = job.sceneData->geometries[index];
+    EncodedGeometry& encoded = job.encoded[index];
+
+    u64 vertexBound =
+        meshopt_encodeVertexBufferBound(geometry.vertexCount, sizeof(QVertex));
+    encoded.vertexData = static_cast<u8*>(Alloc(vertexBound));
+    encoded.vertexDataSize = meshopt_encodeVertexBuffer(
+        encoded.vertexData, vertexBound, geometry.qvertices,
+        geometry.vertexCount, sizeof(QVertex));
+
+    u64 indexBound = meshopt_encodeIndexBufferBound(geometry.indexCount,
+                                                    geometry.vertexCount);
+    encoded.indexData = static_cast<u8*>(Alloc(indexBound));
+    encoded.indexDataSize =
+        meshopt_encodeIndexBuffer(encoded.indexData, indexBound,
+                                  geometry.indices, geometry.indexCount);
+}
+
+// Returns the size of the geometry data, the encoded streams of all meshes
+static u64 EncodeGeometries(const SceneData& sceneData,
+                            EncodedGeometry* encoded)
+{
+    meshopt_encodeIndexVersion(1);
+
+    EncodeGeometryJob job;
+    job.sceneData = &sceneData;
+    job.encoded = encoded;
+    ParallelFor(sceneData.geometryCount, EncodeGeometryTask, &job);
+
+    u64 size = 0;
+    for (u32 i = 0; i < sceneData.geometryCount; i++)
+    {
+        size += encoded[i].vertexDataSize + encoded[i].indexDataSize;
+    }
+    return size;
+}
+
+// Without encoded geometries the data holds all vertices followed by the
+// u32 and the u16 index pools, otherwise the encoded vertices and indices of
+// each mesh in turn
 static void SerializeMeshes(const SceneData& sceneData,
+                            const EncodedGeometry* encoded,
                             MeshHeader* meshHeaderStart, LOD* lodStart,
                             i32* submeshMaterialIndexStart,
-                            QVertex* vertexStart, u32* indexStart)
+                            u8* geometryDataStart, u64 totalVertexCount,
+                            u64 totalIndexCount, Meshlet* meshletStart,
+                            u32* meshletVertexStart, u8* meshletTriangleStart)
 {
+    u64 geometryDataOffset = 0;
     u64 firstVertex = 0;
-    u64 firstIndex = 0;
+    u64 firstIndex32 = 0;
+    u64 firstIndex16 = 0;
     u32 firstLod = 0;
+    u32 firstMeshlet = 0;
+    u32 firstMeshletVertex = 0;
+    u32 firstMeshletTriangle = 0;
 
     u32 sgOffset = 0;
     for (u32 i = 0; i < sceneData.geometryCount; i++)
     {
         const Geometry& geometry = sceneData.geometries[i];
+        u64& firstIndex =
+            geometry.indexSize == sizeof(u16) ? firstIndex16 : firstIndex32;
 
         MeshHeader& meshHeader = *(meshHeaderStart + i);
         meshHeader.sphereCenter = geometry.sphereCenter;
@@ -619,14 +1251,19 @@ static void SerializeMeshes(const SceneData& sceneData,
         meshHeader.vertexCount = geometry.vertexCount;
         meshHeader.indexCount = geometry.indexCount;
         meshHeader.lodCount = geometry.lodCount;
+        meshHeader.indexSize = geometry.indexSize;
         meshHeader.sphereRadius = geometry.sphereRadius;
         meshHeader.firstLod = firstLod;
         meshHeader.firstVertex = firstVertex;
         meshHeader.firstIndex = firstIndex;
+        meshHeader.meshletCount = geometry.meshletCount;
+        meshHeader.firstMeshlet = firstMeshlet;
+        meshHeader.meshletVertexCount = geometry.meshletVertexCount;
+        meshHeader.firstMeshletVertex = firstMeshletVertex;
+        meshHeader.meshletTriangleCount = geometry.meshletTriangleCount;
+        meshHeader.firstMeshletTriangle = firstMeshletTriangle;
 
         LOD* lodData = lodStart + firstLod;
-        QVertex* vertexData = vertexStart + firstVertex;
-        u32* indexData = indexStart + firstIndex;
 
         for (u32 j = 0; j < geometry.subgeometryCount; j++)
         {
@@ -640,26 +1277,154 @@ static void SerializeMeshes(const SceneData& sceneData,
             {
                 LOD* lod = lodData + j * geometry.lodCount + k;
                 lod->firstIndex += firstIndex;
+                lod->firstMeshlet += firstMeshlet;
             }
         }
 
-        memcpy(vertexData, geometry.qvertices,
-               sizeof(QVertex) * geometry.vertexCount);
-        memcpy(indexData, geometry.indices, sizeof(u32) * geometry.indexCount);
+        // Meshlet vertices stay relative to the mesh vertices like indices,
+        // meshlet offsets become offsets into the scene arrays
+        Meshlet* meshletData = meshletStart + firstMeshlet;
+        for (u32 j = 0; j < geometry.meshletCount; j++)
+        {
+            Meshlet& meshlet = meshletData[j];
+            meshlet = geometry.meshlets[j];
+            meshlet.vertexOffset += firstMeshletVertex;
+            meshlet.triangleOffset += firstMeshletTriangle;
+        }
+        memcpy(meshletVertexStart + firstMeshletVertex,
+               geometry.meshletVertices,
+               sizeof(u32) * geometry.meshletVertexCount);
+        memcpy(meshletTriangleStart + firstMeshletTriangle,
+               geometry.meshletTriangles,
+               sizeof(u8) * geometry.meshletTriangleCount);
+
+        if (encoded)
+        {
+            meshHeader.vertexDataOffset = geometryDataOffset;
+            meshHeader.vertexDataSize = encoded[i].vertexDataSize;
+            geometryDataOffset += encoded[i].vertexDataSize;
+            meshHeader.indexDataOffset = geometryDataOffset;
+            meshHeader.indexDataSize = encoded[i].indexDataSize;
+            geometryDataOffset += encoded[i].indexDataSize;
+
+            memcpy(geometryDataStart + meshHeader.vertexDataOffset,
+                   encoded[i].vertexData, encoded[i].vertexDataSize);
+            memcpy(geometryDataStart + meshHeader.indexDataOffset,
+                   encoded[i].indexData, encoded[i].indexDataSize);
+        }
+        else
+        {
+            meshHeader.vertexDataOffset = sizeof(QVertex) * firstVertex;
+            meshHeader.vertexDataSize = sizeof(QVertex) * geometry.vertexCount;
+            meshHeader.indexDataOffset = sizeof(QVertex) * totalVertexCount;
+            meshHeader.indexDataSize = geometry.indexSize * geometry.indexCount;
+            memcpy(geometryDataStart + meshHeader.vertexDataOffset,
+                   geometry.qvertices, meshHeader.vertexDataSize);
+
+            if (geometry.indexSize == sizeof(u16))
+            {
+                meshHeader.indexDataOffset += sizeof(u32) * totalIndexCount +
+                                              sizeof(u16) * firstIndex;
+                u16* indexData = reinterpret_cast<u16*>(
+                    geometryDataStart + meshHeader.indexDataOffset);
+                for (u32 j = 0; j < geometry.indexCount; j++)
+                {
+                    indexData[j] = static_cast<u16>(geometry.indices[j]);
+                }
+            }
+            else
+            {
+                meshHeader.indexDataOffset += sizeof(u32) * firstIndex;
+                memcpy(geometryDataStart + meshHeader.indexDataOffset,
+                       geometry.indices, meshHeader.indexDataSize);
+            }
+        }
 
         firstLod += geometry.subgeometryCount * geometry.lodCount;
         firstVertex += geometry.vertexCount;
         firstIndex += geometry.indexCount;
+        firstMeshlet += geometry.meshletCount;
+        firstMeshletVertex += geometry.meshletVertexCount;
+        firstMeshletTriangle += geometry.meshletTriangleCount;
     }
 }
 
+static bool IsGltfPath(String8 path)
+{
+    return String8::EndsWith(path, FLY_STRING8_LITERAL(".gltf")) ||
+           String8::EndsWith(path, FLY_STRING8_LITERAL(".GLTF")) ||
+           String8::EndsWith(path, FLY_STRING8_LITERAL(".glb")) ||
+           String8::EndsWith(path, FLY_STRING8_LITERAL(".GLB"));
+}
+
+static bool HashExternalFile(String8 path, const char* uri, u64& key)
+{
+    if (!uri || strncmp(uri, "data:", 5) == 0)
+    {
+        return true;
+    }
+
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+    bool res = HashCookInput(GetRelativePath(arena, path, uri), key);
+    ArenaPopToMarker(arena, marker);
+    return res;
+}
+
+bool HashSceneInputs(String8 path, const SceneExportOptions& options,
+                     u64& key)
+{
+    if (!HashCookInput(path, key))
+    {
+        return false;
+    }
+
+    // Buffers and images of a gltf may live in separate files
+    if (IsGltfPath(path))
+    {
+        const cgltf_options gltfOptions{};
+        cgltf_data* data = nullptr;
+        if (cgltf_parse_file(&gltfOptions, path.Data(), &data) !=
+            cgltf_result_success)
+        {
+            return false;
+        }
+
+        bool res = true;
+        for (cgltf_size i = 0; res && i < data->buffers_count; i++)
+        {
+            res = HashExternalFile(path, data->buffers[i].uri, key);
+        }
+        for (cgltf_size i = 0; res && i < data->images_count; i++)
+        {
+            res = HashExternalFile(path, data->images[i].uri, key);
+        }
+        cgltf_free(data);
+
+        if (!res)
+        {
+            return false;
+        }
+    }
+
+    HashCookOption(options.scale, key);
+    HashCookOption(options.coordSystem, key);
+    HashCookOption(options.flipRight, key);
+    HashCookOption(options.flipUp, key);
+    HashCookOption(options.flipForward, key);
+    HashCookOption(options.flipWindingOrder, key);
+    HashCookOption(options.exportNodes, key);
+    HashCookOption(options.exportMaterials, key);
+    HashCookOption(options.compressGeometry, key);
+    HashCookOption(options.ormBC7, key);
+
+    return true;
+}
+
 bool CookSceneData(String8 path, const SceneExportOptions& cookOptions,
-                   SceneData& sceneData)
+                   SceneData& sceneData, String8 cacheDirectory)
 {
-    if (String8::EndsWith(path, FLY_STRING8_LITERAL(".gltf")) ||
-        String8::EndsWith(path, FLY_STRING8_LITERAL(".GLTF")) ||
-        String8::EndsWith(path, FLY_STRING8_LITERAL(".glb")) ||
-        String8::EndsWith(path, FLY_STRING8_LITERAL(".GLB")))
+    if (IsGltfPath(path))
     {
         const cgltf_options options{};
         cgltf_data* data = nullptr;
@@ -677,102 +1442,270 @@ bool CookSceneData(String8 path, const SceneExportOptions& cookOptions,
             return false;
         }
 
-        bool res = CookSceneGltf(path, data, cookOptions, sceneData);
+        bool res =
+            CookSceneGltf(path, data, cookOptions, cacheDirectory, sceneData);
         cgltf_free(data);
         return res;
     }
     else if (String8::EndsWith(path, FLY_STRING8_LITERAL(".obj")) ||
              String8::EndsWith(path, FLY_STRING8_LITERAL(".OBJ")))
     {
-        fastObjMesh* mesh = fast_obj_read(path.Data());
-        bool res = CookSceneObj(path, mesh, cookOptions, sceneData);
-        fast_obj_destroy(mesh);
-        return res;
+        return CookSceneObj(path, cookOptions, sceneData);
     }
     return false;
 }
 
-bool ExportSceneData(String8 path, const SceneData& sceneData)
+static u64 AlignSceneOffset(u64 offset)
+{
+    const u64 alignment = FLY_SCENE_SECTION_ALIGNMENT;
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+static void SetSceneSectionSize(SceneSectionType type, u64 size,
+                                SceneFileSection* sections)
+{
+    SceneFileSection& section = sections[static_cast<u32>(type)];
+    section = {};
+    section.type = type;
+    section.size = size;
+}
+
+static void ChecksumMeshes(const SceneData& sceneData,
+                           const MeshHeader* meshHeaderStart,
+                           const u8* geometryDataStart,
+                           u64* meshChecksumStart)
+{
+    for (u32 i = 0; i < sceneData.geometryCount; i++)
+    {
+        const MeshHeader& meshHeader = meshHeaderStart[i];
+        u64 seed = Hash64(geometryDataStart + meshHeader.indexDataOffset,
+                          meshHeader.indexDataSize);
+        meshChecksumStart[i] =
+            Hash64(geometryDataStart + meshHeader.vertexDataOffset,
+                   meshHeader.vertexDataSize, seed);
+    }
+}
+
+static void ChecksumMips(const SceneData& sceneData,
+                         const ImageHeader* imageHeaderStart,
+                         const u8* imageDataStart, u64* mipChecksumStart)
+{
+    for (u32 i = 0; i < sceneData.imageCount; i++)
+    {
+        const ImageHeader& header = imageHeaderStart[i];
+        for (u8 j = 0; j < header.mipCount; j++)
+        {
+            u64 offset = GetImageSize(header.width, header.height,
+                                      header.channelCount, header.layerCount,
+                                      j, header.storageType);
+            u64 size = GetImageSize(header.width, header.height,
+                                    header.channelCount, header.layerCount,
+                                    static_cast<u8>(j + 1),
+                                    header.storageType) -
+                       offset;
+            *mipChecksumStart++ =
+                Hash64(imageDataStart + header.offset + offset, size);
+        }
+    }
+}
+
+static u8* SceneSectionData(SceneSectionType type,
+                            const SceneFileSection* sections, u8* data)
+{
+    return data + sections[static_cast<u32>(type)].offset;
+}
+
+bool ExportSceneData(String8 path, const SceneData& sceneData,
+                     bool compressGeometry)
 {
     u64 totalIndexCount = 0;
+    u64 totalIndex16Count = 0;
     u64 totalVertexCount = 0;
     u64 totalSubmeshCount = 0;
     u32 totalLodCount = 0;
+    u32 totalMeshletCount = 0;
+    u32 totalMeshletVertexCount = 0;
+    u32 totalMeshletTriangleCount = 0;
 
     for (u32 i = 0; i < sceneData.geometryCount; i++)
     {
         const Geometry& geometry = sceneData.geometries[i];
         totalVertexCount += geometry.vertexCount;
-        totalIndexCount += geometry.indexCount;
+        if (geometry.indexSize == sizeof(u16))
+        {
+            totalIndex16Count += geometry.indexCount;
+        }
+        else
+        {
+            totalIndexCount += geometry.indexCount;
+        }
         totalSubmeshCount += geometry.subgeometryCount;
         totalLodCount += geometry.lodCount * geometry.subgeometryCount;
+        totalMeshletCount += geometry.meshletCount;
+        totalMeshletVertexCount += geometry.meshletVertexCount;
+        totalMeshletTriangleCount += geometry.meshletTriangleCount;
     }
 
     u64 totalImageSize = 0;
+    u32 totalMipCount = 0;
     for (u32 i = 0; i < sceneData.imageCount; i++)
     {
         totalImageSize += GetImageSize(sceneData.images[i]);
+        totalMipCount += sceneData.images[i].mipCount;
+    }
+
+    EncodedGeometry* encoded = nullptr;
+    u64 geometryDataSize =
+        sizeof(QVertex) * totalVertexCount + sizeof(u32) * totalIndexCount +
+        sizeof(u16) * totalIndex16Count;
+    if (compressGeometry && sceneData.geometryCount)
+    {
+        encoded = static_cast<EncodedGeometry*>(
+            Alloc(sizeof(EncodedGeometry) * sceneData.geometryCount));
+        geometryDataSize = EncodeGeometries(sceneData, encoded);
     }
 
+    const u32 sectionCount = static_cast<u32>(SceneSectionType::Count);
+    SceneFileSection sections[sectionCount];
+    SetSceneSectionSize(SceneSectionType::ImageHeaders,
+                        sizeof(ImageHeader) * sceneData.imageCount, sections);
+    SetSceneSectionSize(SceneSectionType::Materials,
+                        sizeof(SerializedPBRMaterial) *
+                            sceneData.materialCount,
+                        sections);
+    SetSceneSectionSize(SceneSectionType::MeshHeaders,
+                        sizeof(MeshHeader) * sceneData.geometryCount,
+                        sections);
+    SetSceneSectionSize(SceneSectionType::Nodes,
+                        sizeof(SerializedSceneNode) * sceneData.nodeCount,
+                        sections);
+    SetSceneSectionSize(SceneSectionType::Lods, sizeof(LOD) * totalLodCount,
+                        sections);
+    SetSceneSectionSize(SceneSectionType::SubmeshMaterialIndices,
+                        sizeof(i32) * totalSubmeshCount, sections);
+    SetSceneSectionSize(SceneSectionType::GeometryData, geometryDataSize,
+                        sections);
+    SetSceneSectionSize(SceneSectionType::Meshlets,
+                        sizeof(Meshlet) * totalMeshletCount, sections);
+    SetSceneSectionSize(SceneSectionType::MeshletVertices,
+                        sizeof(u32) * totalMeshletVertexCount, sections);
+    SetSceneSectionSize(SceneSectionType::MeshletTriangles,
+                        sizeof(u8) * totalMeshletTriangleCount, sections);
+    SetSceneSectionSize(SceneSectionType::ImageData, totalImageSize,
+                        sections);
+    SetSceneSectionSize(SceneSectionType::TextureFlags,
+                        sizeof(u32) * sceneData.imageCount, sections);
+    SetSceneSectionSize(SceneSectionType::MeshChecksums,
+                        sizeof(u64) * sceneData.geometryCount, sections);
+    SetSceneSectionSize(SceneSectionType::MipChecksums,
+                        sizeof(u64) * totalMipCount, sections);
+
+    // Header, section table, then every section at an aligned offset
+    u64 sectionTableOffset = AlignSceneOffset(sizeof(SceneFileHeader));
     u64 totalSize =
-        sizeof(SceneFileHeader) + sizeof(ImageHeader) * sceneData.imageCount +
-        sizeof(SerializedPBRMaterial) * sceneData.materialCount +
-        sizeof(MeshHeader) * sceneData.geometryCount +
-        sizeof(SerializedSceneNode) * sceneData.nodeCount +
-        sizeof(LOD) * totalLodCount + sizeof(i32) * totalSubmeshCount +
-        sizeof(QVertex) * totalVertexCount + +sizeof(u32) * totalIndexCount +
-        totalImageSize;
-
-    u64 offset = 0;
+        sectionTableOffset + sizeof(SceneFileSection) * sectionCount;
+    for (u32 i = 0; i < sectionCount; i++)
+    {
+        sections[i].offset = AlignSceneOffset(totalSize);
+        totalSize = sections[i].offset + sections[i].size;
+    }
+
+    // Zeroed so that padding is deterministic for checksums and the cook
+    // cache
     u8* data = static_cast<u8*>(Alloc(totalSize));
+    MemZero(data, totalSize);
     SceneFileHeader* sceneHeader = reinterpret_cast<SceneFileHeader*>(data);
-    offset += sizeof(SceneFileHeader);
-
-    ImageHeader* imageHeaderStart =
-        reinterpret_cast<ImageHeader*>(data + offset);
-    offset += sizeof(ImageHeader) * sceneData.imageCount;
+    *sceneHeader = {};
 
+    ImageHeader* imageHeaderStart = reinterpret_cast<ImageHeader*>(
+        SceneSectionData(SceneSectionType::ImageHeaders, sections, data));
     SerializedPBRMaterial* pbrMaterialStart =
-        reinterpret_cast<SerializedPBRMaterial*>(data + offset);
-    offset += sizeof(SerializedPBRMaterial) * sceneData.materialCount;
-
-    MeshHeader* meshHeaderStart = reinterpret_cast<MeshHeader*>(data + offset);
-    offset += sizeof(MeshHeader) * sceneData.geometryCount;
-
+        reinterpret_cast<SerializedPBRMaterial*>(
+            SceneSectionData(SceneSectionType::Materials, sections, data));
+    MeshHeader* meshHeaderStart = reinterpret_cast<MeshHeader*>(
+        SceneSectionData(SceneSectionType::MeshHeaders, sections, data));
     SerializedSceneNode* sceneNodeStart =
-        reinterpret_cast<SerializedSceneNode*>(data + offset);
-    offset += sizeof(SerializedSceneNode) * sceneData.nodeCount;
-
-    LOD* lodStart = reinterpret_cast<LOD*>(data + offset);
-    offset += sizeof(LOD) * totalLodCount;
-
-    i32* submeshMaterialIndexStart = reinterpret_cast<i32*>(data + offset);
-    offset += sizeof(i32) * totalSubmeshCount;
-
-    QVertex* vertexStart = reinterpret_cast<QVertex*>(data + offset);
-    offset += sizeof(QVertex) * totalVertexCount;
-
-    u32* indexStart = reinterpret_cast<u32*>(data + offset);
-    offset += sizeof(u32) * totalIndexCount;
-
-    u8* imageDataStart = reinterpret_cast<u8*>(data + offset);
-    offset += sizeof(u8) * totalImageSize;
-
-    sceneHeader->version = {1, 0, 0};
+        reinterpret_cast<SerializedSceneNode*>(
+            SceneSectionData(SceneSectionType::Nodes, sections, data));
+    LOD* lodStart = reinterpret_cast<LOD*>(
+        SceneSectionData(SceneSectionType::Lods, sections, data));
+    i32* submeshMaterialIndexStart =
+        reinterpret_cast<i32*>(SceneSectionData(
+            SceneSectionType::SubmeshMaterialIndices, sections, data));
+    u8* geometryDataStart =
+        SceneSectionData(SceneSectionType::GeometryData, sections, data);
+    Meshlet* meshletStart = reinterpret_cast<Meshlet*>(
+        SceneSectionData(SceneSectionType::Meshlets, sections, data));
+    u32* meshletVertexStart = reinterpret_cast<u32*>(
+        SceneSectionData(SceneSectionType::MeshletVertices, sections, data));
+    u8* meshletTriangleStart =
+        SceneSectionData(SceneSectionType::MeshletTriangles, sections, data);
+    u8* imageDataStart =
+        SceneSectionData(SceneSectionType::ImageData, sections, data);
+    u32* textureFlagStart = reinterpret_cast<u32*>(
+        SceneSectionData(SceneSectionType::TextureFlags, sections, data));
+    u64* meshChecksumStart = reinterpret_cast<u64*>(
+        SceneSectionData(SceneSectionType::MeshChecksums, sections, data));
+    u64* mipChecksumStart = reinterpret_cast<u64*>(
+        SceneSectionData(SceneSectionType::MipChecksums, sections, data));
+
+    sceneHeader->magic = FLY_SCENE_FILE_MAGIC;
+    sceneHeader->version = {FLY_SCENE_FILE_VERSION_MAJOR,
+                            FLY_SCENE_FILE_VERSION_MINOR, 0};
+    sceneHeader->sectionTableOffset = sectionTableOffset;
+    sceneHeader->sectionCount = sectionCount;
     sceneHeader->totalVertexCount = totalVertexCount;
     sceneHeader->totalIndexCount = totalIndexCount;
+    sceneHeader->totalIndex16Count = totalIndex16Count;
+    sceneHeader->geometryDataSize = geometryDataSize;
+    sceneHeader->flags = encoded ? FLY_SCENE_FILE_COMPRESSED_GEOMETRY_BIT
+                                 : FLY_SCENE_FILE_NONE_BIT;
     sceneHeader->totalSubmeshCount = totalSubmeshCount;
     sceneHeader->totalLodCount = totalLodCount;
+    sceneHeader->totalMeshletCount = totalMeshletCount;
+    sceneHeader->totalMeshletVertexCount = totalMeshletVertexCount;
+    sceneHeader->totalMeshletTriangleCount = totalMeshletTriangleCount;
     sceneHeader->textureCount = sceneData.imageCount;
     sceneHeader->meshCount = sceneData.geometryCount;
     sceneHeader->nodeCount = sceneData.nodeCount;
     sceneHeader->materialCount = sceneData.materialCount;
+    sceneHeader->totalMipCount = totalMipCount;
 
-    SerializeImages(sceneData, imageHeaderStart, imageDataStart);
+    SerializeImages(sceneData, imageHeaderStart, textureFlagStart,
+                    imageDataStart);
     SerializeMaterials(sceneData, pbrMaterialStart);
     SerializeNodes(sceneData, sceneNodeStart);
-    SerializeMeshes(sceneData, meshHeaderStart, lodStart,
-                    submeshMaterialIndexStart, vertexStart, indexStart);
+    SerializeMeshes(sceneData, encoded, meshHeaderStart, lodStart,
+                    submeshMaterialIndexStart, geometryDataStart,
+                    totalVertexCount, totalIndexCount, meshletStart,
+                    meshletVertexStart, meshletTriangleStart);
+    ChecksumMeshes(sceneData, meshHeaderStart, geometryDataStart,
+                   meshChecksumStart);
+    ChecksumMips(sceneData, imageHeaderStart, imageDataStart,
+                 mipChecksumStart);
+
+    if (encoded)
+    {
+        for (u32 i = 0; i < sceneData.geometryCount; i++)
+        {
+            Free(encoded[i].vertexData);
+            Free(encoded[i].indexData);
+        }
+        Free(encoded);
+    }
+
+    for (u32 i = 0; i < sectionCount; i++)
+    {
+        if (sections[i].size)
+        {
+            sections[i].checksum =
+                Hash64(data + sections[i].offset, sections[i].size);
+        }
+    }
+    memcpy(data + sectionTableOffset, sections,
+           sizeof(SceneFileSection) * sectionCount);
+    sceneHeader->sectionTableChecksum = Hash64(
+        data + sectionTableOffset, sizeof(SceneFileSection) * sectionCount);
 
     String8 str(reinterpret_cast<char*>(data), totalSize);
     bool res = WriteStringToFile(str, path);
@@ -809,6 +1742,11 @@ void DestroySceneData(SceneData& sceneData)
         }
     }
 
+    if (sceneData.imageFlags)
+    {
+        Free(sceneData.imageFlags);
+    }
+
     sceneData = {};
 }
 
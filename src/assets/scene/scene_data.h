@@ -19,15 +19,26 @@ struct SceneData
     SerializedSceneNode* nodes = nullptr;
     Geometry* geometries = nullptr;
     Image* images = nullptr;
+    // SceneTextureFlags of every image
+    u32* imageFlags = nullptr;
     u32 nodeCount = 0;
     u32 geometryCount = 0;
     u32 imageCount = 0;
     u32 materialCount = 0;
 };
 
+// With a cache directory compressed textures are reused across scenes and
+// runs
 bool CookSceneData(String8 path, const SceneExportOptions& options,
-               SceneData& sceneStorage);
-bool ExportSceneData(String8 path, const SceneData& sceneStorage);
+                   SceneData& sceneStorage,
+                   String8 cacheDirectory = String8());
+// Hashes the scene file, the files it references and the options into key
+bool HashSceneInputs(String8 path, const SceneExportOptions& options,
+                     u64& key);
+// Compressed geometry is encoded with the meshoptimizer vertex and index
+// codecs, usually 2 to 4 times smaller than the quantized vertices and indices
+bool ExportSceneData(String8 path, const SceneData& sceneStorage,
+                     bool compressGeometry = true);
 void DestroySceneData(SceneData& sceneData);
 
 } // namespace Fly
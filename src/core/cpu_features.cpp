@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_features.h"
+
+#if defined(FLY_PLATFORM_ARCH_X86) || defined(FLY_PLATFORM_ARCH_X86_64)
+#if defined(FLY_PLATFORM_COMPILER_CL)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(FLY_PLATFORM_ARCH_ARM_64)
+#if defined(FLY_PLATFORM_OS_LINUX)
+#include <sys/auxv.h>
+#elif defined(FLY_PLATFORM_OS_MAC_OSX)
+#include <sys/sysctl.h>
+#elif defined(FLY_PLATFORM_OS_WINDOWS)
+#include <windows.h>
+#endif
+#endif
+
+namespace Fly
+{
+
+static const char* sCpuFeatureNames[FLY_CPU_FEATURE_COUNT] = {
+    "sse2",     "sse3",     "ssse3",     "sse4.1",   "sse4.2",
+    "popcnt",   "avx",      "avx2",      "fma",      "f16c",
+    "bmi1",     "bmi2",     "avx512f",   "avx512bw", "avx512dq",
+    "avx512vl", "neon",     "neon-fp16", "dotprod",  "crc32",
+    "sve"};
+
+#if defined(FLY_PLATFORM_ARCH_X86) || defined(FLY_PLATFORM_ARCH_X86_64)
+
+static void Cpuid(u32 leaf, u32 subleaf, u32 regs[4])
+{
+#if defined(FLY_PLATFORM_COMPILER_CL)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (u32 i = 0; i < 4; i++)
+    {
+        regs[i] = static_cast<u32>(r[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 Xgetbv()
+{
+#if defined(FLY_PLATFORM_COMPILER_CL)
+    return _xgetbv(0);
+#else
+    u32 lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<u64>(hi) << 32) | lo;
+#endif
+}
+
+static u32 DetectCpuFeatures()
+{
+    u32 regs[4];
+    Cpuid(0, 0, regs);
+    u32 maxLeaf = regs[0];
+    if (maxLeaf < 1)
+    {
+        return FLY_CPU_FEATURE_NONE_BIT;
+    }
+
+    u32 features = FLY_CPU_FEATURE_NONE_BIT;
+
+    Cpuid(1, 0, regs);
+    u32 ecx = regs[2];
+    u32 edx = regs[3];
+    features |= (edx & (1u << 26)) ? FLY_CPU_FEATURE_SSE2_BIT : 0;
+    features |= (ecx & (1u << 0)) ? FLY_CPU_FEATURE_SSE3_BIT : 0;
+    features |= (ecx & (1u << 9)) ? FLY_CPU_FEATURE_SSSE3_BIT : 0;
+    features |= (ecx & (1u << 19)) ? FLY_CPU_FEATURE_SSE4_1_BIT : 0;
+    features |= (ecx & (1u << 20)) ? FLY_CPU_FEATURE_SSE4_2_BIT : 0;
+    features |= (ecx & (1u << 23)) ? FLY_CPU_FEATURE_POPCNT_BIT : 0;
+
+    // Vex and evex encoded instructions also need the os to save the
+    // extended register state
+    bool osxsave = ecx & (1u << 27);
+    u64 xcr0 = osxsave ? Xgetbv() : 0;
+    bool ymmState = (xcr0 & 0x6) == 0x6;
+    bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+    if (ymmState && (ecx & (1u << 28)))
+    {
+        features |= FLY_CPU_FEATURE_AVX_BIT;
+        features |= (ecx & (1u << 12)) ? FLY_CPU_FEATURE_FMA_BIT : 0;
+        features |= (ecx & (1u << 29)) ? FLY_CPU_FEATURE_F16C_BIT : 0;
+    }
+
+    if (maxLeaf >= 7)
+    {
+        Cpuid(7, 0, regs);
+        u32 ebx = regs[1];
+        features |= (ebx & (1u << 3)) ? FLY_CPU_FEATURE_BMI1_BIT : 0;
+        features |= (ebx & (1u << 8)) ? FLY_CPU_FEATURE_BMI2_BIT : 0;
+        if (features & FLY_CPU_FEATURE_AVX_BIT)
+        {
+            features |= (ebx & (1u << 5)) ? FLY_CPU_FEATURE_AVX2_BIT : 0;
+        }
+        if (zmmState && (ebx & (1u << 16)))
+        {
+            features |= FLY_CPU_FEATURE_AVX512F_BIT;
+            features |= (ebx & (1u << 17)) ? FLY_CPU_FEATURE_AVX512DQ_BIT : 0;
+            features |= (ebx & (1u << 30)) ? FLY_CPU_FEATURE_AVX512BW_BIT : 0;
+            features |= (ebx & (1u << 31)) ? FLY_CPU_FEATURE_AVX512VL_BIT : 0;
+        }
+    }
+
+    return features;
+}
+
+#elif defined(FLY_PLATFORM_ARCH_ARM_64)
+
+#if defined(FLY_PLATFORM_OS_MAC_OSX)
+static bool SysctlFlag(const char* name)
+{
+    int value = 0;
+    size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, nullptr, 0) != 0)
+    {
+        return false;
+    }
+    return value != 0;
+}
+#endif
+
+static u32 DetectCpuFeatures()
+{
+    // Advanced simd is mandatory on arm64
+    u32 features = FLY_CPU_FEATURE_NEON_BIT;
+
+#if defined(FLY_PLATFORM_OS_LINUX)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    features |= (hwcap & (1ul << 7)) ? FLY_CPU_FEATURE_CRC32_BIT : 0;
+    features |= (hwcap & (1ul << 10)) ? FLY_CPU_FEATURE_NEON_FP16_BIT : 0;
+    features |= (hwcap & (1ul << 20)) ? FLY_CPU_FEATURE_NEON_DOTPROD_BIT : 0;
+    features |= (hwcap & (1ul << 22)) ? FLY_CPU_FEATURE_SVE_BIT : 0;
+#elif defined(FLY_PLATFORM_OS_MAC_OSX)
+    features |= SysctlFlag("hw.optional.armv8_crc32")
+                    ? FLY_CPU_FEATURE_CRC32_BIT
+                    : 0;
+    features |= SysctlFlag("hw.optional.arm.FEAT_FP16")
+                    ? FLY_CPU_FEATURE_NEON_FP16_BIT
+                    : 0;
+    features |= SysctlFlag("hw.optional.arm.FEAT_DotProd")
+                    ? FLY_CPU_FEATURE_NEON_DOTPROD_BIT
+                    : 0;
+#elif defined(FLY_PLATFORM_OS_WINDOWS)
+    features |= IsProcessorFeaturePresent(
+                    PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE)
+                    ? FLY_CPU_FEATURE_CRC32_BIT
+                    : 0;
+#endif
+
+    return features;
+}
+
+#else
+
+static u32 DetectCpuFeatures() { return FLY_CPU_FEATURE_NONE_BIT; }
+
+#endif
+
+static bool NameEquals(const char* name, const char* str, u64 size)
+{
+    for (u64 i = 0; i < size; i++)
+    {
+        char c = str[i];
+        if (c >= 'A' && c <= 'Z')
+        {
+            c = c - 'A' + 'a';
+        }
+        if (name[i] != c)
+        {
+            return false;
+        }
+    }
+    return name[size] == '\0';
+}
+
+static u32 DisabledCpuFeatures()
+{
+    const char* disabled = getenv("FLY_DISABLE_CPU_FEATURES");
+    if (!disabled)
+    {
+        return FLY_CPU_FEATURE_NONE_BIT;
+    }
+
+    u32 features = FLY_CPU_FEATURE_NONE_BIT;
+    while (*disabled)
+    {
+        u64 size = strcspn(disabled, ", ");
+        for (u32 i = 0; i < FLY_CPU_FEATURE_COUNT; i++)
+        {
+            if (NameEquals(sCpuFeatureNames[i], disabled, size))
+            {
+                features |= 1u << i;
+            }
+        }
+        disabled += size;
+        disabled += strspn(disabled, ", ");
+    }
+    return features;
+}
+
+u32 GetCpuFeatures()
+{
+    static const u32 sFeatures = DetectCpuFeatures() & ~DisabledCpuFeatures();
+    return sFeatures;
+}
+
+bool HasCpuFeatures(u32 features)
+{
+    return (GetCpuFeatures() & features) == features;
+}
+
+const char* GetCpuFeatureName(CpuFeatureFlags feature)
+{
+    for (u32 i = 0; i < FLY_CPU_FEATURE_COUNT; i++)
+    {
+        if (feature == (1u << i))
+        {
+            return sCpuFeatureNames[i];
+        }
+    }
+    return "none";
+}
+
+} // namespace Fly
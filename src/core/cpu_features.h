@@ -0,0 +1,84 @@
+#ifndef FLY_CPU_FEATURES_H
+#define FLY_CPU_FEATURES_H
+
+#include "platform.h"
+#include "types.h"
+
+namespace Fly
+{
+
+enum CpuFeatureFlags
+{
+    FLY_CPU_FEATURE_NONE_BIT = 0,
+    // x86
+    FLY_CPU_FEATURE_SSE2_BIT = 1 << 0,
+    FLY_CPU_FEATURE_SSE3_BIT = 1 << 1,
+    FLY_CPU_FEATURE_SSSE3_BIT = 1 << 2,
+    FLY_CPU_FEATURE_SSE4_1_BIT = 1 << 3,
+    FLY_CPU_FEATURE_SSE4_2_BIT = 1 << 4,
+    FLY_CPU_FEATURE_POPCNT_BIT = 1 << 5,
+    FLY_CPU_FEATURE_AVX_BIT = 1 << 6,
+    FLY_CPU_FEATURE_AVX2_BIT = 1 << 7,
+    FLY_CPU_FEATURE_FMA_BIT = 1 << 8,
+    FLY_CPU_FEATURE_F16C_BIT = 1 << 9,
+    FLY_CPU_FEATURE_BMI1_BIT = 1 << 10,
+    FLY_CPU_FEATURE_BMI2_BIT = 1 << 11,
+    FLY_CPU_FEATURE_AVX512F_BIT = 1 << 12,
+    FLY_CPU_FEATURE_AVX512BW_BIT = 1 << 13,
+    FLY_CPU_FEATURE_AVX512DQ_BIT = 1 << 14,
+    FLY_CPU_FEATURE_AVX512VL_BIT = 1 << 15,
+    // arm
+    FLY_CPU_FEATURE_NEON_BIT = 1 << 16,
+    FLY_CPU_FEATURE_NEON_FP16_BIT = 1 << 17,
+    FLY_CPU_FEATURE_NEON_DOTPROD_BIT = 1 << 18,
+    FLY_CPU_FEATURE_CRC32_BIT = 1 << 19,
+    FLY_CPU_FEATURE_SVE_BIT = 1 << 20,
+    FLY_CPU_FEATURE_COUNT = 21
+};
+
+// Features supported by both the cpu and the os, queried once and cached.
+// Features can be masked out for testing with the FLY_DISABLE_CPU_FEATURES
+// environment variable, e.g. FLY_DISABLE_CPU_FEATURES=avx2,f16c
+u32 GetCpuFeatures();
+bool HasCpuFeatures(u32 features);
+const char* GetCpuFeatureName(CpuFeatureFlags feature);
+
+// Allows intrinsics of a feature set inside one function, so that kernels
+// for several instruction sets can live in a single translation unit. MSVC
+// does not need it.
+#if defined(FLY_PLATFORM_COMPILER_CL)
+#define FLY_CPU_TARGET(features)
+#else
+#define FLY_CPU_TARGET(features) __attribute__((target(features)))
+#endif
+
+// One implementation of a multi-versioned kernel
+template <typename Func>
+struct CpuKernel
+{
+    u32 requiredFeatures;
+    Func func;
+};
+
+// Picks the first kernel whose features are supported. Kernels are ordered
+// from the most specialized to the portable one, which must require
+// nothing. Cache the result, e.g.
+//
+// static const ConvertFunc sConvert = SelectCpuKernel(sConvertKernels);
+template <typename Func, u32 N>
+Func SelectCpuKernel(const CpuKernel<Func> (&kernels)[N])
+{
+    static_assert(N > 0, "Empty kernel list");
+    for (u32 i = 0; i + 1 < N; i++)
+    {
+        if (HasCpuFeatures(kernels[i].requiredFeatures))
+        {
+            return kernels[i].func;
+        }
+    }
+    return kernels[N - 1].func;
+}
+
+} // namespace Fly
+
+#endif /* FLY_CPU_FEATURES_H */
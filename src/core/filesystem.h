@@ -12,6 +12,26 @@ char* ReadFileToCStr(Arena&, String8 path, u64& size, u32 align = 1);
 String8 ReadFileToString(Arena& arena, String8 filename, u32 align = 1);
 bool WriteStringToFile(String8 str, String8 path, bool append = false);
 
+struct MappedFile
+{
+    const u8* data = nullptr;
+    u64 size = 0;
+    // File mapping object on windows
+    void* handle = nullptr;
+};
+
+// Maps a whole non empty file read only, data stays valid until UnmapFile
+bool MapFile(String8 path, MappedFile& file);
+void UnmapFile(MappedFile& file);
+
+bool FileExists(String8 path);
+bool RemoveFile(String8 path);
+// Replaces to if it exists
+bool RenameFile(String8 from, String8 to);
+// Hard links to to from, copies when the filesystem can not link. Replaces to
+// if it exists.
+bool LinkOrCopyFile(String8 from, String8 to);
+
 String8 CurrentWorkingDirectory(Arena& arena);
 String8 ParentDirectory(String8 path);
 
@@ -1,4 +1,6 @@
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -17,6 +19,8 @@
 
 #define FLY_PATH_SEPARATOR '/'
 
+#define FLY_COPY_CHUNK_SIZE (64 * 1024)
+
 namespace Fly
 {
 
@@ -33,17 +37,10 @@ bool CreateDirectories(String8 path)
         if (*p == '/' || *p == '\\')
         {
             *p = '\0';
-            if (mkdir(tmp, 0755) != 0)
+            if (mkdir(tmp, 0755) != 0 && errno != EEXIST)
             {
-                if (errno == EEXIST)
-                {
-                    continue;
-                }
-                else
-                {
-                    result = false;
-                    break;
-                }
+                result = false;
+                break;
             }
             *p = '/';
         }
@@ -53,6 +50,158 @@ bool CreateDirectories(String8 path)
     return result;
 }
 
+bool FileExists(String8 path)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    struct stat st;
+    bool result = stat(String8::PushCStr(scratch, path), &st) == 0 &&
+                  S_ISREG(st.st_mode);
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool RemoveFile(String8 path)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    bool result = unlink(String8::PushCStr(scratch, path)) == 0;
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool RenameFile(String8 from, String8 to)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    bool result = rename(String8::PushCStr(scratch, from),
+                         String8::PushCStr(scratch, to)) == 0;
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+// Copies through a small buffer, so files of any size stay out of the arenas
+static bool CopyFile(const char* from, const char* to)
+{
+    int fromFd = open(from, O_RDONLY);
+    if (fromFd == -1)
+    {
+        return false;
+    }
+    int toFd = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (toFd == -1)
+    {
+        close(fromFd);
+        return false;
+    }
+
+    char buffer[FLY_COPY_CHUNK_SIZE];
+    bool result = true;
+    while (result)
+    {
+        ssize_t readSize = read(fromFd, buffer, sizeof(buffer));
+        if (readSize == 0)
+        {
+            break;
+        }
+        if (readSize < 0)
+        {
+            result = errno == EINTR;
+            continue;
+        }
+
+        ssize_t offset = 0;
+        while (offset < readSize)
+        {
+            ssize_t written = write(toFd, buffer + offset, readSize - offset);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                result = false;
+                break;
+            }
+            offset += written;
+        }
+    }
+
+    close(fromFd);
+    if (close(toFd) != 0)
+    {
+        result = false;
+    }
+    if (!result)
+    {
+        unlink(to);
+    }
+    return result;
+}
+
+bool LinkOrCopyFile(String8 from, String8 to)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    const char* fromCStr = String8::PushCStr(scratch, from);
+    const char* toCStr = String8::PushCStr(scratch, to);
+
+    unlink(toCStr);
+    bool result = link(fromCStr, toCStr) == 0 || CopyFile(fromCStr, toCStr);
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool MapFile(String8 path, MappedFile& file)
+{
+    file = {};
+
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+    int fd = open(String8::PushCStr(scratch, path), O_RDONLY);
+    ArenaPopToMarker(scratch, marker);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    file.data = static_cast<const u8*>(data);
+    file.size = static_cast<u64>(st.st_size);
+    return true;
+}
+
+void UnmapFile(MappedFile& file)
+{
+    if (file.data)
+    {
+        munmap(const_cast<u8*>(file.data), file.size);
+    }
+    file = {};
+}
+
 String8 CurrentWorkingDirectory(Arena& arena)
 {
     char* buffer = FLY_PUSH_ARENA(arena, char, PATH_MAX);
@@ -45,4 +45,111 @@ bool CreateDirectories(String8 path)
     return result;
 }
 
+bool FileExists(String8 path)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    DWORD attributes = GetFileAttributesA(String8::PushCStr(scratch, path));
+    bool result = attributes != INVALID_FILE_ATTRIBUTES &&
+                  !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool RemoveFile(String8 path)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    bool result = DeleteFileA(String8::PushCStr(scratch, path));
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool RenameFile(String8 from, String8 to)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    bool result = MoveFileExA(String8::PushCStr(scratch, from),
+                              String8::PushCStr(scratch, to),
+                              MOVEFILE_REPLACE_EXISTING);
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool LinkOrCopyFile(String8 from, String8 to)
+{
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+
+    const char* fromCStr = String8::PushCStr(scratch, from);
+    const char* toCStr = String8::PushCStr(scratch, to);
+
+    DeleteFileA(toCStr);
+    bool result = CreateHardLinkA(toCStr, fromCStr, nullptr) ||
+                  CopyFileA(fromCStr, toCStr, FALSE);
+
+    ArenaPopToMarker(scratch, marker);
+    return result;
+}
+
+bool MapFile(String8 path, MappedFile& file)
+{
+    file = {};
+
+    Arena& scratch = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(scratch);
+    HANDLE fileHandle = CreateFileA(
+        String8::PushCStr(scratch, path), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    ArenaPopToMarker(scratch, marker);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart <= 0)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    // The mapping object keeps its own reference to the file
+    HANDLE mapping =
+        CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(fileHandle);
+    if (!mapping)
+    {
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    file.data = static_cast<const u8*>(data);
+    file.size = static_cast<u64>(size.QuadPart);
+    file.handle = mapping;
+    return true;
+}
+
+void UnmapFile(MappedFile& file)
+{
+    if (file.data)
+    {
+        UnmapViewOfFile(file.data);
+        CloseHandle(static_cast<HANDLE>(file.handle));
+    }
+    file = {};
+}
+
 } // namespace Fly
@@ -0,0 +1,135 @@
+#include "half.h"
+#include "cpu_features.h"
+
+#if defined(FLY_PLATFORM_ARCH_X86_64)
+#include <immintrin.h>
+#elif defined(FLY_PLATFORM_ARCH_ARM_64)
+#include <arm_neon.h>
+#endif
+
+using namespace Fly;
+
+typedef void (*ConvertF32ToF16Func)(f16*, const f32*, u64);
+typedef void (*ConvertF16ToF32Func)(f32*, const f16*, u64);
+
+static void ConvertF32ToF16Scalar(f16* dst, const f32* src, u64 count)
+{
+    for (u64 i = 0; i < count; i++)
+    {
+        dst[i].data = f16::QuantizeHalf(src[i]);
+    }
+}
+
+static void ConvertF16ToF32Scalar(f32* dst, const f16* src, u64 count)
+{
+    for (u64 i = 0; i < count; i++)
+    {
+        dst[i] = f16::DequantizeHalf(src[i]);
+    }
+}
+
+#if defined(FLY_PLATFORM_ARCH_X86_64)
+
+FLY_CPU_TARGET("avx,f16c")
+static void ConvertF32ToF16F16C(f16* dst, const f32* src, u64 count)
+{
+    u64 i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(src + i);
+        __m128i h = _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    for (; i < count; i++)
+    {
+        __m128i h = _mm_cvtps_ph(_mm_set_ss(src[i]), _MM_FROUND_TO_NEAREST_INT);
+        dst[i].data = static_cast<u16>(_mm_cvtsi128_si32(h));
+    }
+}
+
+FLY_CPU_TARGET("avx,f16c")
+static void ConvertF16ToF32F16C(f32* dst, const f16* src, u64 count)
+{
+    u64 i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i h =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    for (; i < count; i++)
+    {
+        __m128 v = _mm_cvtph_ps(_mm_cvtsi32_si128(src[i].data));
+        dst[i] = _mm_cvtss_f32(v);
+    }
+}
+
+static const CpuKernel<ConvertF32ToF16Func> sConvertF32ToF16Kernels[] = {
+    {FLY_CPU_FEATURE_F16C_BIT, ConvertF32ToF16F16C},
+    {FLY_CPU_FEATURE_NONE_BIT, ConvertF32ToF16Scalar},
+};
+
+static const CpuKernel<ConvertF16ToF32Func> sConvertF16ToF32Kernels[] = {
+    {FLY_CPU_FEATURE_F16C_BIT, ConvertF16ToF32F16C},
+    {FLY_CPU_FEATURE_NONE_BIT, ConvertF16ToF32Scalar},
+};
+
+#elif defined(FLY_PLATFORM_ARCH_ARM_64)
+
+static void ConvertF32ToF16Neon(f16* dst, const f32* src, u64 count)
+{
+    u64 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float16x4_t h = vcvt_f16_f32(vld1q_f32(src + i));
+        vst1_u16(reinterpret_cast<u16*>(dst + i), vreinterpret_u16_f16(h));
+    }
+    ConvertF32ToF16Scalar(dst + i, src + i, count - i);
+}
+
+static void ConvertF16ToF32Neon(f32* dst, const f16* src, u64 count)
+{
+    u64 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint16x4_t h = vld1_u16(reinterpret_cast<const u16*>(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(h)));
+    }
+    ConvertF16ToF32Scalar(dst + i, src + i, count - i);
+}
+
+static const CpuKernel<ConvertF32ToF16Func> sConvertF32ToF16Kernels[] = {
+    {FLY_CPU_FEATURE_NEON_BIT, ConvertF32ToF16Neon},
+    {FLY_CPU_FEATURE_NONE_BIT, ConvertF32ToF16Scalar},
+};
+
+static const CpuKernel<ConvertF16ToF32Func> sConvertF16ToF32Kernels[] = {
+    {FLY_CPU_FEATURE_NEON_BIT, ConvertF16ToF32Neon},
+    {FLY_CPU_FEATURE_NONE_BIT, ConvertF16ToF32Scalar},
+};
+
+#else
+
+static const CpuKernel<ConvertF32ToF16Func> sConvertF32ToF16Kernels[] = {
+    {FLY_CPU_FEATURE_NONE_BIT, ConvertF32ToF16Scalar},
+};
+
+static const CpuKernel<ConvertF16ToF32Func> sConvertF16ToF32Kernels[] = {
+    {FLY_CPU_FEATURE_NONE_BIT, ConvertF16ToF32Scalar},
+};
+
+#endif
+
+void ConvertF32ToF16(f16* dst, const f32* src, u64 count)
+{
+    static const ConvertF32ToF16Func sConvert =
+        SelectCpuKernel(sConvertF32ToF16Kernels);
+    sConvert(dst, src, count);
+}
+
+void ConvertF16ToF32(f32* dst, const f16* src, u64 count)
+{
+    static const ConvertF16ToF32Func sConvert =
+        SelectCpuKernel(sConvertF16ToF32Kernels);
+    sConvert(dst, src, count);
+}
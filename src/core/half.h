@@ -0,0 +1,14 @@
+#ifndef FLY_HALF_H
+#define FLY_HALF_H
+
+#include "types.h"
+
+// Bulk f32 <-> f16 conversions. Use F16C on x86-64 when the cpu supports
+// it and NEON on arm64, otherwise fall back to QuantizeHalf/DequantizeHalf.
+// Hardware paths round to nearest even and keep denormals, so results may
+// differ from the scalar fallback in the last bit and for values below
+// 2^-14.
+void ConvertF32ToF16(f16* dst, const f32* src, u64 count);
+void ConvertF16ToF32(f32* dst, const f16* src, u64 count);
+
+#endif /* FLY_HALF_H */
@@ -13,4 +13,11 @@ u64 Hash64(const void* data, u64 size)
     return XXH64(data, size, HASH_SEED);
 }
 
+u64 Hash64(const void* data, u64 size, u64 seed)
+{
+    FLY_ASSERT(data);
+    FLY_ASSERT(size > 0);
+    return XXH64(data, size, seed);
+}
+
 } // namespace Fly
@@ -7,6 +7,8 @@ namespace Fly
 {
 
 u64 Hash64(const void* data, u64 size);
+// Pass a previous hash as seed to hash data that is not contiguous
+u64 Hash64(const void* data, u64 size, u64 seed);
 
 template <typename T>
 struct Hash;
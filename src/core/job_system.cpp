@@ -0,0 +1,200 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "assert.h"
+#include "job_system.h"
+#include "memory.h"
+#include "thread_context.h"
+
+namespace Fly
+{
+
+struct JobBatch
+{
+    JobFunc func = nullptr;
+    void* userData = nullptr;
+    u32 count = 0;
+    std::atomic<u32> next{0};
+    // Workers that may still touch the batch, guarded by the mutex
+    u32 refs = 0;
+    JobBatch* prev = nullptr;
+    JobBatch* nextBatch = nullptr;
+};
+
+struct JobSystem
+{
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable batchReleased;
+    JobBatch* batches = nullptr;
+    std::thread* workers = nullptr;
+    u32 workerCount = 0;
+    bool quit = false;
+};
+
+static JobSystem sJobSystem;
+
+static void RunBatch(JobBatch& batch)
+{
+    for (;;)
+    {
+        u32 index = batch.next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= batch.count)
+        {
+            break;
+        }
+        batch.func(index, batch.userData);
+    }
+}
+
+// Must be called with the mutex locked
+static void UnlinkBatch(JobBatch& batch)
+{
+    if (batch.prev)
+    {
+        batch.prev->nextBatch = batch.nextBatch;
+    }
+    else if (sJobSystem.batches == &batch)
+    {
+        sJobSystem.batches = batch.nextBatch;
+    }
+    else
+    {
+        // Already unlinked
+        return;
+    }
+
+    if (batch.nextBatch)
+    {
+        batch.nextBatch->prev = batch.prev;
+    }
+    batch.prev = nullptr;
+    batch.nextBatch = nullptr;
+}
+
+static void WorkerMain()
+{
+    InitArenas();
+
+    std::unique_lock<std::mutex> lock(sJobSystem.mutex);
+    for (;;)
+    {
+        sJobSystem.wakeWorkers.wait(
+            lock, [] { return sJobSystem.quit || sJobSystem.batches; });
+        if (sJobSystem.quit)
+        {
+            break;
+        }
+
+        // Newest batch first, so nested loops finish before outer ones
+        JobBatch& batch = *sJobSystem.batches;
+        batch.refs++;
+        lock.unlock();
+
+        RunBatch(batch);
+
+        lock.lock();
+        UnlinkBatch(batch);
+        if (--batch.refs == 0)
+        {
+            sJobSystem.batchReleased.notify_all();
+        }
+    }
+    lock.unlock();
+
+    ReleaseThreadContext();
+}
+
+void InitJobSystem(u32 workerCount)
+{
+    FLY_ASSERT(!sJobSystem.workers);
+
+    if (workerCount == 0)
+    {
+        u32 hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    sJobSystem.quit = false;
+    sJobSystem.workerCount = workerCount;
+    if (workerCount == 0)
+    {
+        return;
+    }
+
+    sJobSystem.workers =
+        static_cast<std::thread*>(Alloc(sizeof(std::thread) * workerCount));
+    for (u32 i = 0; i < workerCount; i++)
+    {
+        new (&sJobSystem.workers[i]) std::thread(WorkerMain);
+    }
+}
+
+void ShutdownJobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sJobSystem.mutex);
+        FLY_ASSERT(!sJobSystem.batches);
+        sJobSystem.quit = true;
+    }
+    sJobSystem.wakeWorkers.notify_all();
+
+    for (u32 i = 0; i < sJobSystem.workerCount && sJobSystem.workers; i++)
+    {
+        sJobSystem.workers[i].join();
+        sJobSystem.workers[i].~thread();
+    }
+    Free(sJobSystem.workers);
+    sJobSystem.workers = nullptr;
+    sJobSystem.workerCount = 0;
+}
+
+u32 GetJobWorkerCount() { return sJobSystem.workerCount; }
+
+void ParallelFor(u32 count, JobFunc func, void* userData)
+{
+    FLY_ASSERT(func);
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (count == 1 || !sJobSystem.workers)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            func(i, userData);
+        }
+        return;
+    }
+
+    JobBatch batch;
+    batch.func = func;
+    batch.userData = userData;
+    batch.count = count;
+
+    {
+        std::lock_guard<std::mutex> lock(sJobSystem.mutex);
+        batch.nextBatch = sJobSystem.batches;
+        if (sJobSystem.batches)
+        {
+            sJobSystem.batches->prev = &batch;
+        }
+        sJobSystem.batches = &batch;
+    }
+    sJobSystem.wakeWorkers.notify_all();
+
+    RunBatch(batch);
+
+    // Every index is taken at this point. Wait for the workers that are
+    // still running one before the batch goes out of scope.
+    std::unique_lock<std::mutex> lock(sJobSystem.mutex);
+    UnlinkBatch(batch);
+    sJobSystem.batchReleased.wait(lock, [&batch] { return batch.refs == 0; });
+}
+
+} // namespace Fly
@@ -0,0 +1,25 @@
+#ifndef FLY_CORE_JOB_SYSTEM_H
+#define FLY_CORE_JOB_SYSTEM_H
+
+#include "types.h"
+
+namespace Fly
+{
+
+typedef void (*JobFunc)(u32 index, void* userData);
+
+// Starts worker threads, each with its own thread context. Zero workers
+// means one per hardware thread except the calling one.
+void InitJobSystem(u32 workerCount = 0);
+void ShutdownJobSystem();
+u32 GetJobWorkerCount();
+
+// Calls func for every index in [0, count) on the workers and the calling
+// thread and returns once all of them are done. Can be called from inside a
+// job. Without an initialized job system the loop runs on the calling
+// thread.
+void ParallelFor(u32 count, JobFunc func, void* userData);
+
+} // namespace Fly
+
+#endif /* FLY_CORE_JOB_SYSTEM_H */
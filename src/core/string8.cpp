@@ -19,12 +19,12 @@ bool CharIsExponent(i32 c) { return c == 'e' || c == 'E'; }
 
 bool CharIsNewline(i32 c) { return c == '\n'; }
 
-bool String8::operator==(String8 rhs)
+bool String8::operator==(String8 rhs) const
 {
     return size_ == rhs.size_ && (!size_ || !memcmp(data_, rhs.data_, size_));
 }
 
-bool String8::operator!=(String8 rhs) { return !(*this == rhs); }
+bool String8::operator!=(String8 rhs) const { return !(*this == rhs); }
 
 bool String8::StartsWith(String8 str, String8 pattern)
 {
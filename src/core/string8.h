@@ -29,8 +29,8 @@ struct String8
 
     inline operator bool() const { return data_ && size_; }
 
-    bool operator==(String8 rhs);
-    bool operator!=(String8 rhs);
+    bool operator==(String8 rhs) const;
+    bool operator!=(String8 rhs) const;
 
     inline const char* Data() const { return data_; }
     inline u64 Size() const { return size_; }
@@ -7,7 +7,6 @@ union FloatBits
 };
 
 // Impl taken from meshoptimizer
-// TODO: Newer CPU with F16C should have special instruction for conversion!
 u16 f16::QuantizeHalf(f32 v)
 {
     FloatBits u = {v};
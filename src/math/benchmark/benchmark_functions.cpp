@@ -143,11 +143,145 @@ void BenchmarkInvSqrt()
     }
 }
 
+static f32 sValues[COUNT];
+static f32 sResults[COUNT];
+static f32 sResults2[COUNT];
+
+static void PrintComparison(const char* flyName, const char* stdlibName,
+                            u64 flyTime, u64 stdlibTime)
+{
+    printf("Fly - %s - %f s\n", flyName, Fly::ToSeconds(flyTime));
+    printf("cmath - %s - %f s\n", stdlibName, Fly::ToSeconds(stdlibTime));
+
+    if (flyTime < stdlibTime)
+    {
+        printf("Fly %s is %f times faster than cmath one\n\n", flyName,
+               Fly::ToSeconds(stdlibTime) / Fly::ToSeconds(flyTime));
+    }
+    else
+    {
+        printf("cmath %s is %f times faster than Fly one\n\n", stdlibName,
+               Fly::ToSeconds(flyTime) / Fly::ToSeconds(stdlibTime));
+    }
+}
+
+static void FillValues(f32 min, f32 max)
+{
+    for (i32 i = 0; i < COUNT; i++)
+    {
+        sValues[i] = min + (max - min) * static_cast<f32>(i) / COUNT;
+        sResults[i] = 0.0f;
+        sResults2[i] = 0.0f;
+    }
+}
+
+void BenchmarkFastSin()
+{
+    u64 flyStart = Fly::ClockNow();
+    for (i32 i = 0; i < COUNT; i++)
+    {
+        volatile f32 s = Fly::Math::FastSin(static_cast<f32>(i));
+    }
+    u64 flyEnd = Fly::ClockNow();
+
+    u64 stdlibStart = Fly::ClockNow();
+    for (i32 i = 0; i < COUNT; i++)
+    {
+        volatile f32 s = sinf(static_cast<f32>(i));
+    }
+    u64 stdlibEnd = Fly::ClockNow();
+
+    PrintComparison("FastSin()", "sin()", flyEnd - flyStart,
+                    stdlibEnd - stdlibStart);
+}
+
+void BenchmarkFastSinCosBatch()
+{
+    FillValues(-1000.0f, 1000.0f);
+
+    u64 flyStart = Fly::ClockNow();
+    Fly::Math::FastSinCos(sValues, sResults, sResults2, COUNT);
+    u64 flyEnd = Fly::ClockNow();
+
+    u64 stdlibStart = Fly::ClockNow();
+    for (i32 i = 0; i < COUNT; i++)
+    {
+        sResults[i] = sinf(sValues[i]);
+        sResults2[i] = cosf(sValues[i]);
+    }
+    u64 stdlibEnd = Fly::ClockNow();
+
+    PrintComparison("FastSinCos() batch", "sin() + cos()", flyEnd - flyStart,
+                    stdlibEnd - stdlibStart);
+}
+
+void BenchmarkFastExpBatch()
+{
+    FillValues(-80.0f, 80.0f);
+
+    u64 flyStart = Fly::ClockNow();
+    Fly::Math::FastExp(sValues, sResults, COUNT);
+    u64 flyEnd = Fly::ClockNow();
+
+    u64 stdlibStart = Fly::ClockNow();
+    for (i32 i = 0; i < COUNT; i++)
+    {
+        sResults[i] = expf(sValues[i]);
+    }
+    u64 stdlibEnd = Fly::ClockNow();
+
+    PrintComparison("FastExp() batch", "exp()", flyEnd - flyStart,
+                    stdlibEnd - stdlibStart);
+}
+
+void BenchmarkFastLog2Batch()
+{
+    FillValues(1e-3f, 1000.0f);
+
+    u64 flyStart = Fly::ClockNow();
+    Fly::Math::FastLog2(sValues, sResults, COUNT);
+    u64 flyEnd = Fly::ClockNow();
+
+    u64 stdlibStart = Fly::ClockNow();
+    for (i32 i = 0; i < COUNT; i++)
+    {
+        sResults[i] = log2f(sValues[i]);
+    }
+    u64 stdlibEnd = Fly::ClockNow();
+
+    PrintComparison("FastLog2() batch", "log2()", flyEnd - flyStart,
+                    stdlibEnd - stdlibStart);
+}
+
+void BenchmarkFastPowBatch()
+{
+    FillValues(1e-3f, 1.0f);
+
+    u64 flyStart = Fly::ClockNow();
+    Fly::Math::FastPow(sValues, 2.2f, sResults, COUNT);
+    u64 flyEnd = Fly::ClockNow();
+
+    u64 stdlibStart = Fly::ClockNow();
+    for (i32 i = 0; i < COUNT; i++)
+    {
+        sResults[i] = powf(sValues[i], 2.2f);
+    }
+    u64 stdlibEnd = Fly::ClockNow();
+
+    PrintComparison("FastPow() batch", "pow()", flyEnd - flyStart,
+                    stdlibEnd - stdlibStart);
+}
+
 int main()
 {
     BenchmarkRand();
     BenchmarkSin();
     BenchmarkCos();
     BenchmarkInvSqrt();
+    BenchmarkFastSin();
+    BenchmarkFastSinCosBatch();
+    BenchmarkFastExpBatch();
+    BenchmarkFastLog2Batch();
+    BenchmarkFastPowBatch();
     return 0;
 }
@@ -0,0 +1,264 @@
+#include "frustum.h"
+#include "functions.h"
+#include "simd.h"
+
+namespace Fly
+{
+namespace Math
+{
+
+Plane NormalizePlane(Plane plane)
+{
+    f32 length = Length(plane.normal);
+    if (length < MinF32())
+    {
+        // Degenerate plane (e.g. infinite far plane), never rejects anything
+        return Plane(Vec3(0.0f), MaxF32());
+    }
+    f32 invLength = 1.0f / length;
+    return Plane(plane.normal * invLength, plane.distance * invLength);
+}
+
+static Vec4 MatrixRow(const Mat4& m, u32 row)
+{
+    return Vec4(m.data[row], m.data[4 + row], m.data[8 + row],
+                m.data[12 + row]);
+}
+
+static Plane PlaneFromVec4(Vec4 v)
+{
+    return NormalizePlane(Plane(Vec3(v.x, v.y, v.z), v.w));
+}
+
+Frustum ExtractFrustum(const Mat4& viewProjection)
+{
+    // Gribb-Hartmann. Clip space is -w <= x,y <= w and 0 <= z <= w,
+    // with z = w on the near plane because of reverse-z.
+    Vec4 row0 = MatrixRow(viewProjection, 0);
+    Vec4 row1 = MatrixRow(viewProjection, 1);
+    Vec4 row2 = MatrixRow(viewProjection, 2);
+    Vec4 row3 = MatrixRow(viewProjection, 3);
+
+    Frustum frustum;
+    frustum.planes[FRUSTUM_PLANE_LEFT] = PlaneFromVec4(row3 + row0);
+    frustum.planes[FRUSTUM_PLANE_RIGHT] = PlaneFromVec4(row3 - row0);
+    frustum.planes[FRUSTUM_PLANE_BOTTOM] = PlaneFromVec4(row3 + row1);
+    frustum.planes[FRUSTUM_PLANE_TOP] = PlaneFromVec4(row3 - row1);
+    frustum.planes[FRUSTUM_PLANE_NEAR] = PlaneFromVec4(row3 - row2);
+    frustum.planes[FRUSTUM_PLANE_FAR] = PlaneFromVec4(row2);
+    return frustum;
+}
+
+Sphere TransformSphere(const Sphere& sphere, const Mat4& transform)
+{
+    Vec4 center = transform * Vec4(sphere.center, 1.0f);
+
+    f32 maxScaleSqr = Max(LengthSqr(Vec3(transform[0])),
+                          Max(LengthSqr(Vec3(transform[1])),
+                              LengthSqr(Vec3(transform[2]))));
+    return Sphere(Vec3(center), sphere.radius * Sqrt(maxScaleSqr));
+}
+
+AABB TransformAABB(const AABB& aabb, const Mat4& transform)
+{
+    // Arvo's method: project the extents on the absolute basis
+    Vec3 center = (aabb.min + aabb.max) * 0.5f;
+    Vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+    Vec3 newCenter = Vec3(transform * Vec4(center, 1.0f));
+    Vec3 newExtent(0.0f);
+    for (i32 i = 0; i < 3; i++)
+    {
+        for (i32 j = 0; j < 3; j++)
+        {
+            newExtent[i] += Abs(transform[j][i]) * extent[j];
+        }
+    }
+    return AABB(newCenter - newExtent, newCenter + newExtent);
+}
+
+bool IsVisible(const Frustum& frustum, const Sphere& sphere)
+{
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        if (SignedDistance(frustum.planes[i], sphere.center) < -sphere.radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsVisible(const Frustum& frustum, const AABB& aabb)
+{
+    Vec3 center = (aabb.min + aabb.max) * 0.5f;
+    Vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        const Plane& plane = frustum.planes[i];
+        f32 radius = Abs(plane.normal.x) * extent.x +
+                     Abs(plane.normal.y) * extent.y +
+                     Abs(plane.normal.z) * extent.z;
+        if (SignedDistance(plane, center) < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct FrustumPlanesX4
+{
+    F32x4 nx[FRUSTUM_PLANE_COUNT];
+    F32x4 ny[FRUSTUM_PLANE_COUNT];
+    F32x4 nz[FRUSTUM_PLANE_COUNT];
+    F32x4 d[FRUSTUM_PLANE_COUNT];
+};
+
+static void SplatPlanes(const Frustum& frustum, FrustumPlanesX4& planes)
+{
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        planes.nx[i] = SplatF32x4(frustum.planes[i].normal.x);
+        planes.ny[i] = SplatF32x4(frustum.planes[i].normal.y);
+        planes.nz[i] = SplatF32x4(frustum.planes[i].normal.z);
+        planes.d[i] = SplatF32x4(frustum.planes[i].distance);
+    }
+}
+
+static u32 WriteVisibility(u32 mask, u32 laneCount, u8* visible)
+{
+    u32 visibleCount = 0;
+    for (u32 i = 0; i < laneCount; i++)
+    {
+        visible[i] = static_cast<u8>((mask >> i) & 1u);
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+
+static u32 CullSpheresX4(const FrustumPlanesX4& planes, F32x4 cx, F32x4 cy,
+                         F32x4 cz, F32x4 r)
+{
+    F32x4 zero = SplatF32x4(0.0f);
+    F32x4 inside = CmpGe(zero, zero);
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        F32x4 dist = MulAdd(planes.nx[i], cx,
+                            MulAdd(planes.ny[i], cy,
+                                   MulAdd(planes.nz[i], cz, planes.d[i])));
+        inside = inside & CmpGe(dist + r, zero);
+    }
+    return MoveMask(inside);
+}
+
+u32 CullSpheres(const Frustum& frustum, const f32* centerX,
+                const f32* centerY, const f32* centerZ, const f32* radius,
+                u32 count, u8* visible)
+{
+    FLY_ASSERT(centerX && centerY && centerZ && radius);
+    FLY_ASSERT(visible || count == 0);
+
+    FrustumPlanesX4 planes;
+    SplatPlanes(frustum, planes);
+
+    u32 visibleCount = 0;
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        u32 mask = CullSpheresX4(planes, LoadF32x4(centerX + i),
+                                 LoadF32x4(centerY + i),
+                                 LoadF32x4(centerZ + i), LoadF32x4(radius + i));
+        visibleCount += WriteVisibility(mask, 4, visible + i);
+    }
+
+    if (i < count)
+    {
+        f32 tail[4][4] = {};
+        for (u32 j = 0; i + j < count; j++)
+        {
+            tail[0][j] = centerX[i + j];
+            tail[1][j] = centerY[i + j];
+            tail[2][j] = centerZ[i + j];
+            tail[3][j] = radius[i + j];
+        }
+        u32 mask =
+            CullSpheresX4(planes, LoadF32x4(tail[0]), LoadF32x4(tail[1]),
+                          LoadF32x4(tail[2]), LoadF32x4(tail[3]));
+        visibleCount += WriteVisibility(mask, count - i, visible + i);
+    }
+
+    return visibleCount;
+}
+
+static u32 CullAABBsX4(const FrustumPlanesX4& planes, F32x4 minX, F32x4 minY,
+                       F32x4 minZ, F32x4 maxX, F32x4 maxY, F32x4 maxZ)
+{
+    F32x4 half = SplatF32x4(0.5f);
+    F32x4 zero = SplatF32x4(0.0f);
+
+    F32x4 cx = (minX + maxX) * half;
+    F32x4 cy = (minY + maxY) * half;
+    F32x4 cz = (minZ + maxZ) * half;
+    F32x4 ex = (maxX - minX) * half;
+    F32x4 ey = (maxY - minY) * half;
+    F32x4 ez = (maxZ - minZ) * half;
+
+    F32x4 inside = CmpGe(zero, zero);
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        F32x4 dist = MulAdd(planes.nx[i], cx,
+                            MulAdd(planes.ny[i], cy,
+                                   MulAdd(planes.nz[i], cz, planes.d[i])));
+        F32x4 r = MulAdd(Abs(planes.nx[i]), ex,
+                         MulAdd(Abs(planes.ny[i]), ey, Abs(planes.nz[i]) * ez));
+        inside = inside & CmpGe(dist + r, zero);
+    }
+    return MoveMask(inside);
+}
+
+u32 CullAABBs(const Frustum& frustum, const f32* minX, const f32* minY,
+              const f32* minZ, const f32* maxX, const f32* maxY,
+              const f32* maxZ, u32 count, u8* visible)
+{
+    FLY_ASSERT(minX && minY && minZ && maxX && maxY && maxZ);
+    FLY_ASSERT(visible || count == 0);
+
+    FrustumPlanesX4 planes;
+    SplatPlanes(frustum, planes);
+
+    u32 visibleCount = 0;
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        u32 mask = CullAABBsX4(planes, LoadF32x4(minX + i),
+                               LoadF32x4(minY + i), LoadF32x4(minZ + i),
+                               LoadF32x4(maxX + i), LoadF32x4(maxY + i),
+                               LoadF32x4(maxZ + i));
+        visibleCount += WriteVisibility(mask, 4, visible + i);
+    }
+
+    if (i < count)
+    {
+        f32 tail[6][4] = {};
+        for (u32 j = 0; i + j < count; j++)
+        {
+            tail[0][j] = minX[i + j];
+            tail[1][j] = minY[i + j];
+            tail[2][j] = minZ[i + j];
+            tail[3][j] = maxX[i + j];
+            tail[4][j] = maxY[i + j];
+            tail[5][j] = maxZ[i + j];
+        }
+        u32 mask = CullAABBsX4(planes, LoadF32x4(tail[0]), LoadF32x4(tail[1]),
+                               LoadF32x4(tail[2]), LoadF32x4(tail[3]),
+                               LoadF32x4(tail[4]), LoadF32x4(tail[5]));
+        visibleCount += WriteVisibility(mask, count - i, visible + i);
+    }
+
+    return visibleCount;
+}
+
+} // namespace Math
+} // namespace Fly
@@ -0,0 +1,89 @@
+#ifndef FLY_MATH_FRUSTUM_H
+#define FLY_MATH_FRUSTUM_H
+
+#include "mat.h"
+#include "vec.h"
+
+namespace Fly
+{
+namespace Math
+{
+
+// Points with Dot(normal, p) + distance >= 0 are in front of the plane
+struct Plane
+{
+    Vec3 normal = Vec3(0.0f, 0.0f, 1.0f);
+    f32 distance = 0.0f;
+
+    Plane() = default;
+    inline Plane(Vec3 n, f32 d) : normal(n), distance(d) {}
+};
+
+struct Sphere
+{
+    Vec3 center = Vec3(0.0f);
+    f32 radius = 0.0f;
+
+    Sphere() = default;
+    inline Sphere(Vec3 c, f32 r) : center(c), radius(r) {}
+};
+
+struct AABB
+{
+    Vec3 min = Vec3(0.0f);
+    Vec3 max = Vec3(0.0f);
+
+    AABB() = default;
+    inline AABB(Vec3 minCorner, Vec3 maxCorner) : min(minCorner), max(maxCorner)
+    {
+    }
+};
+
+enum FrustumPlane
+{
+    FRUSTUM_PLANE_LEFT = 0,
+    FRUSTUM_PLANE_RIGHT,
+    FRUSTUM_PLANE_BOTTOM,
+    FRUSTUM_PLANE_TOP,
+    FRUSTUM_PLANE_NEAR,
+    FRUSTUM_PLANE_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+// Plane normals point inside the frustum
+struct Frustum
+{
+    Plane planes[FRUSTUM_PLANE_COUNT];
+};
+
+Plane NormalizePlane(Plane plane);
+
+inline f32 SignedDistance(const Plane& plane, Vec3 point)
+{
+    return Dot(plane.normal, point) + plane.distance;
+}
+
+// Extracts world space planes from projection * view. Expects the Vulkan clip
+// space produced by Perspective/Ortho: reverse-z, depth 1 at near, 0 at far.
+Frustum ExtractFrustum(const Mat4& viewProjection);
+
+Sphere TransformSphere(const Sphere& sphere, const Mat4& transform);
+AABB TransformAABB(const AABB& aabb, const Mat4& transform);
+
+bool IsVisible(const Frustum& frustum, const Sphere& sphere);
+bool IsVisible(const Frustum& frustum, const AABB& aabb);
+
+// Batch tests over structure of arrays. visible[i] is set to 1 if the i-th
+// volume intersects the frustum and to 0 otherwise. Returns the number of
+// visible volumes.
+u32 CullSpheres(const Frustum& frustum, const f32* centerX,
+                const f32* centerY, const f32* centerZ, const f32* radius,
+                u32 count, u8* visible);
+u32 CullAABBs(const Frustum& frustum, const f32* minX, const f32* minY,
+              const f32* minZ, const f32* maxX, const f32* maxY,
+              const f32* maxZ, u32 count, u8* visible);
+
+} // namespace Math
+} // namespace Fly
+
+#endif /* FLY_MATH_FRUSTUM_H */
@@ -1,11 +1,59 @@
 #include "functions.h"
 #include "core/assert.h"
+#include "simd.h"
 
 #include <math.h>
 
 #define LUT_TABLE_SIZE 1024
 #define LUT_VALUE_SCALE LUT_TABLE_SIZE / FLY_MATH_TWO_PI
 
+// Cody-Waite split of pi/2, the high parts have trailing zero bits so that
+// q * part is exact for the supported range
+#define PI_OVER_TWO_HI 1.5703125f
+#define PI_OVER_TWO_MID 4.837512969970703125e-4f
+#define PI_OVER_TWO_LO 7.54978995489188216e-8f
+#define TWO_OVER_PI 0.636619772367581343f
+
+// Minimax coefficients on [-pi/4, pi/4] (Cephes)
+#define SIN_C0 -1.6666654611e-1f
+#define SIN_C1 8.3321608736e-3f
+#define SIN_C2 -1.9515295891e-4f
+#define COS_C0 4.166664568298827e-2f
+#define COS_C1 -1.388731625493765e-3f
+#define COS_C2 2.443315711809948e-5f
+
+#define LN2_HI 0.693359375f
+#define LN2_LO -2.12194440e-4f
+#define LN2 0.693147180559945309f
+#define LOG2E 1.44269504088896341f
+// log2(e) - 1
+#define LOG2E_MINUS_ONE 0.44269504088896340736f
+#define SQRT2 1.41421356237309505f
+
+// exp(r) = 1 + r + r^2 * P(r) on [-ln2/2, ln2/2] (Cephes)
+#define EXP_C0 1.9875691500e-4f
+#define EXP_C1 1.3981999507e-3f
+#define EXP_C2 8.3334519073e-3f
+#define EXP_C3 4.1665795894e-2f
+#define EXP_C4 1.6666665459e-1f
+#define EXP_C5 5.0000001201e-1f
+
+// log(1 + f) = f - f^2 / 2 + f^3 * P(f) on [sqrt(0.5) - 1, sqrt(2) - 1]
+#define LOG_C0 7.0376836292e-2f
+#define LOG_C1 -1.1514610310e-1f
+#define LOG_C2 1.1676998740e-1f
+#define LOG_C3 -1.2420140846e-1f
+#define LOG_C4 1.4249322787e-1f
+#define LOG_C5 -1.6668057665e-1f
+#define LOG_C6 2.0000714765e-1f
+#define LOG_C7 -2.4999993993e-1f
+#define LOG_C8 3.3333331174e-1f
+
+#define EXP_MAX_INPUT 88.72283935546875f
+#define EXP_MIN_INPUT -103.972084045410f
+#define EXP2_MAX_INPUT 128.0f
+#define EXP2_MIN_INPUT -150.0f
+
 thread_local u32 stSeed = 2025;
 
 namespace Fly
@@ -54,6 +102,388 @@ f32 Tan(f32 radians) { return tanf(radians); }
 
 f32 Atan2(f32 y, f32 x) { return atan2f(y, x); }
 
+static inline f32 BitsToF32(u32 bits)
+{
+    union
+    {
+        u32 u;
+        f32 f;
+    } v;
+    v.u = bits;
+    return v.f;
+}
+
+static inline u32 F32ToBits(f32 value)
+{
+    union
+    {
+        u32 u;
+        f32 f;
+    } v;
+    v.f = value;
+    return v.u;
+}
+
+static inline i32 RoundToI32(f32 value)
+{
+    return static_cast<i32>(value + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+// 2^exponent for exponent in [-252, 254], split in two factors to stay in
+// the normal range
+static inline f32 ScaleByPow2(f32 value, i32 exponent)
+{
+    i32 e0 = exponent >> 1;
+    i32 e1 = exponent - e0;
+    value *= BitsToF32(static_cast<u32>(e0 + 127) << 23);
+    return value * BitsToF32(static_cast<u32>(e1 + 127) << 23);
+}
+
+static inline f32 ExpPolynomial(f32 r)
+{
+    f32 p = EXP_C0;
+    p = p * r + EXP_C1;
+    p = p * r + EXP_C2;
+    p = p * r + EXP_C3;
+    p = p * r + EXP_C4;
+    p = p * r + EXP_C5;
+    return p * r * r + r + 1.0f;
+}
+
+void FastSinCos(f32 radians, f32& sin, f32& cos)
+{
+    i32 quadrant = RoundToI32(radians * TWO_OVER_PI);
+    f32 k = static_cast<f32>(quadrant);
+    f32 r = radians - k * PI_OVER_TWO_HI;
+    r = r - k * PI_OVER_TWO_MID;
+    r = r - k * PI_OVER_TWO_LO;
+
+    f32 z = r * r;
+    f32 s = r + r * z * (SIN_C0 + z * (SIN_C1 + z * SIN_C2));
+    f32 c = 1.0f - 0.5f * z + z * z * (COS_C0 + z * (COS_C1 + z * COS_C2));
+
+    // Odd quadrants swap sin and cos, bit 1 of the quadrant flips the sign
+    u32 q = static_cast<u32>(quadrant);
+    f32 swappedSin = (q & 1u) ? c : s;
+    f32 swappedCos = (q & 1u) ? s : c;
+    sin = BitsToF32(F32ToBits(swappedSin) ^ ((q & 2u) << 30));
+    cos = BitsToF32(F32ToBits(swappedCos) ^ (((q + 1u) & 2u) << 30));
+}
+
+f32 FastSin(f32 radians)
+{
+    f32 s, c;
+    FastSinCos(radians, s, c);
+    return s;
+}
+
+f32 FastCos(f32 radians)
+{
+    f32 s, c;
+    FastSinCos(radians, s, c);
+    return c;
+}
+
+f32 FastExp(f32 value)
+{
+    if (value > EXP_MAX_INPUT)
+    {
+        return InfinityF32();
+    }
+    if (value < EXP_MIN_INPUT)
+    {
+        return 0.0f;
+    }
+
+    i32 n = RoundToI32(value * LOG2E);
+    f32 q = static_cast<f32>(n);
+    f32 r = value - q * LN2_HI;
+    r = r - q * LN2_LO;
+    return ScaleByPow2(ExpPolynomial(r), n);
+}
+
+f32 FastExp2(f32 value)
+{
+    if (value >= EXP2_MAX_INPUT)
+    {
+        return InfinityF32();
+    }
+    if (value < EXP2_MIN_INPUT)
+    {
+        return 0.0f;
+    }
+
+    i32 n = RoundToI32(value);
+    f32 r = (value - static_cast<f32>(n)) * LN2;
+    return ScaleByPow2(ExpPolynomial(r), n);
+}
+
+f32 FastLog2(f32 value)
+{
+    if (!(value >= 0.0f))
+    {
+        return BitsToF32(0x7FC00000u);
+    }
+    if (value < MinF32())
+    {
+        return MinusInfinityF32();
+    }
+    if (value == InfinityF32())
+    {
+        return value;
+    }
+
+    u32 bits = F32ToBits(value);
+    i32 e = static_cast<i32>(bits >> 23) - 127;
+    f32 m = BitsToF32((bits & 0x007FFFFFu) | 0x3F800000u);
+    if (m > SQRT2)
+    {
+        m *= 0.5f;
+        e += 1;
+    }
+
+    f32 f = m - 1.0f;
+    f32 z = f * f;
+    f32 p = LOG_C0;
+    p = p * f + LOG_C1;
+    p = p * f + LOG_C2;
+    p = p * f + LOG_C3;
+    p = p * f + LOG_C4;
+    p = p * f + LOG_C5;
+    p = p * f + LOG_C6;
+    p = p * f + LOG_C7;
+    p = p * f + LOG_C8;
+    f32 y = f * z * p - 0.5f * z;
+
+    // (f + y) * log2(e) with the multiplication split to keep precision
+    f32 res = y * LOG2E_MINUS_ONE;
+    res += f * LOG2E_MINUS_ONE;
+    res += y;
+    res += f;
+    return res + static_cast<f32>(e);
+}
+
+f32 FastPow(f32 value, f32 exponent)
+{
+    return FastExp2(exponent * FastLog2(value));
+}
+
+template <typename F>
+static inline F ScaleByPow2(F value, typename F::Int exponent)
+{
+    typedef typename F::Int I;
+    I e0 = ShiftRightArithmetic(exponent, 1);
+    I e1 = exponent - e0;
+    I bias = SplatI32<I>(127);
+    value = value * BitCastToF32(ShiftLeft(e0 + bias, 23));
+    return value * BitCastToF32(ShiftLeft(e1 + bias, 23));
+}
+
+template <typename F>
+static inline F ExpPolynomial(F r)
+{
+    F p = Splat<F>(EXP_C0);
+    p = MulAdd(p, r, Splat<F>(EXP_C1));
+    p = MulAdd(p, r, Splat<F>(EXP_C2));
+    p = MulAdd(p, r, Splat<F>(EXP_C3));
+    p = MulAdd(p, r, Splat<F>(EXP_C4));
+    p = MulAdd(p, r, Splat<F>(EXP_C5));
+    return MulAdd(p, r * r, r + Splat<F>(1.0f));
+}
+
+template <typename F>
+static inline void SinCosKernel(F x, F& sin, F& cos)
+{
+    typedef typename F::Int I;
+
+    I quadrant = ConvertToI32(x * Splat<F>(TWO_OVER_PI));
+    F q = ConvertToF32(quadrant);
+    F r = x - q * Splat<F>(PI_OVER_TWO_HI);
+    r = r - q * Splat<F>(PI_OVER_TWO_MID);
+    r = r - q * Splat<F>(PI_OVER_TWO_LO);
+
+    F z = r * r;
+    F s = MulAdd(Splat<F>(SIN_C2), z, Splat<F>(SIN_C1));
+    s = MulAdd(s, z, Splat<F>(SIN_C0));
+    s = MulAdd(s, z * r, r);
+
+    F c = MulAdd(Splat<F>(COS_C2), z, Splat<F>(COS_C1));
+    c = MulAdd(c, z, Splat<F>(COS_C0));
+    c = MulAdd(c, z * z, Splat<F>(1.0f) - Splat<F>(0.5f) * z);
+
+    // Odd quadrants swap sin and cos, bit 1 of the quadrant flips the sign
+    I signBit = SplatI32<I>(static_cast<i32>(0x80000000u));
+    F swap = BitCastToF32(ShiftRightArithmetic(ShiftLeft(quadrant, 31), 31));
+    F sinSign = BitCastToF32(ShiftLeft(quadrant, 30) & signBit);
+    F cosSign =
+        BitCastToF32(ShiftLeft(quadrant + SplatI32<I>(1), 30) & signBit);
+
+    sin = Select(swap, c, s) ^ sinSign;
+    cos = Select(swap, s, c) ^ cosSign;
+}
+
+template <typename F>
+static inline F ExpKernel(F x)
+{
+    typedef typename F::Int I;
+
+    F clamped = Min(Max(x, Splat<F>(EXP_MIN_INPUT)), Splat<F>(EXP_MAX_INPUT));
+    I n = ConvertToI32(clamped * Splat<F>(LOG2E));
+    F q = ConvertToF32(n);
+    F r = clamped - q * Splat<F>(LN2_HI);
+    r = r - q * Splat<F>(LN2_LO);
+
+    F res = ScaleByPow2(ExpPolynomial(r), n);
+    res = Select(CmpLt(Splat<F>(EXP_MAX_INPUT), x), Splat<F>(InfinityF32()),
+                 res);
+    return Select(CmpLt(x, Splat<F>(EXP_MIN_INPUT)), Splat<F>(0.0f), res);
+}
+
+template <typename F>
+static inline F Exp2Kernel(F x)
+{
+    typedef typename F::Int I;
+
+    F clamped =
+        Min(Max(x, Splat<F>(EXP2_MIN_INPUT)), Splat<F>(EXP2_MAX_INPUT));
+    I n = ConvertToI32(clamped);
+    F r = (clamped - ConvertToF32(n)) * Splat<F>(LN2);
+
+    F res = ScaleByPow2(ExpPolynomial(r), n);
+    res = Select(CmpGe(x, Splat<F>(EXP2_MAX_INPUT)), Splat<F>(InfinityF32()),
+                 res);
+    return Select(CmpLt(x, Splat<F>(EXP2_MIN_INPUT)), Splat<F>(0.0f), res);
+}
+
+template <typename F>
+static inline F Log2Kernel(F x)
+{
+    typedef typename F::Int I;
+
+    I bits = BitCastToI32(x);
+    I e = ShiftRightLogical(bits, 23) - SplatI32<I>(127);
+    F m = BitCastToF32((bits & SplatI32<I>(0x007FFFFF)) |
+                       SplatI32<I>(0x3F800000));
+
+    F large = CmpLt(Splat<F>(SQRT2), m);
+    m = Select(large, m * Splat<F>(0.5f), m);
+    F exponent = ConvertToF32(e) + (large & Splat<F>(1.0f));
+
+    F f = m - Splat<F>(1.0f);
+    F z = f * f;
+    F p = Splat<F>(LOG_C0);
+    p = MulAdd(p, f, Splat<F>(LOG_C1));
+    p = MulAdd(p, f, Splat<F>(LOG_C2));
+    p = MulAdd(p, f, Splat<F>(LOG_C3));
+    p = MulAdd(p, f, Splat<F>(LOG_C4));
+    p = MulAdd(p, f, Splat<F>(LOG_C5));
+    p = MulAdd(p, f, Splat<F>(LOG_C6));
+    p = MulAdd(p, f, Splat<F>(LOG_C7));
+    p = MulAdd(p, f, Splat<F>(LOG_C8));
+    F y = f * z * p - Splat<F>(0.5f) * z;
+
+    F log2e = Splat<F>(LOG2E_MINUS_ONE);
+    F res = y * log2e;
+    res = MulAdd(f, log2e, res);
+    res = res + y + f + exponent;
+
+    F zero = Splat<F>(0.0f);
+    F invalid = AndNot(CmpGe(x, zero), CmpEq(zero, zero));
+    res = Select(CmpLt(x, Splat<F>(MinF32())), Splat<F>(MinusInfinityF32()),
+                 res);
+    res = Select(CmpEq(x, Splat<F>(InfinityF32())), x, res);
+    return Select(invalid, BitCastToF32(SplatI32<I>(0x7FC00000)), res);
+}
+
+template <typename Func>
+static inline void ApplyBatch(const f32* src, f32* dst, u32 count, Func func)
+{
+    const u32 width = F32x4::kLaneCount;
+
+    u32 i = 0;
+    for (; i + width <= count; i += width)
+    {
+        Store(dst + i, func(Load<F32x4>(src + i)));
+    }
+
+    if (i < count)
+    {
+        f32 tail[width] = {};
+        for (u32 j = 0; i + j < count; j++)
+        {
+            tail[j] = src[i + j];
+        }
+        Store(tail, func(Load<F32x4>(tail)));
+        for (u32 j = 0; i + j < count; j++)
+        {
+            dst[i + j] = tail[j];
+        }
+    }
+}
+
+void FastSinCos(const f32* radians, f32* sin, f32* cos, u32 count)
+{
+    FLY_ASSERT(radians || count == 0);
+    const u32 width = F32x4::kLaneCount;
+
+    u32 i = 0;
+    for (; i + width <= count; i += width)
+    {
+        F32x4 s, c;
+        SinCosKernel(Load<F32x4>(radians + i), s, c);
+        Store(sin + i, s);
+        Store(cos + i, c);
+    }
+
+    if (i < count)
+    {
+        f32 tailSin[width] = {};
+        f32 tailCos[width] = {};
+        for (u32 j = 0; i + j < count; j++)
+        {
+            tailSin[j] = radians[i + j];
+        }
+        F32x4 s, c;
+        SinCosKernel(Load<F32x4>(tailSin), s, c);
+        Store(tailSin, s);
+        Store(tailCos, c);
+        for (u32 j = 0; i + j < count; j++)
+        {
+            sin[i + j] = tailSin[j];
+            cos[i + j] = tailCos[j];
+        }
+    }
+}
+
+void FastExp(const f32* values, f32* dst, u32 count)
+{
+    FLY_ASSERT(values || count == 0);
+    ApplyBatch(values, dst, count,
+               [](F32x4 x) { return ExpKernel(x); });
+}
+
+void FastExp2(const f32* values, f32* dst, u32 count)
+{
+    FLY_ASSERT(values || count == 0);
+    ApplyBatch(values, dst, count,
+               [](F32x4 x) { return Exp2Kernel(x); });
+}
+
+void FastLog2(const f32* values, f32* dst, u32 count)
+{
+    FLY_ASSERT(values || count == 0);
+    ApplyBatch(values, dst, count,
+               [](F32x4 x) { return Log2Kernel(x); });
+}
+
+void FastPow(const f32* values, f32 exponent, f32* dst, u32 count)
+{
+    FLY_ASSERT(values || count == 0);
+    F32x4 e = Splat<F32x4>(exponent);
+    ApplyBatch(values, dst, count, [e](F32x4 x)
+               { return Exp2Kernel(e * Log2Kernel(x)); });
+}
+
 void SetRandomSeed(u32 seed) { stSeed = seed; }
 
 u32 Rand()
@@ -66,64 +496,114 @@ u32 Rand()
     return stSeed = x;
 }
 
+// Unbiased value in [0, range]
+static u64 RandomRange(u64 range)
+{
+    if (range < FLY_MAX_U32)
+    {
+        // Lemire's multiply and reject
+        u32 bound = static_cast<u32>(range) + 1;
+        u64 m = static_cast<u64>(Rand()) * bound;
+        u32 low = static_cast<u32>(m);
+        if (low < bound)
+        {
+            u32 threshold = (0u - bound) % bound;
+            while (low < threshold)
+            {
+                m = static_cast<u64>(Rand()) * bound;
+                low = static_cast<u32>(m);
+            }
+        }
+        return m >> 32;
+    }
+
+    if (range == FLY_MAX_U32)
+    {
+        return Rand();
+    }
+
+    // Bitmask with rejection
+    u64 mask = range;
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+    mask |= mask >> 32;
+
+    u64 value;
+    do
+    {
+        value = ((static_cast<u64>(Rand()) << 32) | Rand()) & mask;
+    } while (value > range);
+    return value;
+}
+
 i8 RandomI8(i8 min, i8 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    return static_cast<i8>(min + RandomRange(max - min));
 }
 
 i16 RandomI16(i16 min, i16 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    return static_cast<i16>(min + RandomRange(max - min));
 }
 
 i32 RandomI32(i32 min, i32 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    u64 range = static_cast<u64>(static_cast<i64>(max) - min);
+    return static_cast<i32>(min + static_cast<i64>(RandomRange(range)));
 }
 
 i64 RandomI64(i64 min, i64 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    u64 range = static_cast<u64>(max) - static_cast<u64>(min);
+    return static_cast<i64>(static_cast<u64>(min) + RandomRange(range));
 }
 
 u8 RandomU8(u8 min, u8 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    return static_cast<u8>(min + RandomRange(max - min));
 }
 
 u16 RandomU16(u16 min, u16 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    return static_cast<u16>(min + RandomRange(max - min));
 }
 
 u32 RandomU32(u32 min, u32 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    return static_cast<u32>(min + RandomRange(max - min));
 }
 
 u64 RandomU64(u64 min, u64 max)
 {
     FLY_ASSERT(min <= max);
-    return Rand() % (max - min + 1) + min;
+    return min + RandomRange(max - min);
 }
 
 f32 RandomF32(f32 min, f32 max)
 {
     FLY_ASSERT(min <= max);
-    return (max - min) * (static_cast<f32>(Rand()) / 0xFFFFFFFFu) + min;
+    f32 unit = static_cast<f32>(Rand() >> 8) * (1.0f / 16777216.0f);
+    f32 value = (max - min) * unit + min;
+    return value < max ? value : nextafterf(max, min);
 }
 
 f64 RandomF64(f64 min, f64 max)
 {
     FLY_ASSERT(min <= max);
-    return (max - min) * (static_cast<f32>(Rand()) / 0xFFFFFFFFu) + min;
+    u64 bits = (static_cast<u64>(Rand()) << 32) | Rand();
+    f64 unit = static_cast<f64>(bits >> 11) * (1.0 / 9007199254740992.0);
+    f64 value = (max - min) * unit + min;
+    return value < max ? value : nextafter(max, min);
 }
 
 } // namespace Math
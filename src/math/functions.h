@@ -51,6 +51,34 @@ f32 Cos(f32 radians);
 f32 Tan(f32 radians);
 f32 Atan2(f32 y, f32 x);
 
+// Polynomial approximations, faster than the libm based versions above.
+// Sin/Cos: absolute error below 1e-7 for |radians| <= 8192, accuracy
+// degrades beyond that because of the range reduction.
+// Exp/Exp2: relative error below 2e-7, underflow returns 0 and overflow
+// returns infinity. NaN is not propagated.
+// Log2: absolute error below 2e-7 on [0.25, 4] and relative error below 1e-7
+// elsewhere. Denormals are treated as zero.
+// Pow: Exp2(exponent * Log2(value)) for value > 0, the relative error grows
+// with |exponent * Log2(value)| and stays below 4e-6 while it is under 128.
+f32 FastSin(f32 radians);
+f32 FastCos(f32 radians);
+void FastSinCos(f32 radians, f32& sin, f32& cos);
+f32 FastExp(f32 value);
+f32 FastExp2(f32 value);
+f32 FastLog2(f32 value);
+f32 FastPow(f32 value, f32 exponent);
+
+// Batch versions of the approximations above, 4 lanes at a time with SSE2 or
+// NEON. Source and destination may alias.
+void FastSinCos(const f32* radians, f32* sin, f32* cos, u32 count);
+void FastExp(const f32* values, f32* dst, u32 count);
+void FastExp2(const f32* values, f32* dst, u32 count);
+void FastLog2(const f32* values, f32* dst, u32 count);
+void FastPow(const f32* values, f32 exponent, f32* dst, u32 count);
+
+// Per thread xorshift32 sequence, see random.h for reproducible parallel
+// streams. Integer ranges are inclusive and unbiased, float ranges are
+// [min, max).
 void SetRandomSeed(u32 seed);
 u32 Rand();
 
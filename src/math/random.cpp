@@ -0,0 +1,381 @@
+#include "random.h"
+#include "core/assert.h"
+#include "simd.h"
+
+#include <math.h>
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+namespace Fly
+{
+namespace Math
+{
+
+static inline void MulHiLo(u32 a, u32 b, u32& hi, u32& lo)
+{
+    u64 product = static_cast<u64>(a) * b;
+    hi = static_cast<u32>(product >> 32);
+    lo = static_cast<u32>(product);
+}
+
+void Philox4x32(const u32 counter[4], const u32 key[2], u32 out[4])
+{
+    u32 c0 = counter[0];
+    u32 c1 = counter[1];
+    u32 c2 = counter[2];
+    u32 c3 = counter[3];
+    u32 k0 = key[0];
+    u32 k1 = key[1];
+
+    for (u32 i = 0; i < PHILOX_ROUNDS; i++)
+    {
+        u32 hi0, lo0, hi1, lo1;
+        MulHiLo(PHILOX_M0, c0, hi0, lo0);
+        MulHiLo(PHILOX_M1, c2, hi1, lo1);
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Four consecutive counters of a stream, 16 values in sequence order
+static void PhiloxBlocks(u64 seed, u64 stream, u64 counter, u32 out[16])
+{
+#if defined(FLY_MATH_SIMD_SSE2)
+    __m128i c0 = _mm_setr_epi32(static_cast<i32>(counter),
+                                static_cast<i32>(counter + 1),
+                                static_cast<i32>(counter + 2),
+                                static_cast<i32>(counter + 3));
+    __m128i c1 = _mm_setr_epi32(static_cast<i32>(counter >> 32),
+                                static_cast<i32>((counter + 1) >> 32),
+                                static_cast<i32>((counter + 2) >> 32),
+                                static_cast<i32>((counter + 3) >> 32));
+    __m128i c2 = _mm_set1_epi32(static_cast<i32>(stream));
+    __m128i c3 = _mm_set1_epi32(static_cast<i32>(stream >> 32));
+
+    const __m128i m0 = _mm_set1_epi32(static_cast<i32>(PHILOX_M0));
+    const __m128i m1 = _mm_set1_epi32(static_cast<i32>(PHILOX_M1));
+    const __m128i lowMask = _mm_set_epi32(0, -1, 0, -1);
+    const __m128i highMask = _mm_set_epi32(-1, 0, -1, 0);
+
+    u32 k0 = static_cast<u32>(seed);
+    u32 k1 = static_cast<u32>(seed >> 32);
+
+    for (u32 i = 0; i < PHILOX_ROUNDS; i++)
+    {
+        // 32x32 -> 64 multiplies on even and odd lanes
+        __m128i even0 = _mm_mul_epu32(c0, m0);
+        __m128i odd0 = _mm_mul_epu32(_mm_srli_epi64(c0, 32), m0);
+        __m128i even1 = _mm_mul_epu32(c2, m1);
+        __m128i odd1 = _mm_mul_epu32(_mm_srli_epi64(c2, 32), m1);
+
+        __m128i lo0 = _mm_or_si128(_mm_and_si128(even0, lowMask),
+                                   _mm_slli_epi64(odd0, 32));
+        __m128i hi0 = _mm_or_si128(_mm_srli_epi64(even0, 32),
+                                   _mm_and_si128(odd0, highMask));
+        __m128i lo1 = _mm_or_si128(_mm_and_si128(even1, lowMask),
+                                   _mm_slli_epi64(odd1, 32));
+        __m128i hi1 = _mm_or_si128(_mm_srli_epi64(even1, 32),
+                                   _mm_and_si128(odd1, highMask));
+
+        c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1),
+                           _mm_set1_epi32(static_cast<i32>(k0)));
+        c1 = lo1;
+        c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3),
+                           _mm_set1_epi32(static_cast<i32>(k1)));
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    // Transpose lanes (one counter each) to sequence order
+    __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+    __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+    __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+    __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4),
+                     _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8),
+                     _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12),
+                     _mm_unpackhi_epi64(t2, t3));
+#elif defined(FLY_MATH_SIMD_NEON)
+    u32 counterLo[4];
+    u32 counterHi[4];
+    for (u32 i = 0; i < 4; i++)
+    {
+        counterLo[i] = static_cast<u32>(counter + i);
+        counterHi[i] = static_cast<u32>((counter + i) >> 32);
+    }
+
+    uint32x4_t c0 = vld1q_u32(counterLo);
+    uint32x4_t c1 = vld1q_u32(counterHi);
+    uint32x4_t c2 = vdupq_n_u32(static_cast<u32>(stream));
+    uint32x4_t c3 = vdupq_n_u32(static_cast<u32>(stream >> 32));
+
+    const uint32x2_t m0 = vdup_n_u32(PHILOX_M0);
+    const uint32x2_t m1 = vdup_n_u32(PHILOX_M1);
+
+    u32 k0 = static_cast<u32>(seed);
+    u32 k1 = static_cast<u32>(seed >> 32);
+
+    for (u32 i = 0; i < PHILOX_ROUNDS; i++)
+    {
+        uint32x4_t p0Low =
+            vreinterpretq_u32_u64(vmull_u32(vget_low_u32(c0), m0));
+        uint32x4_t p0High =
+            vreinterpretq_u32_u64(vmull_u32(vget_high_u32(c0), m0));
+        uint32x4_t p1Low =
+            vreinterpretq_u32_u64(vmull_u32(vget_low_u32(c2), m1));
+        uint32x4_t p1High =
+            vreinterpretq_u32_u64(vmull_u32(vget_high_u32(c2), m1));
+
+        uint32x4_t lo0 = vuzp1q_u32(p0Low, p0High);
+        uint32x4_t hi0 = vuzp2q_u32(p0Low, p0High);
+        uint32x4_t lo1 = vuzp1q_u32(p1Low, p1High);
+        uint32x4_t hi1 = vuzp2q_u32(p1Low, p1High);
+
+        c0 = veorq_u32(veorq_u32(hi1, c1), vdupq_n_u32(k0));
+        c1 = lo1;
+        c2 = veorq_u32(veorq_u32(hi0, c3), vdupq_n_u32(k1));
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    uint32x4x4_t result = {{c0, c1, c2, c3}};
+    vst4q_u32(out, result);
+#else
+    u32 key[2] = {static_cast<u32>(seed), static_cast<u32>(seed >> 32)};
+    for (u32 i = 0; i < 4; i++)
+    {
+        u64 n = counter + i;
+        u32 c[4] = {static_cast<u32>(n), static_cast<u32>(n >> 32),
+                    static_cast<u32>(stream), static_cast<u32>(stream >> 32)};
+        Philox4x32(c, key, out + 4 * i);
+    }
+#endif
+}
+
+static void RefillBuffer(RandomStream& rng)
+{
+    u32 counter[4] = {static_cast<u32>(rng.counter),
+                      static_cast<u32>(rng.counter >> 32),
+                      static_cast<u32>(rng.stream),
+                      static_cast<u32>(rng.stream >> 32)};
+    u32 key[2] = {static_cast<u32>(rng.seed),
+                  static_cast<u32>(rng.seed >> 32)};
+    Philox4x32(counter, key, rng.buffer);
+    rng.counter++;
+    rng.bufferIndex = 0;
+}
+
+RandomStream CreateRandomStream(u64 seed, u64 stream)
+{
+    RandomStream rng;
+    rng.seed = seed;
+    rng.stream = stream;
+    return rng;
+}
+
+void SeekRandomStream(RandomStream& rng, u64 position)
+{
+    rng.counter = position / 4;
+    rng.bufferIndex = 4;
+    if (position % 4)
+    {
+        RefillBuffer(rng);
+        rng.bufferIndex = static_cast<u32>(position % 4);
+    }
+}
+
+u32 NextU32(RandomStream& rng)
+{
+    if (rng.bufferIndex == 4)
+    {
+        RefillBuffer(rng);
+    }
+    return rng.buffer[rng.bufferIndex++];
+}
+
+u64 NextU64(RandomStream& rng)
+{
+    u64 lo = NextU32(rng);
+    u64 hi = NextU32(rng);
+    return (hi << 32) | lo;
+}
+
+f32 NextF32(RandomStream& rng) { return UnitF32(NextU32(rng)); }
+
+f64 NextF64(RandomStream& rng)
+{
+    return static_cast<f64>(NextU64(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+u32 NextU32(RandomStream& rng, u32 min, u32 max)
+{
+    FLY_ASSERT(min <= max);
+
+    u32 range = max - min + 1;
+    if (range == 0)
+    {
+        return NextU32(rng);
+    }
+
+    // Lemire's multiply and reject, unbiased without a division in the
+    // common case
+    u64 m = static_cast<u64>(NextU32(rng)) * range;
+    u32 low = static_cast<u32>(m);
+    if (low < range)
+    {
+        u32 threshold = (0u - range) % range;
+        while (low < threshold)
+        {
+            m = static_cast<u64>(NextU32(rng)) * range;
+            low = static_cast<u32>(m);
+        }
+    }
+    return min + static_cast<u32>(m >> 32);
+}
+
+i32 NextI32(RandomStream& rng, i32 min, i32 max)
+{
+    FLY_ASSERT(min <= max);
+    u32 range = static_cast<u32>(max) - static_cast<u32>(min);
+    return static_cast<i32>(static_cast<u32>(min) + NextU32(rng, 0, range));
+}
+
+u64 NextU64(RandomStream& rng, u64 min, u64 max)
+{
+    FLY_ASSERT(min <= max);
+
+    u64 range = max - min;
+    if (range <= FLY_MAX_U32)
+    {
+        return min + NextU32(rng, 0, static_cast<u32>(range));
+    }
+    if (range == FLY_MAX_U64)
+    {
+        return NextU64(rng);
+    }
+
+    // Bitmask with rejection
+    u64 mask = range;
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+    mask |= mask >> 32;
+
+    u64 value = NextU64(rng) & mask;
+    while (value > range)
+    {
+        value = NextU64(rng) & mask;
+    }
+    return min + value;
+}
+
+f32 NextF32(RandomStream& rng, f32 min, f32 max)
+{
+    FLY_ASSERT(min <= max);
+    // Rounding can land on max when the range is only a few ulps wide
+    f32 value = min + (max - min) * NextF32(rng);
+    return value < max ? value : nextafterf(max, min);
+}
+
+// Generates whole counters straight into dst once the buffer is drained,
+// calls func(dst, values, count) per chunk of at most 16 values
+template <typename T, typename Func>
+static void FillRandom(RandomStream& rng, T* dst, u64 count, Func func)
+{
+    FLY_ASSERT(dst || count == 0);
+
+    u64 i = 0;
+    while (i < count && rng.bufferIndex != 4)
+    {
+        u32 value = NextU32(rng);
+        func(dst + i, &value, 1);
+        i++;
+    }
+
+    u32 block[16];
+    for (; i + 16 <= count; i += 16)
+    {
+        PhiloxBlocks(rng.seed, rng.stream, rng.counter, block);
+        rng.counter += 4;
+        func(dst + i, block, 16);
+    }
+
+    for (; i < count; i++)
+    {
+        u32 value = NextU32(rng);
+        func(dst + i, &value, 1);
+    }
+}
+
+void FillRandomU32(RandomStream& rng, u32* dst, u64 count)
+{
+    FillRandom(rng, dst, count,
+               [](u32* out, const u32* values, u32 valueCount)
+               {
+                   for (u32 i = 0; i < valueCount; i++)
+                   {
+                       out[i] = values[i];
+                   }
+               });
+}
+
+void FillRandomF32(RandomStream& rng, f32* dst, u64 count, f32 min, f32 max)
+{
+    FLY_ASSERT(min <= max);
+
+    // Clamped like NextF32, values never exceed max so Min is enough
+    f32 scale = (max - min) * (1.0f / 16777216.0f);
+    f32 limit = nextafterf(max, min);
+    FillRandom(rng, dst, count,
+               [min, scale, limit](f32* out, const u32* values, u32 valueCount)
+               {
+                   u32 i = 0;
+                   F32x4 scaleX4 = SplatF32x4(scale);
+                   F32x4 minX4 = SplatF32x4(min);
+                   F32x4 limitX4 = SplatF32x4(limit);
+                   for (; i + 4 <= valueCount; i += 4)
+                   {
+                       F32x4 bits =
+                           LoadF32x4(reinterpret_cast<const f32*>(values + i));
+                       F32x4 v = ConvertToF32(
+                           ShiftRightLogical(BitCastToI32(bits), 8));
+                       StoreF32x4(out + i,
+                                  Min(MulAdd(v, scaleX4, minX4), limitX4));
+                   }
+                   for (; i < valueCount; i++)
+                   {
+                       f32 value =
+                           min + static_cast<f32>(values[i] >> 8) * scale;
+                       out[i] = value < limit ? value : limit;
+                   }
+               });
+}
+
+void FillRandomF32(RandomStream& rng, f32* dst, u64 count)
+{
+    FillRandomF32(rng, dst, count, 0.0f, 1.0f);
+}
+
+} // namespace Math
+} // namespace Fly
@@ -0,0 +1,61 @@
+#ifndef FLY_MATH_RANDOM_H
+#define FLY_MATH_RANDOM_H
+
+#include "core/types.h"
+
+namespace Fly
+{
+namespace Math
+{
+
+// Philox4x32-10 counter based generator (Salmon et al. 2011). Each
+// (key, counter) pair maps to four independent 32 bit values without any
+// shared state, which makes streams reproducible regardless of how work is
+// split between threads.
+void Philox4x32(const u32 counter[4], const u32 key[2], u32 out[4]);
+
+// A stream is identified by a seed and a stream index, e.g. one stream per
+// thread, per instance or per texel. Values are drawn from consecutive
+// counters, so two streams with different indices never overlap.
+struct RandomStream
+{
+    u64 seed = 0;
+    u64 stream = 0;
+    u64 counter = 0;
+    u32 buffer[4] = {};
+    u32 bufferIndex = 4;
+};
+
+RandomStream CreateRandomStream(u64 seed, u64 stream = 0);
+
+// Moves the stream to the given position in its sequence
+void SeekRandomStream(RandomStream& rng, u64 position);
+
+u32 NextU32(RandomStream& rng);
+u64 NextU64(RandomStream& rng);
+// Uniform in [0, 1)
+f32 NextF32(RandomStream& rng);
+f64 NextF64(RandomStream& rng);
+
+// Unbiased integers in [min, max], uniform floats in [min, max)
+u32 NextU32(RandomStream& rng, u32 min, u32 max);
+i32 NextI32(RandomStream& rng, i32 min, i32 max);
+u64 NextU64(RandomStream& rng, u64 min, u64 max);
+f32 NextF32(RandomStream& rng, f32 min, f32 max);
+
+// Bulk generation, produces exactly the values that the same number of
+// NextU32/NextF32 calls would return
+void FillRandomU32(RandomStream& rng, u32* dst, u64 count);
+void FillRandomF32(RandomStream& rng, f32* dst, u64 count);
+void FillRandomF32(RandomStream& rng, f32* dst, u64 count, f32 min, f32 max);
+
+// Converts 32 random bits to a float in [0, 1)
+inline f32 UnitF32(u32 bits)
+{
+    return static_cast<f32>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+} // namespace Math
+} // namespace Fly
+
+#endif /* FLY_MATH_RANDOM_H */
@@ -0,0 +1,396 @@
+#ifndef FLY_MATH_SIMD_H
+#define FLY_MATH_SIMD_H
+
+#include "core/platform.h"
+#include "core/types.h"
+
+#include <string.h>
+
+// Thin 4-wide float vector used by the batch kernels in math. Maps to SSE2 on
+// x86, NEON on arm64 and plain arrays everywhere else. Comparisons return lane
+// masks with all bits set for true lanes.
+
+// clang-format off
+#if defined(FLY_PLATFORM_ARCH_X86_64) || defined(__SSE2__)
+#    define FLY_MATH_SIMD_SSE2
+#    include <emmintrin.h>
+#elif defined(FLY_PLATFORM_ARCH_ARM_64) || defined(_M_ARM64)
+#    define FLY_MATH_SIMD_NEON
+#    include <arm_neon.h>
+#else
+#    define FLY_MATH_SIMD_SCALAR
+#    include <math.h>
+#endif
+// clang-format on
+
+namespace Fly
+{
+namespace Math
+{
+
+template <typename T>
+T Splat(f32 value);
+template <typename T>
+T SplatI32(i32 value);
+
+struct I32x4
+{
+#if defined(FLY_MATH_SIMD_SSE2)
+    __m128i v;
+#elif defined(FLY_MATH_SIMD_NEON)
+    int32x4_t v;
+#else
+    i32 i[4];
+#endif
+};
+
+struct F32x4
+{
+    typedef I32x4 Int;
+    static const u32 kLaneCount = 4;
+
+#if defined(FLY_MATH_SIMD_SSE2)
+    __m128 v;
+#elif defined(FLY_MATH_SIMD_NEON)
+    float32x4_t v;
+#else
+    union
+    {
+        f32 f[4];
+        u32 u[4];
+    };
+#endif
+};
+
+#if defined(FLY_MATH_SIMD_SSE2)
+
+inline F32x4 LoadF32x4(const f32* p) { return {_mm_loadu_ps(p)}; }
+inline void StoreF32x4(f32* p, F32x4 a) { _mm_storeu_ps(p, a.v); }
+inline F32x4 SplatF32x4(f32 value) { return {_mm_set1_ps(value)}; }
+inline I32x4 SplatI32x4(i32 value) { return {_mm_set1_epi32(value)}; }
+
+inline F32x4 operator+(F32x4 a, F32x4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline F32x4 operator-(F32x4 a, F32x4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline F32x4 operator*(F32x4 a, F32x4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline F32x4 operator/(F32x4 a, F32x4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline F32x4 operator&(F32x4 a, F32x4 b) { return {_mm_and_ps(a.v, b.v)}; }
+inline F32x4 operator|(F32x4 a, F32x4 b) { return {_mm_or_ps(a.v, b.v)}; }
+inline F32x4 operator^(F32x4 a, F32x4 b) { return {_mm_xor_ps(a.v, b.v)}; }
+// ~a & b
+inline F32x4 AndNot(F32x4 a, F32x4 b) { return {_mm_andnot_ps(a.v, b.v)}; }
+
+inline F32x4 Min(F32x4 a, F32x4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline F32x4 Max(F32x4 a, F32x4 b) { return {_mm_max_ps(a.v, b.v)}; }
+inline F32x4 Abs(F32x4 a)
+{
+    return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)};
+}
+
+inline F32x4 CmpGe(F32x4 a, F32x4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline F32x4 CmpLt(F32x4 a, F32x4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline F32x4 CmpEq(F32x4 a, F32x4 b) { return {_mm_cmpeq_ps(a.v, b.v)}; }
+
+// Returns one bit per lane, lane 0 in the lowest bit
+inline u32 MoveMask(F32x4 mask) { return _mm_movemask_ps(mask.v); }
+
+inline I32x4 operator+(I32x4 a, I32x4 b) { return {_mm_add_epi32(a.v, b.v)}; }
+inline I32x4 operator-(I32x4 a, I32x4 b) { return {_mm_sub_epi32(a.v, b.v)}; }
+inline I32x4 operator&(I32x4 a, I32x4 b) { return {_mm_and_si128(a.v, b.v)}; }
+inline I32x4 operator|(I32x4 a, I32x4 b) { return {_mm_or_si128(a.v, b.v)}; }
+inline I32x4 ShiftLeft(I32x4 a, i32 bits)
+{
+    return {_mm_sll_epi32(a.v, _mm_cvtsi32_si128(bits))};
+}
+inline I32x4 ShiftRightLogical(I32x4 a, i32 bits)
+{
+    return {_mm_srl_epi32(a.v, _mm_cvtsi32_si128(bits))};
+}
+inline I32x4 ShiftRightArithmetic(I32x4 a, i32 bits)
+{
+    return {_mm_sra_epi32(a.v, _mm_cvtsi32_si128(bits))};
+}
+
+// Round to nearest even
+inline I32x4 ConvertToI32(F32x4 a) { return {_mm_cvtps_epi32(a.v)}; }
+inline F32x4 ConvertToF32(I32x4 a) { return {_mm_cvtepi32_ps(a.v)}; }
+inline I32x4 BitCastToI32(F32x4 a) { return {_mm_castps_si128(a.v)}; }
+inline F32x4 BitCastToF32(I32x4 a) { return {_mm_castsi128_ps(a.v)}; }
+
+#elif defined(FLY_MATH_SIMD_NEON)
+
+inline F32x4 LoadF32x4(const f32* p) { return {vld1q_f32(p)}; }
+inline void StoreF32x4(f32* p, F32x4 a) { vst1q_f32(p, a.v); }
+inline F32x4 SplatF32x4(f32 value) { return {vdupq_n_f32(value)}; }
+inline I32x4 SplatI32x4(i32 value) { return {vdupq_n_s32(value)}; }
+
+inline I32x4 BitCastToI32(F32x4 a) { return {vreinterpretq_s32_f32(a.v)}; }
+inline F32x4 BitCastToF32(I32x4 a) { return {vreinterpretq_f32_s32(a.v)}; }
+
+inline F32x4 operator+(F32x4 a, F32x4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline F32x4 operator-(F32x4 a, F32x4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline F32x4 operator*(F32x4 a, F32x4 b) { return {vmulq_f32(a.v, b.v)}; }
+inline F32x4 operator/(F32x4 a, F32x4 b) { return {vdivq_f32(a.v, b.v)}; }
+inline F32x4 operator&(F32x4 a, F32x4 b)
+{
+    return {vreinterpretq_f32_u32(
+        vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)))};
+}
+inline F32x4 operator|(F32x4 a, F32x4 b)
+{
+    return {vreinterpretq_f32_u32(
+        vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)))};
+}
+inline F32x4 operator^(F32x4 a, F32x4 b)
+{
+    return {vreinterpretq_f32_u32(
+        veorq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)))};
+}
+// ~a & b
+inline F32x4 AndNot(F32x4 a, F32x4 b)
+{
+    return {vreinterpretq_f32_u32(
+        vbicq_u32(vreinterpretq_u32_f32(b.v), vreinterpretq_u32_f32(a.v)))};
+}
+
+inline F32x4 Min(F32x4 a, F32x4 b) { return {vminq_f32(a.v, b.v)}; }
+inline F32x4 Max(F32x4 a, F32x4 b) { return {vmaxq_f32(a.v, b.v)}; }
+inline F32x4 Abs(F32x4 a) { return {vabsq_f32(a.v)}; }
+
+inline F32x4 CmpGe(F32x4 a, F32x4 b)
+{
+    return {vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v))};
+}
+inline F32x4 CmpLt(F32x4 a, F32x4 b)
+{
+    return {vreinterpretq_f32_u32(vcltq_f32(a.v, b.v))};
+}
+inline F32x4 CmpEq(F32x4 a, F32x4 b)
+{
+    return {vreinterpretq_f32_u32(vceqq_f32(a.v, b.v))};
+}
+
+inline u32 MoveMask(F32x4 mask)
+{
+    static const i32 shifts[4] = {-31, -30, -29, -28};
+    uint32x4_t bits =
+        vshlq_u32(vreinterpretq_u32_f32(mask.v), vld1q_s32(shifts));
+    return vaddvq_u32(bits);
+}
+
+inline I32x4 operator+(I32x4 a, I32x4 b) { return {vaddq_s32(a.v, b.v)}; }
+inline I32x4 operator-(I32x4 a, I32x4 b) { return {vsubq_s32(a.v, b.v)}; }
+inline I32x4 operator&(I32x4 a, I32x4 b) { return {vandq_s32(a.v, b.v)}; }
+inline I32x4 operator|(I32x4 a, I32x4 b) { return {vorrq_s32(a.v, b.v)}; }
+inline I32x4 ShiftLeft(I32x4 a, i32 bits)
+{
+    return {vshlq_s32(a.v, vdupq_n_s32(bits))};
+}
+inline I32x4 ShiftRightLogical(I32x4 a, i32 bits)
+{
+    return {vreinterpretq_s32_u32(
+        vshlq_u32(vreinterpretq_u32_s32(a.v), vdupq_n_s32(-bits)))};
+}
+inline I32x4 ShiftRightArithmetic(I32x4 a, i32 bits)
+{
+    return {vshlq_s32(a.v, vdupq_n_s32(-bits))};
+}
+
+// Round to nearest even
+inline I32x4 ConvertToI32(F32x4 a) { return {vcvtnq_s32_f32(a.v)}; }
+inline F32x4 ConvertToF32(I32x4 a) { return {vcvtq_f32_s32(a.v)}; }
+
+#else
+
+inline F32x4 LoadF32x4(const f32* p)
+{
+    F32x4 r;
+    memcpy(r.f, p, sizeof(r.f));
+    return r;
+}
+
+inline void StoreF32x4(f32* p, F32x4 a) { memcpy(p, a.f, sizeof(a.f)); }
+
+#define FLY_MATH_SIMD_SCALAR_OP(T, field, expr)                                \
+    T r;                                                                       \
+    for (u32 i = 0; i < 4; i++)                                                \
+    {                                                                          \
+        r.field[i] = (expr);                                                   \
+    }                                                                          \
+    return r;
+
+inline F32x4 SplatF32x4(f32 value)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, value)
+}
+inline I32x4 SplatI32x4(i32 value)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i, value)
+}
+
+inline I32x4 BitCastToI32(F32x4 a)
+{
+    I32x4 r;
+    memcpy(r.i, a.f, sizeof(r.i));
+    return r;
+}
+
+inline F32x4 BitCastToF32(I32x4 a)
+{
+    F32x4 r;
+    memcpy(r.f, a.i, sizeof(r.f));
+    return r;
+}
+
+inline F32x4 operator+(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, a.f[i] + b.f[i])
+}
+inline F32x4 operator-(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, a.f[i] - b.f[i])
+}
+inline F32x4 operator*(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, a.f[i] * b.f[i])
+}
+inline F32x4 operator/(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, a.f[i] / b.f[i])
+}
+inline F32x4 operator&(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, a.u[i] & b.u[i])
+}
+inline F32x4 operator|(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, a.u[i] | b.u[i])
+}
+inline F32x4 operator^(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, a.u[i] ^ b.u[i])
+}
+// ~a & b
+inline F32x4 AndNot(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, ~a.u[i] & b.u[i])
+}
+
+inline F32x4 Min(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, a.f[i] < b.f[i] ? a.f[i] : b.f[i])
+}
+inline F32x4 Max(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, a.f[i] > b.f[i] ? a.f[i] : b.f[i])
+}
+inline F32x4 Abs(F32x4 a)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, a.u[i] & 0x7FFFFFFFu)
+}
+
+inline F32x4 CmpGe(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, a.f[i] >= b.f[i] ? 0xFFFFFFFFu : 0u)
+}
+inline F32x4 CmpLt(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, a.f[i] < b.f[i] ? 0xFFFFFFFFu : 0u)
+}
+inline F32x4 CmpEq(F32x4 a, F32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, u, a.f[i] == b.f[i] ? 0xFFFFFFFFu : 0u)
+}
+
+inline u32 MoveMask(F32x4 mask)
+{
+    return (mask.u[0] >> 31) | ((mask.u[1] >> 31) << 1) |
+           ((mask.u[2] >> 31) << 2) | ((mask.u[3] >> 31) << 3);
+}
+
+inline I32x4 operator+(I32x4 a, I32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i,
+                            static_cast<i32>(static_cast<u32>(a.i[i]) +
+                                             static_cast<u32>(b.i[i])))
+}
+inline I32x4 operator-(I32x4 a, I32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i,
+                            static_cast<i32>(static_cast<u32>(a.i[i]) -
+                                             static_cast<u32>(b.i[i])))
+}
+inline I32x4 operator&(I32x4 a, I32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i, a.i[i] & b.i[i])
+}
+inline I32x4 operator|(I32x4 a, I32x4 b)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i, a.i[i] | b.i[i])
+}
+inline I32x4 ShiftLeft(I32x4 a, i32 bits)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i,
+                            static_cast<i32>(static_cast<u32>(a.i[i]) << bits))
+}
+inline I32x4 ShiftRightLogical(I32x4 a, i32 bits)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i,
+                            static_cast<i32>(static_cast<u32>(a.i[i]) >> bits))
+}
+inline I32x4 ShiftRightArithmetic(I32x4 a, i32 bits)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i, a.i[i] >> bits)
+}
+
+// Round to nearest even
+inline I32x4 ConvertToI32(F32x4 a)
+{
+    FLY_MATH_SIMD_SCALAR_OP(I32x4, i, static_cast<i32>(rintf(a.f[i])))
+}
+inline F32x4 ConvertToF32(I32x4 a)
+{
+    FLY_MATH_SIMD_SCALAR_OP(F32x4, f, static_cast<f32>(a.i[i]))
+}
+
+#undef FLY_MATH_SIMD_SCALAR_OP
+
+#endif
+
+template <>
+inline F32x4 Splat<F32x4>(f32 value)
+{
+    return SplatF32x4(value);
+}
+
+template <>
+inline I32x4 SplatI32<I32x4>(i32 value)
+{
+    return SplatI32x4(value);
+}
+
+// a * b + c
+inline F32x4 MulAdd(F32x4 a, F32x4 b, F32x4 c) { return a * b + c; }
+
+// Generic helpers for the kernels templated on the vector type
+
+template <typename F>
+inline F Select(F mask, F a, F b)
+{
+    return (mask & a) | AndNot(mask, b);
+}
+
+template <typename F>
+inline F Load(const f32* p);
+
+template <>
+inline F32x4 Load<F32x4>(const f32* p)
+{
+    return LoadF32x4(p);
+}
+
+inline void Store(f32* p, F32x4 a) { StoreF32x4(p, a); }
+
+} // namespace Math
+} // namespace Fly
+
+#endif /* FLY_MATH_SIMD_H */
@@ -74,7 +74,11 @@ void Blit(CommandBuffer& cmd, Texture& src, u32 srcMipLevel, Texture& dst,
 void CopyTextureToBuffer(CommandBuffer& cmd, Buffer& dstBuffer,
                          const Texture& srcTexture, u32 mipLevel);
 void CopyBufferToTexture(CommandBuffer& cmd, Texture& dstTexture,
-                         Buffer& srcBuffer, u32 mipLevel);
+                         Buffer& srcBuffer, u32 mipLevel,
+                         u64 bufferOffset = 0);
+void CopyBufferToBuffer(CommandBuffer& cmd, Buffer& dstBuffer,
+                        const Buffer& srcBuffer, u64 size, u64 srcOffset = 0,
+                        u64 dstOffset = 0);
 void CopyBufferToMip(CommandBuffer& cmd, Texture& dstTexture, u32 layer,
                      u32 mipLevel, u32 width, u32 height, u32 depth,
                      Buffer& srcBuffer);
@@ -144,7 +144,7 @@ void CopyTextureToBuffer(CommandBuffer& cmd, Buffer& dstBuffer,
 }
 
 void CopyBufferToTexture(CommandBuffer& cmd, Texture& dstTexture,
-                         Buffer& srcBuffer, u32 mipLevel)
+                         Buffer& srcBuffer, u32 mipLevel, u64 bufferOffset)
 {
     FLY_ASSERT(cmd.state == CommandBuffer::State::Recording);
     FLY_ASSERT(mipLevel < dstTexture.mipCount);
@@ -154,7 +154,7 @@ void CopyBufferToTexture(CommandBuffer& cmd, Texture& dstTexture,
     u32 depth = MAX(dstTexture.depth >> mipLevel, 1);
 
     VkBufferImageCopy copyRegion{};
-    copyRegion.bufferOffset = 0;
+    copyRegion.bufferOffset = bufferOffset;
     copyRegion.bufferRowLength = 0;
     copyRegion.bufferImageHeight = 0;
     copyRegion.imageSubresource.aspectMask =
@@ -171,6 +171,22 @@ void CopyBufferToTexture(CommandBuffer& cmd, Texture& dstTexture,
                            &copyRegion);
 }
 
+void CopyBufferToBuffer(CommandBuffer& cmd, Buffer& dstBuffer,
+                        const Buffer& srcBuffer, u64 size, u64 srcOffset,
+                        u64 dstOffset)
+{
+    FLY_ASSERT(cmd.state == CommandBuffer::State::Recording);
+    FLY_ASSERT(srcOffset + size <= srcBuffer.allocationInfo.size);
+    FLY_ASSERT(dstOffset + size <= dstBuffer.allocationInfo.size);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(cmd.handle, srcBuffer.handle, dstBuffer.handle, 1,
+                    &copyRegion);
+}
+
 void BindGraphicsPipeline(CommandBuffer& cmd,
                           const GraphicsPipeline& graphicsPipeline)
 {
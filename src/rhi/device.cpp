@@ -2,6 +2,7 @@
 
 #include "core/assert.h"
 #include "core/log.h"
+#include "core/memory.h"
 #include "core/platform.h"
 #include "core/thread_context.h"
 
@@ -595,11 +596,21 @@ static bool CreateDescriptorPool(Device& device)
         return false;
     }
 
+    device.bindlessTextureHandleCapacity =
+        combinedImageSamplerDescriptorPoolSize;
+    device.bindlessWriteTextureHandleCapacity = storageImageDescriptorPoolSize;
+    device.freeBindlessTextureHandles = static_cast<u32*>(
+        Alloc(sizeof(u32) * device.bindlessTextureHandleCapacity));
+    device.freeBindlessTextureHandleCount = 0;
+
     return true;
 }
 
 static void DestroyDescriptorPool(Device& device)
 {
+    Free(device.freeBindlessTextureHandles);
+    device.freeBindlessTextureHandles = nullptr;
+    device.freeBindlessTextureHandleCount = 0;
     vkDestroyDescriptorSetLayout(device.logicalDevice,
                                  device.bindlessDescriptorSetLayout,
                                  GetVulkanAllocationCallbacks());
@@ -89,6 +89,11 @@ struct Device
     u32 bindlessTextureHandleCount = 0;
     u32 bindlessWriteTextureHandleCount = 0;
     u32 bindlessAccelerationStructureHandleCount = 0;
+    // Handles of destroyed textures, reused before the counts above grow
+    u32* freeBindlessTextureHandles = nullptr;
+    u32 freeBindlessTextureHandleCount = 0;
+    u32 bindlessTextureHandleCapacity = 0;
+    u32 bindlessWriteTextureHandleCapacity = 0;
     u32 swapchainTextureCount = 0;
     u32 swapchainTextureIndex = 0;
     u32 swapchainWidth = 0;
@@ -276,10 +276,53 @@ VkImageView CreateImageView(Device& device, const Texture& texture,
     return result;
 }
 
-static void CreateDescriptors(Device& device, Texture& texture)
+// Storage textures share the handle of the sampled descriptor, shaders index
+// both arrays with bindlessHandle. Handles of destroyed textures are reused
+// first, DestroyTexture is only called once no frame in flight uses them.
+static void ReleaseDescriptors(Device& device, Texture& texture)
+{
+    if (texture.bindlessHandle != FLY_MAX_U32)
+    {
+        FLY_ASSERT(device.freeBindlessTextureHandleCount <
+                   device.bindlessTextureHandleCapacity);
+        device.freeBindlessTextureHandles
+            [device.freeBindlessTextureHandleCount++] = texture.bindlessHandle;
+    }
+    texture.bindlessHandle = FLY_MAX_U32;
+    texture.bindlessStorageHandle = FLY_MAX_U32;
+}
+
+static bool CreateDescriptors(Device& device, Texture& texture)
 {
     u32 count = (texture.usage & VK_IMAGE_USAGE_STORAGE_BIT) ? 2 : 1;
 
+    u32 handle = FLY_MAX_U32;
+    if (device.freeBindlessTextureHandleCount > 0)
+    {
+        handle = device.freeBindlessTextureHandles
+                     [--device.freeBindlessTextureHandleCount];
+    }
+    else if (device.bindlessTextureHandleCount <
+             device.bindlessTextureHandleCapacity)
+    {
+        handle = device.bindlessTextureHandleCount++;
+        device.bindlessWriteTextureHandleCount =
+            device.bindlessTextureHandleCount;
+    }
+    else
+    {
+        FLY_ERROR("Out of bindless texture handles");
+        return false;
+    }
+
+    if (count == 2 && handle >= device.bindlessWriteTextureHandleCapacity)
+    {
+        device.freeBindlessTextureHandles
+            [device.freeBindlessTextureHandleCount++] = handle;
+        FLY_ERROR("Out of bindless storage texture handles");
+        return false;
+    }
+
     VkImageLayout layouts[2] = {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                 VK_IMAGE_LAYOUT_GENERAL};
     VkDescriptorImageInfo imageInfo[2];
@@ -296,99 +339,98 @@ static void CreateDescriptors(Device& device, Texture& texture)
         descriptorWrites[i].dstSet = device.bindlessDescriptorSet;
         descriptorWrites[i].descriptorCount = 1;
         descriptorWrites[i].pImageInfo = &(imageInfo[i]);
+        descriptorWrites[i].dstArrayElement = handle;
     }
 
     descriptorWrites[0].dstBinding = FLY_TEXTURE_BINDING_INDEX;
-    descriptorWrites[0].dstArrayElement = device.bindlessTextureHandleCount;
     descriptorWrites[0].descriptorType =
         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
     descriptorWrites[1].dstBinding = FLY_STORAGE_TEXTURE_BINDING_INDEX;
-    descriptorWrites[1].dstArrayElement =
-        device.bindlessWriteTextureHandleCount;
     descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 
     vkUpdateDescriptorSets(device.logicalDevice, count, descriptorWrites, 0,
                            nullptr);
 
-    texture.bindlessHandle = device.bindlessTextureHandleCount++;
-    texture.bindlessStorageHandle = device.bindlessWriteTextureHandleCount++;
+    texture.bindlessHandle = handle;
+    texture.bindlessStorageHandle = handle;
+    return true;
+}
+
+// Every mip that is not generated is copied from one staging buffer, mip
+// major with all layers of a mip next to each other
+static u64 GetTextureDataSize(const Texture& texture, bool generateMips)
+{
+    u32 mipCount = generateMips ? 1 : texture.mipCount;
+    u64 dataSize = 0;
+    for (u32 i = 0; i < mipCount; i++)
+    {
+        u32 mipWidth = MAX(texture.width >> i, 1);
+        u32 mipHeight = MAX(texture.height >> i, 1);
+        u32 mipDepth = MAX(texture.depth >> i, 1);
+        dataSize += static_cast<u64>(GetImageSize(mipWidth, mipHeight,
+                                                  mipDepth, texture.format)) *
+                    texture.layerCount;
+    }
+    return dataSize;
+}
+
+static void UploadStagingBuffer(Device& device, Buffer& stagingBuffer,
+                                bool generateMips, Texture& texture)
+{
+    BeginOneTimeSubmit(device);
+    Fly::RHI::CommandBuffer& cmd = OneTimeSubmitCommandBuffer(device);
+    RHI::ChangeTextureAccessLayout(cmd, texture,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    u32 mipCount = generateMips ? 1 : texture.mipCount;
+    u64 offset = 0;
+    for (u32 i = 0; i < mipCount; i++)
+    {
+        RHI::CopyBufferToTexture(cmd, texture, stagingBuffer, i, offset);
+
+        u32 mipWidth = MAX(texture.width >> i, 1);
+        u32 mipHeight = MAX(texture.height >> i, 1);
+        u32 mipDepth = MAX(texture.depth >> i, 1);
+        offset += static_cast<u64>(GetImageSize(mipWidth, mipHeight, mipDepth,
+                                                texture.format)) *
+                  texture.layerCount;
+    }
+
+    if (generateMips)
+    {
+        RHI::GenerateMipmaps(cmd, texture);
+    }
+    RHI::ChangeTextureAccessLayout(cmd, texture,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                   VK_ACCESS_2_SHADER_READ_BIT);
+    EndOneTimeSubmit(device);
 }
 
-static bool CopyDataToTexture(Device& device, const u8* data, bool generateMips,
+static bool CopyDataToTexture(Device& device, const u8* data,
+                              Buffer* stagingBuffer, bool generateMips,
                               Texture& texture)
 {
-    if (data)
+    if (stagingBuffer)
     {
-        u64 dataSize = GetImageSize(texture.width, texture.height,
-                                    texture.depth, texture.format) *
-                       texture.layerCount;
-        Arena& arena = GetScratchArena();
-        ArenaMarker marker = ArenaGetMarker(arena);
+        FLY_ASSERT(stagingBuffer->hostVisible);
+        FLY_ASSERT(stagingBuffer->allocationInfo.size >=
+                   GetTextureDataSize(texture, generateMips));
+        UploadStagingBuffer(device, *stagingBuffer, generateMips, texture);
+        return true;
+    }
 
-        Fly::RHI::Buffer stagingBuffer;
+    if (data)
+    {
+        Fly::RHI::Buffer buffer;
         if (!CreateBuffer(device, true, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, data,
-                          dataSize, stagingBuffer))
+                          GetTextureDataSize(texture, generateMips), buffer))
         {
             return false;
         }
-
-        BeginOneTimeSubmit(device);
-        Fly::RHI::CommandBuffer& cmd = OneTimeSubmitCommandBuffer(device);
-        RHI::ChangeTextureAccessLayout(cmd, texture,
-                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                       VK_ACCESS_2_TRANSFER_WRITE_BIT);
-        RHI::CopyBufferToTexture(cmd, texture, stagingBuffer, 0);
-
-        RHI::Buffer* mipStagingBuffers = nullptr;
-        if (generateMips)
-        {
-            RHI::GenerateMipmaps(cmd, texture);
-        }
-        else if (texture.mipCount > 1)
-        {
-            u64 offset = dataSize;
-            mipStagingBuffers =
-                FLY_PUSH_ARENA(arena, RHI::Buffer, texture.mipCount - 1);
-            for (u32 i = 1; i < texture.mipCount; i++)
-            {
-                u32 mipWidth = MAX(texture.width >> i, 1);
-                u32 mipHeight = MAX(texture.height >> i, 1);
-                u32 mipDepth = MAX(texture.depth >> i, 1);
-                u64 mipSize = GetImageSize(mipWidth, mipHeight, mipDepth,
-                                           texture.format) *
-                              texture.layerCount;
-                const u8* mipData = data + offset;
-                if (!CreateBuffer(device, true,
-                                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT, mipData,
-                                  mipSize, mipStagingBuffers[i - 1]))
-                {
-                    return false;
-                }
-                offset += mipSize;
-            }
-
-            for (u32 i = 0; i < texture.mipCount - 1; i++)
-            {
-
-                RHI::CopyBufferToTexture(cmd, texture, mipStagingBuffers[i],
-                                         i + 1);
-            }
-        }
-        RHI::ChangeTextureAccessLayout(cmd, texture,
-                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                       VK_ACCESS_2_SHADER_READ_BIT);
-        EndOneTimeSubmit(device);
-        DestroyBuffer(device, stagingBuffer);
-
-        if (mipStagingBuffers)
-        {
-            for (u32 i = 0; i < texture.mipCount - 1; i++)
-            {
-                DestroyBuffer(device, mipStagingBuffers[i]);
-            }
-        }
-        ArenaPopToMarker(arena, marker);
+        UploadStagingBuffer(device, buffer, generateMips, texture);
+        DestroyBuffer(device, buffer);
     }
     return true;
 }
@@ -551,10 +593,12 @@ void DestroySampler(Device& device, Sampler& sampler)
     sampler.handle = VK_NULL_HANDLE;
 }
 
-bool CreateTexture2D(Device& device, VkImageUsageFlags usage, const void* data,
-                     u32 width, u32 height, VkFormat format,
-                     Sampler::FilterMode filterMode, Sampler::WrapMode wrapMode,
-                     u32 mipCount, Texture& texture)
+static bool CreateTexture2D(Device& device, VkImageUsageFlags usage,
+                            const void* data, Buffer* stagingBuffer, u32 width,
+                            u32 height, VkFormat format,
+                            Sampler::FilterMode filterMode,
+                            Sampler::WrapMode wrapMode, u32 mipCount,
+                            Texture& texture)
 {
     FLY_ASSERT(width > 0);
     FLY_ASSERT(height > 0);
@@ -606,7 +650,15 @@ bool CreateTexture2D(Device& device, VkImageUsageFlags usage, const void* data,
             return false;
         }
 
-        CreateDescriptors(device, texture);
+        if (!CreateDescriptors(device, texture))
+        {
+            DestroySampler(device, texture.sampler);
+            vkDestroyImageView(device.logicalDevice, texture.imageView,
+                               GetVulkanAllocationCallbacks());
+            vmaDestroyImage(device.allocator, texture.image,
+                            texture.allocation);
+            return false;
+        }
     }
 
     texture.width = width;
@@ -615,9 +667,10 @@ bool CreateTexture2D(Device& device, VkImageUsageFlags usage, const void* data,
     texture.mipCount = mipCount;
     texture.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-    if (!CopyDataToTexture(device, static_cast<const u8*>(data), generateMips,
-                           texture))
+    if (!CopyDataToTexture(device, static_cast<const u8*>(data),
+                           stagingBuffer, generateMips, texture))
     {
+        ReleaseDescriptors(device, texture);
         DestroySampler(device, texture.sampler);
         vkDestroyImageView(device.logicalDevice, texture.imageView,
                            GetVulkanAllocationCallbacks());
@@ -633,9 +686,10 @@ bool CreateTexture2D(Device& device, VkImageUsageFlags usage, const void* data,
     return true;
 }
 
-bool CreateCubemap(Device& device, VkImageUsageFlags usage, const void* data,
-                   u32 size, VkFormat format, Sampler::FilterMode filterMode,
-                   u32 mipCount, Texture& texture)
+static bool CreateCubemap(Device& device, VkImageUsageFlags usage,
+                          const void* data, Buffer* stagingBuffer, u32 size,
+                          VkFormat format, Sampler::FilterMode filterMode,
+                          u32 mipCount, Texture& texture)
 {
     FLY_ASSERT(size > 0);
 
@@ -695,7 +749,15 @@ bool CreateCubemap(Device& device, VkImageUsageFlags usage, const void* data,
             return false;
         }
 
-        CreateDescriptors(device, texture);
+        if (!CreateDescriptors(device, texture))
+        {
+            DestroySampler(device, texture.sampler);
+            vkDestroyImageView(device.logicalDevice, texture.imageView,
+                               GetVulkanAllocationCallbacks());
+            vmaDestroyImage(device.allocator, texture.image,
+                            texture.allocation);
+            return false;
+        }
     }
 
     texture.width = size;
@@ -704,9 +766,10 @@ bool CreateCubemap(Device& device, VkImageUsageFlags usage, const void* data,
     texture.mipCount = mipCount;
     texture.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-    if (!CopyDataToTexture(device, static_cast<const u8*>(data), generateMips,
-                           texture))
+    if (!CopyDataToTexture(device, static_cast<const u8*>(data),
+                           stagingBuffer, generateMips, texture))
     {
+        ReleaseDescriptors(device, texture);
         DestroySampler(device, texture.sampler);
         vkDestroyImageView(device.logicalDevice, texture.imageView,
                            GetVulkanAllocationCallbacks());
@@ -723,6 +786,43 @@ bool CreateCubemap(Device& device, VkImageUsageFlags usage, const void* data,
     return true;
 }
 
+bool CreateTexture2D(Device& device, VkImageUsageFlags usage, const void* data,
+                     u32 width, u32 height, VkFormat format,
+                     Sampler::FilterMode filterMode, Sampler::WrapMode wrapMode,
+                     u32 mipCount, Texture& texture)
+{
+    return CreateTexture2D(device, usage, data, nullptr, width, height, format,
+                           filterMode, wrapMode, mipCount, texture);
+}
+
+bool CreateTexture2D(Device& device, VkImageUsageFlags usage,
+                     Buffer& stagingBuffer, u32 width, u32 height,
+                     VkFormat format, Sampler::FilterMode filterMode,
+                     Sampler::WrapMode wrapMode, u32 mipCount,
+                     Texture& texture)
+{
+    return CreateTexture2D(device, usage, nullptr, &stagingBuffer, width,
+                           height, format, filterMode, wrapMode, mipCount,
+                           texture);
+}
+
+bool CreateCubemap(Device& device, VkImageUsageFlags usage, const void* data,
+                   u32 size, VkFormat format, Sampler::FilterMode filterMode,
+                   u32 mipCount, Texture& texture)
+{
+    return CreateCubemap(device, usage, data, nullptr, size, format,
+                         filterMode, mipCount, texture);
+}
+
+bool CreateCubemap(Device& device, VkImageUsageFlags usage,
+                   Buffer& stagingBuffer, u32 size, VkFormat format,
+                   Sampler::FilterMode filterMode, u32 mipCount,
+                   Texture& texture)
+{
+    return CreateCubemap(device, usage, nullptr, &stagingBuffer, size, format,
+                         filterMode, mipCount, texture);
+}
+
 bool CreateTexture3D(Device& device, VkImageUsageFlags usage, const void* data,
                      u32 width, u32 height, u32 depth, VkFormat format,
                      Sampler::FilterMode filterMode, Sampler::WrapMode wrapMode,
@@ -781,13 +881,23 @@ bool CreateTexture3D(Device& device, VkImageUsageFlags usage, const void* data,
                                GetVulkanAllocationCallbacks());
             vmaDestroyImage(device.allocator, texture.image,
                             texture.allocation);
+            return false;
+        }
+        if (!CreateDescriptors(device, texture))
+        {
+            DestroySampler(device, texture.sampler);
+            vkDestroyImageView(device.logicalDevice, texture.imageView,
+                               GetVulkanAllocationCallbacks());
+            vmaDestroyImage(device.allocator, texture.image,
+                            texture.allocation);
+            return false;
         }
-        CreateDescriptors(device, texture);
     }
 
-    if (!CopyDataToTexture(device, static_cast<const u8*>(data), generateMips,
-                           texture))
+    if (!CopyDataToTexture(device, static_cast<const u8*>(data),
+                           nullptr, generateMips, texture))
     {
+        ReleaseDescriptors(device, texture);
         DestroySampler(device, texture.sampler);
         vkDestroyImageView(device.logicalDevice, texture.imageView,
                            GetVulkanAllocationCallbacks());
@@ -805,6 +915,7 @@ bool CreateTexture3D(Device& device, VkImageUsageFlags usage, const void* data,
 
 void DestroyTexture(Device& device, Texture& texture)
 {
+    ReleaseDescriptors(device, texture);
     DestroySampler(device, texture.sampler);
     if (texture.arrayImageView != VK_NULL_HANDLE)
     {
@@ -11,6 +11,7 @@ namespace Fly
 namespace RHI
 {
 
+struct Buffer;
 struct Device;
 
 u32 GetImageSize(u32 width, u32 height, VkFormat format);
@@ -74,6 +75,14 @@ bool CreateTexture2D(Device& device, VkImageUsageFlags usage, const void* data,
                      u32 width, u32 height, VkFormat format,
                      Sampler::FilterMode filterMode, Sampler::WrapMode wrapMode,
                      u32 mipCount, Texture& texture);
+// Uploads from a host visible buffer the caller already filled with every
+// mip, mip major with the layers of a mip next to each other. Saves the
+// copy into an internal staging buffer.
+bool CreateTexture2D(Device& device, VkImageUsageFlags usage,
+                     Buffer& stagingBuffer, u32 width, u32 height,
+                     VkFormat format, Sampler::FilterMode filterMode,
+                     Sampler::WrapMode wrapMode, u32 mipCount,
+                     Texture& texture);
 bool CreateTexture3D(Device& device, VkImageUsageFlags usage, const void* data,
                      u32 width, u32 height, u32 depth, VkFormat format,
                      Sampler::FilterMode filterMode, Sampler::WrapMode wrapMode,
@@ -83,6 +92,10 @@ void DestroyTexture(Device& device, Texture& texture);
 bool CreateCubemap(Device& device, VkImageUsageFlags usage, const void* data,
                    u32 size, VkFormat format, Sampler::FilterMode filterMode,
                    u32 mipCount, Texture& texture);
+bool CreateCubemap(Device& device, VkImageUsageFlags usage,
+                   Buffer& stagingBuffer, u32 size, VkFormat format,
+                   Sampler::FilterMode filterMode, u32 mipCount,
+                   Texture& texture);
 
 VkImageView CreateImageView(Device& device, const Texture& texture,
                             VkImageViewType imageViewType, u32 baseMipLevel = 0,
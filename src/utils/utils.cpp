@@ -4,6 +4,7 @@
 
 #include "math/functions.h"
 
+#include "rhi/buffer.h"
 #include "rhi/device.h"
 #include "rhi/pipeline.h"
 
@@ -91,6 +92,28 @@ bool LoadCubemap(RHI::Device& device, VkImageUsageFlags usage, String8 path,
     return true;
 }
 
+// Compressed files are read straight into a mapped staging buffer, which is
+// then copied to the texture with a single submit
+struct StagingAllocator
+{
+    RHI::Device* device = nullptr;
+    RHI::Buffer buffer;
+};
+
+static u8* AllocStagingBuffer(const Image& image, u64 size, void* userData)
+{
+    StagingAllocator& allocator = *static_cast<StagingAllocator*>(userData);
+    FLY_ASSERT(allocator.buffer.handle == VK_NULL_HANDLE);
+
+    if (!RHI::CreateBuffer(*allocator.device, true,
+                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT, nullptr, size,
+                           allocator.buffer))
+    {
+        return nullptr;
+    }
+    return static_cast<u8*>(RHI::BufferMappedPtr(allocator.buffer));
+}
+
 bool LoadCompressedCubemap(RHI::Device& device, VkImageUsageFlags usage,
                            String8 path, VkFormat format,
                            RHI::Sampler::FilterMode filterMode,
@@ -111,20 +134,23 @@ bool LoadCompressedCubemap(RHI::Device& device, VkImageUsageFlags usage,
                format == VK_FORMAT_BC7_UNORM_BLOCK ||
                format == VK_FORMAT_BC7_SRGB_BLOCK);
 
-    Image image;
-    if (!Fly::LoadImageFromFile(path, image))
-    {
-        return false;
-    }
+    StagingAllocator allocator;
+    allocator.device = &device;
 
-    if (!RHI::CreateCubemap(device, usage, image.data, image.width, format,
-                            filterMode, image.mipCount, texture))
+    Image image;
+    if (!Fly::LoadImageFromFile(path, image, AllocStagingBuffer, &allocator))
     {
+        if (allocator.buffer.handle != VK_NULL_HANDLE)
+        {
+            RHI::DestroyBuffer(device, allocator.buffer);
+        }
         return false;
     }
 
-    DestroyImage(image);
-    return true;
+    bool res = RHI::CreateCubemap(device, usage, allocator.buffer, image.width,
+                                  format, filterMode, image.mipCount, texture);
+    RHI::DestroyBuffer(device, allocator.buffer);
+    return res;
 }
 
 bool LoadCompressedTexture2D(RHI::Device& device, VkImageUsageFlags usage,
@@ -148,21 +174,25 @@ bool LoadCompressedTexture2D(RHI::Device& device, VkImageUsageFlags usage,
                format == VK_FORMAT_BC7_UNORM_BLOCK ||
                format == VK_FORMAT_BC7_SRGB_BLOCK);
 
-    Image image;
-    if (!Fly::LoadImageFromFile(path, image))
-    {
-        return false;
-    }
+    StagingAllocator allocator;
+    allocator.device = &device;
 
-    if (!RHI::CreateTexture2D(device, usage, image.data, image.width,
-                              image.height, format, filterMode, wrapMode,
-                              image.mipCount, texture))
+    Image image;
+    if (!Fly::LoadImageFromFile(path, image, AllocStagingBuffer, &allocator))
     {
+        if (allocator.buffer.handle != VK_NULL_HANDLE)
+        {
+            RHI::DestroyBuffer(device, allocator.buffer);
+        }
         return false;
     }
 
-    DestroyImage(image);
-    return true;
+    bool res = RHI::CreateTexture2D(device, usage, allocator.buffer,
+                                    image.width, image.height, format,
+                                    filterMode, wrapMode, image.mipCount,
+                                    texture);
+    RHI::DestroyBuffer(device, allocator.buffer);
+    return res;
 }
 
 static RHI::Shader::Type GetShaderType(String8 path)
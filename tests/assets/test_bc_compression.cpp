@@ -0,0 +1,663 @@
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include "assets/image/bc_compression.h"
+
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+
+using namespace Fly;
+
+// Reference decoders written from the format specification, only for the
+// modes the encoders emit
+
+static const u8 sTestWeights2[4] = {0, 21, 43, 64};
+static const u8 sTestWeights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const u8 sTestWeights4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                     34, 38, 43, 47, 51, 55, 60, 64};
+
+static const u16 sTestPartitions2[64] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22};
+
+static const u8 sTestAnchors2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2,  8,  2,  2,  8,  8,  15, 2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15, 6,  8,  2,  8,  15, 15, 2,  8,  2,  2,  2,  15, 15, 6,
+    6,  2,  6,  8,  15, 15, 2,  2,  15, 15, 15, 15, 15, 2,  2,  15};
+
+struct BitReader
+{
+    const u8* data;
+    u32 offset = 0;
+
+    u32 Read(u32 count)
+    {
+        u32 value = 0;
+        for (u32 i = 0; i < count; i++, offset++)
+        {
+            value |= ((data[offset >> 3] >> (offset & 7)) & 1u) << i;
+        }
+        return value;
+    }
+};
+
+static u32 Expand(u32 value, u32 precision)
+{
+    value <<= 8 - precision;
+    return value | (value >> precision);
+}
+
+static u8 Interpolate(u32 e0, u32 e1, u32 weight)
+{
+    return static_cast<u8>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+}
+
+// Returns the decoded mode, or -1 for modes the encoder never emits
+static i32 DecodeBC7(const u8* block, u8 texels[16][4])
+{
+    BitReader reader{block};
+    u32 mode = 0;
+    while (mode < 8 && !reader.Read(1))
+    {
+        mode++;
+    }
+
+    if (mode == 6)
+    {
+        u32 e[2][4];
+        for (u32 c = 0; c < 4; c++)
+        {
+            e[0][c] = reader.Read(7) << 1;
+            e[1][c] = reader.Read(7) << 1;
+        }
+        u32 p0 = reader.Read(1);
+        u32 p1 = reader.Read(1);
+        for (u32 c = 0; c < 4; c++)
+        {
+            e[0][c] |= p0;
+            e[1][c] |= p1;
+        }
+        for (u32 i = 0; i < 16; i++)
+        {
+            u32 index = reader.Read(i == 0 ? 3 : 4);
+            for (u32 c = 0; c < 4; c++)
+            {
+                texels[i][c] =
+                    Interpolate(e[0][c], e[1][c], sTestWeights4[index]);
+            }
+        }
+        return 6;
+    }
+
+    if (mode == 5)
+    {
+        u32 rotation = reader.Read(2);
+        u32 e[2][4];
+        for (u32 c = 0; c < 3; c++)
+        {
+            e[0][c] = Expand(reader.Read(7), 7);
+            e[1][c] = Expand(reader.Read(7), 7);
+        }
+        e[0][3] = reader.Read(8);
+        e[1][3] = reader.Read(8);
+
+        u32 colorIndices[16];
+        for (u32 i = 0; i < 16; i++)
+        {
+            colorIndices[i] = reader.Read(i == 0 ? 1 : 2);
+        }
+        for (u32 i = 0; i < 16; i++)
+        {
+            u32 alphaIndex = reader.Read(i == 0 ? 1 : 2);
+            for (u32 c = 0; c < 3; c++)
+            {
+                texels[i][c] = Interpolate(e[0][c], e[1][c],
+                                           sTestWeights2[colorIndices[i]]);
+            }
+            texels[i][3] =
+                Interpolate(e[0][3], e[1][3], sTestWeights2[alphaIndex]);
+            if (rotation)
+            {
+                u8 tmp = texels[i][3];
+                texels[i][3] = texels[i][rotation - 1];
+                texels[i][rotation - 1] = tmp;
+            }
+        }
+        return 5;
+    }
+
+    if (mode == 1 || mode == 3)
+    {
+        const u32 bits = mode == 1 ? 6 : 7;
+        const u32 indexBits = mode == 1 ? 3 : 2;
+        const u8* weights = mode == 1 ? sTestWeights3 : sTestWeights2;
+
+        u32 partition = reader.Read(6);
+        u32 e[2][2][3];
+        for (u32 c = 0; c < 3; c++)
+        {
+            for (u32 s = 0; s < 2; s++)
+            {
+                e[s][0][c] = reader.Read(bits);
+                e[s][1][c] = reader.Read(bits);
+            }
+        }
+        for (u32 s = 0; s < 2; s++)
+        {
+            u32 p0 = reader.Read(1);
+            u32 p1 = mode == 1 ? p0 : reader.Read(1);
+            for (u32 c = 0; c < 3; c++)
+            {
+                e[s][0][c] = Expand((e[s][0][c] << 1) | p0, bits + 1);
+                e[s][1][c] = Expand((e[s][1][c] << 1) | p1, bits + 1);
+            }
+        }
+
+        u16 mask = sTestPartitions2[partition];
+        u32 anchor = sTestAnchors2[partition];
+        for (u32 i = 0; i < 16; i++)
+        {
+            bool isAnchor = i == 0 || i == anchor;
+            u32 index = reader.Read(indexBits - (isAnchor ? 1 : 0));
+            u32 s = (mask >> i) & 1u;
+            for (u32 c = 0; c < 3; c++)
+            {
+                texels[i][c] =
+                    Interpolate(e[s][0][c], e[s][1][c], weights[index]);
+            }
+            texels[i][3] = 255;
+        }
+        return static_cast<i32>(mode);
+    }
+
+    return -1;
+}
+
+static u32 UnquantizeHalf(u32 q)
+{
+    if (q == 0)
+    {
+        return 0;
+    }
+    if (q == 1023)
+    {
+        return 0xffff;
+    }
+    return ((q << 16) + 0x8000) >> 10;
+}
+
+static bool DecodeBC6H(const u8* block, u16 texels[16][3])
+{
+    BitReader reader{block};
+    if (reader.Read(5) != 0x03)
+    {
+        return false;
+    }
+
+    u32 e[2][3];
+    for (u32 k = 0; k < 2; k++)
+    {
+        for (u32 c = 0; c < 3; c++)
+        {
+            e[k][c] = UnquantizeHalf(reader.Read(10));
+        }
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 w = sTestWeights4[reader.Read(i == 0 ? 3 : 4)];
+        for (u32 c = 0; c < 3; c++)
+        {
+            u32 value = (e[0][c] * (64 - w) + e[1][c] * w + 32) >> 6;
+            texels[i][c] = static_cast<u16>((value * 31) >> 6);
+        }
+    }
+    return true;
+}
+
+static u32 Expand565(u32 value, u32 bits)
+{
+    return (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+static void DecodeBC1(const u8* block, u8 texels[16][4])
+{
+    u32 c[2] = {block[0] | (static_cast<u32>(block[1]) << 8),
+                block[2] | (static_cast<u32>(block[3]) << 8)};
+    u32 palette[4][3];
+    for (u32 k = 0; k < 2; k++)
+    {
+        palette[k][0] = Expand565(c[k] >> 11, 5);
+        palette[k][1] = Expand565((c[k] >> 5) & 63, 6);
+        palette[k][2] = Expand565(c[k] & 31, 5);
+    }
+    for (u32 ch = 0; ch < 3; ch++)
+    {
+        u32 a = palette[0][ch];
+        u32 b = palette[1][ch];
+        if (c[0] > c[1])
+        {
+            palette[2][ch] = (2 * a + b) / 3;
+            palette[3][ch] = (a + 2 * b) / 3;
+        }
+        else
+        {
+            palette[2][ch] = (a + b) / 2;
+            palette[3][ch] = 0;
+        }
+    }
+
+    u32 indices = block[4] | (block[5] << 8u) | (block[6] << 16u) |
+                  (static_cast<u32>(block[7]) << 24u);
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 index = (indices >> (i * 2)) & 3;
+        for (u32 ch = 0; ch < 3; ch++)
+        {
+            texels[i][ch] = static_cast<u8>(palette[index][ch]);
+        }
+    }
+}
+
+static void DecodeBC4(const u8* block, u8* texels, u32 stride)
+{
+    u32 a0 = block[0];
+    u32 a1 = block[1];
+    u32 palette[8] = {a0, a1};
+    if (a0 > a1)
+    {
+        for (u32 k = 1; k < 7; k++)
+        {
+            palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+        }
+    }
+    else
+    {
+        for (u32 k = 1; k < 5; k++)
+        {
+            palette[k + 1] = ((5 - k) * a0 + k * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    u64 indices = 0;
+    for (u32 i = 0; i < 6; i++)
+    {
+        indices |= static_cast<u64>(block[2 + i]) << (i * 8);
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+        texels[i * stride] = static_cast<u8>(palette[(indices >> (i * 3)) & 7]);
+    }
+}
+
+static u32 sSeed = 1;
+
+static u32 NextRandom()
+{
+    sSeed = sSeed * 1664525u + 1013904223u;
+    return sSeed >> 8;
+}
+
+// Smooth gradient with some noise, similar to natural image content
+static void MakeBlock(u32 blockIndex, bool withAlpha, u8 texels[16][4])
+{
+    u8 base[4];
+    i32 dx[4];
+    i32 dy[4];
+    for (u32 c = 0; c < 4; c++)
+    {
+        base[c] = static_cast<u8>(NextRandom());
+        dx[c] = static_cast<i32>(NextRandom() % 21) - 10;
+        dy[c] = static_cast<i32>(NextRandom() % 21) - 10;
+    }
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        i32 x = i & 3;
+        i32 y = i >> 2;
+        for (u32 c = 0; c < 4; c++)
+        {
+            i32 noise = static_cast<i32>(NextRandom() % 9) - 4;
+            i32 v = base[c] + dx[c] * x + dy[c] * y + noise;
+            // Every fourth block has a hard edge to exercise partitions
+            if ((blockIndex & 3) == 0 && x + y > 2 && c != 3)
+            {
+                v = 255 - v;
+            }
+            texels[i][c] = static_cast<u8>(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+        if (!withAlpha)
+        {
+            texels[i][3] = 255;
+        }
+    }
+}
+
+static f64 Psnr(f64 squaredError, u64 sampleCount, f64 peak)
+{
+    if (squaredError == 0.0)
+    {
+        return 100.0;
+    }
+    f64 mse = squaredError / sampleCount;
+    return 10.0 * log10(peak * peak / mse);
+}
+
+static f64 CompressBC7(BCQuality quality, bool withAlpha, u32* modeCounts)
+{
+    sSeed = 1;
+    f64 error = 0.0;
+    const u32 blockCount = 256;
+    for (u32 b = 0; b < blockCount; b++)
+    {
+        u8 texels[16][4];
+        MakeBlock(b, withAlpha, texels);
+
+        u8 block[16];
+        CompressBlockBC7(block, &texels[0][0], quality);
+
+        u8 decoded[16][4];
+        i32 mode = DecodeBC7(block, decoded);
+        EXPECT_GE(mode, 0);
+        if (mode < 0)
+        {
+            return 0.0;
+        }
+        modeCounts[mode]++;
+        if (withAlpha)
+        {
+            EXPECT_TRUE(mode == 5 || mode == 6);
+        }
+
+        for (u32 i = 0; i < 16; i++)
+        {
+            for (u32 c = 0; c < 4; c++)
+            {
+                f64 d = static_cast<f64>(decoded[i][c]) - texels[i][c];
+                error += d * d;
+            }
+        }
+    }
+    return Psnr(error, blockCount * 64, 255.0);
+}
+
+TEST(BC7, ConstantBlock)
+{
+    u8 texels[16][4];
+    for (u32 i = 0; i < 16; i++)
+    {
+        texels[i][0] = 12;
+        texels[i][1] = 200;
+        texels[i][2] = 97;
+        texels[i][3] = 255;
+    }
+
+    u8 block[16];
+    CompressBlockBC7(block, &texels[0][0], BCQuality::Fast);
+
+    u8 decoded[16][4];
+    ASSERT_EQ(DecodeBC7(block, decoded), 6);
+    for (u32 i = 0; i < 16; i++)
+    {
+        for (u32 c = 0; c < 4; c++)
+        {
+            EXPECT_NEAR(decoded[i][c], texels[i][c], 1);
+        }
+    }
+}
+
+TEST(BC7, Quality)
+{
+    u32 fastModes[8] = {};
+    u32 normalModes[8] = {};
+    u32 highModes[8] = {};
+    f64 fast = CompressBC7(BCQuality::Fast, false, fastModes);
+    f64 normal = CompressBC7(BCQuality::Normal, false, normalModes);
+    f64 high = CompressBC7(BCQuality::High, false, highModes);
+
+    EXPECT_GT(fast, 33.0);
+    EXPECT_GT(normal, 38.0);
+    EXPECT_GE(normal, fast);
+    EXPECT_GE(high, normal);
+
+    EXPECT_EQ(fastModes[6], 256u);
+    EXPECT_GT(normalModes[1], 0u);
+    EXPECT_GT(highModes[1] + highModes[3], 0u);
+}
+
+TEST(BC7, Alpha)
+{
+    u32 modes[8] = {};
+    f64 normal = CompressBC7(BCQuality::Normal, true, modes);
+    EXPECT_GT(normal, 32.0);
+    EXPECT_EQ(modes[1] + modes[3], 0u);
+}
+
+TEST(BC6H, Gradient)
+{
+    for (u32 quality = 0; quality < 3; quality++)
+    {
+        sSeed = 7;
+        f64 error = 0.0;
+        u64 sampleCount = 0;
+        for (u32 b = 0; b < 64; b++)
+        {
+            // Smooth HDR gradient in [0, 16) with four channels, alpha is
+            // ignored
+            f32 base[3];
+            for (u32 c = 0; c < 3; c++)
+            {
+                base[c] = (NextRandom() % 1000) / 64.0f;
+            }
+
+            f16 texels[16 * 4];
+            for (u32 i = 0; i < 16; i++)
+            {
+                for (u32 c = 0; c < 3; c++)
+                {
+                    f32 t = 1.0f + 0.02f * (i & 3) + 0.01f * (i >> 2);
+                    texels[i * 4 + c] = f16(base[c] * t);
+                }
+                texels[i * 4 + 3] = f16(1.0f);
+            }
+
+            u8 block[16];
+            CompressBlockBC6H(block, texels, 4,
+                              static_cast<BCQuality>(quality));
+
+            u16 decoded[16][3];
+            ASSERT_TRUE(DecodeBC6H(block, decoded));
+            for (u32 i = 0; i < 16; i++)
+            {
+                for (u32 c = 0; c < 3; c++)
+                {
+                    f32 expected = static_cast<f32>(texels[i * 4 + c]);
+                    f16 half;
+                    half.data = decoded[i][c];
+                    f32 d = static_cast<f32>(half) - expected;
+                    // Relative error, HDR content is compared in log space
+                    error += (d * d) / (expected * expected + 1e-4f);
+                    sampleCount++;
+                }
+            }
+        }
+        EXPECT_GT(Psnr(error, sampleCount, 1.0), 30.0) << quality;
+    }
+}
+
+TEST(BC6H, NegativeClampsToZero)
+{
+    f16 texels[16 * 3];
+    for (u32 i = 0; i < 16 * 3; i++)
+    {
+        texels[i] = f16(-2.0f);
+    }
+
+    u8 block[16];
+    CompressBlockBC6H(block, texels, 3, BCQuality::Normal);
+
+    u16 decoded[16][3];
+    ASSERT_TRUE(DecodeBC6H(block, decoded));
+    for (u32 i = 0; i < 16; i++)
+    {
+        for (u32 c = 0; c < 3; c++)
+        {
+            EXPECT_EQ(decoded[i][c], 0);
+        }
+    }
+}
+
+enum class TestCodec
+{
+    BC1,
+    BC3,
+    BC4,
+    BC5,
+};
+
+// Compresses and decodes one block with the Fly encoder and with stb_dxt,
+// accumulating the squared error of the channels the codec stores
+static void CompressDXT(TestCodec codec, const u8 texels[16][4],
+                        f64& flyError, f64& stbError)
+{
+    u8 src[64];
+    u32 channelCount = 4;
+    if (codec == TestCodec::BC4 || codec == TestCodec::BC5)
+    {
+        channelCount = codec == TestCodec::BC4 ? 1 : 2;
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+        for (u32 c = 0; c < channelCount; c++)
+        {
+            src[i * channelCount + c] = texels[i][c];
+        }
+    }
+
+    u8 blocks[2][16];
+    switch (codec)
+    {
+        case TestCodec::BC1:
+        {
+            CompressBlockBC1(blocks[0], src);
+            stb_compress_dxt_block(blocks[1], src, 0, STB_DXT_NORMAL);
+            break;
+        }
+        case TestCodec::BC3:
+        {
+            CompressBlockBC3(blocks[0], src);
+            stb_compress_dxt_block(blocks[1], src, 1, STB_DXT_NORMAL);
+            break;
+        }
+        case TestCodec::BC4:
+        {
+            CompressBlockBC4(blocks[0], src);
+            stb_compress_bc4_block(blocks[1], src);
+            break;
+        }
+        case TestCodec::BC5:
+        {
+            CompressBlockBC5(blocks[0], src);
+            stb_compress_bc5_block(blocks[1], src);
+            break;
+        }
+    }
+
+    for (u32 k = 0; k < 2; k++)
+    {
+        u8 decoded[16][4] = {};
+        u32 firstChannel = 0;
+        u32 lastChannel = channelCount;
+        if (codec == TestCodec::BC1)
+        {
+            DecodeBC1(blocks[k], decoded);
+            lastChannel = 3;
+        }
+        else if (codec == TestCodec::BC3)
+        {
+            DecodeBC4(blocks[k], &decoded[0][3], 4);
+            DecodeBC1(blocks[k] + 8, decoded);
+        }
+        else
+        {
+            for (u32 c = 0; c < channelCount; c++)
+            {
+                DecodeBC4(blocks[k] + c * 8, &decoded[0][c], 4);
+            }
+        }
+
+        f64& error = k == 0 ? flyError : stbError;
+        for (u32 i = 0; i < 16; i++)
+        {
+            for (u32 c = firstChannel; c < lastChannel; c++)
+            {
+                f64 d = static_cast<f64>(decoded[i][c]) - texels[i][c];
+                error += d * d;
+            }
+        }
+    }
+}
+
+static void ComparePsnr(TestCodec codec, u32 sampleChannelCount, f64 minPsnr)
+{
+    sSeed = 3;
+    const u32 blockCount = 512;
+    f64 flyError = 0.0;
+    f64 stbError = 0.0;
+    for (u32 b = 0; b < blockCount; b++)
+    {
+        u8 texels[16][4];
+        MakeBlock(b, codec == TestCodec::BC3, texels);
+        CompressDXT(codec, texels, flyError, stbError);
+    }
+
+    u64 sampleCount = blockCount * 16 * sampleChannelCount;
+    f64 flyPsnr = Psnr(flyError, sampleCount, 255.0);
+    f64 stbPsnr = Psnr(stbError, sampleCount, 255.0);
+    EXPECT_GT(flyPsnr, minPsnr);
+    EXPECT_GT(flyPsnr, stbPsnr - 0.25);
+}
+
+TEST(BC1, Psnr) { ComparePsnr(TestCodec::BC1, 3, 31.0); }
+
+TEST(BC3, Psnr) { ComparePsnr(TestCodec::BC3, 4, 32.5); }
+
+TEST(BC4, Psnr) { ComparePsnr(TestCodec::BC4, 1, 38.5); }
+
+TEST(BC5, Psnr) { ComparePsnr(TestCodec::BC5, 2, 38.5); }
+
+TEST(BC1, SolidBlock)
+{
+    for (u32 value = 0; value < 256; value += 5)
+    {
+        u8 texels[16][4];
+        for (u32 i = 0; i < 16; i++)
+        {
+            texels[i][0] = static_cast<u8>(value);
+            texels[i][1] = static_cast<u8>(255 - value);
+            texels[i][2] = static_cast<u8>(value / 2);
+            texels[i][3] = 255;
+        }
+
+        u8 block[8];
+        CompressBlockBC1(block, &texels[0][0]);
+
+        u8 decoded[16][4];
+        DecodeBC1(block, decoded);
+        for (u32 i = 0; i < 16; i++)
+        {
+            for (u32 c = 0; c < 3; c++)
+            {
+                EXPECT_NEAR(decoded[i][c], texels[i][c], 1);
+            }
+        }
+    }
+}
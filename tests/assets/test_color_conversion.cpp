@@ -0,0 +1,377 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assets/image/import_image.h"
+#include "assets/image/transform_image.h"
+
+#include "core/cpu_features.h"
+#include "core/memory.h"
+#include "core/thread_context.h"
+
+using namespace Fly;
+
+// Scalar references written from the srgb and tonemap formulas. The same
+// tests run a second time with FLY_DISABLE_CPU_FEATURES set, see BUILD.bazel
+
+static f32 DecodeSRGBReference(f32 value)
+{
+    return (value <= 0.04045f) ? value / 12.92f
+                               : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static f32 EncodeSRGBReference(f32 value)
+{
+    value = fminf(fmaxf(value, 0.0f), 1.0f);
+    return (value <= 0.0031308f) ? value * 12.92f
+                                 : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static u8 QuantizeReference(f32 value)
+{
+    value = fminf(fmaxf(value, 0.0f), 1.0f);
+    return static_cast<u8>(value * 255.0f + 0.5f);
+}
+
+static f32 TonemapReference(f32 value, TonemapOperator op)
+{
+    f32 x = fmaxf(value, 0.0f);
+    if (op == TonemapOperator::Reinhard)
+    {
+        return x / (1.0f + x);
+    }
+    return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+}
+
+// Linear values from below 0 to above 1, dense around the srgb threshold
+static f32 LinearTestValue(u64 i)
+{
+    if (i % 7 == 0)
+    {
+        return 0.0031308f * static_cast<f32>(i % 13) / 6.0f;
+    }
+    return -0.25f + 1.5f * static_cast<f32>((i * 37) % 1001) / 1000.0f;
+}
+
+// Hdr values from below 0 to 16, all normal halfs
+static f32 HdrTestValue(u64 i)
+{
+    if (i % 11 == 0)
+    {
+        return -0.5f;
+    }
+    return 16.0f * powf(static_cast<f32>((i * 53) % 997) / 996.0f, 3.0f) +
+           0.001f;
+}
+
+static Image MakeFloatImage(u32 width, u32 height, u8 channelCount,
+                            u8 layerCount, f32 (*value)(u64))
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.channelCount = channelCount;
+    image.layerCount = layerCount;
+    image.mipCount = 1;
+    image.storageType = ImageStorageType::Float;
+    image.data = static_cast<u8*>(Alloc(GetImageSize(image)));
+
+    f32* values = reinterpret_cast<f32*>(image.data);
+    u64 count = static_cast<u64>(width) * height * channelCount * layerCount;
+    for (u64 i = 0; i < count; i++)
+    {
+        values[i] = value(i);
+    }
+    return image;
+}
+
+static u64 GetValueCount(const Image& image)
+{
+    return static_cast<u64>(image.width) * image.height *
+           image.channelCount * image.layerCount * image.mipCount;
+}
+
+TEST(ColorConversion, DisabledCpuFeatures)
+{
+    // The second test target only covers the portable kernels if the
+    // variable really masks the features out
+    const char* disabled = getenv("FLY_DISABLE_CPU_FEATURES");
+    if (disabled && strstr(disabled, "f16c"))
+    {
+        EXPECT_FALSE(HasCpuFeatures(FLY_CPU_FEATURE_F16C_BIT));
+    }
+    if (disabled && strstr(disabled, "avx2"))
+    {
+        EXPECT_FALSE(HasCpuFeatures(FLY_CPU_FEATURE_AVX2_BIT));
+    }
+}
+
+TEST(ColorConversion, SRGBToLinear)
+{
+    InitArenas();
+    for (u8 channelCount = 1; channelCount <= 4; channelCount++)
+    {
+        const u64 texelCount = 301;
+        u64 count = texelCount * channelCount;
+        u8* src = static_cast<u8*>(Alloc(count));
+        f32* dst = static_cast<f32*>(Alloc(sizeof(f32) * count));
+        for (u64 i = 0; i < count; i++)
+        {
+            src[i] = static_cast<u8>(i * 7);
+        }
+
+        SRGBToLinear(dst, src, texelCount, channelCount);
+        for (u64 i = 0; i < count; i++)
+        {
+            bool alpha = channelCount == 4 && i % 4 == 3;
+            f32 expected = alpha ? src[i] / 255.0f
+                                 : DecodeSRGBReference(src[i] / 255.0f);
+            ASSERT_NEAR(dst[i], expected, 1e-6f + expected * 1e-5f)
+                << "channels " << static_cast<u32>(channelCount) << " value "
+                << static_cast<u32>(src[i]);
+        }
+
+        Free(dst);
+        Free(src);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ColorConversion, LinearToSRGB)
+{
+    InitArenas();
+    for (u8 channelCount = 1; channelCount <= 4; channelCount++)
+    {
+        // Spans several chunks and ends in a partial one
+        const u64 texelCount = 1500;
+        u64 count = texelCount * channelCount;
+        f32* src = static_cast<f32*>(Alloc(sizeof(f32) * count));
+        u8* dst = static_cast<u8*>(Alloc(count));
+        for (u64 i = 0; i < count; i++)
+        {
+            src[i] = LinearTestValue(i);
+        }
+
+        LinearToSRGB(dst, src, texelCount, channelCount);
+        for (u64 i = 0; i < count; i++)
+        {
+            bool alpha = channelCount == 4 && i % 4 == 3;
+            u8 expected = QuantizeReference(
+                alpha ? src[i] : EncodeSRGBReference(src[i]));
+            ASSERT_LE(abs(dst[i] - expected), 1)
+                << "channels " << static_cast<u32>(channelCount) << " value "
+                << src[i];
+        }
+
+        Free(dst);
+        Free(src);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ColorConversion, SRGBRoundTrip)
+{
+    InitArenas();
+    for (u8 channelCount = 3; channelCount <= 4; channelCount++)
+    {
+        const u64 texelCount = 256;
+        u64 count = texelCount * channelCount;
+        u8* src = static_cast<u8*>(Alloc(count));
+        f32* linear = static_cast<f32*>(Alloc(sizeof(f32) * count));
+        u8* dst = static_cast<u8*>(Alloc(count));
+        for (u64 i = 0; i < count; i++)
+        {
+            src[i] = static_cast<u8>(i / channelCount);
+        }
+
+        // Every code survives a decode and encode exactly
+        SRGBToLinear(linear, src, texelCount, channelCount);
+        LinearToSRGB(dst, linear, texelCount, channelCount);
+        for (u64 i = 0; i < count; i++)
+        {
+            ASSERT_EQ(dst[i], src[i])
+                << "channels " << static_cast<u32>(channelCount);
+        }
+
+        Free(dst);
+        Free(linear);
+        Free(src);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ColorConversion, Tonemap)
+{
+    InitArenas();
+    const TonemapOperator ops[] = {TonemapOperator::Reinhard,
+                                   TonemapOperator::Aces};
+    for (TonemapOperator op : ops)
+    {
+        for (u8 channelCount = 1; channelCount <= 4; channelCount++)
+        {
+            for (u32 half = 0; half < 2; half++)
+            {
+                // More texels than one job, odd sizes end in partial chunks
+                Image image =
+                    MakeFloatImage(131, 67, channelCount, 2, HdrTestValue);
+                u64 count = GetValueCount(image);
+                f32* src = static_cast<f32*>(Alloc(sizeof(f32) * count));
+                memcpy(src, image.data, sizeof(f32) * count);
+
+                if (half)
+                {
+                    ConvertImageStorage(ImageStorageType::Half, image);
+                    for (u64 i = 0; i < count; i++)
+                    {
+                        src[i] = f16(src[i]);
+                    }
+                    TonemapHalf(image, op);
+                }
+                else
+                {
+                    TonemapFloat(image, op);
+                }
+                ASSERT_EQ(image.storageType, ImageStorageType::Byte);
+                ASSERT_EQ(image.channelCount, channelCount);
+
+                for (u64 i = 0; i < count; i++)
+                {
+                    bool alpha = channelCount == 4 && i % 4 == 3;
+                    u8 expected =
+                        QuantizeReference(alpha ? src[i]
+                                                : EncodeSRGBReference(
+                                                      TonemapReference(
+                                                          src[i], op)));
+                    ASSERT_LE(abs(image.data[i] - expected), 1)
+                        << "op " << static_cast<u32>(op) << " channels "
+                        << static_cast<u32>(channelCount) << " half " << half
+                        << " value " << src[i];
+                }
+
+                Free(src);
+                DestroyImage(image);
+            }
+        }
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ColorConversion, ConvertImageStorage)
+{
+    InitArenas();
+    Image image = MakeFloatImage(129, 130, 3, 1, HdrTestValue);
+    u64 count = GetValueCount(image);
+    f32* values = reinterpret_cast<f32*>(image.data);
+    // Large, negative and small normal values
+    values[0] = 60000.0f;
+    values[1] = -60000.0f;
+    values[2] = 1.0f / 16384.0f;
+    values[3] = 0.0f;
+    f32* src = static_cast<f32*>(Alloc(sizeof(f32) * count));
+    memcpy(src, image.data, sizeof(f32) * count);
+
+    // Hardware and scalar rounding may differ in the last bit
+    ConvertImageStorage(ImageStorageType::Half, image);
+    ASSERT_EQ(image.storageType, ImageStorageType::Half);
+    const f16* halfs = reinterpret_cast<const f16*>(image.data);
+    for (u64 i = 0; i < count; i++)
+    {
+        f32 expected = f16(src[i]);
+        ASSERT_NEAR(halfs[i], expected, fabsf(expected) / 1024.0f)
+            << "value " << src[i];
+        src[i] = halfs[i];
+    }
+
+    ConvertImageStorage(ImageStorageType::Float, image);
+    ASSERT_EQ(image.storageType, ImageStorageType::Float);
+    values = reinterpret_cast<f32*>(image.data);
+    for (u64 i = 0; i < count; i++)
+    {
+        ASSERT_EQ(values[i], src[i]);
+    }
+
+    Free(src);
+    DestroyImage(image);
+    ReleaseThreadContext();
+}
+
+template <typename T>
+static void ExpectChannelsConverted(const Image& image, const T* src,
+                                    u8 srcChannelCount, T one)
+{
+    const T* dst = reinterpret_cast<const T*>(image.data);
+    u64 texelCount =
+        static_cast<u64>(image.width) * image.height * image.layerCount;
+    for (u64 i = 0; i < texelCount; i++)
+    {
+        for (u8 c = 0; c < image.channelCount; c++)
+        {
+            T expected = c < srcChannelCount ? src[i * srcChannelCount + c]
+                                             : (c == 3 ? one : T(0.0f));
+            ASSERT_EQ(static_cast<f32>(dst[i * image.channelCount + c]),
+                      static_cast<f32>(expected))
+                << "channels " << static_cast<u32>(srcChannelCount) << " -> "
+                << static_cast<u32>(image.channelCount);
+        }
+    }
+}
+
+TEST(ColorConversion, ConvertImageChannels)
+{
+    InitArenas();
+    const ImageStorageType storageTypes[] = {ImageStorageType::Byte,
+                                             ImageStorageType::Half,
+                                             ImageStorageType::Float};
+    for (ImageStorageType storageType : storageTypes)
+    {
+        for (u8 srcChannelCount = 1; srcChannelCount <= 4; srcChannelCount++)
+        {
+            for (u8 dstChannelCount = 1; dstChannelCount <= 4;
+                 dstChannelCount++)
+            {
+                Image image = MakeFloatImage(131, 127, srcChannelCount, 1,
+                                             HdrTestValue);
+                if (storageType == ImageStorageType::Byte)
+                {
+                    // Reinterprets the float pattern as bytes
+                    image.width *= 4;
+                    image.storageType = ImageStorageType::Byte;
+                }
+                else if (storageType == ImageStorageType::Half)
+                {
+                    ConvertImageStorage(ImageStorageType::Half, image);
+                }
+                u64 size = GetImageSize(image);
+                u8* src = static_cast<u8*>(Alloc(size));
+                memcpy(src, image.data, size);
+
+                ConvertImageChannels(dstChannelCount, image);
+                ASSERT_EQ(image.channelCount, dstChannelCount);
+                ASSERT_EQ(image.storageType, storageType);
+
+                if (storageType == ImageStorageType::Byte)
+                {
+                    ExpectChannelsConverted(image, src, srcChannelCount,
+                                            static_cast<u8>(255));
+                }
+                else if (storageType == ImageStorageType::Half)
+                {
+                    ExpectChannelsConverted(
+                        image, reinterpret_cast<const f16*>(src),
+                        srcChannelCount, f16(1.0f));
+                }
+                else
+                {
+                    ExpectChannelsConverted(
+                        image, reinterpret_cast<const f32*>(src),
+                        srcChannelCount, 1.0f);
+                }
+
+                Free(src);
+                DestroyImage(image);
+            }
+        }
+    }
+    ReleaseThreadContext();
+}
@@ -0,0 +1,335 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <string>
+
+#include "assets/scene/geometry.h"
+
+#include "core/memory.h"
+#include "core/thread_context.h"
+
+using namespace Fly;
+
+struct ObjResult
+{
+    Geometry* geometries = nullptr;
+    u32 geometryCount = 0;
+    bool res = false;
+
+    ~ObjResult()
+    {
+        for (u32 i = 0; i < geometryCount; i++)
+        {
+            DestroyGeometry(geometries[i]);
+        }
+        Free(geometries);
+    }
+};
+
+static void ImportObj(const char* text, ObjResult& result,
+                      u64 chunkSize = FLY_OBJ_CHUNK_SIZE)
+{
+    result.res = ImportGeometriesObj(text, strlen(text), &result.geometries,
+                                     result.geometryCount, chunkSize);
+}
+
+static void ExpectIndices(const Geometry& geometry, const u32* indices,
+                          u32 indexCount)
+{
+    ASSERT_EQ(geometry.indexCount, indexCount);
+    for (u32 i = 0; i < indexCount; i++)
+    {
+        EXPECT_EQ(geometry.indices[i], indices[i]) << "index " << i;
+    }
+}
+
+static void ExpectSameGeometries(const ObjResult& a, const ObjResult& b)
+{
+    ASSERT_EQ(a.geometryCount, b.geometryCount);
+    for (u32 i = 0; i < a.geometryCount; i++)
+    {
+        const Geometry& ga = a.geometries[i];
+        const Geometry& gb = b.geometries[i];
+        ASSERT_EQ(ga.vertexCount, gb.vertexCount);
+        ASSERT_EQ(ga.indexCount, gb.indexCount);
+        ASSERT_EQ(ga.subgeometryCount, gb.subgeometryCount);
+        EXPECT_EQ(ga.vertexMask, gb.vertexMask);
+        EXPECT_EQ(memcmp(ga.vertices, gb.vertices,
+                         sizeof(Vertex) * ga.vertexCount),
+                  0);
+        EXPECT_EQ(memcmp(ga.indices, gb.indices,
+                         sizeof(u32) * ga.indexCount),
+                  0);
+        for (u32 j = 0; j < ga.subgeometryCount; j++)
+        {
+            EXPECT_EQ(ga.subgeometries[j].lods[0].firstIndex,
+                      gb.subgeometries[j].lods[0].firstIndex);
+            EXPECT_EQ(ga.subgeometries[j].lods[0].indexCount,
+                      gb.subgeometries[j].lods[0].indexCount);
+        }
+    }
+}
+
+static const char* sQuadObj = "v 0 0 0\n"
+                              "v 1 0 0\n"
+                              "v 1 1 0\n"
+                              "v 0 1 0\n"
+                              "vn 0 0 1\n"
+                              "f 1//1 2//1 3//1 4//1\n";
+
+TEST(ObjImport, FanTriangulation)
+{
+    InitArenas();
+    {
+        ObjResult quad;
+        ImportObj(sQuadObj, quad);
+        ASSERT_TRUE(quad.res);
+        ASSERT_EQ(quad.geometryCount, 1u);
+        const u32 quadIndices[] = {0, 1, 2, 0, 2, 3};
+        ExpectIndices(quad.geometries[0], quadIndices, 6);
+        EXPECT_EQ(quad.geometries[0].vertexCount, 4u);
+
+        ObjResult pentagon;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 2 1 0\nv 1 2 0\nv 0 1 0\n"
+                  "f 1 2 3 4 5\n",
+                  pentagon);
+        ASSERT_TRUE(pentagon.res);
+        ASSERT_EQ(pentagon.geometryCount, 1u);
+        const u32 pentagonIndices[] = {0, 1, 2, 0, 2, 3, 0, 3, 4};
+        ExpectIndices(pentagon.geometries[0], pentagonIndices, 9);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ObjImport, AttributeForms)
+{
+    InitArenas();
+    {
+        ObjResult normals;
+        ImportObj(sQuadObj, normals);
+        ASSERT_TRUE(normals.res);
+        const Geometry& n = normals.geometries[0];
+        EXPECT_TRUE(n.vertexMask & FLY_VERTEX_NORMAL_BIT);
+        EXPECT_FALSE(n.vertexMask & FLY_VERTEX_TEXCOORD_BIT);
+        EXPECT_EQ(n.vertices[2].position.x, 1.0f);
+        EXPECT_EQ(n.vertices[2].position.y, 1.0f);
+        EXPECT_EQ(n.vertices[2].normal.z, 1.0f);
+
+        ObjResult texcoords;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\n"
+                  "vt 0.25 0.5\nvt 1 0\nvt 1e0 1.0E+0\n"
+                  "f 1/1 2/2 3/3\n",
+                  texcoords);
+        ASSERT_TRUE(texcoords.res);
+        const Geometry& t = texcoords.geometries[0];
+        EXPECT_TRUE(t.vertexMask & FLY_VERTEX_TEXCOORD_BIT);
+        EXPECT_FALSE(t.vertexMask & FLY_VERTEX_NORMAL_BIT);
+        EXPECT_EQ(t.vertices[0].u, 0.25f);
+        EXPECT_EQ(t.vertices[0].v, 0.5f);
+        EXPECT_EQ(t.vertices[2].u, 1.0f);
+        EXPECT_EQ(t.vertices[2].v, 1.0f);
+
+        // Empty trailing slots leave the attribute out
+        ObjResult empty;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\n"
+                  "f 1// 2// 3//\nf 1/ 2/ 3/\n",
+                  empty);
+        ASSERT_TRUE(empty.res);
+        EXPECT_EQ(empty.geometries[0].vertexCount, 3u);
+        EXPECT_EQ(empty.geometries[0].indexCount, 6u);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ObjImport, Tangents)
+{
+    InitArenas();
+    {
+        // u grows along x and v along y, every vertex gets the same frame
+        ObjResult quad;
+        ImportObj("v 0 0 0\nv 2 0 0\nv 2 2 0\nv 0 2 0\n"
+                  "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0 1\n"
+                  "f 1/1/1 2/2/1 3/3/1 4/4/1\n",
+                  quad);
+        ASSERT_TRUE(quad.res);
+        const Geometry& g = quad.geometries[0];
+        EXPECT_TRUE(g.vertexMask & FLY_VERTEX_TANGENT_BIT);
+        for (u32 i = 0; i < g.vertexCount; i++)
+        {
+            EXPECT_NEAR(g.vertices[i].tangent.x, 1.0f, 1e-4f) << i;
+            EXPECT_NEAR(g.vertices[i].tangent.y, 0.0f, 1e-4f) << i;
+            EXPECT_NEAR(g.vertices[i].tangent.z, 0.0f, 1e-4f) << i;
+            EXPECT_EQ(g.vertices[i].tangent.w, 1.0f) << i;
+        }
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ObjImport, Indices)
+{
+    InitArenas();
+    {
+        ObjResult positive;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\n", positive);
+        ObjResult negative;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nf -3 -2 -1\n", negative);
+        ASSERT_TRUE(positive.res);
+        ASSERT_TRUE(negative.res);
+        ExpectSameGeometries(positive, negative);
+
+        // Negative indices count back from the last element defined so far
+        ObjResult relative;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nf -3 -2 -1\n"
+                  "v 2 0 0\nf -4 -2 -1\n",
+                  relative);
+        ASSERT_TRUE(relative.res);
+        const u32 relativeIndices[] = {0, 1, 2, 0, 2, 3};
+        ExpectIndices(relative.geometries[0], relativeIndices, 6);
+        EXPECT_EQ(relative.geometries[0].vertices[3].position.x, 2.0f);
+
+        const char* invalid[] = {
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n",
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 0 1 2\n",
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nf -4 -2 -1\n",
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1/1 2/1 3/1\n",
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nvn 0 0 1\nf 1//2 2//1 3//1\n",
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3x\n",
+        };
+        for (u32 i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        {
+            ObjResult result;
+            ImportObj(invalid[i], result);
+            EXPECT_FALSE(result.res) << invalid[i];
+            EXPECT_EQ(result.geometryCount, 0u);
+        }
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ObjImport, ObjectsAndMaterials)
+{
+    InitArenas();
+    {
+        ObjResult result;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+                  "o empty\n"
+                  "o first\n"
+                  "usemtl a\n"
+                  "f 1 2 3\n"
+                  "usemtl b\n"
+                  "usemtl a\n"
+                  "f 1 3 4\n"
+                  "usemtl b\n"
+                  "f 2 3 4\n"
+                  "f 1 2 4\n"
+                  "o second\n"
+                  "f 1 2 3\n"
+                  "o trailing\n",
+                  result);
+        ASSERT_TRUE(result.res);
+        // Objects without faces are dropped
+        ASSERT_EQ(result.geometryCount, 2u);
+
+        // Only the last of several usemtl lines between faces counts, so
+        // a, a, b, b give two subgeometries
+        const Geometry& first = result.geometries[0];
+        ASSERT_EQ(first.subgeometryCount, 2u);
+        EXPECT_EQ(first.subgeometries[0].lods[0].firstIndex, 0u);
+        EXPECT_EQ(first.subgeometries[0].lods[0].indexCount, 6u);
+        EXPECT_EQ(first.subgeometries[1].lods[0].firstIndex, 6u);
+        EXPECT_EQ(first.subgeometries[1].lods[0].indexCount, 6u);
+
+        // The second object keeps material b and has its own vertices
+        const Geometry& second = result.geometries[1];
+        EXPECT_EQ(second.subgeometryCount, 1u);
+        EXPECT_EQ(second.vertexCount, 3u);
+        EXPECT_EQ(second.indexCount, 3u);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ObjImport, LineEndings)
+{
+    InitArenas();
+    {
+        ObjResult lf;
+        ImportObj("# comment\nv 0 0 0\nv 1 0 0\nv 1 1 0\n"
+                  "vn 0 0 1\nf 1//1 2//1 3//1\n",
+                  lf);
+        ObjResult crlf;
+        ImportObj("# comment\r\nv 0 0 0\r\nv 1 0 0\r\nv 1 1 0\r\n"
+                  "vn 0 0 1\r\nf 1//1 2//1 3//1\r\n",
+                  crlf);
+        ObjResult noFinalNewline;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nvn 0 0 1\nf 1//1 2//1 3//1",
+                  noFinalNewline);
+        ASSERT_TRUE(lf.res);
+        ASSERT_TRUE(crlf.res);
+        ASSERT_TRUE(noFinalNewline.res);
+        ExpectSameGeometries(lf, crlf);
+        ExpectSameGeometries(lf, noFinalNewline);
+
+        // Continued lines are rejected, a comment may end in a backslash
+        ObjResult continued;
+        ImportObj("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 \\\n3\n", continued);
+        EXPECT_FALSE(continued.res);
+        ObjResult continuedCrlf;
+        ImportObj("v 0 0 0\r\nv 1 0 \\\r\n0\r\nv 1 1 0\r\nf 1 2 3\r\n",
+                  continuedCrlf);
+        EXPECT_FALSE(continuedCrlf.res);
+        ObjResult comment;
+        ImportObj("# path\\\nv 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\n", comment);
+        EXPECT_TRUE(comment.res);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(ObjImport, ChunkSizeIndependence)
+{
+    InitArenas();
+    {
+        // Several objects and materials with negative indices, so that
+        // chunks split objects, usemtl runs and relative references
+        std::string text;
+        for (u32 i = 0; i < 24; i++)
+        {
+            if (i % 5 == 0)
+            {
+                text += "o object" + std::to_string(i) + "\r\n";
+            }
+            if (i % 3 == 0)
+            {
+                text += "usemtl m" + std::to_string(i % 2) + "\n";
+            }
+            for (u32 j = 0; j < 4; j++)
+            {
+                text += "v " + std::to_string(i + j % 2) + " " +
+                        std::to_string(j / 2) + " 0.5\n";
+                text += "vt " + std::to_string(j % 2) + " " +
+                        std::to_string(j / 2) + "\n";
+            }
+            text += "vn 0 0 1\n";
+            text += "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n";
+            if (i > 0)
+            {
+                // Shares vertices with the previous quad
+                text += "f -5/-5/-2 -4/-4/-1 -8/-8/-2\n";
+            }
+        }
+
+        ObjResult reference;
+        ImportObj(text.c_str(), reference);
+        ASSERT_TRUE(reference.res);
+        EXPECT_EQ(reference.geometryCount, 5u);
+
+        const u64 chunkSizes[] = {1, 7, 16, 61, 256};
+        for (u64 chunkSize : chunkSizes)
+        {
+            ObjResult result;
+            ImportObj(text.c_str(), result, chunkSize);
+            ASSERT_TRUE(result.res) << "chunk size " << chunkSize;
+            ExpectSameGeometries(reference, result);
+        }
+    }
+    ReleaseThreadContext();
+}
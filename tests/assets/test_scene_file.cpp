@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "assets/scene/geometry.h"
+#include "assets/scene/scene.h"
+#include "assets/scene/scene_data.h"
+
+#include "core/filesystem.h"
+#include "core/job_system.h"
+#include "core/thread_context.h"
+
+using namespace Fly;
+
+// Two quads without a material library, cooked scenes have no textures,
+// materials or images and every one of their sections is empty
+static const char sObjNoTextures[] = "v 0 0 0\n"
+                                     "v 1 0 0\n"
+                                     "v 1 1 0\n"
+                                     "v 0 1 0\n"
+                                     "v 0 0 1\n"
+                                     "v 1 0 1\n"
+                                     "vt 0 0\n"
+                                     "vt 1 0\n"
+                                     "vt 1 1\n"
+                                     "vt 0 1\n"
+                                     "vn 0 0 1\n"
+                                     "vn 0 1 0\n"
+                                     "o front\n"
+                                     "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+                                     "o bottom\n"
+                                     "f 1/1/2 2/2/2 6/3/2 5/4/2\n";
+
+static std::string TempPath(const char* name)
+{
+    return testing::TempDir() + name;
+}
+
+TEST(SceneFile, RoundTripWithoutTextures)
+{
+    InitArenas();
+    InitJobSystem();
+
+    std::string objPath = TempPath("fly_no_textures.obj");
+    ASSERT_TRUE(WriteStringToFile(
+        String8(sObjNoTextures, sizeof(sObjNoTextures) - 1),
+        String8(objPath.c_str(), objPath.size())));
+
+    SceneExportOptions options;
+    SceneData sceneData;
+    ASSERT_TRUE(CookSceneData(String8(objPath.c_str(), objPath.size()),
+                              options, sceneData));
+    EXPECT_EQ(sceneData.geometryCount, 2u);
+    EXPECT_EQ(sceneData.imageCount, 0u);
+    EXPECT_EQ(sceneData.materialCount, 0u);
+
+    for (u32 compress = 0; compress < 2; compress++)
+    {
+        std::string scenePath = TempPath("fly_no_textures.fscene");
+        String8 path(scenePath.c_str(), scenePath.size());
+        ASSERT_TRUE(ExportSceneData(path, sceneData, compress))
+            << "compress " << compress;
+        EXPECT_TRUE(ValidateSceneFile(path)) << "compress " << compress;
+        EXPECT_TRUE(RemoveFile(path));
+    }
+
+    DestroySceneData(sceneData);
+    EXPECT_TRUE(RemoveFile(String8(objPath.c_str(), objPath.size())));
+
+    ShutdownJobSystem();
+    ReleaseThreadContext();
+}
+
+TEST(SceneFile, RejectsCorruptedSection)
+{
+    InitArenas();
+    InitJobSystem();
+
+    std::string objPath = TempPath("fly_corrupted.obj");
+    String8 objPath8(objPath.c_str(), objPath.size());
+    ASSERT_TRUE(WriteStringToFile(
+        String8(sObjNoTextures, sizeof(sObjNoTextures) - 1), objPath8));
+
+    SceneExportOptions options;
+    SceneData sceneData;
+    ASSERT_TRUE(CookSceneData(objPath8, options, sceneData));
+
+    std::string scenePath = TempPath("fly_corrupted.fscene");
+    String8 path(scenePath.c_str(), scenePath.size());
+    ASSERT_TRUE(ExportSceneData(path, sceneData, false));
+    ASSERT_TRUE(ValidateSceneFile(path));
+
+    // Flips one byte of the mesh headers
+    MappedFile file;
+    ASSERT_TRUE(MapFile(path, file));
+    const SceneFileHeader& header =
+        *reinterpret_cast<const SceneFileHeader*>(file.data);
+    const SceneFileSection* sections =
+        reinterpret_cast<const SceneFileSection*>(file.data +
+                                                  header.sectionTableOffset);
+    u64 offset = 0;
+    for (u32 i = 0; i < header.sectionCount; i++)
+    {
+        if (sections[i].type == SceneSectionType::MeshHeaders)
+        {
+            offset = sections[i].offset;
+        }
+    }
+    ASSERT_NE(offset, 0u);
+    std::string bytes(reinterpret_cast<const char*>(file.data), file.size);
+    UnmapFile(file);
+
+    bytes[offset] ^= 1;
+    ASSERT_TRUE(
+        WriteStringToFile(String8(bytes.data(), bytes.size()), path));
+    EXPECT_FALSE(ValidateSceneFile(path));
+
+    EXPECT_TRUE(RemoveFile(path));
+    DestroySceneData(sceneData);
+    EXPECT_TRUE(RemoveFile(objPath8));
+
+    ShutdownJobSystem();
+    ReleaseThreadContext();
+}
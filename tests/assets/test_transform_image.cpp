@@ -0,0 +1,444 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assets/image/import_image.h"
+#include "assets/image/transform_image.h"
+
+#include "core/memory.h"
+#include "core/thread_context.h"
+
+#include "math/vec.h"
+
+using namespace Fly;
+
+// Smooth single channel pattern, different in every layer
+static Image MakeImage(u32 width, u32 height, u8 layerCount)
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.channelCount = 1;
+    image.layerCount = layerCount;
+    image.mipCount = 1;
+    image.storageType = ImageStorageType::Byte;
+    image.data = static_cast<u8*>(Alloc(GetImageSize(image)));
+
+    for (u32 layer = 0; layer < layerCount; layer++)
+    {
+        u8* texels = image.data + static_cast<u64>(width) * height * layer;
+        for (u32 y = 0; y < height; y++)
+        {
+            for (u32 x = 0; x < width; x++)
+            {
+                f32 v = 128.0f + 50.0f * sinf(x * 0.07f + layer) *
+                                     cosf(y * 0.05f);
+                texels[y * width + x] = static_cast<u8>(v);
+            }
+        }
+    }
+    return image;
+}
+
+static void DecodeBC4(const u8* block, u8 texels[16])
+{
+    u32 palette[8];
+    palette[0] = block[0];
+    palette[1] = block[1];
+    if (palette[0] > palette[1])
+    {
+        for (u32 i = 1; i < 7; i++)
+        {
+            palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7;
+        }
+    }
+    else
+    {
+        for (u32 i = 1; i < 5; i++)
+        {
+            palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    u64 bits = 0;
+    for (u32 i = 0; i < 6; i++)
+    {
+        bits |= static_cast<u64>(block[2 + i]) << (8 * i);
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+        texels[i] = static_cast<u8>(palette[(bits >> (3 * i)) & 7]);
+    }
+}
+
+// Largest difference of the decoded texels of two BC4 images with the same
+// size, mips and layers
+static i32 MaxBC4Difference(const Image& a, const Image& b)
+{
+    EXPECT_EQ(GetImageSize(a), GetImageSize(b));
+    u64 blockCount = GetImageSize(a) / 8;
+    i32 maxDiff = 0;
+    for (u64 i = 0; i < blockCount; i++)
+    {
+        u8 texelsA[16];
+        u8 texelsB[16];
+        DecodeBC4(a.data + i * 8, texelsA);
+        DecodeBC4(b.data + i * 8, texelsB);
+        for (u32 j = 0; j < 16; j++)
+        {
+            i32 diff = abs(static_cast<i32>(texelsA[j]) - texelsB[j]);
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+    }
+    return maxDiff;
+}
+
+static void ExpectSameLayout(const Image& a, const Image& b)
+{
+    EXPECT_EQ(a.width, b.width);
+    EXPECT_EQ(a.height, b.height);
+    EXPECT_EQ(a.channelCount, b.channelCount);
+    EXPECT_EQ(a.layerCount, b.layerCount);
+    EXPECT_EQ(a.mipCount, b.mipCount);
+    EXPECT_EQ(a.storageType, b.storageType);
+}
+
+// A budget of one byte streams bands of four rows
+static ImageStreamSettings TinyBudgetSettings()
+{
+    ImageStreamSettings settings;
+    settings.generateMips = true;
+    settings.codec = ImageStorageType::BC4;
+    settings.memoryBudget = 1;
+    return settings;
+}
+
+TEST(StreamTransformImage, MatchesGenerateMips)
+{
+    InitArenas();
+    Image streamed = MakeImage(40, 36, 2);
+    Image reference;
+    CopyImage(streamed, reference);
+
+    ASSERT_TRUE(StreamTransformImage(TinyBudgetSettings(), streamed));
+    ASSERT_TRUE(GenerateMips(reference));
+    ASSERT_TRUE(CompressImage(ImageStorageType::BC4, reference));
+
+    ExpectSameLayout(streamed, reference);
+    EXPECT_EQ(streamed.mipCount, 6);
+    EXPECT_LE(MaxBC4Difference(streamed, reference), 2);
+
+    DestroyImage(streamed);
+    DestroyImage(reference);
+    ReleaseThreadContext();
+}
+
+TEST(StreamTransformImage, MatchesGenerateMipsFromBaseLevel)
+{
+    InitArenas();
+    Image streamed = MakeImage(33, 20, 1);
+    Image reference;
+    CopyImage(streamed, reference);
+
+    ImageStreamSettings settings = TinyBudgetSettings();
+    settings.fromBaseLevel = true;
+    ASSERT_TRUE(StreamTransformImage(settings, streamed));
+    ASSERT_TRUE(GenerateMips(reference, false, true));
+    ASSERT_TRUE(CompressImage(ImageStorageType::BC4, reference));
+
+    ExpectSameLayout(streamed, reference);
+    EXPECT_LE(MaxBC4Difference(streamed, reference), 2);
+
+    DestroyImage(streamed);
+    DestroyImage(reference);
+    ReleaseThreadContext();
+}
+
+TEST(StreamTransformImage, MatchesResize)
+{
+    InitArenas();
+    Image streamed = MakeImage(48, 40, 1);
+    Image reference;
+    CopyImage(streamed, reference);
+
+    ImageStreamSettings settings = TinyBudgetSettings();
+    settings.width = 32;
+    settings.height = 24;
+    ASSERT_TRUE(StreamTransformImage(settings, streamed));
+    ASSERT_TRUE(ResizeImageSRGB(32, 24, reference));
+    ASSERT_TRUE(GenerateMips(reference));
+    ASSERT_TRUE(CompressImage(ImageStorageType::BC4, reference));
+
+    ExpectSameLayout(streamed, reference);
+    Image level0 = streamed;
+    Image referenceLevel0 = reference;
+    level0.mipCount = 1;
+    referenceLevel0.mipCount = 1;
+    EXPECT_LE(MaxBC4Difference(level0, referenceLevel0), 2);
+    // Level 1 is resampled from the source instead of the resized level 0
+    EXPECT_LE(MaxBC4Difference(streamed, reference), 12);
+
+    DestroyImage(streamed);
+    DestroyImage(reference);
+    ReleaseThreadContext();
+}
+
+TEST(StreamTransformImage, BudgetDoesNotChangeOutput)
+{
+    InitArenas();
+    Image small = MakeImage(37, 29, 2);
+    Image large;
+    CopyImage(small, large);
+
+    ImageStreamSettings settings = TinyBudgetSettings();
+    ASSERT_TRUE(StreamTransformImage(settings, small));
+    settings.memoryBudget = 64 * 1024 * 1024;
+    ASSERT_TRUE(StreamTransformImage(settings, large));
+
+    ExpectSameLayout(small, large);
+    EXPECT_LE(MaxBC4Difference(small, large), 2);
+
+    DestroyImage(small);
+    DestroyImage(large);
+    ReleaseThreadContext();
+}
+
+TEST(StreamTransformImage, RollingWindowsMatchWholeLevels)
+{
+    InitArenas();
+    // Tall enough that every window drops rows many times per layer
+    Image small = MakeImage(12, 300, 1);
+    Image large;
+    CopyImage(small, large);
+
+    ImageStreamSettings settings = TinyBudgetSettings();
+    ASSERT_TRUE(StreamTransformImage(settings, small));
+    settings.memoryBudget = 64 * 1024 * 1024;
+    ASSERT_TRUE(StreamTransformImage(settings, large));
+
+    ExpectSameLayout(small, large);
+    EXPECT_EQ(small.mipCount, 9);
+    EXPECT_EQ(memcmp(small.data, large.data, GetImageSize(small)), 0);
+
+    DestroyImage(small);
+    DestroyImage(large);
+    ReleaseThreadContext();
+}
+
+// Face center and the directions in which columns and rows grow, taken from
+// eq2cube.frag where row 0 is at coord.y = 1
+struct CubeFace
+{
+    Math::Vec3 center;
+    Math::Vec3 right;
+    Math::Vec3 down;
+};
+
+static const CubeFace sCubeFaces[6] = {
+    {Math::Vec3(1.0f, 0.0f, 0.0f), Math::Vec3(0.0f, 0.0f, -1.0f),
+     Math::Vec3(0.0f, 1.0f, 0.0f)},
+    {Math::Vec3(-1.0f, 0.0f, 0.0f), Math::Vec3(0.0f, 0.0f, 1.0f),
+     Math::Vec3(0.0f, 1.0f, 0.0f)},
+    {Math::Vec3(0.0f, -1.0f, 0.0f), Math::Vec3(1.0f, 0.0f, 0.0f),
+     Math::Vec3(0.0f, 0.0f, 1.0f)},
+    {Math::Vec3(0.0f, 1.0f, 0.0f), Math::Vec3(1.0f, 0.0f, 0.0f),
+     Math::Vec3(0.0f, 0.0f, -1.0f)},
+    {Math::Vec3(0.0f, 0.0f, 1.0f), Math::Vec3(1.0f, 0.0f, 0.0f),
+     Math::Vec3(0.0f, 1.0f, 0.0f)},
+    {Math::Vec3(0.0f, 0.0f, -1.0f), Math::Vec3(-1.0f, 0.0f, 0.0f),
+     Math::Vec3(0.0f, 1.0f, 0.0f)},
+};
+
+// Direction through texel coordinates (s, t) of a face, in texels
+static Math::Vec3 CubeTexelDirection(u32 face, f32 s, f32 t, u32 side)
+{
+    const CubeFace& f = sCubeFaces[face];
+    f32 x = 2.0f * s / side - 1.0f;
+    f32 y = 2.0f * t / side - 1.0f;
+    return Math::Normalize(f.center + x * f.right + y * f.down);
+}
+
+// Face, column and row of the texel a direction points at
+static void FindCubeTexel(Math::Vec3 dir, u32 side, u32& face, u32& col,
+                          u32& row)
+{
+    face = 0;
+    f32 best = -2.0f;
+    for (u32 i = 0; i < 6; i++)
+    {
+        f32 d = Math::Dot(dir, sCubeFaces[i].center);
+        if (d > best)
+        {
+            best = d;
+            face = i;
+        }
+    }
+    Math::Vec3 p = dir / best;
+    f32 x = Math::Dot(p, sCubeFaces[face].right);
+    f32 y = Math::Dot(p, sCubeFaces[face].down);
+    col = static_cast<u32>(Math::Clamp((x + 1.0f) * 0.5f * side, 0.0f,
+                                       side - 1.0f));
+    row = static_cast<u32>(Math::Clamp((y + 1.0f) * 0.5f * side, 0.0f,
+                                       side - 1.0f));
+}
+
+// Float panorama whose texels hold the unit direction they are seen from,
+// with the longitude and latitude mapping of eq2cube.frag
+static Image MakeDirectionPanorama(u32 width, u32 height)
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.channelCount = 3;
+    image.layerCount = 1;
+    image.mipCount = 1;
+    image.storageType = ImageStorageType::Float;
+    image.data = static_cast<u8*>(Alloc(GetImageSize(image)));
+
+    f32* texels = reinterpret_cast<f32*>(image.data);
+    for (u32 y = 0; y < height; y++)
+    {
+        f32 latitude = (y + 0.5f) / height * FLY_MATH_PI - FLY_MATH_HALF_PI;
+        for (u32 x = 0; x < width; x++)
+        {
+            f32 longitude = (x + 0.5f) / width * FLY_MATH_TWO_PI - FLY_MATH_PI;
+            f32* texel = texels + 3 * (y * width + x);
+            texel[0] = cosf(latitude) * cosf(longitude);
+            texel[1] = sinf(latitude);
+            texel[2] = cosf(latitude) * sinf(longitude);
+        }
+    }
+    return image;
+}
+
+static Math::Vec3 LoadCubeTexel(const Image& cube, u32 face, u32 col,
+                                u32 row)
+{
+    const f32* texel = reinterpret_cast<const f32*>(cube.data) +
+                       4 * ((static_cast<u64>(face) * cube.height + row) *
+                                cube.width +
+                            col);
+    return Math::Vec3(texel[0], texel[1], texel[2]);
+}
+
+static f32 AngleDegrees(Math::Vec3 a, Math::Vec3 b)
+{
+    f32 d = Math::Dot(Math::Normalize(a), Math::Normalize(b));
+    return acosf(Math::Clamp(d, -1.0f, 1.0f)) * 180.0f / FLY_MATH_PI;
+}
+
+static const Eq2CubeFilter sEq2CubeFilters[] = {
+    Eq2CubeFilter::Nearest, Eq2CubeFilter::Bilinear, Eq2CubeFilter::Bicubic};
+
+TEST(Eq2Cube, FaceOrientation)
+{
+    InitArenas();
+    for (Eq2CubeFilter filter : sEq2CubeFilters)
+    {
+        Image image = MakeDirectionPanorama(128, 64);
+        ASSERT_TRUE(Eq2Cube(image, filter));
+        ASSERT_EQ(image.width, 32u);
+        ASSERT_EQ(image.height, 32u);
+        ASSERT_EQ(image.layerCount, 6u);
+        ASSERT_EQ(image.channelCount, 4u);
+        ASSERT_EQ(image.storageType, ImageStorageType::Float);
+
+        // Every texel sees the direction it is looked up from, a panorama
+        // texel is 2.8 degrees wide and only nearest may be off by most of it
+        f32 maxAngle = 0.0f;
+        const f32* texels = reinterpret_cast<const f32*>(image.data);
+        for (u32 face = 0; face < 6; face++)
+        {
+            for (u32 row = 0; row < image.height; row++)
+            {
+                for (u32 col = 0; col < image.width; col++)
+                {
+                    Math::Vec3 expected = CubeTexelDirection(
+                        face, col + 0.5f, row + 0.5f, image.width);
+                    Math::Vec3 texel = LoadCubeTexel(image, face, col, row);
+                    maxAngle = Math::Max(maxAngle,
+                                         AngleDegrees(texel, expected));
+                }
+            }
+        }
+        f32 bound = filter == Eq2CubeFilter::Nearest ? 2.5f : 0.5f;
+        EXPECT_LT(maxAngle, bound) << "filter " << static_cast<u32>(filter);
+        EXPECT_EQ(texels[3], 1.0f);
+
+        DestroyImage(image);
+    }
+    ReleaseThreadContext();
+}
+
+TEST(Eq2Cube, SeamContinuity)
+{
+    InitArenas();
+    for (Eq2CubeFilter filter : sEq2CubeFilters)
+    {
+        Image image = MakeDirectionPanorama(128, 64);
+        ASSERT_TRUE(Eq2Cube(image, filter));
+        const u32 side = image.width;
+
+        // Texels next to each other across a face edge are as close as
+        // texels next to each other inside a face. The panorama wraps in
+        // the middle of face 1 and its poles are the centers of faces 2
+        // and 3, which the inner neighbours cover.
+        f32 maxInner = 0.0f;
+        f32 maxSeam = 0.0f;
+        for (u32 face = 0; face < 6; face++)
+        {
+            for (u32 row = 0; row < side; row++)
+            {
+                for (u32 col = 0; col < side; col++)
+                {
+                    Math::Vec3 texel = LoadCubeTexel(image, face, col, row);
+                    if (col + 1 < side)
+                    {
+                        maxInner = Math::Max(
+                            maxInner,
+                            AngleDegrees(texel, LoadCubeTexel(image, face,
+                                                              col + 1, row)));
+                    }
+                    if (row + 1 < side)
+                    {
+                        maxInner = Math::Max(
+                            maxInner,
+                            AngleDegrees(texel, LoadCubeTexel(image, face,
+                                                              col, row + 1)));
+                    }
+                    if (col != 0 && col != side - 1 && row != 0 &&
+                        row != side - 1)
+                    {
+                        continue;
+                    }
+
+                    // One texel past every edge the texel lies on
+                    f32 s = col + 0.5f;
+                    f32 t = row + 0.5f;
+                    s += col == 0 ? -1.0f : (col == side - 1 ? 1.0f : 0.0f);
+                    t += row == 0 ? -1.0f : (row == side - 1 ? 1.0f : 0.0f);
+                    u32 otherFace = 0;
+                    u32 otherCol = 0;
+                    u32 otherRow = 0;
+                    FindCubeTexel(CubeTexelDirection(face, s, t, side), side,
+                                  otherFace, otherCol, otherRow);
+                    EXPECT_NE(otherFace, face);
+                    maxSeam = Math::Max(
+                        maxSeam, AngleDegrees(texel,
+                                              LoadCubeTexel(image, otherFace,
+                                                            otherCol,
+                                                            otherRow)));
+                }
+            }
+        }
+
+        EXPECT_LT(maxSeam, maxInner)
+            << "filter " << static_cast<u32>(filter);
+
+        DestroyImage(image);
+    }
+    ReleaseThreadContext();
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include "src/core/cpu_features.h"
+
+using namespace Fly;
+
+static int KernelA() { return 1; }
+static int KernelB() { return 2; }
+
+TEST(CpuFeatures, Query)
+{
+    EXPECT_TRUE(HasCpuFeatures(FLY_CPU_FEATURE_NONE_BIT));
+    EXPECT_EQ(GetCpuFeatures(), GetCpuFeatures());
+
+    u32 features = GetCpuFeatures();
+    EXPECT_EQ(HasCpuFeatures(features), true);
+    // Avx2 implies avx
+    if (features & FLY_CPU_FEATURE_AVX2_BIT)
+    {
+        EXPECT_TRUE(features & FLY_CPU_FEATURE_AVX_BIT);
+    }
+
+    EXPECT_EQ(strcmp(GetCpuFeatureName(FLY_CPU_FEATURE_AVX2_BIT), "avx2"), 0);
+    EXPECT_EQ(strcmp(GetCpuFeatureName(FLY_CPU_FEATURE_SVE_BIT), "sve"), 0);
+}
+
+TEST(CpuFeatures, SelectKernel)
+{
+    typedef int (*KernelFunc)();
+
+    // An impossible combination always falls back to the portable kernel
+    const CpuKernel<KernelFunc> unsupported[] = {
+        {FLY_CPU_FEATURE_AVX512F_BIT | FLY_CPU_FEATURE_NEON_BIT, KernelA},
+        {FLY_CPU_FEATURE_NONE_BIT, KernelB},
+    };
+    EXPECT_EQ(SelectCpuKernel(unsupported)(), 2);
+
+    const CpuKernel<KernelFunc> supported[] = {
+        {FLY_CPU_FEATURE_NONE_BIT, KernelA},
+        {FLY_CPU_FEATURE_NONE_BIT, KernelB},
+    };
+    EXPECT_EQ(SelectCpuKernel(supported)(), 1);
+}
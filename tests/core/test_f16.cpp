@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include "src/core/half.h"
+
+TEST(F16, BulkMatchesScalar)
+{
+    // Odd count to exercise the tail
+    const u32 count = 1003;
+    f32 src[count];
+    for (u32 i = 0; i < count; i++)
+    {
+        // Normal half range, both signs
+        f32 t = static_cast<f32>(i) / count;
+        src[i] = (i & 1 ? -1.0f : 1.0f) * (0.001f + t * t * 60000.0f);
+    }
+
+    f16 bulk[count];
+    ConvertF32ToF16(bulk, src, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 expected = f16::DequantizeHalf(f16(src[i]));
+        f32 actual = f16::DequantizeHalf(bulk[i]);
+        // Rounding mode may differ by one ulp on ties
+        EXPECT_NEAR(actual, expected, fabsf(expected) * 1e-3f);
+    }
+
+    f32 back[count];
+    ConvertF16ToF32(back, bulk, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        EXPECT_EQ(back[i], f16::DequantizeHalf(bulk[i]));
+    }
+}
+
+TEST(F16, BulkSpecialValues)
+{
+    f32 src[] = {0.0f, -0.0f, 1.0f, -2.5f, 65504.0f, 1e6f, -1e6f};
+    const u32 count = STACK_ARRAY_COUNT(src);
+    f16 dst[count];
+    ConvertF32ToF16(dst, src, count);
+
+    EXPECT_EQ(dst[0].data, 0x0000);
+    EXPECT_EQ(dst[1].data, 0x8000);
+    EXPECT_EQ(dst[2].data, 0x3c00);
+    EXPECT_EQ(dst[3].data, 0xc100);
+    EXPECT_EQ(dst[4].data, 0x7bff);
+    EXPECT_EQ(dst[5].data, 0x7c00);
+    EXPECT_EQ(dst[6].data, 0xfc00);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "src/core/job_system.h"
+#include "src/core/thread_context.h"
+
+using namespace Fly;
+
+static void Square(u32 index, void* userData)
+{
+    u64* values = static_cast<u64*>(userData);
+    values[index] = static_cast<u64>(index) * index;
+}
+
+struct NestedData
+{
+    std::atomic<u32> total{0};
+};
+
+static void CountInner(u32 index, void* userData)
+{
+    static_cast<NestedData*>(userData)->total.fetch_add(1);
+}
+
+static void CountOuter(u32 index, void* userData)
+{
+    // Scratch arenas are available on the worker threads
+    Arena& arena = GetScratchArena();
+    ArenaMarker marker = ArenaGetMarker(arena);
+    u32* scratch = FLY_PUSH_ARENA(arena, u32, 64);
+    scratch[63] = index;
+    ArenaPopToMarker(arena, marker);
+
+    ParallelFor(100, CountInner, userData);
+}
+
+static void RunParallelFor()
+{
+    const u32 count = 10000;
+    u64* values = new u64[count];
+    ParallelFor(count, Square, values);
+    for (u32 i = 0; i < count; i++)
+    {
+        EXPECT_EQ(values[i], static_cast<u64>(i) * i);
+    }
+    delete[] values;
+
+    NestedData nested;
+    ParallelFor(37, CountOuter, &nested);
+    EXPECT_EQ(nested.total.load(), 3700u);
+}
+
+TEST(JobSystem, Serial)
+{
+    InitArenas();
+    RunParallelFor();
+    ReleaseThreadContext();
+}
+
+TEST(JobSystem, ParallelFor)
+{
+    InitArenas();
+    InitJobSystem(4);
+    EXPECT_EQ(GetJobWorkerCount(), 4u);
+    for (u32 i = 0; i < 20; i++)
+    {
+        RunParallelFor();
+    }
+    ShutdownJobSystem();
+    EXPECT_EQ(GetJobWorkerCount(), 0u);
+    ReleaseThreadContext();
+}
@@ -22,7 +22,8 @@ TEST(String8, Trim)
     String8 aTrimmedLeft = String8::TrimLeft(a);
 
     String8 b = FLY_STRING8_LITERAL("a and b  ");
-    EXPECT_EQ(a, b);
+    EXPECT_EQ(aTrimmedLeft, b);
+    EXPECT_NE(a, b);
 
     String8 aTrimmed = String8::TrimRight(aTrimmedLeft);
     String8 c = FLY_STRING8_LITERAL("a and b");
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include "core/types.h"
+#include "math/frustum.h"
+#include "math/functions.h"
+
+using namespace Fly::Math;
+
+static Frustum TestFrustum()
+{
+    // Camera at origin looking down -z, 90 degrees horizontal fov
+    Mat4 projection = Perspective(90.0f, 1.0f, 0.1f, 100.0f);
+    Mat4 view = LookAt(Vec3(0.0f), Vec3(0.0f, 0.0f, -1.0f),
+                       Vec3(0.0f, 1.0f, 0.0f));
+    return ExtractFrustum(projection * view);
+}
+
+TEST(Frustum, ExtractPlanes)
+{
+    Frustum frustum = TestFrustum();
+
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        EXPECT_NEAR(Length(frustum.planes[i].normal), 1.0f, 1e-5f);
+    }
+
+    EXPECT_NEAR(SignedDistance(frustum.planes[FRUSTUM_PLANE_NEAR],
+                               Vec3(0.0f, 0.0f, -0.1f)),
+                0.0f, 1e-4f);
+    EXPECT_NEAR(SignedDistance(frustum.planes[FRUSTUM_PLANE_FAR],
+                               Vec3(0.0f, 0.0f, -100.0f)),
+                0.0f, 1e-2f);
+    EXPECT_GT(SignedDistance(frustum.planes[FRUSTUM_PLANE_NEAR],
+                             Vec3(0.0f, 0.0f, -1.0f)),
+              0.0f);
+    EXPECT_GT(SignedDistance(frustum.planes[FRUSTUM_PLANE_FAR],
+                             Vec3(0.0f, 0.0f, -1.0f)),
+              0.0f);
+
+    // Side planes pass through the camera position
+    for (u32 i = FRUSTUM_PLANE_LEFT; i <= FRUSTUM_PLANE_TOP; i++)
+    {
+        EXPECT_NEAR(frustum.planes[i].distance, 0.0f, 1e-5f);
+    }
+}
+
+TEST(Frustum, Sphere)
+{
+    Frustum frustum = TestFrustum();
+
+    EXPECT_TRUE(IsVisible(frustum, Sphere(Vec3(0.0f, 0.0f, -10.0f), 1.0f)));
+    EXPECT_FALSE(IsVisible(frustum, Sphere(Vec3(0.0f, 0.0f, 10.0f), 1.0f)));
+    EXPECT_FALSE(IsVisible(frustum, Sphere(Vec3(0.0f, 0.0f, -200.0f), 1.0f)));
+    EXPECT_FALSE(IsVisible(frustum, Sphere(Vec3(-20.0f, 0.0f, -5.0f), 1.0f)));
+    EXPECT_FALSE(IsVisible(frustum, Sphere(Vec3(0.0f, 20.0f, -5.0f), 1.0f)));
+
+    // Intersecting the right plane
+    EXPECT_TRUE(IsVisible(frustum, Sphere(Vec3(5.5f, 0.0f, -5.0f), 1.0f)));
+}
+
+TEST(Frustum, AABB)
+{
+    Frustum frustum = TestFrustum();
+
+    EXPECT_TRUE(IsVisible(
+        frustum, AABB(Vec3(-1.0f, -1.0f, -11.0f), Vec3(1.0f, 1.0f, -9.0f))));
+    EXPECT_FALSE(IsVisible(
+        frustum, AABB(Vec3(-1.0f, -1.0f, 9.0f), Vec3(1.0f, 1.0f, 11.0f))));
+    EXPECT_FALSE(IsVisible(frustum, AABB(Vec3(-30.0f, -1.0f, -6.0f),
+                                         Vec3(-20.0f, 1.0f, -4.0f))));
+    EXPECT_TRUE(IsVisible(frustum, AABB(Vec3(4.0f, -1.0f, -6.0f),
+                                        Vec3(8.0f, 1.0f, -4.0f))));
+}
+
+TEST(Frustum, TransformSphere)
+{
+    Mat4 transform = TranslationMatrix(1.0f, 2.0f, 3.0f) *
+                     ScaleMatrix(1.0f, 4.0f, 2.0f);
+    Sphere sphere = TransformSphere(Sphere(Vec3(1.0f, 0.0f, 0.0f), 0.5f),
+                                    transform);
+    EXPECT_NEAR(sphere.center.x, 2.0f, 1e-5f);
+    EXPECT_NEAR(sphere.center.y, 2.0f, 1e-5f);
+    EXPECT_NEAR(sphere.center.z, 3.0f, 1e-5f);
+    EXPECT_NEAR(sphere.radius, 2.0f, 1e-5f);
+}
+
+TEST(Frustum, BatchMatchesScalar)
+{
+    Frustum frustum = TestFrustum();
+
+    const u32 count = 103;
+    f32 cx[count], cy[count], cz[count], r[count];
+    f32 maxX[count], maxY[count], maxZ[count];
+    u8 visible[count];
+
+    SetRandomSeed(7);
+    for (u32 i = 0; i < count; i++)
+    {
+        cx[i] = RandomF32(-50.0f, 50.0f);
+        cy[i] = RandomF32(-50.0f, 50.0f);
+        cz[i] = RandomF32(-150.0f, 50.0f);
+        r[i] = RandomF32(0.0f, 10.0f);
+        maxX[i] = cx[i] + r[i];
+        maxY[i] = cy[i] + r[i];
+        maxZ[i] = cz[i] + r[i];
+    }
+
+    u32 expectedCount = 0;
+    u32 visibleCount = CullSpheres(frustum, cx, cy, cz, r, count, visible);
+    for (u32 i = 0; i < count; i++)
+    {
+        bool expected =
+            IsVisible(frustum, Sphere(Vec3(cx[i], cy[i], cz[i]), r[i]));
+        expectedCount += expected;
+        EXPECT_EQ(visible[i], expected ? 1 : 0);
+    }
+    EXPECT_EQ(visibleCount, expectedCount);
+    EXPECT_GT(visibleCount, 0u);
+    EXPECT_LT(visibleCount, count);
+
+    expectedCount = 0;
+    visibleCount =
+        CullAABBs(frustum, cx, cy, cz, maxX, maxY, maxZ, count, visible);
+    for (u32 i = 0; i < count; i++)
+    {
+        bool expected =
+            IsVisible(frustum, AABB(Vec3(cx[i], cy[i], cz[i]),
+                                    Vec3(maxX[i], maxY[i], maxZ[i])));
+        expectedCount += expected;
+        EXPECT_EQ(visible[i], expected ? 1 : 0);
+    }
+    EXPECT_EQ(visibleCount, expectedCount);
+}
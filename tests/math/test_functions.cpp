@@ -40,3 +40,103 @@ TEST(Basic, InvSqrt)
         EXPECT_NEAR(1.0f / sqrtf(value), Fly::Math::InvSqrt(value), 1e-4);
     }
 }
+
+TEST(Approximation, SinCos)
+{
+    const u32 count = 4099;
+    f32 values[count];
+    f32 sin[count];
+    f32 cos[count];
+    for (u32 i = 0; i < count; i++)
+    {
+        values[i] = -8192.0f + 16384.0f * i / count;
+    }
+
+    Fly::Math::FastSinCos(values, sin, cos, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 s, c;
+        Fly::Math::FastSinCos(values[i], s, c);
+        EXPECT_NEAR(sinf(values[i]), s, 1e-6);
+        EXPECT_NEAR(cosf(values[i]), c, 1e-6);
+        EXPECT_NEAR(sinf(values[i]), sin[i], 1e-6);
+        EXPECT_NEAR(cosf(values[i]), cos[i], 1e-6);
+        EXPECT_FLOAT_EQ(Fly::Math::FastSin(values[i]), s);
+        EXPECT_FLOAT_EQ(Fly::Math::FastCos(values[i]), c);
+    }
+}
+
+TEST(Approximation, Exp)
+{
+    const u32 count = 2051;
+    f32 values[count];
+    f32 exp[count];
+    f32 exp2[count];
+    for (u32 i = 0; i < count; i++)
+    {
+        values[i] = -80.0f + 160.0f * i / count;
+    }
+
+    Fly::Math::FastExp(values, exp, count);
+    Fly::Math::FastExp2(values, exp2, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 expected = expf(values[i]);
+        EXPECT_NEAR(expected, Fly::Math::FastExp(values[i]), expected * 1e-6);
+        EXPECT_NEAR(expected, exp[i], expected * 1e-6);
+
+        expected = exp2f(values[i]);
+        EXPECT_NEAR(expected, Fly::Math::FastExp2(values[i]), expected * 1e-6);
+        EXPECT_NEAR(expected, exp2[i], expected * 1e-6);
+    }
+
+    EXPECT_EQ(Fly::Math::FastExp(100.0f), InfinityF32());
+    EXPECT_EQ(Fly::Math::FastExp(-200.0f), 0.0f);
+    EXPECT_EQ(Fly::Math::FastExp2(128.0f), InfinityF32());
+    EXPECT_EQ(Fly::Math::FastExp2(-200.0f), 0.0f);
+}
+
+TEST(Approximation, Log2)
+{
+    const u32 count = 2053;
+    f32 values[count];
+    f32 log2[count];
+    for (u32 i = 0; i < count; i++)
+    {
+        values[i] = ldexpf(1.0f + static_cast<f32>(i) / count,
+                           static_cast<i32>(i % 200) - 100);
+    }
+
+    Fly::Math::FastLog2(values, log2, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 expected = log2f(values[i]);
+        f32 tolerance = Fly::Math::Max(fabsf(expected), 1.0f) * 2e-7f;
+        EXPECT_NEAR(expected, Fly::Math::FastLog2(values[i]), tolerance);
+        EXPECT_NEAR(expected, log2[i], tolerance);
+    }
+
+    EXPECT_EQ(Fly::Math::FastLog2(0.0f), MinusInfinityF32());
+    EXPECT_EQ(Fly::Math::FastLog2(InfinityF32()), InfinityF32());
+    EXPECT_TRUE(isnan(Fly::Math::FastLog2(-1.0f)));
+}
+
+TEST(Approximation, Pow)
+{
+    const u32 count = 1031;
+    f32 values[count];
+    f32 pow[count];
+    for (u32 i = 0; i < count; i++)
+    {
+        values[i] = 1e-3f + 100.0f * i / count;
+    }
+
+    Fly::Math::FastPow(values, 2.2f, pow, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 expected = powf(values[i], 2.2f);
+        EXPECT_NEAR(expected, Fly::Math::FastPow(values[i], 2.2f),
+                    expected * 2e-6);
+        EXPECT_NEAR(expected, pow[i], expected * 2e-6);
+    }
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include "core/types.h"
+#include "math/functions.h"
+#include "math/random.h"
+
+using namespace Fly::Math;
+
+TEST(Random, PhiloxKnownAnswers)
+{
+    // Random123 known answer vectors for philox4x32_10
+    {
+        u32 counter[4] = {0, 0, 0, 0};
+        u32 key[2] = {0, 0};
+        u32 out[4];
+        Philox4x32(counter, key, out);
+        EXPECT_EQ(out[0], 0x6627e8d5u);
+        EXPECT_EQ(out[1], 0xe169c58du);
+        EXPECT_EQ(out[2], 0xbc57ac4cu);
+        EXPECT_EQ(out[3], 0x9b00dbd8u);
+    }
+    {
+        u32 counter[4] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu};
+        u32 key[2] = {0xffffffffu, 0xffffffffu};
+        u32 out[4];
+        Philox4x32(counter, key, out);
+        EXPECT_EQ(out[0], 0x408f276du);
+        EXPECT_EQ(out[1], 0x41c83b0eu);
+        EXPECT_EQ(out[2], 0xa20bc7c6u);
+        EXPECT_EQ(out[3], 0x6d5451fdu);
+    }
+    {
+        u32 counter[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u};
+        u32 key[2] = {0xa4093822u, 0x299f31d0u};
+        u32 out[4];
+        Philox4x32(counter, key, out);
+        EXPECT_EQ(out[0], 0xd16cfe09u);
+        EXPECT_EQ(out[1], 0x94fdccebu);
+        EXPECT_EQ(out[2], 0x5001e420u);
+        EXPECT_EQ(out[3], 0x24126ea1u);
+    }
+}
+
+TEST(Random, FillMatchesSequence)
+{
+    const u32 count = 1000;
+    u32 bulk[count];
+    f32 bulkF32[count];
+
+    RandomStream a = CreateRandomStream(1234, 5);
+    RandomStream b = CreateRandomStream(1234, 5);
+
+    // Start unaligned to a counter boundary
+    EXPECT_EQ(NextU32(a), NextU32(b));
+    FillRandomU32(a, bulk, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        EXPECT_EQ(bulk[i], NextU32(b));
+    }
+
+    FillRandomF32(a, bulkF32, count, -2.0f, 3.0f);
+    for (u32 i = 0; i < count; i++)
+    {
+        EXPECT_EQ(bulkF32[i], NextF32(b, -2.0f, 3.0f));
+        EXPECT_GE(bulkF32[i], -2.0f);
+        EXPECT_LT(bulkF32[i], 3.0f);
+    }
+}
+
+TEST(Random, NarrowFloatRangesExcludeMax)
+{
+    // One ulp wide, min + (max - min) * u rounds to max for about half of
+    // the values
+    const u32 count = 1001;
+    const f32 min = 1.0f;
+    const f32 max = nextafterf(1.0f, 2.0f);
+    f32 bulk[count];
+
+    RandomStream a = CreateRandomStream(99);
+    RandomStream b = CreateRandomStream(99);
+    FillRandomF32(a, bulk, count, min, max);
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 value = NextF32(b, min, max);
+        EXPECT_EQ(bulk[i], value);
+        EXPECT_GE(value, min);
+        EXPECT_LT(value, max);
+
+        f32 legacy = RandomF32(min, max);
+        EXPECT_GE(legacy, min);
+        EXPECT_LT(legacy, max);
+    }
+
+    const f64 maxF64 = nextafter(1.0, 2.0);
+    for (u32 i = 0; i < count; i++)
+    {
+        f64 value = RandomF64(1.0, maxF64);
+        EXPECT_GE(value, 1.0);
+        EXPECT_LT(value, maxF64);
+    }
+
+    EXPECT_EQ(NextF32(b, 2.0f, 2.0f), 2.0f);
+}
+
+TEST(Random, StreamsAndSeek)
+{
+    RandomStream a = CreateRandomStream(42, 0);
+    RandomStream b = CreateRandomStream(42, 1);
+    u32 equal = 0;
+    for (u32 i = 0; i < 64; i++)
+    {
+        equal += NextU32(a) == NextU32(b);
+    }
+    EXPECT_LT(equal, 2u);
+
+    RandomStream c = CreateRandomStream(42, 0);
+    u32 values[16];
+    FillRandomU32(c, values, 16);
+
+    RandomStream d = CreateRandomStream(42, 0);
+    SeekRandomStream(d, 7);
+    EXPECT_EQ(NextU32(d), values[7]);
+    SeekRandomStream(d, 12);
+    EXPECT_EQ(NextU32(d), values[12]);
+}
+
+TEST(Random, UnbiasedRanges)
+{
+    RandomStream rng = CreateRandomStream(7);
+
+    const u32 bucketCount = 6;
+    const u32 sampleCount = 60000;
+    u32 buckets[bucketCount] = {};
+    for (u32 i = 0; i < sampleCount; i++)
+    {
+        u32 value = NextU32(rng, 10, 15);
+        ASSERT_GE(value, 10u);
+        ASSERT_LE(value, 15u);
+        buckets[value - 10]++;
+    }
+
+    f64 expected = static_cast<f64>(sampleCount) / bucketCount;
+    f64 chiSquare = 0.0;
+    for (u32 i = 0; i < bucketCount; i++)
+    {
+        f64 d = buckets[i] - expected;
+        chiSquare += d * d / expected;
+    }
+    // p = 0.001 for 5 degrees of freedom
+    EXPECT_LT(chiSquare, 20.5);
+
+    for (u32 i = 0; i < 1000; i++)
+    {
+        i32 value = NextI32(rng, -3, 3);
+        EXPECT_GE(value, -3);
+        EXPECT_LE(value, 3);
+
+        u64 wide = NextU64(rng, 1ull << 40, (1ull << 40) + (1ull << 35));
+        EXPECT_GE(wide, 1ull << 40);
+        EXPECT_LE(wide, (1ull << 40) + (1ull << 35));
+
+        i32 legacy = RandomI32(-5, 5);
+        EXPECT_GE(legacy, -5);
+        EXPECT_LE(legacy, 5);
+
+        f32 unit = RandomF32(0.0f, 1.0f);
+        EXPECT_GE(unit, 0.0f);
+        EXPECT_LT(unit, 1.0f);
+    }
+
+    EXPECT_EQ(NextU32(rng, 3, 3), 3u);
+    EXPECT_EQ(RandomI64(-9, -9), -9);
+}